@@ -0,0 +1,520 @@
+// Headless benchmarks for the editor core.
+// Everything runs on a ZepEditor with a null display and the standard file system, with threads disabled so
+// that each pass runs start to finish on this thread; the text is generated from a fixed seed, so runs can be
+// compared with each other.
+//
+// zep_bench [--filter <text>] [--sizes <MB,MB,...>] [--repeat <n>] [--out <file.json>]
+// zep_bench --replay <keys.zkeys> [--file <text file>] [--out <file.json>]
+//
+// A replay sends the keys recorded with :ZRecord to the file (or an empty buffer), as fast as they are taken,
+// and reports the time in each command and in each profiled scope.
+
+#include <algorithm>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <functional>
+#include <iostream>
+#include <random>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "zep/buffer.h"
+#include "zep/display.h"
+#include "zep/editor.h"
+#include "zep/filesystem.h"
+#include "zep/gap_buffer.h"
+#include "zep/key_replay.h"
+#include "zep/keymap.h"
+#include "zep/mode.h"
+#include "zep/syntax.h"
+#include "zep/tab_window.h"
+#include "zep/window.h"
+
+// Count the allocations, for the replay report
+#include "zep/mcommon/memory_hooks.h"
+
+using namespace Zep;
+
+namespace
+{
+
+const uint32_t Seed = 1234;
+const size_t MB = 1024 * 1024;
+
+// Only the time between Start and Stop is counted, so each run can set up what it needs first
+struct BenchRun
+{
+    uint64_t elapsed = 0;
+    uint64_t started = 0;
+    uint64_t bytes = 0;
+    uint64_t items = 0;
+
+    void Start()
+    {
+        started = timer_get_time_now();
+    }
+
+    void Stop()
+    {
+        elapsed += timer_get_time_now() - started;
+    }
+};
+
+struct Benchmark
+{
+    std::string name;
+    std::function<void(BenchRun&)> fnRun;
+};
+
+struct BenchResult
+{
+    std::string name;
+    std::vector<uint64_t> samples;
+    uint64_t bytes = 0;
+    uint64_t items = 0;
+};
+
+struct BenchOptions
+{
+    std::string filter;
+    std::vector<size_t> sizes = { 10 };
+    uint32_t repeat = 5;
+    std::string outPath;
+    std::string replayPath;
+    std::string replayFile;
+    ZepPath root;
+};
+
+// Lines picked at random until the text is big enough
+std::string MakeText(const std::vector<std::string>& lines, size_t size, uint32_t seed = Seed)
+{
+    std::mt19937 rng(seed);
+    std::string text;
+    text.reserve(size + 256);
+    while (text.size() < size)
+    {
+        text += lines[rng() % lines.size()];
+        text += '\n';
+    }
+    return text;
+}
+
+const std::vector<std::string> TextLines = {
+    "The quick brown fox jumps over the lazy dog.",
+    "Pack my box with five dozen liquor jugs.",
+    "",
+    "    Indented text, with a tab\tand some punctuation: (a, b) [c] {d}",
+    "Numbers 0123456789 and symbols !@#$%^&*",
+};
+
+struct SyntaxSample
+{
+    std::string extension;
+    std::vector<std::string> lines;
+};
+
+const std::vector<SyntaxSample> SyntaxSamples = {
+    { ".txt", TextLines },
+    { ".cpp", { "#include <vector>", "int function_name(int a, float b) { return a + int(b); } // comment", "/* block", "   comment */ static const char* text = \"string\";", "class Widget : public Base", "{", "};", "    for (size_t i = 0; i < count; i++) total += values[i];" } },
+    { ".lisp", { "(define (square x) (* x x)) ; comment", "(let ((a 1) (b \"two\")) (list a b))", "(if (> n 0) (fact (- n 1)) 1)" } },
+    { ".cmake", { "set(SOURCES main.cpp util.cpp)", "if (WIN32) # comment", "endif()", "target_link_libraries(app PRIVATE lib)" } },
+    { ".toml", { "[section]", "key = \"value\" # comment", "number = 42", "enabled = true" } },
+    { ".md", { "# Heading", "Some *emphasis* and **strong** text with `code`.", "- list item", "[link](http://example.com)", "" } },
+    { ".vert", { "#version 330", "uniform mat4 world;", "void main() { gl_Position = world * vec4(pos, 1.0); }" } },
+};
+
+std::shared_ptr<ZepEditor> MakeEditor(const BenchOptions& options)
+{
+    auto spEditor = std::make_shared<ZepEditor>(new ZepDisplayNull(), options.root, ZepEditorFlags::DisableThreads, new ZepFileSystemCPP(options.root));
+    spEditor->SetDisplayRegion(NVec2f(0.0f, 0.0f), NVec2f(1024.0f, 1024.0f));
+    return spEditor;
+}
+
+std::string SizeName(size_t megabytes)
+{
+    return std::to_string(megabytes) + "MB";
+}
+
+void AddGapBufferBenchmarks(std::vector<Benchmark>& benchmarks)
+{
+    const size_t Count = 100000;
+    const size_t InitialSize = MB;
+
+    benchmarks.push_back({ "gap_buffer/append", [=](BenchRun& run) {
+                              GapBuffer<uint8_t> buffer;
+                              const uint8_t text[] = "append";
+                              run.Start();
+                              for (size_t i = 0; i < Count; i++)
+                              {
+                                  buffer.insert(buffer.end(), text, text + sizeof(text) - 1);
+                              }
+                              run.Stop();
+                              run.items = Count;
+                          } });
+
+    // Typing: each insert goes just after the last one
+    benchmarks.push_back({ "gap_buffer/insert_typing", [=](BenchRun& run) {
+                              GapBuffer<uint8_t> buffer;
+                              buffer.assign(InitialSize, uint8_t('a'));
+                              auto pos = InitialSize / 2;
+                              const uint8_t ch = 'b';
+                              run.Start();
+                              for (size_t i = 0; i < Count; i++)
+                              {
+                                  buffer.insert(buffer.begin() + pos++, &ch, &ch + 1);
+                              }
+                              run.Stop();
+                              run.items = Count;
+                          } });
+
+    // The gap moves every time
+    benchmarks.push_back({ "gap_buffer/insert_random", [=](BenchRun& run) {
+                              GapBuffer<uint8_t> buffer;
+                              buffer.assign(InitialSize, uint8_t('a'));
+                              std::mt19937 rng(Seed);
+                              const uint8_t ch = 'b';
+                              run.Start();
+                              for (size_t i = 0; i < Count; i++)
+                              {
+                                  buffer.insert(buffer.begin() + rng() % buffer.size(), &ch, &ch + 1);
+                              }
+                              run.Stop();
+                              run.items = Count;
+                          } });
+
+    // Backspace
+    benchmarks.push_back({ "gap_buffer/erase_typing", [=](BenchRun& run) {
+                              GapBuffer<uint8_t> buffer;
+                              buffer.assign(InitialSize, uint8_t('a'));
+                              auto pos = InitialSize / 2;
+                              run.Start();
+                              for (size_t i = 0; i < Count; i++)
+                              {
+                                  pos--;
+                                  buffer.erase(buffer.begin() + pos, buffer.begin() + pos + 1);
+                              }
+                              run.Stop();
+                              run.items = Count;
+                          } });
+
+    benchmarks.push_back({ "gap_buffer/erase_random", [=](BenchRun& run) {
+                              GapBuffer<uint8_t> buffer;
+                              buffer.assign(InitialSize, uint8_t('a'));
+                              std::mt19937 rng(Seed);
+                              run.Start();
+                              for (size_t i = 0; i < Count; i++)
+                              {
+                                  auto pos = rng() % (buffer.size() - 1);
+                                  buffer.erase(buffer.begin() + pos, buffer.begin() + pos + 1);
+                              }
+                              run.Stop();
+                              run.items = Count;
+                          } });
+}
+
+void AddBufferBenchmarks(std::vector<Benchmark>& benchmarks, const BenchOptions& options)
+{
+    for (auto size : options.sizes)
+    {
+        auto bytes = size * MB;
+
+        benchmarks.push_back({ "buffer/set_text/" + SizeName(size), [=](BenchRun& run) {
+                                  auto spEditor = MakeEditor(options);
+                                  auto pBuffer = spEditor->GetEmptyBuffer("bench.txt");
+                                  auto text = MakeText(TextLines, bytes);
+                                  run.Start();
+                                  pBuffer->SetText(text);
+                                  run.Stop();
+                                  run.bytes = text.size();
+                              } });
+
+        benchmarks.push_back({ "buffer/save/" + SizeName(size), [=](BenchRun& run) {
+                                  auto spEditor = MakeEditor(options);
+                                  auto path = options.root / "zep_bench_save.txt";
+                                  auto pBuffer = spEditor->GetFileBuffer(path);
+                                  pBuffer->SetText(MakeText(TextLines, bytes));
+                                  int64_t written = 0;
+                                  run.Start();
+                                  pBuffer->Save(written);
+                                  run.Stop();
+                                  run.bytes = uint64_t(written);
+                                  std::error_code ec;
+                                  std::filesystem::remove(path.string(), ec);
+                              } });
+
+        // A search that has to look at the whole buffer
+        benchmarks.push_back({ "buffer/find/" + SizeName(size), [=](BenchRun& run) {
+                                  auto spEditor = MakeEditor(options);
+                                  auto pBuffer = spEditor->GetEmptyBuffer("bench.txt");
+                                  pBuffer->SetText(MakeText(TextLines, bytes));
+                                  const char* pFind = "not in the text";
+                                  run.Start();
+                                  auto found = pBuffer->Find(pBuffer->Begin(), (const uint8_t*)pFind, nullptr);
+                                  run.Stop();
+                                  run.bytes = uint64_t(pBuffer->GetWorkingBuffer().size());
+                                  if (found.Valid() && found != pBuffer->End())
+                                  {
+                                      std::cerr << "Unexpected match in buffer/find\n";
+                                  }
+                              } });
+    }
+}
+
+void AddSyntaxBenchmarks(std::vector<Benchmark>& benchmarks, const BenchOptions& options)
+{
+    // Setting the text runs the whole syntax pass; the .txt run has no syntax, so is the cost of the text alone
+    auto size = options.sizes.front();
+    for (auto& sample : SyntaxSamples)
+    {
+        benchmarks.push_back({ "syntax/" + sample.extension.substr(1) + "/" + SizeName(size), [=](BenchRun& run) {
+                                  auto spEditor = MakeEditor(options);
+                                  auto pBuffer = spEditor->GetEmptyBuffer("bench" + sample.extension);
+                                  auto text = MakeText(sample.lines, size * MB);
+                                  run.Start();
+                                  pBuffer->SetText(text);
+                                  if (pBuffer->GetSyntax())
+                                  {
+                                      pBuffer->GetSyntax()->Wait();
+                                  }
+                                  run.Stop();
+                                  run.bytes = text.size();
+                              } });
+    }
+}
+
+void AddWindowBenchmarks(std::vector<Benchmark>& benchmarks, const BenchOptions& options)
+{
+    // The line spans are rebuilt for the whole buffer when the layout is dirty; drawing to the null display
+    // is close to free
+    auto size = options.sizes.front();
+    benchmarks.push_back({ "window/layout/" + SizeName(size), [=](BenchRun& run) {
+                              auto spEditor = MakeEditor(options);
+                              auto pBuffer = spEditor->InitWithText("bench.txt", MakeText(TextLines, size * MB));
+                              auto pWindow = spEditor->GetActiveTabWindow()->GetActiveWindow();
+                              spEditor->Display();
+                              pWindow->DirtyLayout();
+                              run.Start();
+                              spEditor->Display();
+                              run.Stop();
+                              run.bytes = uint64_t(pBuffer->GetWorkingBuffer().size());
+                          } });
+}
+
+void AddKeymapBenchmarks(std::vector<Benchmark>& benchmarks, const BenchOptions& options)
+{
+    const size_t Count = 100000;
+    benchmarks.push_back({ "keymap/find", [=](BenchRun& run) {
+                              auto spEditor = MakeEditor(options);
+                              auto& keyMap = spEditor->GetGlobalMode()->GetKeyMappings(EditorMode::Normal);
+                              const std::vector<std::string> commands = { "j", "dd", "3dw", "ciw", "gg", "\"ayy", "<C-r>", "2", "d", "zzz" };
+                              run.Start();
+                              for (size_t i = 0; i < Count; i++)
+                              {
+                                  KeyMapResult result;
+                                  keymap_find(keyMap, commands[i % commands.size()], result);
+                              }
+                              run.Stop();
+                              run.items = Count;
+                          } });
+}
+
+uint64_t Median(std::vector<uint64_t> samples)
+{
+    std::sort(samples.begin(), samples.end());
+    return samples[samples.size() / 2];
+}
+
+void WriteJson(std::ostream& str, const std::vector<BenchResult>& results, const BenchOptions& options)
+{
+    str << "{\n  \"version\": 1,\n  \"seed\": " << Seed << ",\n  \"repeat\": " << options.repeat << ",\n  \"benchmarks\": [";
+    for (size_t index = 0; index < results.size(); index++)
+    {
+        auto& result = results[index];
+        auto median = Median(result.samples);
+        uint64_t total = 0;
+        for (auto& sample : result.samples)
+        {
+            total += sample;
+        }
+
+        str << (index == 0 ? "\n" : ",\n");
+        str << "    { \"name\": \"" << result.name << "\"";
+        str << ", \"iterations\": " << result.samples.size();
+        str << ", \"min_us\": " << *std::min_element(result.samples.begin(), result.samples.end());
+        str << ", \"median_us\": " << median;
+        str << ", \"mean_us\": " << total / result.samples.size();
+        str << ", \"max_us\": " << *std::max_element(result.samples.begin(), result.samples.end());
+        if (result.bytes)
+        {
+            str << ", \"bytes\": " << result.bytes;
+            str << ", \"mb_per_s\": " << (median ? double(result.bytes) / MB / timer_to_seconds(median) : 0.0);
+        }
+        if (result.items)
+        {
+            str << ", \"items\": " << result.items;
+            str << ", \"ns_per_item\": " << double(median) * 1000.0 / double(result.items);
+        }
+        str << " }";
+    }
+    str << "\n  ]\n}\n";
+}
+
+bool ParseArgs(int argc, char* argv[], BenchOptions& options)
+{
+    for (int arg = 1; arg < argc; arg++)
+    {
+        std::string name = argv[arg];
+        if (name == "--help" || name == "-h" || arg + 1 >= argc)
+        {
+            return false;
+        }
+
+        std::string value = argv[++arg];
+        if (name == "--filter")
+        {
+            options.filter = value;
+        }
+        else if (name == "--out")
+        {
+            options.outPath = value;
+        }
+        else if (name == "--replay")
+        {
+            options.replayPath = value;
+        }
+        else if (name == "--file")
+        {
+            options.replayFile = value;
+        }
+        else if (name == "--repeat")
+        {
+            options.repeat = std::max(1, std::atoi(value.c_str()));
+        }
+        else if (name == "--sizes")
+        {
+            options.sizes.clear();
+            std::istringstream str(value);
+            std::string size;
+            while (std::getline(str, size, ','))
+            {
+                if (std::atoi(size.c_str()) > 0)
+                {
+                    options.sizes.push_back(size_t(std::atoi(size.c_str())));
+                }
+            }
+            if (options.sizes.empty())
+            {
+                return false;
+            }
+        }
+        else
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+bool WriteOutput(const BenchOptions& options, const std::function<void(std::ostream&)>& fnWrite)
+{
+    if (options.outPath.empty())
+    {
+        fnWrite(std::cout);
+        return true;
+    }
+
+    std::ofstream out(options.outPath);
+    fnWrite(out);
+    if (!out)
+    {
+        std::cerr << "Can't write " << options.outPath << "\n";
+        return false;
+    }
+    return true;
+}
+
+int RunReplay(const BenchOptions& options)
+{
+    auto spEditor = MakeEditor(options);
+
+    KeyRecording recording;
+    if (!recording.Load(spEditor->GetFileSystem(), ZepPath(options.replayPath)))
+    {
+        std::cerr << "Can't read " << options.replayPath << "\n";
+        return 1;
+    }
+
+    if (options.replayFile.empty())
+    {
+        spEditor->InitWithText("replay.txt", "");
+    }
+    else
+    {
+        spEditor->InitWithFileOrDir(options.replayFile);
+    }
+
+    auto report = ReplayKeys(*spEditor, recording);
+    std::cerr << "replay: " << report.keys << " keys in " << timer_to_ms(report.elapsed) << "ms (recorded over " << timer_to_ms(report.recorded) << "ms)\n";
+
+    return WriteOutput(options, [&](std::ostream& str) { report.WriteJson(str); }) ? 0 : 1;
+}
+
+} // namespace
+
+int main(int argc, char* argv[])
+{
+    BenchOptions options;
+    if (!ParseArgs(argc, argv, options))
+    {
+        std::cerr << "zep_bench [--filter <text>] [--sizes <MB,MB,...>] [--repeat <n>] [--out <file.json>]\n";
+        std::cerr << "zep_bench --replay <keys.zkeys> [--file <text file>] [--out <file.json>]\n";
+        return 1;
+    }
+
+    // Saved files, and the config root; no user config is picked up
+    auto root = std::filesystem::temp_directory_path() / "zep_bench";
+    std::filesystem::create_directories(root);
+    options.root = ZepPath(root.string());
+
+    if (!options.replayPath.empty())
+    {
+        return RunReplay(options);
+    }
+
+    std::vector<Benchmark> benchmarks;
+    AddGapBufferBenchmarks(benchmarks);
+    AddBufferBenchmarks(benchmarks, options);
+    AddSyntaxBenchmarks(benchmarks, options);
+    AddWindowBenchmarks(benchmarks, options);
+    AddKeymapBenchmarks(benchmarks, options);
+
+    std::vector<BenchResult> results;
+    for (auto& benchmark : benchmarks)
+    {
+        if (!options.filter.empty() && benchmark.name.find(options.filter) == std::string::npos)
+        {
+            continue;
+        }
+
+        // One run to warm up the caches and the allocator, which isn't counted
+        BenchResult result;
+        result.name = benchmark.name;
+        for (uint32_t iteration = 0; iteration <= options.repeat; iteration++)
+        {
+            BenchRun run;
+            benchmark.fnRun(run);
+            if (iteration > 0)
+            {
+                result.samples.push_back(run.elapsed);
+                result.bytes = run.bytes;
+                result.items = run.items;
+            }
+        }
+        std::cerr << result.name << ": " << timer_to_ms(Median(result.samples)) << "ms\n";
+        results.push_back(result);
+    }
+
+    return WriteOutput(options, [&](std::ostream& str) { WriteJson(str, results, options); }) ? 0 : 1;
+}
@@ -4,6 +4,7 @@
 // (GL3W is a helper library to access OpenGL functions since there is no standard header to access modern OpenGL functions easily. Alternatives are GLEW, Glad, etc.)
 
 #include <SDL.h>
+#include <cmath>
 #include <stdio.h>
 #include <thread>
 
@@ -38,6 +39,7 @@
 #include IMGUI_IMPL_OPENGL_LOADER_CUSTOM
 #endif
 
+#include "zep/mcommon/animation/profiler.h"
 #include "zep/mcommon/animation/timer.h"
 
 #undef max
@@ -174,6 +176,13 @@ struct ZepContainerImGui : public IZepComponent, public IZepReplProvider
 
         spEditor->RegisterCallback(this);
 
+        // Finished background work, or a refresh request from another thread, ends the wait in the main loop
+        spEditor->SetWakeupCallback([]() {
+            SDL_Event wakeup = {};
+            wakeup.type = SDL_USEREVENT;
+            SDL_PushEvent(&wakeup);
+        });
+
         ZepMode_Orca::Register(*spEditor);
 
         ZepRegressExCommand::Register(*spEditor);
@@ -442,6 +451,9 @@ int main(int argc, char* argv[])
     // ** Zep specific code, before Initializing font map
     ZepContainerImGui zep(startupFile, SDL_GetBasePath());
 
+    // Keep running totals for the Timings menu
+    Zep::profile_start(Zep::ProfileFlags::Totals);
+
     // Setup style
     ImGui::StyleColorsDark();
 
@@ -463,8 +475,10 @@ int main(int argc, char* argv[])
         // - When io.WantCaptureMouse is true, do not dispatch mouse input data to your main application.
         // - When io.WantCaptureKeyboard is true, do not dispatch keyboard input data to your main application.
         // Generally you may always pass all inputs to dear imgui, and hide them from your application based on those two flags.
+        // Sleep until there is input, or the editor has something to do
         SDL_Event event;
-        if (SDL_WaitEventTimeout(&event, 10))
+        auto waitMs = int(std::ceil(zep.spEditor->GetNextWakeup() * 1000.0f));
+        if (SDL_WaitEventTimeout(&event, waitMs) && event.type != SDL_USEREVENT)
         {
             ImGui_ImplSDL2_ProcessEvent(&event);
             if (event.type == SDL_QUIT)
@@ -580,10 +594,10 @@ int main(int argc, char* argv[])
             // Currently on a typical file, editor display time is < 1ms, and editor editor time is < 2ms
             if (ImGui::BeginMenu("Timings"))
             {
-                for (auto& p : globalProfiler.timerData)
+                for (auto& total : Zep::profile_get_totals())
                 {
                     std::ostringstream strval;
-                    strval << p.first << " : " << p.second.current / 1000.0 << "ms"; // << " Last: " << p.second.current / 1000.0 << "ms";
+                    strval << total.name << " : " << total.time / double(std::max(total.count, uint64_t(1))) / 1000.0 << "ms, Max: " << total.max / 1000.0 << "ms";
                     ImGui::MenuItem(strval.str().c_str());
                 }
                 ImGui::EndMenu();
@@ -35,8 +35,6 @@ ZepMode_Orca::ZepMode_Orca(ZepEditor& editor)
 
 ZepMode_Orca::~ZepMode_Orca()
 {
-    GetEditor().UnRegisterCallback(this);
-
     // Shut down any dangling orca threads
     for(auto itrPair : m_mapOrca) 
     {
@@ -50,7 +48,7 @@ void ZepMode_Orca::Init()
 {
     ZepMode_Vim::Init();
 
-    GetEditor().RegisterCallback(this);
+    GetEditor().Subscribe(this, Msg::Buffer);
 }
 
 void ZepMode_Orca::SetupKeyMaps()
@@ -1,6 +1,7 @@
 #pragma once
 
 #include <functional>
+#include <future>
 #include <set>
 
 #include "zep/mcommon/file/path.h"
@@ -13,14 +14,17 @@
 #include "zep/editor.h"
 #include "zep/line_widgets.h"
 #include "zep/range_markers.h"
+#include "zep/undo_log.h"
 
 namespace Zep
 {
 
 class ZepSyntax;
+struct BufferReload;
 class ZepTheme;
 class ZepMode;
 enum class ThemeColor;
+enum class BufferMessageType;
 
 enum class Direction
 {
@@ -54,7 +58,8 @@ enum : uint32_t
     DefaultBuffer = (1 << 8), // Default startup buffer
     HasTabs = (1 << 9),
     HasSpaceTabs = (1 << 10),
-    InsertTabs = (1 << 11)
+    InsertTabs = (1 << 11),
+    ChangedOnDisk = (1 << 12) // Someone else changed the file since we loaded or saved it
 };
 }
 
@@ -73,7 +78,8 @@ enum class BufferType
     Search,
     Repl,
     DataGrid,
-    Tree
+    Tree,
+    VirtualList // Lines come from a callback; only a page of them is in the buffer at any time
 };
 
 // A really big cursor move; which will likely clamp
@@ -108,7 +114,32 @@ struct ChangeRecord
     }
 };
 
+class ZepBuffer;
+
+// The memory held for a buffer, by what holds it; see ZepEditor::GetMemoryUsage.
+// These are estimates of the heap use, from the sizes and capacities of the containers.
+struct BufferMemory
+{
+    const ZepBuffer* pBuffer = nullptr;
+    uint64_t text = 0; // The characters in the gap buffer
+    uint64_t textGap = 0; // Room in it, for inserts
+    uint64_t lineEnds = 0;
+    uint64_t syntax = 0;
+    uint64_t adornments = 0; // Rainbow brackets, and anything else adorning the syntax
+    uint64_t markers = 0;
+    uint64_t undo = 0;
+    uint64_t redo = 0;
+    uint64_t windows = 0; // The line spans of the windows showing the buffer
+    uint64_t hibernated = 0; // The compressed text of a hibernated buffer
+
+    uint64_t Total() const
+    {
+        return text + textGap + lineEnds + syntax + adornments + markers + undo + redo + windows + hibernated;
+    }
+};
+
 using fnKeyNotifier = std::function<bool(uint32_t key, uint32_t modifier)>;
+using fnVirtualLine = std::function<std::string(long line)>;
 class ZepBuffer : public ZepComponent
 {
 public:
@@ -121,6 +152,14 @@ public:
     void Load(const ZepPath& path);
     bool Save(int64_t& size);
 
+    // Bring the buffer in line with its file on disk.  The diff runs on a worker, and only the lines
+    // that differ are replaced, so markers, syntax and cursors outside the changes are left alone
+    void Reload();
+    bool IsReloading() const
+    {
+        return m_reloadActive;
+    }
+
     ZepPath GetFilePath() const;
     std::string GetFileExtension() const;
     void SetFilePath(const ZepPath& path);
@@ -217,7 +256,6 @@ public:
     const std::string& GetName() const;
 
     std::string GetDisplayName() const;
-    virtual void Notify(std::shared_ptr<ZepMessage> message) override;
 
     ZepTheme& GetTheme() const;
     void SetTheme(std::shared_ptr<ZepTheme> spTheme);
@@ -231,6 +269,10 @@ public:
     void ClearRangeMarker(std::shared_ptr<RangeMarker> spMarker);
     void ClearRangeMarkers(const std::set<std::shared_ptr<RangeMarker>>& markers);
     void ClearRangeMarkers(uint32_t types);
+
+    // Replace all the markers of the given types (0 for none) with new ones; one sorted pass over the
+    // marker table and a single MarkersChanged, however many there are
+    std::vector<std::shared_ptr<RangeMarker>> ReplaceRangeMarkers(uint32_t types, const std::vector<RangeMarkerDesc>& markers);
     tRangeMarkers GetRangeMarkers(uint32_t types) const;
     tRangeMarkers GetRangeMarkersOnLine(uint32_t types, long line) const;
     void HideMarkers(uint32_t markerType);
@@ -238,10 +280,21 @@ public:
 
     void ForEachMarker(uint32_t types, Direction dir, const GlyphIterator& begin, const GlyphIterator& end, std::function<bool(const std::shared_ptr<RangeMarker>&)> fnCB) const;
     std::shared_ptr<RangeMarker> FindNextMarker(GlyphIterator start, Direction dir, uint32_t markerType);
+    const RangeMarkerTable& GetRangeMarkerTable() const
+    {
+        return m_markerTable;
+    }
 
     void SetBufferType(BufferType type);
     BufferType GetBufferType() const;
 
+    // Virtual lists; the buffer text is just the page of lines [start, start + count)
+    void SetVirtualList(long lineCount, fnVirtualLine fnGetLine);
+    bool SetVirtualPage(long startLine, long pageLines);
+    long GetVirtualLineCount() const;
+    long GetVirtualPageStart() const;
+    long GetVirtualPageLines() const;
+
     void SetLastEditLocation(GlyphIterator loc);
     GlyphIterator GetLastEditLocation();
 
@@ -260,6 +313,31 @@ public:
 
     bool IsHidden() const;
 
+    UndoLog& GetUndoLog()
+    {
+        return m_undoLog;
+    }
+
+    // A hidden buffer can give up its text and syntax until it is next used.  A clean one reads its file
+    // again when it wakes; the rest keep their text compressed.  Markers, undo and file flags are kept
+    // as they are, and the text comes back just as it was, so they still line up.
+    bool Hibernate();
+    void Wake(); // Also marks the buffer as just used
+    bool IsHibernated() const
+    {
+        return m_hibernated;
+    }
+    uint64_t GetLastUsedTime() const
+    {
+        return m_lastUsedTime;
+    }
+
+    // The text, syntax, markers and undo; the editor adds what the windows hold for the buffer
+    void AddMemoryUsage(BufferMemory& memory) const;
+
+    // Compare the file on disk with the one we loaded or saved; flags the buffer if it changed
+    bool CheckDiskState();
+
     bool HasFileFlags(uint32_t flags) const;
     void SetFileFlags(uint32_t flags, bool set = true);
     void ClearFileFlags(uint32_t flags);
@@ -280,8 +358,16 @@ public:
     Zep::signal<void(ZepBuffer& buffer, const GlyphIterator&, const std::string&)> sigPreInsert;
     Zep::signal<void(ZepBuffer& buffer, const GlyphIterator&, const GlyphIterator&)> sigPreDelete;
 
+    // Send the edits held back by ZepEditor::BeginBufferChanges
+    void FlushChanges();
+
 private:
     void MarkUpdate();
+    void RecordDiskState();
+    void FinishReload(const BufferReload& reload);
+    void ApplyReload(const BufferReload& reload);
+    void Broadcast(BufferMessageType type, const GlyphIterator& startLocation, const GlyphIterator& endLocation);
+    void AddDamage(BufferMessageType type, long start, long end);
 
 private:
     // Buffer & record of the line end locations
@@ -297,6 +383,22 @@ private:
     GlyphIterator m_lastEditLocation; // = 0;
     uint64_t m_updateCount = 0;
     uint64_t m_lastUpdateTime = 0;
+    uint64_t m_diskModifiedTime = 0;
+    uint64_t m_diskSize = 0;
+    std::future<void> m_reloadResult;
+    bool m_reloadActive = false;
+
+    // What the held back edits have touched, in the current offsets, and how much they grew the buffer
+    long m_damageStart = -1;
+    long m_damageEnd = 0;
+    long m_damageGrowth = 0;
+
+    // Hibernation; the text is compressed, or left to the file, with a hash to check the file against
+    bool m_hibernated = false;
+    bool m_hibernatedOnDisk = false;
+    std::string m_hibernatedText;
+    uint64_t m_hibernatedHash = 0;
+    uint64_t m_lastUsedTime = 0;
 
     // Syntax and theme
     std::shared_ptr<ZepSyntax> m_spSyntax;
@@ -306,7 +408,14 @@ private:
 
     // Selections
     GlyphRange m_selection;
-    tRangeMarkers m_rangeMarkers;
+    RangeMarkerTable m_markerTable;
+    UndoLog m_undoLog;
+
+    // Virtual list
+    fnVirtualLine m_fnVirtualLine;
+    long m_virtualLineCount = 0;
+    long m_virtualPageStart = 0;
+    long m_virtualPageLines = 128;
 
     // Modes
     std::shared_ptr<ZepMode> m_spMode;
@@ -322,7 +431,9 @@ enum class BufferMessageType
     TextDeleted,
     TextAdded,
     Loaded,
-    MarkersChanged
+    MarkersChanged,
+    // A batch of edits; startLocation..endLocation now holds what was startLocation..oldEndLocation
+    TextReplaced
 };
 
 struct BufferMessage : public ZepMessage
@@ -333,6 +444,17 @@ struct BufferMessage : public ZepMessage
         , type(messageType)
         , startLocation(startLoc)
         , endLocation(endLoc)
+        , oldEndLocation(endLoc)
+    {
+    }
+
+    BufferMessage(ZepBuffer* pBuff, BufferMessageType messageType, const GlyphIterator& startLoc, const GlyphIterator& endLoc, const GlyphIterator& oldEndLoc)
+        : ZepMessage(Msg::Buffer)
+        , pBuffer(pBuff)
+        , type(messageType)
+        , startLocation(startLoc)
+        , endLocation(endLoc)
+        , oldEndLocation(oldEndLoc)
     {
     }
 
@@ -340,6 +462,7 @@ struct BufferMessage : public ZepMessage
     BufferMessageType type;
     GlyphIterator startLocation;
     GlyphIterator endLocation;
+    GlyphIterator oldEndLocation; // TextReplaced only
 };
 
 } // namespace Zep
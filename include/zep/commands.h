@@ -1,6 +1,7 @@
 #pragma once
 
 #include "zep/buffer.h"
+#include "zep/undo_log.h"
 
 namespace Zep
 {
@@ -19,8 +20,9 @@ public:
     {
     }
 
+    // Make the change, then say what it did, for undo
     virtual void Redo() = 0;
-    virtual void Undo() = 0;
+    virtual void RecordUndo(UndoLog& undoLog) const = 0;
 
     virtual GlyphIterator GetCursorAfter() const
     {
@@ -31,6 +33,11 @@ public:
         return m_cursorBefore;
     }
 
+    ZepBuffer& GetBuffer() const
+    {
+        return m_buffer;
+    }
+
 protected:
     ZepBuffer& m_buffer;
     GlyphIterator m_cursorBefore;
@@ -38,22 +45,6 @@ protected:
     ChangeRecord m_changeRecord;
 };
 
-class ZepCommand_GroupMarker : public ZepCommand
-{
-public:
-    ZepCommand_GroupMarker(ZepBuffer& currentMode) : ZepCommand(currentMode) {}
-    virtual void Redo() override {};
-    virtual void Undo() override {};
-};
-
-class ZepCommand_EndGroup : public ZepCommand
-{
-public:
-    ZepCommand_EndGroup(ZepBuffer& currentMode) : ZepCommand(currentMode) {}
-    virtual void Redo() override {};
-    virtual void Undo() override {};
-};
-
 class ZepCommand_DeleteRange : public ZepCommand
 {
 public:
@@ -61,7 +52,7 @@ public:
     virtual ~ZepCommand_DeleteRange(){};
 
     virtual void Redo() override;
-    virtual void Undo() override;
+    virtual void RecordUndo(UndoLog& undoLog) const override;
 
     GlyphIterator m_startIndex;
     GlyphIterator m_endIndex;
@@ -74,7 +65,7 @@ public:
     virtual ~ZepCommand_ReplaceRange(){};
 
     virtual void Redo() override;
-    virtual void Undo() override;
+    virtual void RecordUndo(UndoLog& undoLog) const override;
 
     GlyphIterator m_startIndex;
     GlyphIterator m_endIndex;
@@ -91,7 +82,7 @@ public:
     virtual ~ZepCommand_Insert(){};
 
     virtual void Redo() override;
-    virtual void Undo() override;
+    virtual void RecordUndo(UndoLog& undoLog) const override;
 
     GlyphIterator m_startIndex;
     std::string m_strInsert;
@@ -1,20 +1,27 @@
 #pragma once
 
+#include <initializer_list>
 #include <map>
 #include <memory>
+#include <mutex>
 #include <ostream>
 #include <set>
 #include <sstream>
 #include <string>
+#include <unordered_map>
 #include <vector>
 #include "zep_config.h"
 
 #include "zep/mcommon/math/math.h"
+#include "zep/mcommon/animation/histogram.h"
+#include "zep/mcommon/animation/profiler.h"
 #include "zep/mcommon/animation/timer.h"
+#include "zep/mcommon/memory.h"
 #include "zep/mcommon/threadpool.h"
 #include "zep/mcommon/file/path.h"
 #include "zep/mcommon/file/cpptoml.h"
 
+#include "zep/filesystem.h"
 #include "zep/keymap.h"
 
 #include "splits.h"
@@ -52,6 +59,8 @@ class ZepTheme;
 class ZepDisplay;
 class IZepFileSystem;
 class Indexer;
+struct KeyRecording;
+struct BufferMemory;
 
 struct Region;
 
@@ -93,7 +102,9 @@ enum class Msg
     ComponentChanged,
     Tick,
     ConfigChanged,
-    ToolTip
+    ToolTip,
+    FilesChanged, // See ZepEditor::GetFileEvents
+    Count
 };
 
 struct IZepComponent;
@@ -133,10 +144,18 @@ struct IZepComponent
     virtual ZepEditor& GetEditor() const = 0;
 };
 
+// What a component hears about: every message, as components always have, or only what it subscribes to (see
+// ZepEditor::Subscribe). Zep's own components, and modes and ex commands, subscribe to what they handle.
+enum class ComponentMessages
+{
+    All,
+    Subscribed
+};
+
 class ZepComponent : public IZepComponent
 {
 public:
-    ZepComponent(ZepEditor& editor);
+    ZepComponent(ZepEditor& editor, ComponentMessages messages = ComponentMessages::All);
     virtual ~ZepComponent();
     ZepEditor& GetEditor() const override
     {
@@ -209,6 +228,18 @@ enum class EditorStyle
     Minimal
 };
 
+// The time from a key press to the end of the frame that shows it, in stages
+enum class LatencyStage
+{
+    Command, // Running whatever the key maps to
+    Edit, // Telling listeners about the buffer changes
+    Queue, // Waiting for the host to draw
+    Layout, // Window layout in the next Display
+    Draw, // The rest of the Display
+    Total, // Key press to the end of the Display
+    Count
+};
+
 struct EditorConfig
 {
     uint32_t showScrollBar = 1;
@@ -224,7 +255,11 @@ struct EditorConfig
     bool autoHideCommandRegion = true;
     bool cursorLineSolid = false;
     bool showNormalModeKeyStrokes = false;
+    bool showLatency = false;
     bool searchGitRoot = true;
+    uint32_t hibernateBudget = 512; // MB the buffers may hold before hidden ones hibernate; 0 for no limit
+    uint32_t undoBudget = 64; // MB of undo history per buffer; 0 for no limit
+    bool undoSpill = false; // Past the budget, history goes to a scratch file rather than away
     float backgroundFadeTime = 60.0f;
     float backgroundFadeWait = 60.0f;
 };
@@ -233,7 +268,7 @@ class ZepExCommand : public ZepComponent
 {
 public:
     ZepExCommand(ZepEditor& editor)
-        : ZepComponent(editor)
+        : ZepComponent(editor, ComponentMessages::Subscribed)
     {}
     virtual ~ZepExCommand() {}
     virtual void Run(const std::vector<std::string>& args = {}) = 0;
@@ -283,13 +318,81 @@ public:
 
     void RegisterSyntaxFactory(const std::vector<std::string>& mappings, SyntaxProvider factory);
     bool Broadcast(std::shared_ptr<ZepMessage> payload);
-    void RegisterCallback(IZepComponent* pClient)
+
+    // Sends a message that lives on the caller's stack; listeners must not keep hold of it
+    bool Broadcast(ZepMessage& message);
+
+    // Components only hear about the messages they subscribe to.
+    // A Buffer subscription can be narrowed to the messages from one buffer.
+    void Subscribe(IZepComponent* pClient, Msg id, const ZepBuffer* pBuffer = nullptr);
+    void Subscribe(IZepComponent* pClient, std::initializer_list<Msg> ids);
+    void Unsubscribe(IZepComponent* pClient, Msg id, const ZepBuffer* pBuffer = nullptr);
+    void Unsubscribe(IZepComponent* pClient);
+
+    // Scheduling, so that the host can sleep while nothing is happening.
+    // A component is sent a Tick of its own when its deadline passes, or once fnReady says what it waits for
+    // has arrived; only one of each is kept per component.
+    void ScheduleTick(IZepComponent* pClient, float seconds);
+    void TickWhenReady(IZepComponent* pClient, std::function<bool()> fnReady);
+    void CancelTicks(IZepComponent* pClient);
+
+    // Seconds until RefreshRequired next has something to do.
+    // The host can block on input for this long; the wakeup callback ends the wait early, from any thread,
+    // when background work finishes or a refresh is requested.
+    float GetNextWakeup() const;
+    void SetWakeupCallback(std::function<void()> fnWakeup);
+    void Wake();
+
+    // Work finished on the thread pool hands its result back through here; any thread can post, and the
+    // functions run on the main thread, in order, at the start of the next refresh.
+    // What is posted for a component is dropped when it unsubscribes; it must wait for its own tasks before then.
+    void PostToMainThread(IZepComponent* pOwner, std::function<void()> fn);
+    void CancelPosts(IZepComponent* pOwner);
+
+    // Text changes made to a buffer between these reach its listeners as a single TextReplaced,
+    // when the outermost EndBufferChanges is reached
+    void BeginBufferChanges();
+    void EndBufferChanges();
+
+    // Key to frame latency, in microseconds.
+    // Each key is timed from BeginInputLatency through to the end of the next Display; frames with no keys
+    // waiting on them aren't counted.
+    void BeginInputLatency();
+    void MarkInputLatency(LatencyStage stage);
+    void EndInputLatency();
+    void AddLayoutLatency(uint64_t time);
+    const LatencyHistogram& GetLatency(LatencyStage stage) const;
+    void ResetLatency();
+    static const char* GetLatencyStageName(LatencyStage stage);
+
+    // Keys given to the modes from the host, for replaying later; keys sent from inside a key are left out
+    void StartKeyRecording();
+    std::shared_ptr<KeyRecording> StopKeyRecording();
+    void RecordKey(uint32_t key, uint32_t modifiers);
+
+    // Time spent handling the keys of each mapped command, by the command's id; off unless enabled.
+    // Typed text and the first keys of longer commands come under "(unmapped)"
+    void EnableCommandTimes(bool enable);
+    void AddCommandTime(const StringId& id, uint64_t time);
+    std::vector<ProfileTotal> GetCommandTimes() const;
+
+    // Allocations made on the main thread for each "frame", "key" and ex command (by its name).
+    // Only counted when the program includes zep/mcommon/memory_hooks.h
+    void AddAllocations(const std::string& scope, const AllocationCounts& counts);
+    const std::map<std::string, AllocationTotal>& GetAllocations() const;
+    void ResetAllocations();
+    bool IsBatchingBufferChanges() const
     {
-        m_notifyClients.insert(pClient);
+        return m_bufferChangeDepth > 0;
     }
+    void QueueBufferChanges(ZepBuffer& buffer);
+    void CancelBufferChanges(ZepBuffer& buffer);
+
+    // Every message; for the host application
+    void RegisterCallback(IZepComponent* pClient);
     void UnRegisterCallback(IZepComponent* pClient)
     {
-        m_notifyClients.erase(pClient);
+        Unsubscribe(pClient);
     }
 
     const tBuffers& GetBuffers() const;
@@ -300,6 +403,14 @@ public:
     ZepBuffer* GetEmptyBuffer(const std::string& name, uint32_t fileFlags = 0);
     void RemoveBuffer(ZepBuffer* pBuffer);
     std::vector<ZepWindow*> FindBufferWindows(const ZepBuffer* pBuffer) const;
+
+    // What each buffer holds, along with its undo and its windows; biggest first
+    std::vector<BufferMemory> GetMemoryUsage() const;
+
+    // Hibernate hidden buffers, the least recently used first, until the buffers hold no more than the
+    // budget in bytes; returns how many went.  UpdateHibernation does it with the configured budget.
+    uint32_t HibernateBuffers(uint64_t budget);
+    void UpdateHibernation();
     ZepBuffer* GetActiveBuffer() const;
     ZepBuffer* FindFileBuffer(const ZepPath& filePath);
     ZepWindow* EnsureWindow(ZepBuffer& buffer);
@@ -389,9 +500,21 @@ public:
 
     ThreadPool& GetThreadPool() const;
 
+    // Only present when the project indexer is enabled
+    Indexer* GetIndexer() const
+    {
+        return m_indexer.get();
+    }
+
     // Used to inform when a file changes - called from outside zep by the platform specific code, if possible
     virtual void OnFileChanged(const ZepPath& path);
 
+    // The file system changes behind the current FilesChanged message
+    const std::vector<ZepFileEvent>& GetFileEvents() const
+    {
+        return m_fileEvents;
+    }
+
     ZepBuffer* GetBufferFromHandle(uint64_t handle);
 
 private:
@@ -400,6 +523,15 @@ private:
     ZepBuffer* CreateNewBuffer(const ZepPath& path);
 
     void InitBuffer(ZepBuffer& buffer);
+    void UpdateFileEvents();
+
+    std::vector<IZepComponent*>* FindSubscribers(Msg id, const ZepBuffer* pBuffer, bool create);
+    bool Dispatch(std::vector<IZepComponent*>* pSubscribers, const std::shared_ptr<ZepMessage>& message);
+    void CompactSubscribers();
+    void RunScheduledTicks();
+    void RunPosts();
+    void UpdateLatency(uint64_t frameStart);
+    void DisplayLatency();
     void InitDataGrid(ZepBuffer& buffer, const NVec2i& dimensions);
 
     // Ensure there is a valid tab window and return it
@@ -409,7 +541,55 @@ private:
     ZepDisplay* m_pDisplay;
     IZepFileSystem* m_pFileSystem;
 
-    std::set<IZepComponent*> m_notifyClients;
+    // Listeners for each message id, and for the Buffer messages of each buffer, in subscription order.
+    // Leaving during a broadcast clears the slot; the lists are compacted when the outermost broadcast ends.
+    std::vector<IZepComponent*> m_subscribers[size_t(Msg::Count)];
+    std::unordered_map<const ZepBuffer*, std::vector<IZepComponent*>> m_bufferSubscribers;
+    std::unordered_map<IZepComponent*, std::vector<std::pair<Msg, const ZepBuffer*>>> m_subscriptions;
+    std::vector<std::pair<Msg, const ZepBuffer*>> m_dirtySubscribers;
+    uint32_t m_broadcastDepth = 0;
+
+    struct ScheduledTick
+    {
+        IZepComponent* pClient = nullptr;
+        uint64_t dueTime = 0;
+        std::function<bool()> fnReady;
+    };
+    std::vector<ScheduledTick> m_scheduledTicks;
+    std::vector<IZepComponent*> m_dueTicks;
+    std::function<void()> m_fnWakeup;
+    std::atomic_bool m_bWoken = false;
+
+    struct PostedCall
+    {
+        IZepComponent* pOwner = nullptr;
+        std::function<void()> fn;
+    };
+    std::mutex m_postMutex;
+    std::vector<PostedCall> m_posts;
+    std::vector<PostedCall> m_runningPosts;
+
+    struct PendingInput
+    {
+        uint64_t arrived = 0;
+        uint64_t commandDone = 0;
+        uint64_t editDone = 0;
+    };
+    std::vector<PendingInput> m_pendingInputs;
+    uint32_t m_inputDepth = 0;
+    uint64_t m_frameLayoutTime = 0;
+    LatencyHistogram m_latency[size_t(LatencyStage::Count)];
+
+    std::shared_ptr<KeyRecording> m_spKeyRecording;
+    uint64_t m_keyRecordingStart = 0;
+    std::map<StringId, ProfileTotal> m_commandTimes;
+    bool m_timeCommands = false;
+
+    AllocationScope m_keyAllocations;
+    std::map<std::string, AllocationTotal> m_allocations;
+
+    uint32_t m_bufferChangeDepth = 0;
+    std::vector<ZepBuffer*> m_changedBuffers;
     mutable tRegisters m_registers;
 
     std::shared_ptr<ZepTheme> m_spTheme;
@@ -458,6 +638,8 @@ private:
     std::unique_ptr<ThreadPool> m_threadPool;
 
     std::shared_ptr<Indexer> m_indexer;
+
+    std::vector<ZepFileEvent> m_fileEvents;
 };
 
 } // namespace Zep
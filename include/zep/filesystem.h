@@ -4,7 +4,10 @@
 
 #include <memory>
 #include <map>
+#include <mutex>
 #include <string>
+#include <unordered_map>
+#include <vector>
 #include "zep/mcommon/file/path.h"
 #include <functional>
 
@@ -16,6 +19,21 @@ enum ZepFileSystemFlags
     SearchGitRoot = (1 << 0)
 };
 
+enum class ZepFileChange
+{
+    Created,
+    Deleted,
+    Modified,
+    Overflow // Events were lost; anything watched may have changed
+};
+
+struct ZepFileEvent
+{
+    ZepPath path;
+    ZepFileChange change = ZepFileChange::Modified;
+    bool isDirectory = false;
+};
+
 // Zep's view of the outside world in terms of files
 // Below there is a version of this that will work on most platforms using std's <filesystem> for file operations
 // If you want to expose your app's view of the world, you need to implement this minimal set of functions
@@ -43,13 +61,43 @@ public:
     virtual bool IsReadOnly(const ZepPath& path) const = 0;
     virtual bool Exists(const ZepPath& path) const = 0;
 
+    // Modified time (in whatever units the platform likes, it is only compared for equality) and size in bytes.
+    // Optional; without it, anything that would be compared is taken to have changed
+    virtual bool GetFileInfo(const ZepPath& /*path*/, uint64_t& /*modifiedTime*/, uint64_t& /*size*/) const
+    {
+        return false;
+    }
+
     // A callback API for scaning 
     virtual void ScanDirectory(const ZepPath& path, std::function<bool(const ZepPath& path, bool& dont_recurse)> fnScan) const = 0;
 
+    // One level of a directory; the entry type should come from the directory read itself where the platform
+    // supports it, so walkers don't have to stat every entry. Links to directories are not reported as directories.
+    // The default scans without recursing and asks about each entry, which works, but slowly
+    virtual void ListDirectory(const ZepPath& path, std::function<void(const std::string& name, bool isDirectory)> fnEntry) const
+    {
+        ScanDirectory(path, [&](const ZepPath& entry, bool& recurse) {
+            recurse = false;
+            fnEntry(entry.filename().string(), IsDirectory(entry));
+            return true;
+        });
+    }
+
     // Equivalent means 'the same file'
     virtual bool Equivalent(const ZepPath& path1, const ZepPath& path2) const = 0;
     virtual ZepPath Canonical(const ZepPath& path) const = 0;
     virtual void SetFlags(uint32_t flags) = 0;
+
+    // Optional change notification.  A watch covers the entries of one directory, not its children; new sub
+    // directories are reported as created, and it is up to the caller to watch them too.
+    // WatchDirectory may be called from any thread; events are collected by polling, which never blocks.
+    virtual bool WatchDirectory(const ZepPath& /*path*/)
+    {
+        return false;
+    }
+    virtual void PollFileEvents(std::vector<ZepFileEvent>& /*events*/)
+    {
+    }
 };
 
 // CPP File system - part of the standard C++ libraries
@@ -66,6 +114,7 @@ public:
     virtual std::string Read(const ZepPath& filePath) override;
     virtual bool Write(const ZepPath& filePath, const void* pData, size_t size) override;
     virtual void ScanDirectory(const ZepPath& path, std::function<bool(const ZepPath& path, bool& dont_recurse)> fnScan) const override;
+    virtual void ListDirectory(const ZepPath& path, std::function<void(const std::string& name, bool isDirectory)> fnEntry) const override;
     virtual void SetWorkingDirectory(const ZepPath& path) override;
     virtual bool MakeDirectories(const ZepPath& path) override;
     virtual const ZepPath& GetWorkingDirectory() const override;
@@ -74,14 +123,23 @@ public:
     virtual bool IsDirectory(const ZepPath& path) const override;
     virtual bool IsReadOnly(const ZepPath& path) const override;
     virtual bool Exists(const ZepPath& path) const override;
+    virtual bool GetFileInfo(const ZepPath& path, uint64_t& modifiedTime, uint64_t& size) const override;
     virtual bool Equivalent(const ZepPath& path1, const ZepPath& path2) const override;
     virtual ZepPath Canonical(const ZepPath& path) const override;
     virtual void SetFlags(uint32_t flags) override;
+    virtual bool WatchDirectory(const ZepPath& path) override;
+    virtual void PollFileEvents(std::vector<ZepFileEvent>& events) override;
 
 private:
     ZepPath m_workingDirectory;
     ZepPath m_configPath;
     uint32_t m_flags = ZepFileSystemFlags::SearchGitRoot;
+
+    // inotify, where available (ZEP_FEATURE_FILE_WATCHER on Linux)
+    std::mutex m_watchMutex;
+    int m_watchHandle = -1;
+    std::unordered_map<int, ZepPath> m_watches;
+    bool m_watchFailed = false;
 };
 #endif // CPP File system
 
@@ -177,6 +177,9 @@ public:
     // Size is fixed_size of buffer - the gap fixed_size
     inline size_type size() const { return (m_pEnd - m_pStart) - (m_pGapEnd - m_pGapStart); }
 
+    // The allocated size, including the gap
+    inline size_type capacity() const { return m_pEnd - m_pStart; }
+
     // No current limit ; not sure how to calculate the ram max fixed_size here
     size_type max_size() const { return std::numeric_limits<size_t>::max(); }
 
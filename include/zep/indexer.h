@@ -1,59 +1,134 @@
 #pragma once
 
+#include <functional>
 #include <future>
 #include <memory>
 #include <regex>
+#include <set>
 #include <thread>
 
 #include "zep/editor.h"
+#include "zep/mcommon/animation/timer.h"
+#include "zep/mcommon/string/fuzzy_match.h"
+#include "zep/symbol_index.h"
+#include "zep/trigram_index.h"
 
 namespace Zep
 {
 
 class ZepEditor;
+class GlobMatcher;
 
 // List of files found in the directory search
 struct FileIndexResult
 {
     ZepPath root;
     std::vector<ZepPath> paths;
-    std::vector<std::string> lowerPaths;
+    FuzzyArena pathArena; // The same paths, packed for fuzzy matching
     std::string errors;
 };
 
-struct SymbolDetails
+// Batches of paths found by a walk that is still running; drained by whoever is watching it
+struct FileIndexProgress
 {
-    int line = 0;
-    int column = 0;
-};
+    std::mutex mutex;
+    std::vector<std::shared_ptr<FileIndexResult>> batches;
 
-using SymbolContainer = std::map<std::string, SymbolDetails>;
+    // Called on the walking thread when a batch arrives and the list was empty
+    std::function<void()> fnBatch;
+};
 
 class Indexer : public ZepComponent
 {
 public:
     Indexer(ZepEditor& editor);
-    
+    ~Indexer();
+
     virtual void Notify(std::shared_ptr<ZepMessage> message) override;
 
     bool StartIndexing();
-    void StartSymbolSearch();
+
+    // Drops the walk and index updates; what is running stops at its next check, without waiting for it
+    void StopIndexing();
+
+    // Project wide search, answered from the trigram index (empty until the first index is ready)
+    std::vector<TrigramSearchResult> Search(const std::string& query, bool regex, size_t maxResults = 1000) const;
+    std::shared_ptr<TrigramIndex> GetTrigramIndex() const
+    {
+        return m_spTrigramIndex;
+    }
+
+    // Where a symbol is defined; answered from the symbol table, which is loaded from the last session at startup
+    std::vector<SymbolDefinition> FindDefinitions(const std::string& name) const;
+    std::shared_ptr<SymbolIndex> GetSymbolIndex() const
+    {
+        return m_spSymbolIndex;
+    }
+
+    const ZepPath& GetSearchRoot() const
+    {
+        return m_searchRoot;
+    }
+
+    // The project files; kept current from file system events after the first walk (null until then)
+    std::shared_ptr<FileIndexResult> GetFileIndex() const
+    {
+        return m_spFilePaths;
+    }
 
     static void GetSearchPaths(ZepEditor& editor, const ZepPath& path, std::vector<std::string>& ignore_patterns, std::vector<std::string>& include_patterns, std::string& errors);
-    static std::future<std::shared_ptr<FileIndexResult>> IndexPaths(ZepEditor& editor, const ZepPath& startPath);
+    // Walk the tree on the thread pool; 'watch' asks the file system to report changes to every directory walked.
+    // fnDone is given the result on the thread that finishes the walk, before the future is ready.
+    // The walk runs in pTasks if given, at its priority, and stops if they are cancelled; fnDone isn't called then.
+    static std::future<std::shared_ptr<FileIndexResult>> IndexPaths(ZepEditor& editor, const ZepPath& startPath, std::shared_ptr<FileIndexProgress> spProgress = nullptr, bool watch = false, std::function<void(std::shared_ptr<FileIndexResult>)> fnDone = nullptr, TaskGroup* pTasks = nullptr);
+
+private:
+    void StartTrigramUpdate();
+    void StartSymbolUpdate();
+    void StartPendingUpdates();
+    void StartWalk();
+    void OnWalkDone(std::shared_ptr<FileIndexResult> spResult);
+    void OnSymbolUpdateDone(std::shared_ptr<SymbolIndex> spIndex);
+    void OnTrigramUpdateDone(std::shared_ptr<TrigramIndex> spIndex, bool fullUpdate, std::vector<ZepPath> changed, std::vector<ZepPath> removed, bool unsaved);
+    void ApplyFileEvents(const std::vector<ZepFileEvent>& events);
+    void WatchNewDirectory(const std::string& directory, std::set<std::string>& added);
 
 private:
+    // Background work posts its result back to the main thread, and is stopped before we go away
+    TaskGroup m_tasks;
     bool m_fileSearchActive = false;
-    std::future<std::shared_ptr<FileIndexResult>> m_indexResult;
     std::shared_ptr<FileIndexResult> m_spFilePaths;
 
-    std::mutex m_queueMutex;
-    std::deque<ZepPath> m_searchQueue;
+    // For filtering file system events the way the walk filters the tree
+    std::shared_ptr<GlobMatcher> m_spMatcher;
+
+    // Events that arrive during a walk are applied when it is done
+    std::vector<ZepFileEvent> m_walkEvents;
+
+    // The live index is only touched on the main thread; updates are built on a copy and swapped in.
+    // After a walk the whole project is checked; after that, only the files that events say have changed.
+    // The index that was swapped out is kept; once nothing else holds it, the next event update catches it up with
+    // the files it is behind on instead of copying the live one. Event updates are saved now and then, not every time.
+    std::shared_ptr<TrigramIndex> m_spTrigramIndex;
+    std::shared_ptr<TrigramIndex> m_spTrigramSpare;
+    std::vector<ZepPath> m_trigramSpareChanged;
+    std::vector<ZepPath> m_trigramSpareRemoved;
+    bool m_trigramUnsaved = false;
+    timer m_trigramSaveTimer;
+    bool m_trigramUpdateActive = false;
+    bool m_trigramUpdatePending = false;
+    bool m_trigramFullUpdate = false;
+    std::set<std::string> m_trigramChanged;
+    std::set<std::string> m_trigramRemoved;
+
+    // As above; the first result is the table from the last session, then one that matches the files on disk
+    std::shared_ptr<SymbolIndex> m_spSymbolIndex;
+    bool m_symbolUpdateActive = false;
+    bool m_symbolUpdatePending = false;
+    bool m_symbolFullUpdate = false;
+    std::set<std::string> m_symbolChanged;
 
-    std::mutex m_symbolMutex;
-    SymbolContainer m_symbols;
     ZepPath m_searchRoot;
-    
 };
 
 } // Zep
@@ -0,0 +1,62 @@
+#pragma once
+
+#include <cstdint>
+#include <map>
+#include <ostream>
+#include <vector>
+
+#include "zep/mcommon/animation/profiler.h"
+#include "zep/mcommon/memory.h"
+#include "zep/mcommon/file/path.h"
+
+namespace Zep
+{
+
+class ZepEditor;
+class IZepFileSystem;
+
+struct RecordedKey
+{
+    uint64_t time = 0; // Microseconds from the start of the recording
+    uint32_t key = 0;
+    uint32_t modifiers = 0;
+};
+
+// The keys given to the modes during a session, as they were pressed.
+// Saved as text, a key per line, so a recording can be read, cut down or written by hand.
+struct KeyRecording
+{
+    std::vector<RecordedKey> keys;
+
+    bool Load(IZepFileSystem& fs, const ZepPath& path);
+    bool Save(IZepFileSystem& fs, const ZepPath& path) const;
+};
+
+struct ReplayOptions
+{
+    // Refresh and Display after this many keys; 0 to only do it at the end
+    uint32_t displayEvery = 1;
+};
+
+struct ReplayReport
+{
+    uint64_t keys = 0;
+    uint64_t frames = 0;
+    uint64_t elapsed = 0; // Replay time
+    uint64_t recorded = 0; // Session time
+
+    // Most expensive first; subsystems are the TIME_SCOPEs, which include the scopes inside them
+    std::vector<ProfileTotal> commands;
+    std::vector<ProfileTotal> subsystems;
+
+    // Per frame, key and ex command; empty unless the program counts allocations (see memory.h)
+    std::map<std::string, AllocationTotal> allocations;
+
+    void WriteJson(std::ostream& str) const;
+};
+
+// Sends the keys to the active buffer's mode as fast as it will take them; the recorded times are only reported.
+// The profiler is restarted to collect the subsystem times, and stopped at the end.
+ReplayReport ReplayKeys(ZepEditor& editor, const KeyRecording& recording, const ReplayOptions& options = ReplayOptions{});
+
+} // namespace Zep
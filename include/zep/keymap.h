@@ -95,6 +95,7 @@ DECLARE_COMMANDID(FontBigger)
 DECLARE_COMMANDID(FontSmaller)
 
 DECLARE_COMMANDID(QuickSearch)
+DECLARE_COMMANDID(GotoDefinition)
 
 DECLARE_COMMANDID(Undo)
 DECLARE_COMMANDID(Redo)
@@ -0,0 +1,48 @@
+#pragma once
+
+#include <array>
+#include <cstdint>
+
+namespace Zep
+{
+
+// Counts of durations (or any other positive values), to get percentiles without keeping every sample.
+// Values below 16 have a bucket each; above that there are 8 buckets for every doubling, so a percentile
+// is never more than 1/8th too high. The max is exact.
+class LatencyHistogram
+{
+public:
+    void Add(uint64_t value);
+    void Clear();
+
+    uint64_t GetCount() const
+    {
+        return m_count;
+    }
+
+    uint64_t GetMax() const
+    {
+        return m_max;
+    }
+
+    double GetMean() const;
+
+    // The smallest value that the given fraction (0-1) of the samples are no bigger than
+    uint64_t GetPercentile(double fraction) const;
+
+private:
+    static const uint32_t SubBucketBits = 3;
+    static const uint32_t LinearCount = 2 << SubBucketBits;
+    static const uint32_t BucketCount = LinearCount + (64 - SubBucketBits - 1) * (1 << SubBucketBits);
+
+    static uint32_t BucketIndex(uint64_t value);
+    static uint64_t BucketLimit(uint32_t index);
+
+private:
+    std::array<uint64_t, BucketCount> m_buckets{};
+    uint64_t m_count = 0;
+    uint64_t m_max = 0;
+    uint64_t m_total = 0;
+};
+
+} // namespace Zep
@@ -0,0 +1,82 @@
+#pragma once
+
+#include <cstdint>
+#include <ostream>
+#include <string>
+#include <vector>
+
+namespace Zep
+{
+
+// A trace of where each thread spends its time, for viewing in chrome://tracing or ui.perfetto.dev.
+// Every thread records begin/end/counter events into a ring of its own; only that thread writes to it,
+// so recording takes no locks, and the oldest events are overwritten once the ring is full.
+// Nothing is recorded until profile_start is called, so the scopes cost a flag check the rest of the time.
+// Event names are not copied: they must live as long as the program, as string literals do.
+enum class ProfileEventType : uint8_t
+{
+    Begin,
+    End,
+    Counter
+};
+
+struct ProfileEvent
+{
+    const char* name = nullptr;
+    uint64_t time = 0; // timer_get_time_now
+    int64_t value = 0; // Counters only
+    ProfileEventType type = ProfileEventType::Begin;
+};
+
+namespace ProfileFlags
+{
+enum
+{
+    None = 0,
+    // Also add up the time in each scope, which takes a (per thread) lock as each one ends
+    Totals = (1 << 0)
+};
+};
+
+struct ProfileTotal
+{
+    std::string name;
+    uint64_t count = 0;
+    uint64_t time = 0; // Including the scopes inside it
+    uint64_t max = 0;
+};
+
+// Start throws away anything recorded before it
+void profile_start(uint32_t flags = ProfileFlags::None);
+void profile_stop();
+bool profile_is_recording();
+
+void profile_begin(const char* name);
+void profile_end(const char* name);
+void profile_counter(const char* name, int64_t value);
+
+// Shown in place of the thread's number in the trace
+void profile_set_thread_name(const char* name);
+
+// The events recorded since profile_start, as Chrome Trace Event JSON
+void profile_write_trace(std::ostream& str);
+
+// Every thread's time in each scope since profile_start, by name; empty unless started with ProfileFlags::Totals
+std::vector<ProfileTotal> profile_get_totals();
+
+class ProfileBlock
+{
+public:
+    ProfileBlock(const char* name);
+    ~ProfileBlock();
+
+private:
+    const char* m_name;
+    uint64_t m_start = 0;
+    bool m_recording;
+};
+
+#define TIME_SCOPE(name) ProfileBlock name##_timer_block(#name);
+#define PROFILE_COUNTER(name, value) profile_counter(#name, int64_t(value));
+
+} // namespace Zep
@@ -1,8 +1,6 @@
 #pragma once
 
 #include <cstdint>
-#include <string>
-#include <unordered_map>
 
 namespace Zep
 {
@@ -27,32 +25,4 @@ double timer_get_elapsed_seconds(const timer& timer);
 double timer_to_seconds(uint64_t value);
 double timer_to_ms(uint64_t value);
 
-struct profile_value
-{
-    double average = 0;
-    double current = 0;
-    uint64_t count = 0;
-};
-
-struct profile_data
-{
-    std::unordered_map<const char*, profile_value> timerData;
-};
-extern profile_data globalProfiler;
-
-void profile_add_value(profile_value& val, double av);
-
-class ProfileBlock
-{
-public:
-    const char* strTimer;
-    timer blockTimer;
-    uint64_t elapsed = 0;
-
-    ProfileBlock(const char* timer);
-    ~ProfileBlock();
-};
-
-#define TIME_SCOPE(name) ProfileBlock name##_timer_block(#name);
-
 } // namespace Zep
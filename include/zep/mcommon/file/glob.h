@@ -0,0 +1,72 @@
+#pragma once
+
+#include <bitset>
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+namespace Zep
+{
+
+// Many glob patterns compiled into one matcher.
+// Each set of patterns is added with a tag bit; matching a path returns the tags of every set that has a
+// pattern matching it, in a single pass over the path.
+// Patterns follow fnmatch with no flags: '*' matches any run of characters (including '/'), '?' any one,
+// '[a-z]' / '[!a-z]' a class, and '\' escapes.
+// Extension only patterns such as "*.cpp" become a hash lookup; the rest are built into a DFA whose
+// alphabet is reduced to the byte classes the patterns can tell apart.
+class GlobMatcher
+{
+public:
+    void AddPatterns(const std::vector<std::string>& patterns, uint32_t tag);
+    void Compile();
+
+    uint32_t Match(const std::string_view& path) const;
+
+private:
+    enum class TokenType
+    {
+        Literal,
+        Any,
+        Class,
+        Star,
+        Accept
+    };
+
+    struct Token
+    {
+        TokenType type = TokenType::Literal;
+        uint8_t ch = 0;
+        uint32_t classIndex = 0;
+        uint32_t tag = 0;
+    };
+
+    void AddPattern(const std::string& pattern, uint32_t tag);
+    bool Accepts(const Token& token, uint8_t ch) const;
+    void AddClosure(uint32_t position, std::vector<uint32_t>& states) const;
+
+private:
+    std::vector<Token> m_tokens;
+    std::vector<std::bitset<256>> m_classes;
+
+    std::unordered_set<std::string> m_extensionStore;
+    std::unordered_map<std::string_view, uint32_t> m_extensions;
+
+    // DFA
+    std::vector<uint32_t> m_starts;
+    uint8_t m_byteClass[256] = {};
+    uint32_t m_byteClassCount = 1;
+    std::vector<int32_t> m_transitions;
+    std::vector<uint32_t> m_acceptTags;
+    int32_t m_startState = 0;
+    bool m_compiled = false;
+
+    // Used if the DFA gets too big
+    std::vector<std::pair<std::string, uint32_t>> m_fallback;
+    bool m_useFallback = false;
+};
+
+} // namespace Zep
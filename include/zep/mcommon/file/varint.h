@@ -0,0 +1,40 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+
+namespace Zep
+{
+
+// LEB128 style; 7 bits per byte, high bit set on all but the last byte.
+// Used by the on-disk project indices, where most numbers are small.
+inline void write_varint(std::string& out, uint64_t val)
+{
+    while (val >= 0x80)
+    {
+        out.push_back(char((val & 0x7F) | 0x80));
+        val >>= 7;
+    }
+    out.push_back(char(val));
+}
+
+inline bool read_varint(const std::string& in, size_t& pos, uint64_t& val)
+{
+    val = 0;
+    for (int shift = 0; shift < 64; shift += 7)
+    {
+        if (pos >= in.size())
+        {
+            return false;
+        }
+        auto byte = uint8_t(in[pos++]);
+        val |= uint64_t(byte & 0x7F) << shift;
+        if (!(byte & 0x80))
+        {
+            return true;
+        }
+    }
+    return false;
+}
+
+} // namespace Zep
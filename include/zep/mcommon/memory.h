@@ -0,0 +1,82 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace Zep
+{
+
+// Estimates of the heap memory held by the standard containers, for reporting where the memory goes.
+// They count what was reserved rather than what is used, and leave out the allocator's own overhead.
+
+template <class T>
+uint64_t memory_vector_bytes(const std::vector<T>& vec)
+{
+    return uint64_t(vec.capacity()) * sizeof(T);
+}
+
+// Short strings live inside the string itself
+inline uint64_t memory_string_bytes(const std::string& str)
+{
+    return str.capacity() > std::string().capacity() ? uint64_t(str.capacity()) + 1 : 0;
+}
+
+// A node per entry: the value, plus the links and colour of a red-black tree
+template <class TMap>
+uint64_t memory_map_bytes(const TMap& map)
+{
+    return uint64_t(map.size()) * (sizeof(typename TMap::value_type) + 4 * sizeof(void*));
+}
+
+// A node per entry with its link and hash, and the bucket array
+template <class TSet>
+uint64_t memory_hash_bytes(const TSet& set)
+{
+    return uint64_t(set.size()) * (sizeof(typename TSet::value_type) + 2 * sizeof(void*)) + uint64_t(set.bucket_count()) * sizeof(void*);
+}
+
+// "12.3 MB" and so on
+std::string memory_to_string(uint64_t bytes);
+
+// Allocation counting.  A program opts in by including zep/mcommon/memory_hooks.h in one of its files, which
+// replaces operator new and delete with versions that count every allocation made on each thread.
+// Without the hooks the counts stay at zero.
+struct AllocationCounts
+{
+    uint64_t allocs = 0;
+    uint64_t bytes = 0;
+    uint64_t frees = 0;
+};
+
+struct AllocationTotal
+{
+    uint64_t scopes = 0;
+    uint64_t allocs = 0;
+    uint64_t bytes = 0;
+    uint64_t maxAllocs = 0; // In any one scope
+};
+
+bool memory_hooks_installed();
+
+// This thread's counts since it started
+AllocationCounts memory_thread_allocations();
+
+// For the hooks
+void memory_set_hooks_installed();
+void memory_note_alloc(size_t bytes);
+void memory_note_free();
+
+// The allocations made on this thread since the scope began
+class AllocationScope
+{
+public:
+    AllocationScope();
+    AllocationCounts GetCounts() const;
+
+private:
+    AllocationCounts m_start;
+};
+
+} // namespace Zep
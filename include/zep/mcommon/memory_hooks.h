@@ -0,0 +1,92 @@
+#pragma once
+
+// Replaces the global operator new and delete with versions that count the allocations (see memory.h).
+// Include this in exactly one file of a program, and in no library: the definitions aren't inline.
+// The aligned forms are left alone; the editor doesn't over-align anything.
+
+#include <cstdlib>
+#include <new>
+
+#include "zep/mcommon/memory.h"
+
+namespace Zep
+{
+namespace
+{
+const bool memoryHooksInstalled = (memory_set_hooks_installed(), true);
+
+void* memory_hook_alloc(std::size_t size)
+{
+    // The size is as the caller asked for it; malloc's own rounding isn't counted
+    Zep::memory_note_alloc(size);
+    return std::malloc(size == 0 ? 1 : size);
+}
+
+void memory_hook_free(void* p)
+{
+    if (p)
+    {
+        Zep::memory_note_free();
+        std::free(p);
+    }
+}
+} // namespace
+} // namespace Zep
+
+void* operator new(std::size_t size)
+{
+    if (auto p = Zep::memory_hook_alloc(size))
+    {
+        return p;
+    }
+    throw std::bad_alloc();
+}
+
+void* operator new[](std::size_t size)
+{
+    if (auto p = Zep::memory_hook_alloc(size))
+    {
+        return p;
+    }
+    throw std::bad_alloc();
+}
+
+void* operator new(std::size_t size, const std::nothrow_t&) noexcept
+{
+    return Zep::memory_hook_alloc(size);
+}
+
+void* operator new[](std::size_t size, const std::nothrow_t&) noexcept
+{
+    return Zep::memory_hook_alloc(size);
+}
+
+void operator delete(void* p) noexcept
+{
+    Zep::memory_hook_free(p);
+}
+
+void operator delete[](void* p) noexcept
+{
+    Zep::memory_hook_free(p);
+}
+
+void operator delete(void* p, std::size_t) noexcept
+{
+    Zep::memory_hook_free(p);
+}
+
+void operator delete[](void* p, std::size_t) noexcept
+{
+    Zep::memory_hook_free(p);
+}
+
+void operator delete(void* p, const std::nothrow_t&) noexcept
+{
+    Zep::memory_hook_free(p);
+}
+
+void operator delete[](void* p, const std::nothrow_t&) noexcept
+{
+    Zep::memory_hook_free(p);
+}
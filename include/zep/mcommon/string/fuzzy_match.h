@@ -0,0 +1,61 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace Zep
+{
+
+// All the strings to be searched, stored back to back, with a lower case copy and a bitmask
+// of the characters each string contains; so most strings can be rejected with a single AND
+struct FuzzyArena
+{
+    std::vector<char> text;
+    std::vector<char> lowerText;
+    std::vector<uint32_t> offsets = { 0 };
+    std::vector<uint64_t> masks;
+
+    void Add(const std::string& str);
+    void Clear();
+
+    uint32_t Size() const
+    {
+        return uint32_t(masks.size());
+    }
+
+    std::string Get(uint32_t index) const
+    {
+        return std::string(text.data() + offsets[index], text.data() + offsets[index + 1]);
+    }
+};
+
+struct FuzzyMatch
+{
+    int32_t score = 0;
+    uint32_t index = 0;
+    uint32_t length = 0;
+};
+
+struct FuzzySearchResult
+{
+    // Best first, once merged
+    std::vector<FuzzyMatch> matches;
+    uint32_t matchCount = 0;
+};
+
+uint64_t fuzzy_char_mask(const char* pBegin, const char* pEnd);
+
+// fzf (v1) style score of the tightest match of the pattern in the string; false if it doesn't match.
+// Rewards consecutive characters and matches at word boundaries, path separators and camel humps.
+// Gaps cost, so a real match with a long gap can score below zero.
+bool fuzzy_score(const char* pText, const char* pSearch, uint32_t length, const char* pPattern, uint32_t patternLength, int32_t& score);
+
+// Score the strings [begin, end) of the arena, keeping the best 'maxResults' in a heap.
+// A pattern with capitals is matched case sensitively.
+FuzzySearchResult fuzzy_search(const FuzzyArena& arena, const std::string& pattern, uint32_t begin, uint32_t end, uint32_t maxResults);
+
+// Combine partial searches into one sorted result
+FuzzySearchResult fuzzy_merge(std::vector<FuzzySearchResult>& parts, uint32_t maxResults);
+
+} // namespace Zep
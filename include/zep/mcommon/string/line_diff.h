@@ -0,0 +1,26 @@
+#pragma once
+
+#include <cstdint>
+#include <string_view>
+#include <vector>
+
+namespace Zep
+{
+
+// Lines [oldLine, oldLine + oldCount) of the old text become [newLine, newLine + newCount) of the new
+struct DiffHunk
+{
+    uint32_t oldLine = 0;
+    uint32_t oldCount = 0;
+    uint32_t newLine = 0;
+    uint32_t newCount = 0;
+};
+
+// Split into lines, each keeping its '\n'; a last line without one is still a line
+std::vector<std::string_view> diff_split_lines(std::string_view text);
+
+// The shortest edit script between two lists of lines (Myers, in linear space), as hunks in order.
+// Lines are interned first, so the diff itself only ever compares integers.
+std::vector<DiffHunk> diff_lines(const std::vector<std::string_view>& oldLines, const std::vector<std::string_view>& newLines);
+
+} // namespace Zep
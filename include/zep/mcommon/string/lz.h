@@ -0,0 +1,16 @@
+#pragma once
+
+#include <string>
+
+namespace Zep
+{
+
+// A small byte oriented LZ77 codec, after LZ4: no entropy coding, so both directions run at memory speed
+// and text still comes out at around a third of its size.  Used to keep hibernated buffers in memory.
+// The stream is the decoded size as a varint, then sequences of literals and back references.
+std::string lz_compress(const std::string& in);
+
+// False if the stream is damaged; nothing is read or written out of bounds either way
+bool lz_decompress(const std::string& in, std::string& out);
+
+} // namespace Zep
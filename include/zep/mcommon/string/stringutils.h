@@ -143,6 +143,13 @@ void string_split_each(char* text, size_t start, size_t end, const char* delims,
 size_t string_first_of(const char* text, size_t start, size_t end, const char* delims);
 size_t string_first_not_of(const char* text, size_t start, size_t end, const char* delims);
 
+// As a quoted JSON string; control characters become spaces
+void string_write_json(std::ostream& str, const char* text);
+inline void string_write_json(std::ostream& str, const std::string& text)
+{
+    string_write_json(str, text.c_str());
+}
+
 inline bool string_equals(const std::string& str, const std::string& str2)
 {
     return str == str2;
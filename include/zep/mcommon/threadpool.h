@@ -25,6 +25,10 @@ freely, subject to the following restrictions:
 CM: Note: Modified from the original to support query of the threads available on the machine,
 and fallback to using single threaded if not possible.
 Original here: https://github.com/progschj/ThreadPool
+
+Since rewritten as a work stealing scheduler: each worker has its own deques, one per priority, and takes
+from the back of its own or the front of another's. Higher priority work is always taken first, wherever it
+is queued, and one worker is kept back for Interactive work so that long background jobs can't hold it up.
 */
 
 #ifndef THREAD_POOL_HPP
@@ -32,7 +36,7 @@ Original here: https://github.com/progschj/ThreadPool
 
 // containers
 #include <vector>
-#include <queue>
+#include <deque>
 // threading
 #include <thread>
 #include <mutex>
@@ -40,10 +44,38 @@ Original here: https://github.com/progschj/ThreadPool
 #include <atomic>
 #include <future>
 // utility wrappers
+#include <cstdint>
 #include <memory>
 #include <functional>
+#include <algorithm>
 // exceptions
 #include <stdexcept>
+#include <exception>
+
+enum class TaskPriority
+{
+    Interactive, // The user is waiting on it; a filter, a syntax pass
+    Normal,
+    Idle,        // Background upkeep; a walk of the project, an index update
+    Count
+};
+
+// Cooperative cancellation; copies share the same state.
+// A task that is cancelled before it starts is dropped; one that is running has to check for itself.
+class CancelToken {
+public:
+    CancelToken() : cancelled(std::make_shared<std::atomic_bool>(false)) {}
+    void cancel() const
+    {
+        *cancelled = true;
+    }
+    bool is_cancelled() const
+    {
+        return *cancelled;
+    }
+private:
+    std::shared_ptr<std::atomic_bool> cancelled;
+};
 
 // std::thread pool for resources recycling
 class ThreadPool {
@@ -54,29 +86,15 @@ public:
         // If not enough threads, the pool will just execute all tasks immediately
         if (threads_n > 1)
         {
-            this->workers.reserve(threads_n);
-            for (; threads_n; --threads_n)
-                this->workers.emplace_back(
-                    [this]
-            {
-                while (true)
-                {
-                    std::function<void()> task;
+            // known before any worker starts
+            this->threads = threads_n;
+            this->queues.reserve(threads_n);
+            for (size_t i = 0; i < threads_n; ++i)
+                this->queues.emplace_back(new worker_queue());
 
-                    {
-                        std::unique_lock<std::mutex> lock(this->queue_mutex);
-                        this->condition.wait(lock,
-                            [this] { return this->stop || !this->tasks.empty(); });
-                        if (this->stop && this->tasks.empty())
-                            return;
-                        task = std::move(this->tasks.front());
-                        this->tasks.pop();
-                    }
-
-                    task();
-                }
-            }
-            );
+            this->workers.reserve(threads_n);
+            for (size_t i = 0; i < threads_n; ++i)
+                this->workers.emplace_back([this, i] { this->run(i); });
         }
     }
     // deleted copy&move ctors&assignments
@@ -84,6 +102,16 @@ public:
     ThreadPool& operator=(const ThreadPool&) = delete;
     ThreadPool(ThreadPool&&) = delete;
     ThreadPool& operator=(ThreadPool&&) = delete;
+    // called after each task finishes, on the thread that ran it; set before enqueuing anything
+    void set_task_done(std::function<void()> fn)
+    {
+        task_done = std::move(fn);
+    }
+    // 0 if tasks are run on the calling thread
+    size_t thread_count() const
+    {
+        return threads;
+    }
     // add new work item to the pool
     template<class F, class... Args>
     #if ((defined(_MSVC_LANG) && _MSVC_LANG >= 201703L) || __cplusplus >= 201703L)
@@ -91,50 +119,405 @@ public:
     #else
     std::future<typename std::result_of<F(Args...)>::type> enqueue(F&& f, Args&&... args)
     #endif
+    {
+        return enqueue(TaskPriority::Normal, CancelToken(), std::bind(std::forward<F>(f), std::forward<Args>(args)...));
+    }
+    template<class F>
+    auto enqueue(TaskPriority priority, F&& f)
+    {
+        return enqueue(priority, CancelToken(), std::forward<F>(f));
+    }
+    // a task cancelled before it starts never runs; its future is then broken
+    template<class F>
+    auto enqueue(TaskPriority priority, const CancelToken& token, F&& f)
     {
         #if ((defined(_MSVC_LANG) && _MSVC_LANG >= 201703L) || __cplusplus >= 201703L)
-        using packaged_task_t = std::packaged_task<typename std::invoke_result<F, Args...>::type()>;
+        using packaged_task_t = std::packaged_task<typename std::invoke_result<F>::type()>;
         #else
-        using packaged_task_t = std::packaged_task<typename std::result_of<F(Args...)>::type ()>;
+        using packaged_task_t = std::packaged_task<typename std::result_of<F()>::type ()>;
         #endif
 
-        std::shared_ptr<packaged_task_t> task(new packaged_task_t(
-                std::bind(std::forward<F>(f), std::forward<Args>(args)...)
-            ));
-
-        // If there are no works, just run the task in the main thread and return
-        if (workers.empty())
-        {
-            (*task)();
-            return task->get_future();
-        }
+        std::shared_ptr<packaged_task_t> task(new packaged_task_t(std::forward<F>(f)));
         auto res = task->get_future();
-        {
-            std::unique_lock<std::mutex> lock(this->queue_mutex);
-            this->tasks.emplace([task](){ (*task)(); });
-        }
-        this->condition.notify_one();
+        push(priority, [task, token]() {
+            if (!token.is_cancelled())
+                (*task)();
+        });
         return res;
     }
-    // the destructor joins all threads
+    // runs fn(i) for each i in [0, count) across the pool and returns when all are done; the calling thread
+    // takes indices too, so this is safe to call from inside a task. Cancelled indices are skipped.
+    template<class F>
+    void parallel_for(size_t count, F&& fn, TaskPriority priority = TaskPriority::Normal, CancelToken token = CancelToken())
+    {
+        auto state = std::make_shared<for_state>();
+        state->count = count;
+        state->token = token;
+        state->body = std::ref(fn);
+
+        start_helpers(state, priority);
+        state->work();
+
+        std::unique_lock<std::mutex> lock(state->mutex);
+        state->condition.wait(lock, [&state] { return state->finished == state->count; });
+        if (state->error)
+            std::rethrow_exception(state->error);
+    }
+    // as parallel_for, but returns at once; done() is called on the thread that finishes the last index, and
+    // the future is ready (or holds the first exception thrown) after it returns
+    template<class F, class D>
+    std::future<void> parallel_for_async(size_t count, F fn, D done, TaskPriority priority = TaskPriority::Normal, CancelToken token = CancelToken())
+    {
+        auto state = std::make_shared<for_state>();
+        state->count = count;
+        state->token = token;
+        state->body = std::move(fn);
+        state->done = std::move(done);
+        auto res = state->promise.get_future();
+
+        if (count == 0)
+            state->finish();
+        else
+            start_helpers(state, priority);
+        return res;
+    }
+    // the destructor runs what is queued, then joins all threads
     virtual ~ThreadPool()
     {
         this->stop = true;
+        {
+            std::lock_guard<std::mutex> lock(this->sleep_mutex);
+        }
         this->condition.notify_all();
+        this->interactive_condition.notify_all();
         for(std::thread& worker : this->workers)
             worker.join();
     }
 private:
+    struct worker_queue
+    {
+        std::mutex mutex;
+        std::deque< std::function<void()> > tasks[size_t(TaskPriority::Count)];
+    };
+
+    // shared by the threads working through one parallel_for
+    struct for_state
+    {
+        size_t count = 0;
+        CancelToken token;
+        std::function<void(size_t)> body;
+        std::function<void()> done;
+        std::atomic<size_t> next{ 0 };
+        std::atomic<size_t> finished{ 0 };
+        std::exception_ptr error;
+        std::mutex mutex;
+        std::condition_variable condition;
+        std::promise<void> promise;
+
+        void work()
+        {
+            for (size_t i = next++; i < count; i = next++)
+            {
+                if (!token.is_cancelled())
+                {
+                    try
+                    {
+                        body(i);
+                    }
+                    catch (...)
+                    {
+                        std::lock_guard<std::mutex> lock(mutex);
+                        if (!error)
+                            error = std::current_exception();
+                    }
+                }
+
+                if (++finished == count)
+                    finish();
+            }
+        }
+        void finish()
+        {
+            if (done)
+                done();
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+            }
+            condition.notify_all();
+            if (error)
+                promise.set_exception(error);
+            else
+                promise.set_value();
+        }
+    };
+
+    void start_helpers(const std::shared_ptr<for_state>& state, TaskPriority priority)
+    {
+        auto helpers = std::max<size_t>(1, std::min(state->count, threads));
+        for (size_t i = 0; i < helpers; ++i)
+            push(priority, [state]() { state->work(); });
+    }
+
+    // which worker of which pool the current thread is, if any
+    struct worker_id
+    {
+        ThreadPool* pool = nullptr;
+        size_t index = 0;
+    };
+    static worker_id& current_worker()
+    {
+        thread_local worker_id id;
+        return id;
+    }
+
+    // the first worker is kept for Interactive work, if there are others to do the rest
+    TaskPriority lowest_priority(size_t worker) const
+    {
+        return (worker == 0 && threads > 1) ? TaskPriority::Interactive : TaskPriority::Idle;
+    }
+
+    bool has_work(size_t worker) const
+    {
+        for (size_t p = 0; p <= size_t(lowest_priority(worker)); ++p)
+            if (queued[p] > 0)
+                return true;
+        return false;
+    }
+
+    void push(TaskPriority priority, std::function<void()> task)
+    {
+        // If there are no works, just run the task in the main thread and return
+        if (threads == 0)
+        {
+            task();
+            if (task_done)
+                task_done();
+            return;
+        }
+
+        // a worker keeps what it starts close, the rest is spread around
+        auto& self = current_worker();
+        auto index = self.pool == this ? self.index : (next_queue++ % queues.size());
+        {
+            auto& queue = *queues[index];
+            std::lock_guard<std::mutex> lock(queue.mutex);
+            queue.tasks[size_t(priority)].push_back(std::move(task));
+            queued[size_t(priority)]++;
+        }
+
+        // taken after the count is raised, so a worker can't miss it between checking and sleeping
+        {
+            std::lock_guard<std::mutex> lock(this->sleep_mutex);
+        }
+        if (priority == TaskPriority::Interactive)
+            this->interactive_condition.notify_one();
+        this->condition.notify_one();
+    }
+
+    bool pop(size_t worker, std::function<void()>& task)
+    {
+        for (size_t p = 0; p <= size_t(lowest_priority(worker)); ++p)
+        {
+            if (queued[p] == 0)
+                continue;
+
+            // newest from our own, oldest from the others
+            for (size_t offset = 0; offset < queues.size(); ++offset)
+            {
+                auto& queue = *queues[(worker + offset) % queues.size()];
+                std::lock_guard<std::mutex> lock(queue.mutex);
+                auto& tasks = queue.tasks[p];
+                if (tasks.empty())
+                    continue;
+                if (offset == 0)
+                {
+                    task = std::move(tasks.back());
+                    tasks.pop_back();
+                }
+                else
+                {
+                    task = std::move(tasks.front());
+                    tasks.pop_front();
+                }
+                queued[p]--;
+                return true;
+            }
+        }
+        return false;
+    }
+
+    void run(size_t worker)
+    {
+        current_worker() = worker_id{ this, worker };
+        auto& condition = lowest_priority(worker) == TaskPriority::Interactive ? this->interactive_condition : this->condition;
+        while (true)
+        {
+            std::function<void()> task;
+            if (!pop(worker, task))
+            {
+                std::unique_lock<std::mutex> lock(this->sleep_mutex);
+                condition.wait(lock,
+                    [this, worker] { return this->stop || this->has_work(worker); });
+                if (this->stop && !this->has_work(worker))
+                    return;
+                continue;
+            }
+
+            task();
+            if (this->task_done)
+                this->task_done();
+        }
+    }
+
     // need to keep track of threads so we can join them
     std::vector< std::thread > workers;
-    // the task queue
-    std::queue< std::function<void()> > tasks;
+    // the task queues, one per worker
+    size_t threads = 0;
+    std::vector< std::unique_ptr<worker_queue> > queues;
+    std::atomic<size_t> queued[size_t(TaskPriority::Count)] = {};
+    std::atomic<size_t> next_queue{ 0 };
 
     // synchronization
-    std::mutex queue_mutex;
+    std::mutex sleep_mutex;
     std::condition_variable condition;
+    std::condition_variable interactive_condition;
     // workers finalization flag
     std::atomic_bool stop;
+    std::function<void()> task_done;
+};
+
+// Tasks run on the pool for one owner, who can drop them all at once.
+// Cancelling doesn't block: what hasn't started never will, and what is running is told to stop through the
+// token the owner handed it. Waiting then only waits on what had already started; the destructor does both.
+class TaskGroup {
+public:
+    TaskGroup(ThreadPool& pool, TaskPriority priority = TaskPriority::Normal)
+        : pool(pool), priority(priority), state(std::make_shared<group_state>())
+    {
+    }
+    TaskGroup(const TaskGroup&) = delete;
+    TaskGroup& operator=(const TaskGroup&) = delete;
+    ~TaskGroup()
+    {
+        cancel();
+        wait();
+    }
+    // the token of the tasks started from now on; replaced when they are cancelled
+    CancelToken token() const
+    {
+        std::lock_guard<std::mutex> lock(state->mutex);
+        return state->token;
+    }
+    template<class F>
+    void run(F f)
+    {
+        auto job = state->begin();
+        auto group = state;
+        pool.enqueue(priority, job.token, [group, job, f]() mutable {
+            if (!group->enter(job))
+                return;
+            running_piece piece{ group, job, true };
+            f();
+        });
+    }
+    // as ThreadPool::parallel_for_async; done isn't called if the group is cancelled first
+    template<class F, class D>
+    void parallel_for(size_t count, F fn, D done)
+    {
+        auto job = state->begin();
+        auto group = state;
+        pool.parallel_for_async(
+            count, [group, job, fn](size_t index) mutable {
+                if (!group->enter(job))
+                    return;
+                running_piece piece{ group, job, false };
+                fn(index);
+            },
+            [group, job, done]() mutable {
+                if (!group->enter(job))
+                    return;
+                running_piece piece{ group, job, true };
+                done();
+            },
+            priority, job.token);
+    }
+    void cancel()
+    {
+        std::lock_guard<std::mutex> lock(state->mutex);
+        state->generation++;
+        state->pending = 0;
+        state->token.cancel();
+        state->token = CancelToken();
+        state->condition.notify_all();
+    }
+    void wait() const
+    {
+        std::unique_lock<std::mutex> lock(state->mutex);
+        state->condition.wait(lock, [this] { return state->pending == 0 && state->running == 0; });
+    }
+    bool is_busy() const
+    {
+        std::lock_guard<std::mutex> lock(state->mutex);
+        return state->pending != 0 || state->running != 0;
+    }
+private:
+    struct group_job
+    {
+        uint64_t generation = 0;
+        CancelToken token;
+    };
+
+    // shared with the tasks, which can outlive the group if they never start
+    struct group_state
+    {
+        std::mutex mutex;
+        std::condition_variable condition;
+        CancelToken token;
+        uint64_t generation = 0;
+        // jobs not yet done, since the last cancel
+        size_t pending = 0;
+        // pieces of work running now, cancelled or not
+        size_t running = 0;
+
+        group_job begin()
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            pending++;
+            return group_job{ generation, token };
+        }
+        bool enter(const group_job& job)
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            if (job.generation != generation)
+                return false;
+            running++;
+            return true;
+        }
+        void leave(const group_job& job, bool finished)
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            running--;
+            if (finished && job.generation == generation)
+                pending--;
+            condition.notify_all();
+        }
+    };
+
+    // leaves the group however the work ends
+    struct running_piece
+    {
+        std::shared_ptr<group_state> group;
+        group_job job;
+        bool finished;
+        ~running_piece()
+        {
+            group->leave(job, finished);
+        }
+    };
+
+    ThreadPool& pool;
+    TaskPriority priority;
+    std::shared_ptr<group_state> state;
 };
 
 #endif // THREAD_POOL_HPP
@@ -214,8 +214,6 @@ protected:
     virtual bool HandleIgnoredInput(CommandContext&) { return false; };
 
 protected:
-    std::stack<std::shared_ptr<ZepCommand>> m_undoStack;
-    std::stack<std::shared_ptr<ZepCommand>> m_redoStack;
     EditorMode m_currentMode = EditorMode::Normal;
     bool m_lineWise = false;
     GlyphIterator m_visualBegin;
@@ -15,11 +15,9 @@ class ZepMode_Search : public ZepMode
 {
 public:
     ZepMode_Search(ZepEditor& editor, ZepWindow& previousWindow, ZepWindow& window, const ZepPath& startPath);
-    ~ZepMode_Search();
 
     virtual void AddKeyPress(uint32_t key, uint32_t modifiers = 0) override;
     virtual void Begin(ZepWindow* pWindow) override;
-    virtual void Notify(std::shared_ptr<ZepMessage> message) override;
     virtual EditorMode DefaultMode() const override { return EditorMode::Normal; }
     
     static const char* StaticName()
@@ -35,9 +33,13 @@ public:
 
 private:
     void GetSearchPaths(const ZepPath& path, std::vector<std::string>& ignore, std::vector<std::string>& include) const;
-    void InitSearchTree();
     void ShowTreeResult();
     void UpdateTree();
+    void UpdateStatus();
+    void OnWalkBatches();
+    void OnWalkDone(std::shared_ptr<FileIndexResult> spResult);
+    void OnSearchDone(std::shared_ptr<std::vector<FuzzySearchResult>> spParts);
+    void AddFileSet(std::shared_ptr<FileIndexResult> spFiles);
 
     enum class OpenType
     {
@@ -49,42 +51,44 @@ private:
     void OpenSelection(OpenType type);
 
 private:
-
-    // List of lines in the file result, with last found char
-    struct SearchResult
-    {
-        uint32_t index = 0;
-        uint32_t location = 0;
-    };
-
-    // A mapping from character distance to a list of lines
-    struct IndexSet
-    {
-        std::multimap<uint32_t, SearchResult> indices;
-    };
-
     bool fileSearchActive = false;
     bool treeSearchActive = false;
 
-    // Results of the file search and the indexing threads
-    std::future<std::shared_ptr<FileIndexResult>> m_indexResult;
-    std::future<std::shared_ptr<IndexSet>> m_searchResult;
+    // Found by the walk, and the partitions of the running search
+    std::shared_ptr<FileIndexProgress> m_spProgress;
+    std::shared_ptr<std::vector<FuzzySearchResult>> m_spSearchParts;
+
+    // All files that can potentially match; batches from the walk while it runs, then the complete result.
+    // Match indices run across all the sets, each set starting at its entry in the starts array.
+    using FileSets = std::vector<std::shared_ptr<FileIndexResult>>;
+    FileSets m_fileSets;
+    std::vector<uint32_t> m_fileSetStarts;
+    uint32_t m_fileCount = 0;
+    bool m_filesChanged = false;
+
+    // The sets the running search, and the current results, refer to
+    FileSets m_searchSets;
+    std::vector<uint32_t> m_searchStarts;
+    FileSets m_resultSets;
+    std::vector<uint32_t> m_resultStarts;
+
+    // The best matches for m_resultTerm, best first
+    FuzzySearchResult m_results;
+    std::string m_resultTerm;
+    std::string m_activeSearchTerm;
+    bool m_resultsValid = false;
 
-    // All files that can potentially match
-    std::shared_ptr<FileIndexResult> m_spFilePaths;
-
-    // A hierarchy of index results.
-    // The 'top' of the tree is the most narrow finding from a set of 'n' characters
-    // index a,b,c -> index b,c -> index c
-    std::vector<std::shared_ptr<IndexSet>> m_indexTree;
-   
     // What we are searching for 
     std::string m_searchTerm;
-    bool m_caseImportant = false;
 
     ZepWindow& m_launchWindow;
     ZepWindow& m_window;
     ZepPath m_startPath;
+
+    // The file search and the fuzzy match partitions; each posts back to the main thread, and is cancelled
+    // on the way out. A search for a term the user has moved on from is cancelled straight away.
+    TaskGroup m_walkTasks;
+    TaskGroup m_searchTasks;
 };
 
 } // namespace Zep
@@ -145,6 +145,14 @@ private:
     void BuildTree();
 
 private:
+    // The visible (expanded) nodes in display order; lines are built from these on demand
+    struct TreeRow
+    {
+        ZepTreeNode* pNode = nullptr;
+        uint32_t indent = 0;
+    };
+    std::vector<TreeRow> m_rows;
+
     std::shared_ptr<ZepTree> m_spTree;
     GlyphIterator m_startLocation = GlyphIterator{ 0 };
     ZepWindow& m_launchWindow;
@@ -2,6 +2,7 @@
 
 #include <QTimer>
 #include <QWidget>
+#include <cmath>
 #include <memory>
 
 #include <QClipboard>
@@ -49,10 +50,13 @@ public:
         setFocusPolicy(Qt::FocusPolicy::StrongFocus);
         setMouseTracking(true);
 
-        m_refreshTimer.setInterval(1);
-        m_refreshTimer.setSingleShot(false);
-        m_refreshTimer.start();
+        // Sleep until the editor has something to do; background work can wake us sooner
+        m_refreshTimer.setSingleShot(true);
+        m_refreshTimer.start(0);
         connect(&m_refreshTimer, &QTimer::timeout, this, &ZepWidget_Qt::OnTimer);
+        m_spEditor->SetWakeupCallback([this]() {
+            QMetaObject::invokeMethod(this, [this]() { OnTimer(); }, Qt::QueuedConnection);
+        });
 
     }
 
@@ -101,6 +105,9 @@ public:
         m_spEditor->Display();
 
         ((ZepDisplay_Qt&)m_spEditor->GetDisplay()).SetPainter(nullptr);
+
+        // What we just drew may want another look sooner (a flash, a new cursor blink)
+        m_refreshTimer.start(int(std::ceil(m_spEditor->GetNextWakeup() * 1000.0f)));
     }
 
     virtual void keyPressEvent(QKeyEvent* ev) override
@@ -279,6 +286,7 @@ private slots:
         {
             update();
         }
+        m_refreshTimer.start(int(std::ceil(m_spEditor->GetNextWakeup() * 1000.0f)));
     }
 
 private:
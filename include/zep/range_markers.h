@@ -1,7 +1,9 @@
 #pragma once
 
-#include <set>
 #include <map>
+#include <memory>
+#include <set>
+#include <vector>
 
 #include "zep/mcommon/animation/timer.h"
 #include "zep/mcommon/signals.h"
@@ -62,9 +64,23 @@ enum class ToolTipPos
     Count = 3
 };
 
+// A marker as plain data, for adding many at once; see ZepBuffer::ReplaceRangeMarkers
+struct RangeMarkerDesc
+{
+    ByteRange range;
+    uint32_t markerType = RangeMarkerType::Mark;
+    uint32_t displayType = RangeMarkerDisplayType::All;
+    std::string name;
+    std::string description;
+    ThemeColor backgroundColor = ThemeColor::Background;
+    ThemeColor textColor = ThemeColor::Text;
+    ThemeColor highlightColor = ThemeColor::Background;
+};
+
 struct RangeMarker : std::enable_shared_from_this<RangeMarker>
 {
     RangeMarker(ZepBuffer& buffer);
+    RangeMarker(ZepBuffer& buffer, const RangeMarkerDesc& desc);
 
     bool ContainsLocation(GlyphIterator loc) const;
     bool IntersectsRange(const ByteRange& i) const;
@@ -85,12 +101,10 @@ struct RangeMarker : std::enable_shared_from_this<RangeMarker>
     virtual void SetAlpha(float a);
     virtual void SetName(const std::string& name);
     virtual void SetDescription(const std::string& desc);
+    // A disabled marker stays where it was set; edits neither move it nor remove it
     virtual void SetEnabled(bool enabled);
     virtual void SetInlineSize(const NVec2f& size);
 
-    void HandleBufferInsert(ZepBuffer& buffer, const GlyphIterator& itrStart, const std::string& str);
-    void HandleBufferDelete(ZepBuffer& buffer, const GlyphIterator& itr, const GlyphIterator& itrEnd);
-
     ZepBuffer& GetBuffer();
 
 public:
@@ -105,17 +119,21 @@ public:
     FlashType flashType = FlashType::Flash;
 
 protected:
+    friend class RangeMarkerTable;
+
     ZepBuffer& m_buffer;
-    ByteRange m_range;
+
+    // Where the marker was when it was set; the buffer's marker table tracks it from there
+    mutable ByteRange m_range;
+    int64_t m_tableSlot = -1;
+    bool m_tablePending = false;
+    bool m_tablePinned = false;
     mutable float alpha = 1.0f;
     std::string m_name;
     std::string m_description;
     bool m_enabled = true;
     NVec2f m_inlineSize;
 
-    Zep::scoped_connection onPreBufferInsert;
-    Zep::scoped_connection onPreBufferDelete;
-
     mutable ThemeColor m_textColor = ThemeColor::Text;
     mutable ThemeColor m_backgroundColor = ThemeColor::Background;
     mutable ThemeColor m_highlightColor = ThemeColor::Background; // Used for lines around tip box, underline, etc.
@@ -123,4 +141,87 @@ protected:
 
 using tRangeMarkers = std::map<ByteIndex, std::set<std::shared_ptr<RangeMarker>>>;
 
+// The markers in a buffer, and where they are.
+// Markers are kept in start order with a tree over them; each node holds the lowest and highest start and
+// the furthest end below it, and a shift not yet pushed down to its children.  An edit moves every marker
+// after it by shifting O(log n) nodes, without visiting the markers, and the markers it lands inside are
+// found from the same bounds.  An overlap query only descends into nodes that start early enough and end
+// late enough, so finding the k markers on a line is O(log n + k).
+// Markers added or removed are batched; the tree is rebuilt the next time it is used.
+// Disabled markers don't follow edits, so they are kept in a list to one side, out of the tree.
+class RangeMarkerTable
+{
+public:
+    ~RangeMarkerTable();
+
+    void Add(const std::shared_ptr<RangeMarker>& spMarker);
+    void Remove(RangeMarker& marker);
+    void Clear();
+
+    // Swap all the markers of the given types (except timed ones, which expire by themselves) for new
+    // ones, in a single sorted rebuild
+    void Replace(uint32_t markerTypes, const std::vector<std::shared_ptr<RangeMarker>>& markers);
+
+    // Follow an edit.  Markers after it move with the text; markers the edit is inside of are removed
+    // and returned.  An edit at the start of a marker moves it, one at the end leaves it alone.
+    void Insert(ByteIndex at, ByteIndex length, std::vector<std::shared_ptr<RangeMarker>>& removed);
+    void Delete(ByteIndex begin, ByteIndex end, std::vector<std::shared_ptr<RangeMarker>>& removed);
+
+    // Markers whose inclusive range [first, max(0, second - 1)] meets [first, last], in start order
+    void Find(ByteIndex first, ByteIndex last, std::vector<std::shared_ptr<RangeMarker>>& found) const;
+
+    ByteRange GetRange(const RangeMarker& marker) const;
+
+    size_t Size() const
+    {
+        return m_entries.size() - m_deadCount + m_pending.size() + m_pinned.size();
+    }
+
+    // The markers and the tree over them, in bytes
+    uint64_t GetMemoryUsage() const;
+
+private:
+    struct Node
+    {
+        ByteIndex shift = 0;
+        ByteIndex minFirst = 0;
+        ByteIndex maxFirst = 0;
+        ByteIndex maxSecond = 0;
+    };
+
+    struct Item
+    {
+        ByteRange range;
+        std::shared_ptr<RangeMarker> spMarker;
+    };
+
+    void Flush() const;
+    void Unlist(std::vector<std::shared_ptr<RangeMarker>>& markers, RangeMarker& marker);
+    std::vector<Item> Gather(uint32_t dropTypes) const;
+    void Rebuild(std::vector<Item>&& items) const;
+    void Build(size_t node, size_t begin, size_t end, const std::vector<ByteRange>& ranges) const;
+    void Gather(size_t node, size_t begin, size_t end, ByteIndex shift, std::vector<ByteRange>& ranges) const;
+    void Update(size_t node);
+    void Shift(size_t node, size_t begin, size_t end, size_t from, ByteIndex delta);
+    void Kill(size_t node, size_t begin, size_t end, size_t index, ByteIndex shift, const ByteIndex* pNewFirst);
+    void Kill(size_t index, const ByteIndex* pNewFirst, std::vector<std::shared_ptr<RangeMarker>>& removed);
+    size_t LowerBound(ByteIndex position) const;
+    void CollectEndingAfter(size_t node, size_t begin, size_t end, size_t before, ByteIndex position, ByteIndex shift, std::vector<size_t>& indices) const;
+    void Find(size_t node, size_t begin, size_t end, ByteIndex first, ByteIndex last, ByteIndex shift, std::vector<std::shared_ptr<RangeMarker>>& found) const;
+    size_t FindLeaf(size_t index, ByteIndex& shift) const;
+
+private:
+    // Start order; removed markers leave a null entry until the next rebuild
+    mutable std::vector<std::shared_ptr<RangeMarker>> m_entries;
+
+    // Node 1 is the root, and node n has children 2n and 2n + 1; leaves hold the marker positions
+    mutable std::vector<Node> m_nodes;
+    mutable size_t m_deadCount = 0;
+
+    mutable std::vector<std::shared_ptr<RangeMarker>> m_pending;
+
+    // Disabled markers, in no order
+    std::vector<std::shared_ptr<RangeMarker>> m_pinned;
+};
+
 }; // Zep
@@ -0,0 +1,133 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "zep/mcommon/file/path.h"
+
+namespace Zep
+{
+
+class IZepFileSystem;
+
+enum class SymbolKind : uint8_t
+{
+    Function,
+    Type,
+    Namespace,
+    Macro,
+    Variable
+};
+
+enum class SymbolLanguage
+{
+    None,
+    C,
+    Lisp
+};
+
+// A definition found by the tokenizer; line and column are 0 based
+struct ParsedSymbol
+{
+    std::string name;
+    uint32_t line = 0;
+    uint32_t column = 0;
+    SymbolKind kind = SymbolKind::Function;
+};
+
+// Everything defined in one file, and the state of the file when it was read
+struct ParsedSymbolFile
+{
+    ZepPath path;
+    uint64_t modifiedTime = 0;
+    uint64_t size = 0;
+    std::vector<ParsedSymbol> symbols;
+};
+
+struct SymbolDefinition
+{
+    ZepPath path;
+    long line = 0;
+    long column = 0;
+    SymbolKind kind = SymbolKind::Function;
+};
+
+// The definitions in the project files.
+// Names are interned into one sorted arena, and the symbols for each name are stored together, so a
+// lookup is a binary search over the names; nothing is read from disk to answer it.
+// The table is rebuilt as a whole from the per-file parse results, which are produced in parallel
+// elsewhere; files that haven't changed since the last build keep the symbols they had.
+class SymbolIndex
+{
+public:
+    // Persist to/from disk; typically <project>/.zep/symboldb
+    bool Load(IZepFileSystem& fs, const ZepPath& dbPath);
+    bool Save(IZepFileSystem& fs, const ZepPath& dbPath) const;
+
+    // True if the file needs (re)parsing
+    bool IsStale(const ZepPath& path, uint64_t modifiedTime, uint64_t size) const;
+
+    // Rebuild the table for the given list of root-relative paths.
+    // Files in 'parsed' replace what we had for them; files in neither are dropped.
+    void Update(const std::vector<ZepPath>& paths, const std::vector<ParsedSymbolFile>& parsed);
+
+    std::vector<SymbolDefinition> Find(const std::string& name) const;
+
+    size_t GetFileCount() const
+    {
+        return m_files.size();
+    }
+
+    size_t GetNameCount() const
+    {
+        return m_nameOffsets.size() - 1;
+    }
+
+    size_t GetSymbolCount() const
+    {
+        return m_symbols.size();
+    }
+
+    static SymbolLanguage GetLanguage(const ZepPath& path);
+
+    // A light tokenizer; enough to find definitions, not to understand the code
+    static void Parse(const std::string& text, SymbolLanguage language, std::vector<ParsedSymbol>& symbols);
+
+private:
+    struct SymbolFile
+    {
+        ZepPath path;
+        uint64_t modifiedTime = 0;
+        uint64_t size = 0;
+    };
+
+    struct SymbolEntry
+    {
+        uint32_t file = 0;
+        uint32_t line = 0;
+        uint32_t column = 0;
+        SymbolKind kind = SymbolKind::Function;
+    };
+
+    std::string GetName(uint32_t name) const
+    {
+        return std::string(m_nameText.data() + m_nameOffsets[name], m_nameText.data() + m_nameOffsets[name + 1]);
+    }
+    void Clear();
+
+private:
+    std::vector<SymbolFile> m_files;
+    std::unordered_map<std::string, uint32_t> m_fileLookup;
+
+    // Sorted names, back to back
+    std::vector<char> m_nameText;
+    std::vector<uint32_t> m_nameOffsets = { 0 };
+
+    // The symbols for name n are [m_nameSymbols[n], m_nameSymbols[n + 1])
+    std::vector<uint32_t> m_nameSymbols = { 0 };
+    std::vector<SymbolEntry> m_symbols;
+};
+
+} // namespace Zep
@@ -10,6 +10,7 @@
 
 #include "zep/mcommon/animation/timer.h"
 #include "zep/mcommon/math/math.h"
+#include "zep/mcommon/threadpool.h"
 
 namespace Zep
 {
@@ -68,6 +69,10 @@ public:
     }
     virtual void Notify(std::shared_ptr<ZepMessage> payload) override;
 
+    // In bytes; the syntax of each character, and the keywords and comments found
+    virtual uint64_t GetMemoryUsage() const;
+    uint64_t GetAdornmentMemoryUsage() const;
+
     const NVec4f& ToBackgroundColor(const SyntaxResult& res) const;
     const NVec4f& ToForegroundColor(const SyntaxResult& res) const;
 
@@ -80,14 +85,15 @@ protected:
     ZepBuffer& m_buffer;
     std::vector<CommentEntry> m_commentEntries;
     std::vector<SyntaxData> m_syntax;
-    std::future<void> m_syntaxResult;
     std::atomic<long> m_processedChar = { 0 };
     std::atomic<long> m_targetChar = { 0 };
     std::vector<uint32_t> m_multiCommentStarts;
     std::vector<uint32_t> m_multiCommentEnds;
     std::unordered_set<std::string> m_keywords;
     std::unordered_set<std::string> m_identifiers;
-    std::atomic<bool> m_stop;
+    // Passes run on the pool, and check the token of the one they belong to
+    TaskGroup m_syntaxTasks;
+    CancelToken m_cancel;
     std::vector<std::shared_ptr<ZepSyntaxAdorn>> m_adornments;
     uint32_t m_flags;
 
@@ -98,13 +104,17 @@ class ZepSyntaxAdorn : public ZepComponent
 {
 public:
     ZepSyntaxAdorn(ZepSyntax& syntax, ZepBuffer& buffer)
-        : ZepComponent(syntax.GetEditor())
+        : ZepComponent(syntax.GetEditor(), ComponentMessages::Subscribed)
         , m_buffer(buffer)
         , m_syntax(syntax)
     {
     }
 
     virtual SyntaxResult GetSyntaxAt(const GlyphIterator& offset, bool& found) const = 0;
+    virtual uint64_t GetMemoryUsage() const
+    {
+        return 0;
+    }
 
 protected:
     ZepBuffer& m_buffer;
@@ -16,6 +16,7 @@ public:
 
     void Notify(std::shared_ptr<ZepMessage> payload) override;
     virtual SyntaxResult GetSyntaxAt(const GlyphIterator& offset, bool& found) const override;
+    virtual uint64_t GetMemoryUsage() const override;
 
     virtual void Clear(const GlyphIterator& start, const GlyphIterator& end);
     virtual void Insert(const GlyphIterator& start, const GlyphIterator& end);
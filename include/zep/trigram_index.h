@@ -0,0 +1,91 @@
+#pragma once
+
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "zep/mcommon/file/path.h"
+
+namespace Zep
+{
+
+class IZepFileSystem;
+
+// A file that has been fed to the trigram index.
+// The modified time and size are used to decide if a file needs to be re-read on the next update
+struct TrigramFile
+{
+    ZepPath path;
+    uint64_t modifiedTime = 0;
+    uint64_t size = 0;
+    bool live = true;
+};
+
+// A verified hit in a file
+struct TrigramSearchResult
+{
+    ZepPath path;
+    long line = 0;
+    long column = 0;
+    std::string text;
+};
+
+// A posting-list index of every (lower case) 3 byte sequence in the project files.
+// Queries collect the trigrams that must be present in a matching file, intersect their posting
+// lists to get a small set of candidate files, and only then read those files to verify the match.
+// Files that change are tombstoned and re-added with a new id, so an update only reads the files
+// whose modified time or size has changed since the last time the index was built.
+class TrigramIndex
+{
+public:
+    // Persist to/from disk; typically <project>/.zep/indexdb
+    bool Load(IZepFileSystem& fs, const ZepPath& dbPath);
+    bool Save(IZepFileSystem& fs, const ZepPath& dbPath) const;
+
+    // Bring the index in line with the given list of root-relative paths.
+    // Returns the number of files that were (re)read.
+    uint32_t Update(IZepFileSystem& fs, const ZepPath& root, const std::vector<ZepPath>& paths);
+
+    // The same for a known set of changes; only the named files are looked at
+    uint32_t UpdateFiles(IZepFileSystem& fs, const ZepPath& root, const std::vector<ZepPath>& changed, const std::vector<ZepPath>& removed);
+
+    // Files that may contain all of the given literal strings
+    std::vector<uint32_t> GetCandidates(const std::vector<std::string>& literals) const;
+
+    std::vector<TrigramSearchResult> SearchLiteral(IZepFileSystem& fs, const ZepPath& root, const std::string& text, size_t maxResults = 1000) const;
+    std::vector<TrigramSearchResult> SearchRegex(IZepFileSystem& fs, const ZepPath& root, const std::string& pattern, size_t maxResults = 1000) const;
+
+    const TrigramFile& GetFile(uint32_t id) const
+    {
+        return m_files[id];
+    }
+
+    size_t GetLiveFileCount() const
+    {
+        return m_lookup.size();
+    }
+
+    size_t GetTrigramCount() const
+    {
+        return m_postings.size();
+    }
+
+    // Literal runs that any match of the regex must contain; empty if nothing could be proven
+    static std::vector<std::string> GetRequiredLiterals(const std::string& pattern);
+    static void GetTrigrams(const uint8_t* pBegin, const uint8_t* pEnd, std::vector<uint32_t>& trigrams);
+
+private:
+    void AddFile(const ZepPath& path, uint64_t modifiedTime, uint64_t size, const std::string& text);
+    bool RefreshFile(IZepFileSystem& fs, const ZepPath& root, const ZepPath& path);
+    void RemoveFile(const ZepPath& path);
+    void Compact();
+
+private:
+    std::vector<TrigramFile> m_files;
+    std::unordered_map<std::string, uint32_t> m_lookup;
+    std::unordered_map<uint32_t, std::vector<uint32_t>> m_postings;
+    uint32_t m_deadFiles = 0;
+};
+
+} // namespace Zep
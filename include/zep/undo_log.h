@@ -0,0 +1,92 @@
+#pragma once
+
+#include <cstdio>
+#include <string>
+#include <vector>
+
+#include "zep/glyph_iterator.h"
+
+// The undo history of a buffer.  The changes sit end to end in one array, with all of their text in one
+// string beside it, and a group (what one undo takes back) is just the index of its first change.
+// Typed characters join the insert before them, as do deletes in one place, so a run of typing or of
+// 'x' is a single change however long it is.
+namespace Zep
+{
+class ZepBuffer;
+
+class UndoLog
+{
+public:
+    // Text that was inserted at the offset, or deleted from it
+    struct Change
+    {
+        ByteIndex offset = 0;
+        size_t textStart = 0; // In m_text
+        uint32_t textLength = 0;
+        bool inserted = false;
+    };
+
+    struct Group
+    {
+        size_t firstChange = 0;
+        ByteIndex cursorBefore = -1;
+        ByteIndex cursorAfter = -1;
+    };
+
+    UndoLog() = default;
+    UndoLog(const UndoLog&) = delete;
+    UndoLog& operator=(const UndoLog&) = delete;
+    ~UndoLog();
+
+    // Recording.  Anything recorded after an undo replaces what could have been redone; changes made
+    // outside a group join the last one
+    void BeginGroup();
+    void AddInsert(ByteIndex offset, const std::string& text);
+    void AddDelete(ByteIndex offset, const std::string& text);
+    void AddCursors(const GlyphIterator& before, const GlyphIterator& after); // The first before, the last after
+    void Clear();
+
+    // Take back or make again a whole group, in one batch of buffer changes; returns where the cursor goes
+    GlyphIterator Undo(ZepBuffer& buffer);
+    GlyphIterator Redo(ZepBuffer& buffer);
+
+    // Over the budget, the oldest groups go; to a scratch file if spilling, where undo finds them again
+    void Trim(uint64_t budget, bool spill);
+
+    uint64_t GetUndoMemory() const;
+    uint64_t GetRedoMemory() const;
+    size_t GetGroupCount() const
+    {
+        return m_groups.size();
+    }
+    size_t GetChangeCount() const
+    {
+        return m_changes.size();
+    }
+    size_t GetSpillCount() const
+    {
+        return m_spills.size();
+    }
+
+private:
+    void TruncateRedo();
+    Group& CurrentGroup();
+    size_t GroupEnd(size_t group) const;
+    uint64_t GetUsedMemory(size_t groupBegin, size_t groupEnd) const;
+    void Spill(size_t groupCount);
+    bool Unspill();
+
+private:
+    std::vector<Change> m_changes;
+    std::vector<Group> m_groups;
+    std::string m_text;
+
+    // Groups before this have been done; the rest are there to redo
+    size_t m_current = 0;
+
+    // Older history in the scratch file, as a stack of [offset, size) chunks
+    std::FILE* m_pSpillFile = nullptr;
+    std::vector<std::pair<long, long>> m_spills;
+};
+
+} // namespace Zep
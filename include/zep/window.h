@@ -157,6 +157,9 @@ public:
 
     void DirtyLayout();
 
+    // The line spans laid out for the buffer
+    void AddMemoryUsage(BufferMemory& memory) const;
+
 private:
     void UpdateLayout(bool force = false);
     void UpdateMarkers();
@@ -165,6 +168,7 @@ private:
     void UpdateLineSpans();
     void EnsureCursorVisible();
     void UpdateVisibleLineRange();
+    void UpdateVirtualPage();
 
     NVec2i BufferToDisplay(const GlyphIterator& location);
 
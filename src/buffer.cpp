@@ -2,13 +2,19 @@
 #include <cctype>
 #include <cstdint>
 #include <cstdlib>
+#include <limits>
 #include <regex>
 
 #include "zep/buffer.h"
 #include "zep/editor.h"
 #include "zep/filesystem.h"
+#include "zep/syntax.h"
+#include "zep/window.h"
 
 #include "zep/mcommon/file/path.h"
+#include "zep/mcommon/memory.h"
+#include "zep/mcommon/string/line_diff.h"
+#include "zep/mcommon/string/lz.h"
 #include "zep/mcommon/string/stringutils.h"
 
 #include "zep/mcommon/logger.h"
@@ -16,9 +22,53 @@
 namespace Zep
 {
 
+// A reload worked out on a worker, against the buffer as it was when the reload started.
+// Each edit replaces [begin, end) of the old text with [newBegin, newEnd) of the new.
+struct BufferReload
+{
+    struct Edit
+    {
+        ByteIndex begin = 0;
+        ByteIndex end = 0;
+        ByteIndex newBegin = 0;
+        ByteIndex newEnd = 0;
+    };
+
+    bool found = false;
+    bool strippedCR = false;
+    bool knownState = false; // The file system could say when the file was modified
+    uint64_t updateCount = 0;
+    uint64_t modifiedTime = 0;
+    uint64_t size = 0;
+    std::string text;
+    std::vector<Edit> edits;
+};
+
 namespace
 {
 
+// Where an offset in the old text ends up in the new; inside a changed run it stays on the same line of
+// the run if there is one
+ByteIndex MapReloadOffset(const BufferReload& reload, ByteIndex offset)
+{
+    ByteIndex shift = 0;
+    for (auto& edit : reload.edits)
+    {
+        if (offset < edit.begin)
+        {
+            break;
+        }
+
+        if (offset < edit.end)
+        {
+            auto newLength = edit.newEnd - edit.newBegin;
+            return edit.newBegin + std::min(offset - edit.begin, std::max(newLength - 1, ByteIndex(0)));
+        }
+        shift += (edit.newEnd - edit.newBegin) - (edit.end - edit.begin);
+    }
+    return offset + shift;
+}
+
 // A VIM-like definition of a word.  Actually, in Vim this can be changed, but this editor
 // assumes a word is alphanumeric or underscore for consistency
 inline bool IsWordChar(const char c)
@@ -61,24 +111,141 @@ using fnMatch = std::function<bool>(const char);
 
 } // namespace
 ZepBuffer::ZepBuffer(ZepEditor& editor, const std::string& strName)
-    : ZepComponent(editor)
+    : ZepComponent(editor, ComponentMessages::Subscribed)
     , m_strName(strName)
 {
     Clear();
 }
 
 ZepBuffer::ZepBuffer(ZepEditor& editor, const ZepPath& path)
-    : ZepComponent(editor)
+    : ZepComponent(editor, ComponentMessages::Subscribed)
 {
     Load(path);
 }
 
 ZepBuffer::~ZepBuffer()
 {
+    // The reload posts back to us when it is done
+    if (m_reloadResult.valid())
+    {
+        m_reloadResult.wait();
+    }
+
+    if (m_damageStart >= 0)
+    {
+        GetEditor().CancelBufferChanges(*this);
+    }
 }
 
-void ZepBuffer::Notify(std::shared_ptr<ZepMessage> message)
+void ZepBuffer::Broadcast(BufferMessageType type, const GlyphIterator& startLocation, const GlyphIterator& endLocation)
 {
+    switch (type)
+    {
+    case BufferMessageType::PreBufferChange:
+    case BufferMessageType::TextAdded:
+    case BufferMessageType::TextDeleted:
+    case BufferMessageType::TextChanged:
+        if (GetEditor().IsBatchingBufferChanges())
+        {
+            AddDamage(type, startLocation.Index(), endLocation.Index());
+            return;
+        }
+        break;
+    case BufferMessageType::Loaded:
+        // Listeners must see what came before in order
+        FlushChanges();
+        break;
+    default:
+        break;
+    }
+
+    // Sent often enough that it is worth keeping off the heap
+    BufferMessage message(this, type, startLocation, endLocation);
+    GetEditor().Broadcast(message);
+}
+
+void ZepBuffer::AddDamage(BufferMessageType type, long start, long end)
+{
+    if (type == BufferMessageType::PreBufferChange)
+    {
+        // Listeners stop reading the buffer on the first change, and wait for the flush to look again
+        if (m_damageStart < 0)
+        {
+            BufferMessage message(this, type, GlyphIterator(this, start), GlyphIterator(this, end));
+            GetEditor().Broadcast(message);
+
+            m_damageStart = start;
+            m_damageEnd = start;
+            m_damageGrowth = 0;
+            GetEditor().QueueBufferChanges(*this);
+        }
+        return;
+    }
+
+    auto length = end - start;
+    if (type == BufferMessageType::TextAdded)
+    {
+        m_damageEnd = start <= m_damageEnd ? m_damageEnd + length : end;
+        m_damageGrowth += length;
+    }
+    else if (type == BufferMessageType::TextDeleted)
+    {
+        // Where the old end of the damage is now
+        if (m_damageEnd >= end)
+        {
+            m_damageEnd -= length;
+        }
+        else if (m_damageEnd > start)
+        {
+            m_damageEnd = start;
+        }
+        m_damageEnd = std::max(m_damageEnd, start);
+        m_damageGrowth -= length;
+    }
+    else
+    {
+        m_damageEnd = std::max(m_damageEnd, end);
+    }
+    m_damageStart = std::min(m_damageStart, start);
+}
+
+void ZepBuffer::FlushChanges()
+{
+    if (m_damageStart < 0)
+    {
+        return;
+    }
+
+    auto start = m_damageStart;
+    auto end = m_damageEnd;
+    auto growth = m_damageGrowth;
+    m_damageStart = -1;
+
+    BufferMessage message(this, BufferMessageType::TextReplaced, GlyphIterator(this, start), GlyphIterator(this, end), GlyphIterator(this, end - growth));
+    GetEditor().Broadcast(message);
+}
+
+void ZepBuffer::FinishReload(const BufferReload& reload)
+{
+    m_reloadActive = false;
+    if (!reload.found)
+    {
+        return;
+    }
+
+    if (reload.updateCount != m_updateCount)
+    {
+        // Edited while the diff ran; the edits are the user's, so leave the choice to them
+        SetFileFlags(FileFlags::ChangedOnDisk);
+        return;
+    }
+    ApplyReload(reload);
+
+    // Written again since we read it; without the file's details there is no telling, and it isn't worth a loop
+    if (reload.knownState && CheckDiskState())
+    {
+        Reload();
+    }
 }
 
 // Vertical column
@@ -734,6 +901,7 @@ void ZepBuffer::Load(const ZepPath& path)
         // Always set text, to ensure we prepare the buffer with 0 terminator,
         // even if string is empty
         SetText(read, true);
+        RecordDiskState();
     }
     else
     {
@@ -746,6 +914,8 @@ void ZepBuffer::Load(const ZepPath& path)
 
 bool ZepBuffer::Save(int64_t& size)
 {
+    Wake();
+
     if (ZTestFlags(m_fileFlags, FileFlags::Locked))
     {
         return false;
@@ -790,11 +960,181 @@ bool ZepBuffer::Save(int64_t& size)
             // We wrote succesfully, so make sure our path is canonical
             m_filePath = GetEditor().GetFileSystem().Canonical(m_filePath);
         }
+        RecordDiskState();
         return true;
     }
     return false;
 }
 
+void ZepBuffer::RecordDiskState()
+{
+    m_diskModifiedTime = 0;
+    m_diskSize = 0;
+    GetEditor().GetFileSystem().GetFileInfo(m_filePath, m_diskModifiedTime, m_diskSize);
+    ClearFileFlags(FileFlags::ChangedOnDisk);
+}
+
+bool ZepBuffer::CheckDiskState()
+{
+    // Without the file's details, it may always have changed
+    uint64_t modifiedTime = 0;
+    uint64_t size = 0;
+    if (GetEditor().GetFileSystem().GetFileInfo(m_filePath, modifiedTime, size) && modifiedTime == m_diskModifiedTime && size == m_diskSize)
+    {
+        return false;
+    }
+
+    SetFileFlags(FileFlags::ChangedOnDisk);
+    return true;
+}
+
+void ZepBuffer::Reload()
+{
+    if (m_reloadActive || m_filePath.empty())
+    {
+        return;
+    }
+
+    // The file is read when the buffer wakes anyway
+    if (m_hibernated && m_hibernatedOnDisk)
+    {
+        RecordDiskState();
+        return;
+    }
+    Wake();
+
+    // The worker gets copies; the buffer may change, or go away, before it is done
+    auto oldText = GetWorkingBuffer().string();
+    if (!oldText.empty() && oldText.back() == 0)
+    {
+        oldText.pop_back();
+    }
+
+    auto path = m_filePath;
+    auto updateCount = m_updateCount;
+    auto pFileSystem = &GetEditor().GetFileSystem();
+
+    auto read = [=]() {
+        TIME_SCOPE(BufferReload);
+        auto spReload = std::make_shared<BufferReload>();
+        spReload->updateCount = updateCount;
+        if (!pFileSystem->Exists(path))
+        {
+            return spReload;
+        }
+
+        // Stat first; if it changes again while we read, we'll hear about it again
+        spReload->knownState = pFileSystem->GetFileInfo(path, spReload->modifiedTime, spReload->size);
+        auto text = pFileSystem->Read(path);
+        spReload->found = true;
+
+        // As SetText, the buffer only holds '\n'
+        spReload->text.reserve(text.size());
+        for (auto& ch : text)
+        {
+            if (ch == '\r')
+            {
+                spReload->strippedCR = true;
+            }
+            else
+            {
+                spReload->text.push_back(ch);
+            }
+        }
+
+        auto oldLines = diff_split_lines(oldText);
+        auto newLines = diff_split_lines(spReload->text);
+        auto lineOffset = [](const std::vector<std::string_view>& lines, const std::string& base, uint32_t line) {
+            return line < lines.size() ? ByteIndex(lines[line].data() - base.data()) : ByteIndex(base.size());
+        };
+
+        for (auto& hunk : diff_lines(oldLines, newLines))
+        {
+            BufferReload::Edit edit;
+            edit.begin = lineOffset(oldLines, oldText, hunk.oldLine);
+            edit.end = lineOffset(oldLines, oldText, hunk.oldLine + hunk.oldCount);
+            edit.newBegin = lineOffset(newLines, spReload->text, hunk.newLine);
+            edit.newEnd = lineOffset(newLines, spReload->text, hunk.newLine + hunk.newCount);
+            spReload->edits.push_back(edit);
+        }
+        return spReload;
+    };
+
+    // The result is applied on the main thread, as soon as it is ready
+    auto pEditor = &GetEditor();
+    m_reloadActive = true;
+    m_reloadResult = GetEditor().GetThreadPool().enqueue([this, pEditor, read]() {
+        auto spReload = read();
+        pEditor->PostToMainThread(this, [this, spReload]() {
+            FinishReload(*spReload);
+        });
+    });
+}
+
+void ZepBuffer::ApplyReload(const BufferReload& reload)
+{
+    // Cursors move with the lines around them
+    auto windows = GetEditor().FindBufferWindows(this);
+    std::vector<ByteIndex> cursors;
+    for (auto& pWindow : windows)
+    {
+        cursors.push_back(MapReloadOffset(reload, pWindow->GetBufferCursor().Index()));
+    }
+    auto cursorBefore = windows.empty() ? ByteIndex(-1) : windows[0]->GetBufferCursor().Index();
+
+    // The reload is an undo of its own, so the history before it still lines up with the text
+    m_undoLog.BeginGroup();
+
+    // Bottom up, so the offsets of the edits still to come don't move; listeners hear about them as one
+    GetEditor().BeginBufferChanges();
+    ChangeRecord changeRecord;
+    for (auto itr = reload.edits.rbegin(); itr != reload.edits.rend(); itr++)
+    {
+        auto& edit = *itr;
+        auto str = reload.text.substr(edit.newBegin, edit.newEnd - edit.newBegin);
+        m_undoLog.AddDelete(edit.begin, GetBufferText(GlyphIterator(this, edit.begin), GlyphIterator(this, edit.end)));
+        m_undoLog.AddInsert(edit.begin, str);
+
+        changeRecord.Clear();
+        if (edit.begin == edit.end)
+        {
+            Insert(GlyphIterator(this, edit.begin), str, changeRecord);
+        }
+        else if (str.empty())
+        {
+            Delete(GlyphIterator(this, edit.begin), GlyphIterator(this, edit.end), changeRecord);
+        }
+        else
+        {
+            Replace(GlyphIterator(this, edit.begin), GlyphIterator(this, edit.end), str, ReplaceRangeMode::Replace, changeRecord);
+        }
+    }
+    GetEditor().EndBufferChanges();
+
+    for (size_t i = 0; i < windows.size(); i++)
+    {
+        windows[i]->SetBufferCursor(GlyphIterator(this, cursors[i]).Clamped());
+    }
+
+    if (!windows.empty())
+    {
+        m_undoLog.AddCursors(GlyphIterator(this, cursorBefore), windows[0]->GetBufferCursor());
+    }
+
+    // Whatever comes next, even mid insert, goes in a group after it
+    m_undoLog.BeginGroup();
+
+    if (reload.strippedCR)
+    {
+        m_fileFlags |= FileFlags::StrippedCR;
+    }
+
+    // In step with the disk again
+    m_diskModifiedTime = reload.modifiedTime;
+    m_diskSize = reload.size;
+    ClearFileFlags(FileFlags::Dirty | FileFlags::ChangedOnDisk);
+}
+
 std::string ZepBuffer::GetDisplayName() const
 {
     if (m_filePath.empty())
@@ -853,6 +1193,8 @@ void ZepBuffer::MarkUpdate()
 // Otherwise it is just reset to default state.  A new buffer is always initially cleared.
 void ZepBuffer::Clear()
 {
+    Wake();
+
     // A buffer that is empty is brand new; just make it 0 chars and return
     if (m_workingBuffer.size() <= 1)
     {
@@ -865,7 +1207,8 @@ void ZepBuffer::Clear()
     }
 
     // Inform clients we are about to change the buffer
-    GetEditor().Broadcast(std::make_shared<BufferMessage>(this, BufferMessageType::PreBufferChange, GlyphIterator(this), End()));
+    auto oldEnd = End();
+    Broadcast(BufferMessageType::PreBufferChange, GlyphIterator(this), oldEnd);
 
     m_workingBuffer.clear();
     m_workingBuffer.push_back(0);
@@ -875,15 +1218,16 @@ void ZepBuffer::Clear()
 
     {
         MarkUpdate();
-        GetEditor().Broadcast(std::make_shared<BufferMessage>(this, BufferMessageType::TextDeleted, GlyphIterator(this), End()));
+        Broadcast(BufferMessageType::TextDeleted, GlyphIterator(this), oldEnd);
     }
 }
 
 // Replace the buffer with the text
 void ZepBuffer::SetText(const std::string& text, bool initFromFile)
 {
-    // First, clear it
+    // First, clear it; the history is of some other text
     Clear();
+    m_undoLog.Clear();
 
     bool lastWasSpace = false;
     if (!text.empty())
@@ -954,14 +1298,14 @@ void ZepBuffer::SetText(const std::string& text, bool initFromFile)
     // When loading a file, send the Loaded message to distinguish it from adding to a buffer, and remember that the buffer is not dirty in this case
     if (initFromFile)
     {
-        GetEditor().Broadcast(std::make_shared<BufferMessage>(this, BufferMessageType::Loaded, Begin(), End()));
+        Broadcast(BufferMessageType::Loaded, Begin(), End());
 
         // Doc is not dirty
         m_fileFlags = ZClearFlags(m_fileFlags, FileFlags::Dirty);
     }
     else
     {
-        GetEditor().Broadcast(std::make_shared<BufferMessage>(this, BufferMessageType::TextAdded, Begin(), End()));
+        Broadcast(BufferMessageType::TextAdded, Begin(), End());
     }
 }
 
@@ -1106,6 +1450,8 @@ std::string ZepBuffer::GetBufferText(const GlyphIterator& start, const GlyphIter
 
 bool ZepBuffer::Insert(const GlyphIterator& startIndex, const std::string& str, ChangeRecord& changeRecord)
 {
+    Wake();
+
     if (!startIndex.Valid())
     {
         return false;
@@ -1115,10 +1461,18 @@ bool ZepBuffer::Insert(const GlyphIterator& startIndex, const std::string& str,
 
     sigPreInsert(*this, startIndex, str);
 
+    // Markers move with the text, or go if it lands inside them
+    std::vector<std::shared_ptr<RangeMarker>> removedMarkers;
+    m_markerTable.Insert(startIndex.Index(), long(str.size()), removedMarkers);
+    if (!removedMarkers.empty())
+    {
+        Broadcast(BufferMessageType::MarkersChanged, Begin(), End());
+    }
+
     // We are about to modify this range
     // TODO: Is this correct, and/or useful in any way??
     // We aren't changing this range at all; we are shifting those characters forward and replacing the area
-    GetEditor().Broadcast(std::make_shared<BufferMessage>(this, BufferMessageType::PreBufferChange, startIndex, endIndex));
+    Broadcast(BufferMessageType::PreBufferChange, startIndex, endIndex);
 
     // abcdef\r\nabc<insert>dfdf\r\n
     auto itrLine = std::lower_bound(m_lineEnds.begin(), m_lineEnds.end(), startIndex.Index());
@@ -1171,13 +1525,15 @@ bool ZepBuffer::Insert(const GlyphIterator& startIndex, const std::string& str,
     MarkUpdate();
 
     // This is the range we added (not valid any more in the buffer)
-    GetEditor().Broadcast(std::make_shared<BufferMessage>(this, BufferMessageType::TextAdded, startIndex, endIndex));
+    Broadcast(BufferMessageType::TextAdded, startIndex, endIndex);
 
     return true;
 }
 
 bool ZepBuffer::Replace(const GlyphIterator& startIndex, const GlyphIterator& endIndex, std::string str, ReplaceRangeMode mode, ChangeRecord& changeRecord)
 {
+    Wake();
+
     if (!startIndex.Valid() || !endIndex.Valid())
     {
         return false;
@@ -1197,7 +1553,7 @@ bool ZepBuffer::Replace(const GlyphIterator& startIndex, const GlyphIterator& en
     changeRecord.strDeleted = GetBufferText(startIndex, endIndex);
 
     // We are about to modify this range
-    GetEditor().Broadcast(std::make_shared<BufferMessage>(this, BufferMessageType::PreBufferChange, startIndex, endIndex));
+    Broadcast(BufferMessageType::PreBufferChange, startIndex, endIndex);
 
     // Perform a fill
     for (auto loc = startIndex; loc < endIndex; loc++)
@@ -1210,7 +1566,7 @@ bool ZepBuffer::Replace(const GlyphIterator& startIndex, const GlyphIterator& en
     MarkUpdate();
 
     // This is the range we added (not valid any more in the buffer)
-    GetEditor().Broadcast(std::make_shared<BufferMessage>(this, BufferMessageType::TextChanged, startIndex, endIndex));
+    Broadcast(BufferMessageType::TextChanged, startIndex, endIndex);
 
     return true;
 }
@@ -1225,16 +1581,25 @@ bool ZepBuffer::Replace(const GlyphIterator& startIndex, const GlyphIterator& en
 // This makes a few things fall out more easily
 bool ZepBuffer::Delete(const GlyphIterator& startIndex, const GlyphIterator& endIndex, ChangeRecord& changeRecord)
 {
+    Wake();
+
     assert(startIndex.Valid());
     assert(endIndex.Valid());
 
     // We are about to modify this range
-    GetEditor().Broadcast(std::make_shared<BufferMessage>(this, BufferMessageType::PreBufferChange, startIndex, endIndex));
+    Broadcast(BufferMessageType::PreBufferChange, startIndex, endIndex);
 
     changeRecord.strDeleted = GetBufferText(startIndex, endIndex);
 
     sigPreDelete(*this, startIndex, endIndex);
 
+    std::vector<std::shared_ptr<RangeMarker>> removedMarkers;
+    m_markerTable.Delete(startIndex.Index(), endIndex.Index(), removedMarkers);
+    if (!removedMarkers.empty())
+    {
+        Broadcast(BufferMessageType::MarkersChanged, Begin(), End());
+    }
+
     auto itrLine = std::lower_bound(m_lineEnds.begin(), m_lineEnds.end(), startIndex.Index());
     if (itrLine == m_lineEnds.end())
     {
@@ -1266,7 +1631,7 @@ bool ZepBuffer::Delete(const GlyphIterator& startIndex, const GlyphIterator& end
     MarkUpdate();
 
     // This is the range we deleted (not valid any more in the buffer)
-    GetEditor().Broadcast(std::make_shared<BufferMessage>(this, BufferMessageType::TextDeleted, startIndex, endIndex));
+    Broadcast(BufferMessageType::TextDeleted, startIndex, endIndex);
 
     return true;
 }
@@ -1312,26 +1677,18 @@ void ZepBuffer::SetSelection(const GlyphRange& selection)
 
 void ZepBuffer::AddRangeMarker(std::shared_ptr<RangeMarker> spMarker)
 {
-    m_rangeMarkers[spMarker->GetRange().first].insert(spMarker);
+    m_markerTable.Add(spMarker);
 
     // TODO: Why is this necessary; marks the whole buffer
-    GetEditor().Broadcast(std::make_shared<BufferMessage>(this, BufferMessageType::MarkersChanged, Begin(), End()));
+    Broadcast(BufferMessageType::MarkersChanged, Begin(), End());
 }
 
 void ZepBuffer::ClearRangeMarker(std::shared_ptr<RangeMarker> spMarker)
 {
-    auto itr = m_rangeMarkers.find(spMarker->GetRange().first);
-    if (itr != m_rangeMarkers.end())
-    {
-        itr->second.erase(spMarker);
-        if (itr->second.empty())
-        {
-            m_rangeMarkers.erase(spMarker->GetRange().first);
-        }
-    }
+    m_markerTable.Remove(*spMarker);
 
     // TODO: Why is this necessary; marks the whole buffer
-    GetEditor().Broadcast(std::make_shared<BufferMessage>(this, BufferMessageType::MarkersChanged, Begin(), End()));
+    Broadcast(BufferMessageType::MarkersChanged, Begin(), End());
 }
 
 void ZepBuffer::ClearRangeMarkers(const std::set<std::shared_ptr<RangeMarker>>& markers)
@@ -1340,7 +1697,7 @@ void ZepBuffer::ClearRangeMarkers(const std::set<std::shared_ptr<RangeMarker>>&
     {
         ClearRangeMarker(marker);
     }
-    GetEditor().Broadcast(std::make_shared<BufferMessage>(this, BufferMessageType::MarkersChanged, Begin(), End()));
+    Broadcast(BufferMessageType::MarkersChanged, Begin(), End());
 }
 
 void ZepBuffer::ClearRangeMarkers(uint32_t markerType)
@@ -1360,18 +1717,22 @@ void ZepBuffer::ClearRangeMarkers(uint32_t markerType)
         ClearRangeMarker(victim);
     }
 
-    GetEditor().Broadcast(std::make_shared<BufferMessage>(this, BufferMessageType::MarkersChanged, Begin(), End()));
+    Broadcast(BufferMessageType::MarkersChanged, Begin(), End());
 }
 
-bool OverlapInclusive(ByteRange r1, ByteRange r2)
+std::vector<std::shared_ptr<RangeMarker>> ZepBuffer::ReplaceRangeMarkers(uint32_t markerTypes, const std::vector<RangeMarkerDesc>& markers)
 {
-    // -----aaaaa----
-    // ---bbbbbbbbb-------
-    if (r1.first <= r2.second && r2.first <= r1.second)
+    std::vector<std::shared_ptr<RangeMarker>> created;
+    created.reserve(markers.size());
+    for (auto& desc : markers)
     {
-        return true;
+        created.push_back(std::make_shared<RangeMarker>(*this, desc));
     }
-    return false;
+
+    m_markerTable.Replace(markerTypes, created);
+
+    Broadcast(BufferMessageType::MarkersChanged, Begin(), End());
+    return created;
 }
 
 void ZepBuffer::ForEachMarker(uint32_t markerType, Direction dir, const GlyphIterator& begin, const GlyphIterator& end, std::function<bool(const std::shared_ptr<RangeMarker>&)> fnCB) const
@@ -1379,32 +1740,35 @@ void ZepBuffer::ForEachMarker(uint32_t markerType, Direction dir, const GlyphIte
     ByteRange inclusive = ByteRange(begin.Index(), end.Peek(-1).Index());
     if (dir == Direction::Forward)
     {
-        for (auto itr = m_rangeMarkers.begin(); itr != m_rangeMarkers.end(); itr++)
+        // Collected first; the callback is free to add or remove markers
+        std::vector<std::shared_ptr<RangeMarker>> found;
+        m_markerTable.Find(inclusive.first, inclusive.second, found);
+
+        std::vector<size_t> runEnds;
+        for (size_t index = 1; index <= found.size(); index++)
         {
+            if (index == found.size() || found[index]->GetRange().first != found[index - 1]->GetRange().first)
+            {
+                runEnds.push_back(index);
+            }
+        }
+
+        size_t runStart = 0;
+        for (auto runEnd : runEnds)
+        {
+            // Enumerate timed markers after all others at the same place, because these are effects that should happen last
             for (int pass = 0; pass < 2; pass++)
             {
-                for (auto& markerItem : itr->second)
+                for (auto index = runStart; index < runEnd; index++)
                 {
+                    auto& markerItem = found[index];
                     if ((markerItem->markerType & markerType) == 0)
                     {
                         continue;
                     }
 
-                    // Enumerate timed markers after all others, because these are effects that should happen last
-                    if (pass == 0)
-                    {
-                        if (markerItem->displayType & RangeMarkerDisplayType::Timed)
-                            continue;
-                    }
-                    else
-                    {
-                        if (!(markerItem->displayType & RangeMarkerDisplayType::Timed))
-                            continue;
-                    }
-
-                    ByteRange markerInclusive = ByteRange(markerItem->GetRange().first, std::max(0l, markerItem->GetRange().second - 1));
-
-                    if (!OverlapInclusive(inclusive, markerInclusive))
+                    bool timed = (markerItem->displayType & RangeMarkerDisplayType::Timed) != 0;
+                    if (timed != (pass == 1))
                     {
                         continue;
                     }
@@ -1415,25 +1779,24 @@ void ZepBuffer::ForEachMarker(uint32_t markerType, Direction dir, const GlyphIte
                     }
                 }
             }
+            runStart = runEnd;
         }
     }
     else
     {
-        auto itrREnd = std::make_reverse_iterator(m_rangeMarkers.begin());
-        auto itrRStart = std::make_reverse_iterator(m_rangeMarkers.end());
+        std::vector<std::shared_ptr<RangeMarker>> found;
+        m_markerTable.Find(0, std::numeric_limits<ByteIndex>::max(), found);
 
-        for (auto itr = itrRStart; itr != itrREnd; itr++)
+        for (auto itr = found.rbegin(); itr != found.rend(); itr++)
         {
-            for (auto& markerItem : itr->second)
+            auto& markerItem = *itr;
+            if ((markerItem->markerType & markerType) == 0)
             {
-                if ((markerItem->markerType & markerType) == 0)
-                {
-                    continue;
-                }
-                if (!fnCB(markerItem))
-                {
-                    return;
-                }
+                continue;
+            }
+            if (!fnCB(markerItem))
+            {
+                return;
             }
         }
     }
@@ -1521,6 +1884,57 @@ BufferType ZepBuffer::GetBufferType() const
     return m_bufferType;
 }
 
+void ZepBuffer::SetVirtualList(long lineCount, fnVirtualLine fnGetLine)
+{
+    m_bufferType = BufferType::VirtualList;
+    m_fnVirtualLine = fnGetLine;
+    m_virtualLineCount = lineCount;
+    m_virtualPageStart = -1;
+    SetVirtualPage(0, m_virtualPageLines);
+}
+
+// Only the lines in the page are ever built; so the cost of a list update is the size of the page, not the list
+bool ZepBuffer::SetVirtualPage(long startLine, long pageLines)
+{
+    pageLines = std::max(1l, pageLines);
+    startLine = std::max(0l, std::min(startLine, m_virtualLineCount - pageLines));
+    if (startLine == m_virtualPageStart && pageLines == m_virtualPageLines)
+    {
+        return false;
+    }
+
+    m_virtualPageStart = startLine;
+    m_virtualPageLines = pageLines;
+
+    std::string text;
+    auto endLine = std::min(m_virtualLineCount, startLine + pageLines);
+    for (long line = startLine; line < endLine; line++)
+    {
+        if (line != startLine)
+        {
+            text += '\n';
+        }
+        text += m_fnVirtualLine(line);
+    }
+    SetText(text);
+    return true;
+}
+
+long ZepBuffer::GetVirtualLineCount() const
+{
+    return m_virtualLineCount;
+}
+
+long ZepBuffer::GetVirtualPageStart() const
+{
+    return std::max(0l, m_virtualPageStart);
+}
+
+long ZepBuffer::GetVirtualPageLines() const
+{
+    return m_virtualPageLines;
+}
+
 void ZepBuffer::SetLastEditLocation(GlyphIterator loc)
 {
     m_lastEditLocation = loc;
@@ -1571,6 +1985,120 @@ bool ZepBuffer::IsHidden() const
     return windows.empty();
 }
 
+bool ZepBuffer::Hibernate()
+{
+    // Only a quiet, hidden file buffer; the others are part of the UI, or in the middle of something
+    if (m_hibernated || m_bufferType != BufferType::Normal || m_fnVirtualLine || m_reloadActive || m_damageStart >= 0 || m_workingBuffer.size() <= 1 || !IsHidden())
+    {
+        return false;
+    }
+
+    // A syntax that was set by hand can't be made again
+    if (m_spSyntax && !m_syntaxProvider.factory)
+    {
+        return false;
+    }
+
+    TIME_SCOPE(BufferHibernate);
+    auto text = m_workingBuffer.string();
+    m_hibernatedHash = std::hash<std::string>()(text);
+    m_hibernatedOnDisk = !HasFileFlags(FileFlags::Dirty | FileFlags::ChangedOnDisk) && !m_filePath.empty() && GetEditor().GetFileSystem().Exists(m_filePath);
+    if (!m_hibernatedOnDisk)
+    {
+        m_hibernatedText = lz_compress(text);
+        m_hibernatedText.shrink_to_fit();
+    }
+
+    // Nobody is told; the text is back before anyone looks at it again
+    m_spSyntax.reset();
+    m_workingBuffer.clear();
+    m_workingBuffer.push_back(0);
+    m_lineEnds = std::vector<ByteIndex>{ End().Index() + 1 };
+    m_hibernated = true;
+    return true;
+}
+
+void ZepBuffer::Wake()
+{
+    m_lastUsedTime = timer_get_time_now();
+    if (!m_hibernated)
+    {
+        return;
+    }
+
+    TIME_SCOPE(BufferWake);
+    m_hibernated = false;
+
+    // The syntax starts on the empty buffer, and hears about the text as a load
+    if (m_syntaxProvider.factory)
+    {
+        m_spSyntax = m_syntaxProvider.factory(this);
+    }
+
+    std::string text;
+    if (m_hibernatedOnDisk)
+    {
+        // As SetText reads it
+        auto read = GetEditor().GetFileSystem().Read(m_filePath);
+        text.reserve(read.size() + 1);
+        for (auto& ch : read)
+        {
+            if (ch != '\r')
+            {
+                text.push_back(ch);
+            }
+        }
+        if (text.empty() || text.back() != 0)
+        {
+            text.push_back(0);
+        }
+
+        // Someone changed it while we slept; nothing was edited here, so take theirs
+        if (std::hash<std::string>()(text) != m_hibernatedHash)
+        {
+            SetText(read, true);
+            RecordDiskState();
+            return;
+        }
+    }
+    else if (!lz_decompress(m_hibernatedText, text))
+    {
+        assert(!"Hibernated text is damaged");
+        ZLOG(ERROR, "Lost the hibernated text of " << GetDisplayName());
+        text = std::string(1, 0);
+    }
+    std::string().swap(m_hibernatedText);
+
+    m_workingBuffer.assign(text.begin(), text.end());
+    m_lineEnds.clear();
+    for (size_t index = 0; index < text.size(); index++)
+    {
+        if (text[index] == '\n')
+        {
+            m_lineEnds.push_back(ByteIndex(index + 1));
+        }
+    }
+    m_lineEnds.push_back(End().Index() + 1);
+
+    Broadcast(BufferMessageType::Loaded, Begin(), End());
+}
+
+void ZepBuffer::AddMemoryUsage(BufferMemory& memory) const
+{
+    memory.text += m_workingBuffer.size();
+    memory.textGap += m_workingBuffer.capacity() - m_workingBuffer.size();
+    memory.lineEnds += memory_vector_bytes(m_lineEnds);
+    memory.markers += m_markerTable.GetMemoryUsage();
+    memory.hibernated += memory_string_bytes(m_hibernatedText);
+    memory.undo += m_undoLog.GetUndoMemory();
+    memory.redo += m_undoLog.GetRedoMemory();
+    if (m_spSyntax)
+    {
+        memory.syntax += m_spSyntax->GetMemoryUsage();
+        memory.adornments += m_spSyntax->GetAdornmentMemoryUsage();
+    }
+}
+
 void ZepBuffer::SetFileFlags(uint32_t flags, bool set)
 {
     m_fileFlags = ZSetFlags(m_fileFlags, flags, set);
@@ -32,13 +32,9 @@ void ZepCommand_DeleteRange::Redo()
     }
 }
 
-void ZepCommand_DeleteRange::Undo()
+void ZepCommand_DeleteRange::RecordUndo(UndoLog& undoLog) const
 {
-    if (m_changeRecord.strDeleted.empty())
-        return;
-
-    ChangeRecord tempRecord;
-    m_buffer.Insert(m_startIndex, m_changeRecord.strDeleted, tempRecord);
+    undoLog.AddDelete(m_startIndex.Index(), m_changeRecord.strDeleted);
 }
 
 // Insert a string
@@ -65,12 +61,11 @@ void ZepCommand_Insert::Redo()
     }
 }
 
-void ZepCommand_Insert::Undo()
+void ZepCommand_Insert::RecordUndo(UndoLog& undoLog) const
 {
     if (m_endIndexInserted.Valid())
     {
-        ChangeRecord tempRecord;
-        m_buffer.Delete(m_startIndex, m_endIndexInserted, tempRecord);
+        undoLog.AddInsert(m_startIndex.Index(), m_strInsert);
     }
 }
 
@@ -94,14 +89,16 @@ void ZepCommand_ReplaceRange::Redo()
     }
 }
 
-void ZepCommand_ReplaceRange::Undo()
+void ZepCommand_ReplaceRange::RecordUndo(UndoLog& undoLog) const
 {
-    if (m_startIndex != m_endIndex)
+    if (m_startIndex == m_endIndex || m_changeRecord.strDeleted.empty())
     {
-        // Replace the range we replaced previously with the old thing
-        ChangeRecord temp;
-        m_buffer.Replace(m_startIndex, m_mode == ReplaceRangeMode::Fill ? m_endIndex : m_startIndex.PeekByteOffset((long)m_strReplace.length()), m_changeRecord.strDeleted, ReplaceRangeMode::Replace, temp);
+        return;
     }
+
+    // Either way it is the old text out and the new in; a fill is the first character, over the same length
+    undoLog.AddDelete(m_startIndex.Index(), m_changeRecord.strDeleted);
+    undoLog.AddInsert(m_startIndex.Index(), m_mode == ReplaceRangeMode::Fill ? std::string(m_changeRecord.strDeleted.size(), m_strReplace[0]) : m_strReplace);
 }
 
 } // namespace Zep
\ No newline at end of file
@@ -1,6 +1,7 @@
 #include "zep/editor.h"
 #include "zep/filesystem.h"
 #include "zep/indexer.h"
+#include "zep/key_replay.h"
 #include "zep/mode_search.h"
 #include "zep/mode_standard.h"
 #include "zep/mode_tree.h"
@@ -11,6 +12,8 @@
 
 #include "config_app.h"
 
+#include <cmath>
+#include <iomanip>
 #include <unordered_set>
 
 namespace Zep
@@ -26,15 +29,24 @@ bool Zep::ZLog::disabled = false;
 namespace Zep
 {
 
-ZepComponent::ZepComponent(ZepEditor& editor)
+namespace
+{
+// Changes of the cursor blink state per second
+const double CursorBlinkRate = 1.75;
+} // namespace
+
+ZepComponent::ZepComponent(ZepEditor& editor, ComponentMessages messages)
     : m_editor(editor)
 {
-    m_editor.RegisterCallback(this);
+    if (messages == ComponentMessages::All)
+    {
+        m_editor.RegisterCallback(this);
+    }
 }
 
 ZepComponent::~ZepComponent()
 {
-    m_editor.UnRegisterCallback(this);
+    m_editor.Unsubscribe(this);
 }
 
 ZepEditor::ZepEditor(ZepDisplay* pDisplay, const ZepPath& configRoot, uint32_t flags, IZepFileSystem* pFileSystem)
@@ -66,6 +78,12 @@ ZepEditor::ZepEditor(ZepDisplay* pDisplay, const ZepPath& configRoot, uint32_t f
         m_threadPool = std::make_unique<ThreadPool>();
     }
 
+    // Whoever is waiting on the result is told on the next refresh
+    m_threadPool->set_task_done([this]() {
+        Wake();
+    });
+    profile_set_thread_name("Main");
+
     LoadConfig(m_pFileSystem->GetConfigPath() / "zep.cfg");
 
     m_spTheme = std::make_shared<ZepTheme>();
@@ -107,6 +125,12 @@ ZepEditor::~ZepEditor()
 {
     std::for_each(m_tabWindows.begin(), m_tabWindows.end(), [](ZepTabWindow* w) { delete w; });
     m_tabWindows.clear();
+
+    // The indexer drops what it hasn't done rather than finishing the walk; then any other background work is
+    // finished before the things it uses go away
+    m_indexer.reset();
+    m_threadPool.reset();
+
     delete m_pDisplay;
     delete m_pFileSystem;
 }
@@ -124,6 +148,45 @@ void ZepEditor::OnFileChanged(const ZepPath& path)
         LoadConfig(path);
         Broadcast(std::make_shared<ZepMessage>(Msg::ConfigChanged));
     }
+
+    for (auto& spBuffer : m_buffers)
+    {
+        if (spBuffer->GetFilePath() == path && !spBuffer->HasFileFlags(FileFlags::ChangedOnDisk) && spBuffer->CheckDiskState())
+        {
+            // Unedited buffers just follow the file; otherwise the user decides
+            if (!spBuffer->HasFileFlags(FileFlags::Dirty))
+            {
+                spBuffer->Reload();
+            }
+            else
+            {
+                SetCommandText("Changed on disk: " + spBuffer->GetDisplayName());
+            }
+            RequestRefresh();
+        }
+    }
+}
+
+void ZepEditor::UpdateFileEvents()
+{
+    m_fileEvents.clear();
+    GetFileSystem().PollFileEvents(m_fileEvents);
+    if (m_fileEvents.empty())
+    {
+        return;
+    }
+
+    std::set<std::string> changed;
+    for (auto& event : m_fileEvents)
+    {
+        if (!event.isDirectory && event.change != ZepFileChange::Overflow && changed.insert(event.path.string()).second)
+        {
+            OnFileChanged(event.path);
+        }
+    }
+
+    Broadcast(std::make_shared<ZepMessage>(Msg::FilesChanged));
+    m_fileEvents.clear();
 }
 
 // If you pass a valid path to a 'zep.cfg' file, then editor settings will serialize from that
@@ -163,6 +226,7 @@ void ZepEditor::LoadConfig(std::shared_ptr<cpptoml::table> spConfig)
     try
     {
         m_config.showNormalModeKeyStrokes = spConfig->get_qualified_as<bool>("editor.show_normal_mode_keystrokes").value_or(false);
+        m_config.showLatency = spConfig->get_qualified_as<bool>("editor.show_latency").value_or(false);
         m_config.showIndicatorRegion = spConfig->get_qualified_as<bool>("editor.show_indicator_region").value_or(true);
         m_config.showLineNumbers = spConfig->get_qualified_as<bool>("editor.show_line_numbers").value_or(true);
         m_config.autoHideCommandRegion = spConfig->get_qualified_as<bool>("editor.autohide_command_region").value_or(false);
@@ -177,6 +241,9 @@ void ZepEditor::LoadConfig(std::shared_ptr<cpptoml::table> spConfig)
         m_config.shortTabNames = spConfig->get_qualified_as<bool>("editor.short_tab_names").value_or(false);
         m_config.tabToneColors = spConfig->get_qualified_as<bool>("editor.tab_tone_colors").value_or(false);
         m_config.searchGitRoot = spConfig->get_qualified_as<bool>("search.search_git_root").value_or(true);
+        m_config.hibernateBudget = spConfig->get_qualified_as<uint32_t>("editor.hibernate_budget_mb").value_or(512);
+        m_config.undoBudget = spConfig->get_qualified_as<uint32_t>("editor.undo_budget_mb").value_or(64);
+        m_config.undoSpill = spConfig->get_qualified_as<bool>("editor.undo_spill").value_or(false);
         auto styleStr = string_tolower(spConfig->get_qualified_as<std::string>("editor.style").value_or("normal"));
         if (styleStr == "normal")
         {
@@ -208,12 +275,16 @@ void ZepEditor::SaveConfig(std::shared_ptr<cpptoml::table> spConfig)
     table->insert("background_fade_time", (double)m_config.backgroundFadeTime);
     table->insert("background_fade_wait", (double)m_config.backgroundFadeWait);
     table->insert("cursor_line_solid", m_config.cursorLineSolid);
+    table->insert("hibernate_budget_mb", m_config.hibernateBudget);
     table->insert("line_margin_bottom", m_config.lineMargins.y);
     table->insert("line_margin_top", m_config.lineMargins.x);
     table->insert("short_tab_names", m_config.shortTabNames);
     table->insert("tab_tone_colors", m_config.tabToneColors);
+    table->insert("undo_budget_mb", m_config.undoBudget);
+    table->insert("undo_spill", m_config.undoSpill);
     table->insert("search_git_root", m_config.searchGitRoot);
     table->insert("show_indicator_region", m_config.showIndicatorRegion);
+    table->insert("show_latency", m_config.showLatency);
     table->insert("show_line_numbers", m_config.showLineNumbers);
     table->insert("show_normal_mode_keystrokes", m_config.showNormalModeKeyStrokes);
     table->insert("show_scrollbar", m_config.showScrollBar);
@@ -286,6 +357,77 @@ std::vector<ZepWindow*> ZepEditor::FindBufferWindows(const ZepBuffer* pBuffer) c
     return bufferWindows;
 }
 
+std::vector<BufferMemory> ZepEditor::GetMemoryUsage() const
+{
+    std::vector<BufferMemory> usage;
+    for (auto& spBuffer : m_buffers)
+    {
+        BufferMemory memory;
+        memory.pBuffer = spBuffer.get();
+        spBuffer->AddMemoryUsage(memory);
+        for (auto pWindow : FindBufferWindows(spBuffer.get()))
+        {
+            pWindow->AddMemoryUsage(memory);
+        }
+        usage.push_back(memory);
+    }
+
+    std::stable_sort(usage.begin(), usage.end(), [](const BufferMemory& lhs, const BufferMemory& rhs) {
+        return lhs.Total() > rhs.Total();
+    });
+    return usage;
+}
+
+uint32_t ZepEditor::HibernateBuffers(uint64_t budget)
+{
+    auto residentBytes = [](const ZepBuffer& buffer) {
+        BufferMemory memory;
+        buffer.AddMemoryUsage(memory);
+        return memory.Total();
+    };
+
+    uint64_t total = 0;
+    std::vector<ZepBuffer*> candidates;
+    for (auto& spBuffer : m_buffers)
+    {
+        total += residentBytes(*spBuffer);
+        if (!spBuffer->IsHibernated())
+        {
+            candidates.push_back(spBuffer.get());
+        }
+    }
+
+    std::sort(candidates.begin(), candidates.end(), [](ZepBuffer* pLhs, ZepBuffer* pRhs) {
+        return pLhs->GetLastUsedTime() < pRhs->GetLastUsedTime();
+    });
+
+    uint32_t count = 0;
+    for (auto pBuffer : candidates)
+    {
+        if (total <= budget)
+        {
+            break;
+        }
+
+        auto before = residentBytes(*pBuffer);
+        if (pBuffer->Hibernate())
+        {
+            auto after = residentBytes(*pBuffer);
+            total -= before > after ? before - after : 0;
+            count++;
+        }
+    }
+    return count;
+}
+
+void ZepEditor::UpdateHibernation()
+{
+    if (m_config.hibernateBudget != 0)
+    {
+        HibernateBuffers(uint64_t(m_config.hibernateBudget) << 20);
+    }
+}
+
 void ZepEditor::RemoveBuffer(ZepBuffer* pBuffer)
 {
     auto bufferWindows = FindBufferWindows(pBuffer);
@@ -336,6 +478,7 @@ ZepBuffer* ZepEditor::GetFileBuffer(const ZepPath& filePath, uint32_t fileFlags,
             {
                 if (GetFileSystem().Equivalent(pBuffer->GetFilePath(), path))
                 {
+                    pBuffer->Wake();
                     return pBuffer.get();
                 }
             }
@@ -872,6 +1015,156 @@ void ZepEditor::RegisterSyntaxFactory(const std::vector<std::string>& mappings,
     }
 }
 
+std::vector<IZepComponent*>* ZepEditor::FindSubscribers(Msg id, const ZepBuffer* pBuffer, bool create)
+{
+    if (!pBuffer)
+    {
+        return &m_subscribers[size_t(id)];
+    }
+
+    auto itr = m_bufferSubscribers.find(pBuffer);
+    if (itr == m_bufferSubscribers.end())
+    {
+        if (!create)
+        {
+            return nullptr;
+        }
+        itr = m_bufferSubscribers.emplace(pBuffer, std::vector<IZepComponent*>()).first;
+    }
+    return &itr->second;
+}
+
+void ZepEditor::Subscribe(IZepComponent* pClient, Msg id, const ZepBuffer* pBuffer)
+{
+    // Only buffer messages have a source
+    assert(!pBuffer || id == Msg::Buffer);
+
+    auto& subscriptions = m_subscriptions[pClient];
+    auto key = std::make_pair(id, pBuffer);
+    if (std::find(subscriptions.begin(), subscriptions.end(), key) != subscriptions.end())
+    {
+        return;
+    }
+    subscriptions.push_back(key);
+    FindSubscribers(id, pBuffer, true)->push_back(pClient);
+}
+
+void ZepEditor::Subscribe(IZepComponent* pClient, std::initializer_list<Msg> ids)
+{
+    for (auto id : ids)
+    {
+        Subscribe(pClient, id);
+    }
+}
+
+void ZepEditor::RegisterCallback(IZepComponent* pClient)
+{
+    for (size_t id = 0; id < size_t(Msg::Count); id++)
+    {
+        Subscribe(pClient, Msg(id));
+    }
+}
+
+void ZepEditor::Unsubscribe(IZepComponent* pClient, Msg id, const ZepBuffer* pBuffer)
+{
+    auto itrClient = m_subscriptions.find(pClient);
+    if (itrClient == m_subscriptions.end())
+    {
+        return;
+    }
+
+    auto& subscriptions = itrClient->second;
+    auto key = std::make_pair(id, pBuffer);
+    auto itrKey = std::find(subscriptions.begin(), subscriptions.end(), key);
+    if (itrKey == subscriptions.end())
+    {
+        return;
+    }
+    subscriptions.erase(itrKey);
+    if (subscriptions.empty())
+    {
+        m_subscriptions.erase(itrClient);
+    }
+
+    auto pSubscribers = FindSubscribers(id, pBuffer, false);
+    auto itr = std::find(pSubscribers->begin(), pSubscribers->end(), pClient);
+    if (m_broadcastDepth == 0)
+    {
+        pSubscribers->erase(itr);
+        if (pBuffer && pSubscribers->empty())
+        {
+            m_bufferSubscribers.erase(pBuffer);
+        }
+    }
+    else
+    {
+        // A broadcast may be walking this list
+        *itr = nullptr;
+        m_dirtySubscribers.push_back(key);
+    }
+}
+
+void ZepEditor::Unsubscribe(IZepComponent* pClient)
+{
+    CancelTicks(pClient);
+    CancelPosts(pClient);
+
+    auto itrClient = m_subscriptions.find(pClient);
+    if (itrClient == m_subscriptions.end())
+    {
+        return;
+    }
+
+    auto subscriptions = itrClient->second;
+    for (auto& [id, pBuffer] : subscriptions)
+    {
+        Unsubscribe(pClient, id, pBuffer);
+    }
+}
+
+void ZepEditor::CompactSubscribers()
+{
+    auto dirty = std::move(m_dirtySubscribers);
+    m_dirtySubscribers.clear();
+    for (auto& [id, pBuffer] : dirty)
+    {
+        auto pSubscribers = FindSubscribers(id, pBuffer, false);
+        if (!pSubscribers)
+        {
+            continue;
+        }
+        pSubscribers->erase(std::remove(pSubscribers->begin(), pSubscribers->end(), nullptr), pSubscribers->end());
+        if (pBuffer && pSubscribers->empty())
+        {
+            m_bufferSubscribers.erase(pBuffer);
+        }
+    }
+}
+
+bool ZepEditor::Dispatch(std::vector<IZepComponent*>* pSubscribers, const std::shared_ptr<ZepMessage>& message)
+{
+    if (!pSubscribers)
+    {
+        return false;
+    }
+
+    // Walk by index; the list can grow while we call out, and those that join now wait for the next message
+    auto count = pSubscribers->size();
+    for (size_t index = 0; index < count; index++)
+    {
+        auto pClient = (*pSubscribers)[index];
+        if (pClient)
+        {
+            pClient->Notify(message);
+            if (message->handled)
+            {
+                return true;
+            }
+        }
+    }
+    return false;
+}
+
 // Inform clients of an event in the buffer
 bool ZepEditor::Broadcast(std::shared_ptr<ZepMessage> message)
 {
@@ -879,15 +1172,270 @@ bool ZepEditor::Broadcast(std::shared_ptr<ZepMessage> message)
     if (message->handled)
         return true;
 
-    for (auto& client : m_notifyClients)
+    m_broadcastDepth++;
+
+    // Listeners on the source buffer first, then those that want every message of this kind
+    if (message->messageId == Msg::Buffer)
     {
-        client->Notify(message);
-        if (message->handled)
-            break;
+        auto pBuffer = static_cast<BufferMessage*>(message.get())->pBuffer;
+        Dispatch(FindSubscribers(Msg::Buffer, pBuffer, false), message);
+    }
+    if (!message->handled)
+    {
+        Dispatch(FindSubscribers(message->messageId, nullptr, false), message);
+    }
+
+    if (--m_broadcastDepth == 0 && !m_dirtySubscribers.empty())
+    {
+        CompactSubscribers();
     }
     return message->handled;
 }
 
+void ZepEditor::BeginBufferChanges()
+{
+    m_bufferChangeDepth++;
+}
+
+void ZepEditor::EndBufferChanges()
+{
+    assert(m_bufferChangeDepth > 0);
+    if (--m_bufferChangeDepth > 0)
+    {
+        return;
+    }
+
+    TIME_SCOPE(BufferChanges);
+
+    // Listeners may edit again; anything they change now is sent straight away
+    auto changed = std::move(m_changedBuffers);
+    m_changedBuffers.clear();
+    for (auto pBuffer : changed)
+    {
+        pBuffer->FlushChanges();
+    }
+}
+
+void ZepEditor::BeginInputLatency()
+{
+    // Keys sent from inside a key (replays, mappings) are part of the outer one
+    if (m_inputDepth++ > 0)
+    {
+        return;
+    }
+
+    // The key's allocations are counted over the same span
+    m_keyAllocations = AllocationScope();
+
+    // A host that never draws would otherwise collect these forever
+    const size_t MaxPendingInputs = 1024;
+    if (m_pendingInputs.size() >= MaxPendingInputs)
+    {
+        m_pendingInputs.erase(m_pendingInputs.begin());
+    }
+
+    PendingInput input;
+    input.arrived = timer_get_time_now();
+    m_pendingInputs.push_back(input);
+}
+
+void ZepEditor::MarkInputLatency(LatencyStage stage)
+{
+    if (m_inputDepth != 1 || m_pendingInputs.empty())
+    {
+        return;
+    }
+
+    auto& input = m_pendingInputs.back();
+    if (stage == LatencyStage::Command)
+    {
+        input.commandDone = timer_get_time_now();
+    }
+    else if (stage == LatencyStage::Edit)
+    {
+        input.editDone = timer_get_time_now();
+    }
+}
+
+void ZepEditor::EndInputLatency()
+{
+    assert(m_inputDepth > 0);
+    MarkInputLatency(LatencyStage::Edit);
+    if (--m_inputDepth == 0)
+    {
+        AddAllocations("key", m_keyAllocations.GetCounts());
+    }
+}
+
+void ZepEditor::AddLayoutLatency(uint64_t time)
+{
+    m_frameLayoutTime += time;
+}
+
+const LatencyHistogram& ZepEditor::GetLatency(LatencyStage stage) const
+{
+    return m_latency[size_t(stage)];
+}
+
+void ZepEditor::ResetLatency()
+{
+    for (auto& histogram : m_latency)
+    {
+        histogram.Clear();
+    }
+}
+
+void ZepEditor::StartKeyRecording()
+{
+    m_spKeyRecording = std::make_shared<KeyRecording>();
+    m_keyRecordingStart = timer_get_time_now();
+}
+
+std::shared_ptr<KeyRecording> ZepEditor::StopKeyRecording()
+{
+    auto spRecording = m_spKeyRecording;
+    m_spKeyRecording.reset();
+    return spRecording;
+}
+
+void ZepEditor::RecordKey(uint32_t key, uint32_t modifiers)
+{
+    // A key sent while handling another is replayed by that one
+    if (!m_spKeyRecording || m_inputDepth > 0)
+    {
+        return;
+    }
+
+    RecordedKey recorded;
+    recorded.time = timer_get_time_now() - m_keyRecordingStart;
+    recorded.key = key;
+    recorded.modifiers = modifiers;
+    m_spKeyRecording->keys.push_back(recorded);
+}
+
+void ZepEditor::EnableCommandTimes(bool enable)
+{
+    m_timeCommands = enable;
+    m_commandTimes.clear();
+}
+
+void ZepEditor::AddCommandTime(const StringId& id, uint64_t time)
+{
+    if (!m_timeCommands)
+    {
+        return;
+    }
+
+    auto& total = m_commandTimes[id];
+    total.count++;
+    total.time += time;
+    total.max = std::max(total.max, time);
+}
+
+std::vector<ProfileTotal> ZepEditor::GetCommandTimes() const
+{
+    std::vector<ProfileTotal> times;
+    for (auto& [id, total] : m_commandTimes)
+    {
+        times.push_back(total);
+        times.back().name = id.id == 0 ? "(unmapped)" : id.ToString();
+    }
+    return times;
+}
+
+void ZepEditor::AddAllocations(const std::string& scope, const AllocationCounts& counts)
+{
+    if (!memory_hooks_installed())
+    {
+        return;
+    }
+
+    auto& total = m_allocations[scope];
+    total.scopes++;
+    total.allocs += counts.allocs;
+    total.bytes += counts.bytes;
+    total.maxAllocs = std::max(total.maxAllocs, counts.allocs);
+}
+
+const std::map<std::string, AllocationTotal>& ZepEditor::GetAllocations() const
+{
+    return m_allocations;
+}
+
+void ZepEditor::ResetAllocations()
+{
+    m_allocations.clear();
+}
+
+const char* ZepEditor::GetLatencyStageName(LatencyStage stage)
+{
+    switch (stage)
+    {
+    case LatencyStage::Command:
+        return "Command";
+    case LatencyStage::Edit:
+        return "Edit";
+    case LatencyStage::Queue:
+        return "Queue";
+    case LatencyStage::Layout:
+        return "Layout";
+    case LatencyStage::Draw:
+        return "Draw";
+    case LatencyStage::Total:
+        return "Total";
+    default:
+        return "";
+    }
+}
+
+void ZepEditor::UpdateLatency(uint64_t frameStart)
+{
+    auto layoutTime = m_frameLayoutTime;
+    m_frameLayoutTime = 0;
+
+    // Only the frames that show a key count; an idle redraw isn't keeping anyone waiting.
+    // A key still being handled is shown by a later frame.
+    auto count = m_pendingInputs.size() - (m_inputDepth > 0 && !m_pendingInputs.empty() ? 1 : 0);
+    if (count == 0)
+    {
+        return;
+    }
+
+    auto now = timer_get_time_now();
+    auto frameTime = now - frameStart;
+    m_latency[size_t(LatencyStage::Layout)].Add(layoutTime);
+    m_latency[size_t(LatencyStage::Draw)].Add(frameTime - std::min(layoutTime, frameTime));
+
+    for (size_t index = 0; index < count; index++)
+    {
+        // Without a command mark, the whole key counts as the edit
+        auto& input = m_pendingInputs[index];
+        auto commandDone = std::max(input.commandDone, input.arrived);
+        auto editDone = std::max(input.editDone, commandDone);
+        m_latency[size_t(LatencyStage::Command)].Add(commandDone - input.arrived);
+        m_latency[size_t(LatencyStage::Edit)].Add(editDone - commandDone);
+        m_latency[size_t(LatencyStage::Queue)].Add(frameStart > editDone ? frameStart - editDone : 0);
+        m_latency[size_t(LatencyStage::Total)].Add(now - input.arrived);
+    }
+    m_pendingInputs.erase(m_pendingInputs.begin(), m_pendingInputs.begin() + count);
+}
+
+void ZepEditor::QueueBufferChanges(ZepBuffer& buffer)
+{
+    m_changedBuffers.push_back(&buffer);
+}
+
+void ZepEditor::CancelBufferChanges(ZepBuffer& buffer)
+{
+    m_changedBuffers.erase(std::remove(m_changedBuffers.begin(), m_changedBuffers.end(), &buffer), m_changedBuffers.end());
+}
+
+bool ZepEditor::Broadcast(ZepMessage& message)
+{
+    // Shares no ownership, so nothing is allocated
+    return Broadcast(std::shared_ptr<ZepMessage>(std::shared_ptr<ZepMessage>(), &message));
+}
+
 const std::deque<std::shared_ptr<ZepBuffer>>& ZepEditor::GetBuffers() const
 {
     return m_buffers;
@@ -934,6 +1482,12 @@ ZepBuffer* ZepEditor::CreateNewBuffer(const ZepPath& path)
 
     InitBuffer(*pBuffer);
 
+    // So we know if someone else changes it
+    if (!pBuffer->GetFilePath().empty() && GetFileSystem().Exists(pBuffer->GetFilePath()))
+    {
+        GetFileSystem().WatchDirectory(pBuffer->GetFilePath().parent_path());
+    }
+
     return pBuffer.get();
 }
 
@@ -1064,13 +1618,186 @@ void ZepEditor::SetCommandText(const std::string& strCommand)
 
 void ZepEditor::RequestRefresh()
 {
-    m_bPendingRefresh = true;
+    // Can come from another thread; make sure a sleeping host notices
+    if (!m_bPendingRefresh.exchange(true))
+    {
+        Wake();
+    }
+}
+
+void ZepEditor::ScheduleTick(IZepComponent* pClient, float seconds)
+{
+    auto dueTime = timer_get_time_now() + uint64_t(std::max(0.0f, seconds) * 1000000.0f);
+    for (auto& scheduled : m_scheduledTicks)
+    {
+        if (scheduled.pClient == pClient && !scheduled.fnReady)
+        {
+            scheduled.dueTime = std::min(scheduled.dueTime, dueTime);
+            return;
+        }
+    }
+    m_scheduledTicks.push_back(ScheduledTick{ pClient, dueTime, nullptr });
+}
+
+void ZepEditor::TickWhenReady(IZepComponent* pClient, std::function<bool()> fnReady)
+{
+    for (auto& scheduled : m_scheduledTicks)
+    {
+        if (scheduled.pClient == pClient && scheduled.fnReady)
+        {
+            scheduled.fnReady = fnReady;
+            return;
+        }
+    }
+    m_scheduledTicks.push_back(ScheduledTick{ pClient, 0, fnReady });
+}
+
+void ZepEditor::CancelTicks(IZepComponent* pClient)
+{
+    m_scheduledTicks.erase(std::remove_if(m_scheduledTicks.begin(), m_scheduledTicks.end(), [pClient](const ScheduledTick& scheduled) {
+        return scheduled.pClient == pClient;
+    }),
+        m_scheduledTicks.end());
+    std::replace(m_dueTicks.begin(), m_dueTicks.end(), pClient, (IZepComponent*)nullptr);
+}
+
+void ZepEditor::RunScheduledTicks()
+{
+    auto now = timer_get_time_now();
+    for (auto itr = m_scheduledTicks.begin(); itr != m_scheduledTicks.end();)
+    {
+        if (itr->fnReady ? itr->fnReady() : itr->dueTime <= now)
+        {
+            m_dueTicks.push_back(itr->pClient);
+            itr = m_scheduledTicks.erase(itr);
+        }
+        else
+        {
+            itr++;
+        }
+    }
+
+    // Clients can schedule again, or go away, while the others are ticked
+    ZepMessage tick(Msg::Tick);
+    auto spTick = std::shared_ptr<ZepMessage>(std::shared_ptr<ZepMessage>(), &tick);
+    for (size_t index = 0; index < m_dueTicks.size(); index++)
+    {
+        if (m_dueTicks[index])
+        {
+            m_dueTicks[index]->Notify(spTick);
+        }
+    }
+    m_dueTicks.clear();
+}
+
+float ZepEditor::GetNextWakeup() const
+{
+    if (m_bPendingRefresh || m_bWoken || ZTestFlags(m_flags, ZepEditorFlags::FastUpdate))
+    {
+        return 0.0f;
+    }
+
+    // The next change of the cursor blink
+    auto blinks = timer_get_elapsed_seconds(m_cursorTimer) * CursorBlinkRate;
+    auto next = (std::floor(blinks) + 1.0 - blinks) / CursorBlinkRate;
+
+    auto now = timer_get_time_now();
+    for (auto& scheduled : m_scheduledTicks)
+    {
+        if (!scheduled.fnReady)
+        {
+            next = std::min(next, scheduled.dueTime > now ? timer_to_seconds(scheduled.dueTime - now) : 0.0);
+        }
+    }
+    return float(next);
+}
+
+void ZepEditor::SetWakeupCallback(std::function<void()> fnWakeup)
+{
+    m_fnWakeup = fnWakeup;
+}
+
+void ZepEditor::Wake()
+{
+    m_bWoken = true;
+    if (m_fnWakeup)
+    {
+        m_fnWakeup();
+    }
+}
+
+void ZepEditor::PostToMainThread(IZepComponent* pOwner, std::function<void()> fn)
+{
+    {
+        std::lock_guard<std::mutex> lock(m_postMutex);
+        m_posts.push_back(PostedCall{ pOwner, std::move(fn) });
+    }
+    Wake();
+}
+
+void ZepEditor::CancelPosts(IZepComponent* pOwner)
+{
+    {
+        std::lock_guard<std::mutex> lock(m_postMutex);
+        m_posts.erase(std::remove_if(m_posts.begin(), m_posts.end(), [pOwner](const PostedCall& posted) {
+            return posted.pOwner == pOwner;
+        }),
+            m_posts.end());
+    }
+
+    // Only the main thread runs them; one may be running now, so it is skipped rather than destroyed
+    for (auto& posted : m_runningPosts)
+    {
+        if (posted.pOwner == pOwner)
+        {
+            posted.pOwner = nullptr;
+        }
+    }
+}
+
+void ZepEditor::RunPosts()
+{
+    TIME_SCOPE(RunPosts);
+    // A continuation can start more work, which may post again (or finish straight away, if the pool runs
+    // tasks inline); keep going until there is nothing left, so a chain of stages completes in one refresh
+    for (;;)
+    {
+        {
+            std::lock_guard<std::mutex> lock(m_postMutex);
+            if (m_posts.empty())
+            {
+                return;
+            }
+            std::swap(m_posts, m_runningPosts);
+        }
+        PROFILE_COUNTER(Posts, m_runningPosts.size());
+
+        for (size_t index = 0; index < m_runningPosts.size(); index++)
+        {
+            if (m_runningPosts[index].pOwner)
+            {
+                m_runningPosts[index].fn();
+            }
+        }
+        m_runningPosts.clear();
+    }
 }
 
 bool ZepEditor::RefreshRequired()
 {
-    // Allow any components to update themselves
-    Broadcast(std::make_shared<ZepMessage>(Msg::Tick));
+    TIME_SCOPE(RefreshRequired);
+    m_bWoken = false;
+    UpdateFileEvents();
+
+    // Results handed back by the thread pool
+    RunPosts();
+
+    // Components whose time has come, or whose results are in
+    RunScheduledTicks();
+
+    // And any that still want a Tick every time we are polled
+    ZepMessage tick(Msg::Tick);
+    Broadcast(tick);
 
     auto lastBlink = m_lastCursorBlink;
     if (m_bPendingRefresh || lastBlink != GetCursorBlinkState())
@@ -1087,7 +1814,7 @@ bool ZepEditor::RefreshRequired()
 
 bool ZepEditor::GetCursorBlinkState() const
 {
-    m_lastCursorBlink = (int(timer_get_elapsed_seconds(m_cursorTimer) * 1.75f) & 1) ? true : false;
+    m_lastCursorBlink = (int(timer_get_elapsed_seconds(m_cursorTimer) * CursorBlinkRate) & 1) ? true : false;
     return m_lastCursorBlink;
 }
 
@@ -1139,6 +1866,8 @@ void ZepEditor::UpdateSize()
 
 void ZepEditor::Display()
 {
+    auto frameStart = timer_get_time_now();
+    AllocationScope frameAllocations;
     UpdateWindowState();
 
     if (m_bRegionsChanged)
@@ -1146,6 +1875,7 @@ void ZepEditor::Display()
         m_bRegionsChanged = false;
         UpdateSize();
     }
+    AddLayoutLatency(timer_get_time_now() - frameStart);
 
     // Command plus output
     auto& commandLines = GetCommandLines();
@@ -1279,8 +2009,66 @@ void ZepEditor::Display()
     {
         GetActiveTabWindow()->Display();
     }
+
+    // The overlay isn't part of what it measures
+    AddAllocations("frame", frameAllocations.GetCounts());
+    UpdateLatency(frameStart);
+    if (m_config.showLatency)
+    {
+        DisplayLatency();
+    }
 } // namespace Zep
 
+void ZepEditor::DisplayLatency()
+{
+    auto& uiFont = m_pDisplay->GetFont(ZepTextType::UI);
+    auto border = DPI_X(textBorder);
+    auto lineHeight = uiFont.GetPixelHeight();
+
+    auto textWidth = [&](const std::string& text) {
+        return uiFont.GetTextSize((const uint8_t*)text.c_str(), (const uint8_t*)text.c_str() + text.size()).x;
+    };
+
+    // A name, then p50, p99 and max in milliseconds, in columns wide enough for a second
+    const char* headings[] = { "ms", "p50", "p99", "max" };
+    auto nameWidth = textWidth("Command") + border * 2.0f;
+    auto columnWidth = textWidth("0000.00") + border * 2.0f;
+    auto rows = size_t(LatencyStage::Count) + 1;
+
+    NRectf rc(m_editorRegion->rect.Right() - nameWidth - columnWidth * 3.0f - border * 2.0f, m_editorRegion->rect.Top(), nameWidth + columnWidth * 3.0f + border * 2.0f, lineHeight * rows + border * 2.0f);
+    m_pDisplay->DrawRectFilled(rc, GetTheme().GetColor(ThemeColor::Background));
+
+    auto textColor = GetTheme().GetColor(ThemeColor::Text);
+    auto drawRow = [&](size_t row, const std::string* pColumns) {
+        auto pos = rc.topLeftPx + NVec2f(border, border + lineHeight * row);
+        for (size_t column = 0; column < 4; column++)
+        {
+            // Numbers are right aligned
+            auto x = column == 0 ? 0.0f : nameWidth + columnWidth * column - textWidth(pColumns[column]) - border;
+            m_pDisplay->DrawChars(uiFont, pos + NVec2f(x, 0.0f), textColor, (const uint8_t*)pColumns[column].c_str());
+        }
+    };
+
+    std::string columns[4] = { headings[0], headings[1], headings[2], headings[3] };
+    drawRow(0, columns);
+
+    auto toText = [](uint64_t time) {
+        std::ostringstream str;
+        str << std::fixed << std::setprecision(2) << timer_to_ms(time);
+        return str.str();
+    };
+
+    for (size_t stage = 0; stage < size_t(LatencyStage::Count); stage++)
+    {
+        auto& histogram = m_latency[stage];
+        columns[0] = GetLatencyStageName(LatencyStage(stage));
+        columns[1] = toText(histogram.GetPercentile(0.5));
+        columns[2] = toText(histogram.GetPercentile(0.99));
+        columns[3] = toText(histogram.GetMax());
+        drawRow(stage + 1, columns);
+    }
+}
+
 ZepTheme& ZepEditor::GetTheme() const
 {
     return *m_spTheme;
@@ -1289,7 +2077,8 @@ ZepTheme& ZepEditor::GetTheme() const
 bool ZepEditor::OnMouseMove(const NVec2f& mousePos)
 {
     m_mousePos = mousePos;
-    bool handled = Broadcast(std::make_shared<ZepMessage>(Msg::MouseMove, mousePos));
+    ZepMessage message(Msg::MouseMove, mousePos);
+    bool handled = Broadcast(message);
     m_bPendingRefresh = true;
     return handled;
 }
@@ -1297,7 +2086,8 @@ bool ZepEditor::OnMouseMove(const NVec2f& mousePos)
 bool ZepEditor::OnMouseDown(const NVec2f& mousePos, ZepMouseButton button)
 {
     m_mousePos = mousePos;
-    bool handled = Broadcast(std::make_shared<ZepMessage>(Msg::MouseDown, mousePos, button));
+    ZepMessage message(Msg::MouseDown, mousePos, button);
+    bool handled = Broadcast(message);
     m_bPendingRefresh = true;
     return handled;
 }
@@ -1305,7 +2095,8 @@ bool ZepEditor::OnMouseDown(const NVec2f& mousePos, ZepMouseButton button)
 bool ZepEditor::OnMouseUp(const NVec2f& mousePos, ZepMouseButton button)
 {
     m_mousePos = mousePos;
-    bool handled = Broadcast(std::make_shared<ZepMessage>(Msg::MouseUp, mousePos, button));
+    ZepMessage message(Msg::MouseUp, mousePos, button);
+    bool handled = Broadcast(message);
     m_bPendingRefresh = true;
     return handled;
 }
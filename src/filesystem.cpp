@@ -13,6 +13,13 @@
 #include <filesystem>
 namespace cpp_fs = std::filesystem;
 
+#if defined(ZEP_FEATURE_FILE_WATCHER) && defined(__linux__)
+#define ZEP_INOTIFY
+#include <cerrno>
+#include <sys/inotify.h>
+#include <unistd.h>
+#endif
+
 namespace Zep
 {
 ZepFileSystemCPP::ZepFileSystemCPP(const ZepPath& configPath)
@@ -34,6 +41,12 @@ ZepFileSystemCPP::ZepFileSystemCPP(const ZepPath& configPath)
 
 ZepFileSystemCPP::~ZepFileSystemCPP()
 {
+#ifdef ZEP_INOTIFY
+    if (m_watchHandle >= 0)
+    {
+        close(m_watchHandle);
+    }
+#endif
 }
 
 void ZepFileSystemCPP::SetWorkingDirectory(const ZepPath& path)
@@ -133,6 +146,18 @@ void ZepFileSystemCPP::ScanDirectory(const ZepPath& path, std::function<bool(con
     }
 }
 
+void ZepFileSystemCPP::ListDirectory(const ZepPath& path, std::function<void(const std::string& name, bool isDirectory)> fnEntry) const
+{
+    std::error_code ec;
+    for (auto itr = cpp_fs::directory_iterator(path.string(), ec); !ec && itr != cpp_fs::directory_iterator(); itr.increment(ec))
+    {
+        // The entry caches the type read with the directory, so these don't need a stat
+        std::error_code typeError;
+        auto isDirectory = !itr->is_symlink(typeError) && itr->is_directory(typeError);
+        fnEntry(itr->path().filename().string(), isDirectory);
+    }
+}
+
 bool ZepFileSystemCPP::Exists(const ZepPath& path) const
 {
     try
@@ -147,6 +172,24 @@ bool ZepFileSystemCPP::Exists(const ZepPath& path) const
     }
 }
 
+bool ZepFileSystemCPP::GetFileInfo(const ZepPath& path, uint64_t& modifiedTime, uint64_t& size) const
+{
+    std::error_code ec;
+    auto time = cpp_fs::last_write_time(path.string(), ec);
+    if (ec)
+    {
+        return false;
+    }
+    auto fileSize = cpp_fs::file_size(path.string(), ec);
+    if (ec)
+    {
+        return false;
+    }
+    modifiedTime = uint64_t(time.time_since_epoch().count());
+    size = uint64_t(fileSize);
+    return true;
+}
+
 bool ZepFileSystemCPP::Equivalent(const ZepPath& path1, const ZepPath& path2) const
 {
     try
@@ -269,6 +312,112 @@ void ZepFileSystemCPP::SetFlags(uint32_t flags)
     m_flags = flags;
 }
 
+bool ZepFileSystemCPP::WatchDirectory(const ZepPath& path)
+{
+#ifdef ZEP_INOTIFY
+    std::lock_guard<std::mutex> lock(m_watchMutex);
+    if (m_watchFailed)
+    {
+        return false;
+    }
+
+    if (m_watchHandle < 0)
+    {
+        m_watchHandle = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+        if (m_watchHandle < 0)
+        {
+            ZLOG(INFO, "File watching unavailable");
+            m_watchFailed = true;
+            return false;
+        }
+    }
+
+    // Close after write catches the end of a save, moves catch editors that save by renaming a temporary
+    auto watch = inotify_add_watch(m_watchHandle, path.c_str(), IN_CREATE | IN_DELETE | IN_CLOSE_WRITE | IN_MOVED_FROM | IN_MOVED_TO | IN_ONLYDIR | IN_DONT_FOLLOW);
+    if (watch < 0)
+    {
+        // Most likely out of watches (fs.inotify.max_user_watches); report it once
+        if (errno == ENOSPC)
+        {
+            ZLOG(INFO, "Out of file watches; some changes will be missed");
+            m_watchFailed = true;
+        }
+        return false;
+    }
+
+    m_watches[watch] = path;
+    return true;
+#else
+    ZEP_UNUSED(path);
+    return false;
+#endif
+}
+
+void ZepFileSystemCPP::PollFileEvents(std::vector<ZepFileEvent>& events)
+{
+#ifdef ZEP_INOTIFY
+    std::lock_guard<std::mutex> lock(m_watchMutex);
+    if (m_watchHandle < 0)
+    {
+        return;
+    }
+
+    alignas(inotify_event) char buffer[16384];
+    for (;;)
+    {
+        auto length = read(m_watchHandle, buffer, sizeof(buffer));
+        if (length <= 0)
+        {
+            break;
+        }
+
+        for (auto pCh = buffer; pCh < buffer + length;)
+        {
+            auto pEvent = reinterpret_cast<const inotify_event*>(pCh);
+            pCh += sizeof(inotify_event) + pEvent->len;
+
+            if (pEvent->mask & IN_Q_OVERFLOW)
+            {
+                events.push_back(ZepFileEvent{ ZepPath(), ZepFileChange::Overflow, false });
+                continue;
+            }
+
+            // The watch went with its directory; the delete is reported by the parent
+            if (pEvent->mask & IN_IGNORED)
+            {
+                m_watches.erase(pEvent->wd);
+                continue;
+            }
+
+            auto itr = m_watches.find(pEvent->wd);
+            if (itr == m_watches.end() || pEvent->len == 0)
+            {
+                continue;
+            }
+
+            ZepFileEvent event;
+            event.path = itr->second / pEvent->name;
+            event.isDirectory = (pEvent->mask & IN_ISDIR) != 0;
+            if (pEvent->mask & (IN_CREATE | IN_MOVED_TO))
+            {
+                event.change = ZepFileChange::Created;
+            }
+            else if (pEvent->mask & (IN_DELETE | IN_MOVED_FROM))
+            {
+                event.change = ZepFileChange::Deleted;
+            }
+            else
+            {
+                event.change = ZepFileChange::Modified;
+            }
+            events.push_back(event);
+        }
+    }
+#else
+    ZEP_UNUSED(events);
+#endif
+}
+
 } // namespace Zep
 
 #endif // CPP_FILESYSTEM
@@ -1,4 +1,8 @@
-#include "zep/mcommon/file/fnmatch.h"
+#include <algorithm>
+
+#include "zep/mcommon/animation/profiler.h"
+#include "zep/mcommon/animation/timer.h"
+#include "zep/mcommon/file/glob.h"
 #include "zep/mcommon/logger.h"
 #include "zep/mcommon/string/stringutils.h"
 #include "zep/mcommon/threadutils.h"
@@ -9,44 +13,17 @@
 namespace Zep
 {
 
-enum TypeName
+Indexer::Indexer(ZepEditor& editor)
+    : ZepComponent(editor, ComponentMessages::Subscribed)
+    , m_tasks(editor.GetThreadPool(), TaskPriority::Idle)
 {
-    t_class,
-    t_void,
-    t_byte,
-    t_char,
-    t_int,
-    t_long,
-    t_float,
-    t_double,
-    t_uint32_t,
-    t_uint8_t,
-    t_uint64_t,
-    t_int32_t,
-    t_int64_t,
-    t_int8_t
-};
-
-std::map<std::string, TypeName> MapToType = {
-    { "class", t_class },
-    { "void", t_void },
-    { "byte", t_byte },
-    { "char", t_char },
-    { "int", t_int },
-    { "long", t_long },
-    { "float", t_float },
-    { "double", t_double },
-    { "uint32_t", t_uint32_t },
-    { "uint8_t", t_uint8_t },
-    { "uint64_t", t_uint64_t },
-    { "int32_t", t_int32_t },
-    { "int64_t", t_int64_t },
-    { "int8_t", t_int8_t }
-};
+    GetEditor().Subscribe(this, Msg::FilesChanged);
+}
 
-Indexer::Indexer(ZepEditor& editor)
-    : ZepComponent(editor)
+Indexer::~Indexer()
 {
+    StopIndexing();
+    m_tasks.wait();
 }
 
 void Indexer::GetSearchPaths(ZepEditor& editor, const ZepPath& path, std::vector<std::string>& ignore_patterns, std::vector<std::string>& include_patterns, std::string& errors)
@@ -107,161 +84,762 @@ void Indexer::GetSearchPaths(ZepEditor& editor, const ZepPath& path, std::vector
     }
 } // namespace Zep
 
-std::future<std::shared_ptr<FileIndexResult>> Indexer::IndexPaths(ZepEditor& editor, const ZepPath& startPath)
+namespace
 {
-    std::vector<std::string> ignorePaths;
-    std::vector<std::string> includePaths;
-    std::string errors;
-    GetSearchPaths(editor, startPath, ignorePaths, includePaths, errors);
 
-    auto spResult = std::make_shared<FileIndexResult>();
-    if (!errors.empty())
+enum PatternTag : uint32_t
+{
+    Ignore = (1 << 0),
+    Include = (1 << 1)
+};
+
+std::shared_ptr<GlobMatcher> CompileMatcher(const std::vector<std::string>& ignorePaths, const std::vector<std::string>& includePaths)
+{
+    // Compiled once; every entry is then one pass over its relative path
+    auto spMatcher = std::make_shared<GlobMatcher>();
+    spMatcher->AddPatterns(ignorePaths, PatternTag::Ignore);
+    spMatcher->AddPatterns(includePaths, PatternTag::Include);
+    spMatcher->Compile();
+    return spMatcher;
+}
+
+// Paths found by a walker are handed over in batches of this size
+const size_t WalkBatchSize = 1024;
+
+// A directory walk shared by several workers.
+// Each worker has its own queue of directories; it takes work from the back of its own queue and steals from the
+// front of the others when it runs dry. A worker with nothing to take leaves, giving its thread back to the pool,
+// and workers are started again as directories turn up, one per thread at most. There is no coordinator to wait
+// on; the last worker out builds the result.
+// The workers run at Idle priority, so the walk gives way to anything the user is waiting on.
+struct DirectoryWalk : public std::enable_shared_from_this<DirectoryWalk>
+{
+    struct WorkQueue
     {
-        spResult->errors = errors;
-        return make_ready_future(spResult);
+        std::mutex mutex;
+        std::deque<std::string> directories;
+    };
+
+    IZepFileSystem* pFileSystem = nullptr;
+    std::shared_ptr<GlobMatcher> spMatcher;
+    std::shared_ptr<FileIndexProgress> spProgress;
+    CancelToken token;
+    ZepPath root;
+    bool watch = false;
+
+    // Workers go to the group if there is one, so they can be cancelled
+    ThreadPool* pPool = nullptr;
+    TaskGroup* pTasks = nullptr;
+
+    std::vector<std::unique_ptr<WorkQueue>> queues;
+
+    // Workers started and not yet gone; counted before they are queued, so it can't hit 0 early
+    std::atomic<uint32_t> workers{ 0 };
+    std::atomic<uint32_t> nextQueue{ 0 };
+
+    std::mutex foundMutex;
+    std::vector<std::string> found;
+
+    std::function<void(std::shared_ptr<FileIndexResult>)> fnDone;
+    std::promise<std::shared_ptr<FileIndexResult>> result;
+
+    bool Pop(uint32_t worker, std::string& directory)
+    {
+        {
+            auto& queue = *queues[worker];
+            std::lock_guard<std::mutex> lock(queue.mutex);
+            if (!queue.directories.empty())
+            {
+                directory = std::move(queue.directories.back());
+                queue.directories.pop_back();
+                return true;
+            }
+        }
+
+        for (uint32_t offset = 1; offset < queues.size(); offset++)
+        {
+            auto& victim = *queues[(worker + offset) % queues.size()];
+            std::lock_guard<std::mutex> lock(victim.mutex);
+            if (!victim.directories.empty())
+            {
+                directory = std::move(victim.directories.front());
+                victim.directories.pop_front();
+                return true;
+            }
+        }
+        return false;
     }
 
-    auto pFileSystem = &editor.GetFileSystem();
-    return editor.GetThreadPool().enqueue([=](ZepPath root) {
-        spResult->root = root;
+    void Flush(std::vector<std::string>& batch)
+    {
+        if (batch.empty())
+        {
+            return;
+        }
 
-        try
+        if (spProgress)
         {
-            // Index the whole subtree, ignoring any patterns supplied to us
-            pFileSystem->ScanDirectory(root, [&](const ZepPath& p, bool& recurse) -> bool {
-                recurse = true;
+            auto spBatch = std::make_shared<FileIndexResult>();
+            spBatch->root = root;
+            for (auto& path : batch)
+            {
+                spBatch->paths.push_back(ZepPath(path));
+                spBatch->pathArena.Add(path);
+            }
+            bool first = false;
+            {
+                std::lock_guard<std::mutex> lock(spProgress->mutex);
+                first = spProgress->batches.empty();
+                spProgress->batches.push_back(spBatch);
+            }
 
-                auto bDir = pFileSystem->IsDirectory(p);
+            // The watcher takes everything there is when it looks, so it only needs telling once
+            if (first && spProgress->fnBatch)
+            {
+                spProgress->fnBatch();
+            }
+        }
 
-                // Add this one to our list
-                auto targetZep = pFileSystem->Canonical(p);
-                auto rel = path_get_relative(root, targetZep);
+        std::lock_guard<std::mutex> lock(foundMutex);
+        found.insert(found.end(), std::make_move_iterator(batch.begin()), std::make_move_iterator(batch.end()));
+        batch.clear();
+    }
 
-                bool matched = true;
-                for (auto& proj : ignorePaths)
+    // The caller has counted the worker in
+    void Start()
+    {
+        auto spWalk = shared_from_this();
+        auto run = [spWalk, worker = nextQueue++ % uint32_t(queues.size())]() {
+            spWalk->Run(worker);
+        };
+        if (pTasks)
+        {
+            pTasks->run(run);
+        }
+        else
+        {
+            pPool->enqueue(TaskPriority::Idle, run);
+        }
+    }
+
+    void Run(uint32_t worker)
+    {
+        TIME_SCOPE(IndexWalk);
+        std::vector<std::string> batch;
+        std::string directory;
+        while (!token.is_cancelled() && Pop(worker, directory))
+        {
+            // Watched before it is read, so nothing created in between is missed
+            auto path = directory.empty() ? root : root / directory;
+            size_t directories = 0;
+            try
+            {
+                if (watch)
                 {
-                    auto res = fnmatch(proj.c_str(), rel.string().c_str(), 0);
-                    if (res == 0)
+                    pFileSystem->WatchDirectory(path);
+                }
+
+                pFileSystem->ListDirectory(path, [&](const std::string& name, bool isDirectory) {
+                    auto rel = directory.empty() ? name : directory + "/" + name;
+                    auto tags = spMatcher->Match(rel);
+
+                    // Pruned on the name alone
+                    if (tags & PatternTag::Ignore)
                     {
-                        matched = false;
-                        break;
+                        return;
                     }
-                }
 
-                if (!matched)
-                {
-                    if (bDir)
+                    if (isDirectory)
                     {
-                        recurse = false;
+                        directories++;
+                        auto& queue = *queues[worker];
+                        std::lock_guard<std::mutex> lock(queue.mutex);
+                        queue.directories.push_back(std::move(rel));
+                        return;
                     }
-                    return true;
-                }
 
-                matched = false;
-                for (auto& proj : includePaths)
-                {
-                    auto res = fnmatch(proj.c_str(), rel.string().c_str(), 0);
-                    if (res == 0)
+                    if (tags & PatternTag::Include)
                     {
-                        matched = true;
-                        break;
+                        batch.push_back(std::move(rel));
                     }
-                }
+                });
+            }
+            catch (std::exception& ex)
+            {
+                ZLOG(ERROR, "Can't list " << path.string() << ": " << ex.what());
+            }
 
-                if (!matched)
+            // More hands for what was just found
+            while (directories > 0)
+            {
+                auto active = workers.load();
+                if (active >= queues.size())
                 {
-                    return true;
+                    break;
                 }
-
-                // Not adding directories to the search list
-                if (bDir)
+                if (workers.compare_exchange_weak(active, active + 1))
                 {
-                    return true;
+                    Start();
+                    directories--;
                 }
+            }
 
-                spResult->paths.push_back(rel);
-                spResult->lowerPaths.push_back(string_tolower(rel.string()));
+            if (batch.size() >= WalkBatchSize)
+            {
+                Flush(batch);
+            }
+        }
+        Flush(batch);
 
-                return true;
-            });
+        // Only the workers add directories, and each looks for more before it goes, so the last one out has seen
+        // the lot; a cancelled walk has no result
+        if (--workers == 0 && !token.is_cancelled())
+        {
+            Finish();
+        }
+    }
+
+    void Finish()
+    {
+        // The walk order depends on the threads; sort so results are stable
+        std::sort(found.begin(), found.end());
+
+        auto spResult = std::make_shared<FileIndexResult>();
+        spResult->root = root;
+        spResult->paths.reserve(found.size());
+        for (auto& path : found)
+        {
+            spResult->paths.push_back(ZepPath(path));
+            spResult->pathArena.Add(path);
         }
-        catch (std::exception&)
+        found.clear();
+
+        if (fnDone)
         {
+            fnDone(spResult);
+        }
+        result.set_value(spResult);
+    }
+};
+
+// Updates made from file events are saved at most this often; a walk saves every time. What isn't saved is only
+// re-read next session, as the walk finds it changed
+const double TrigramSaveSeconds = 60.0;
+
+// Files bigger than this are likely generated, and not worth parsing for symbols
+const uint64_t MaxParsedFileSize = 4 * 1024 * 1024;
+
+// A symbol table update shared by the pool.
+// Each file is checked, and parsed if it changed, into its own slot; whoever parses the last one builds the new
+// table from the old one and the parse results.
+struct SymbolUpdate
+{
+    IZepFileSystem* pFileSystem = nullptr;
+    ZepPath root;
+    std::shared_ptr<FileIndexResult> spFiles;
+
+    // The files that may have changed; all of them after a walk
+    std::vector<ZepPath> candidates;
+
+    // Only read while the update runs
+    std::shared_ptr<SymbolIndex> spIndex;
+
+    // One per candidate; left empty if the file hasn't changed
+    std::vector<ParsedSymbolFile> parsed;
+    timer updateTimer;
+
+    std::function<void(std::shared_ptr<SymbolIndex>)> fnDone;
+
+    void Parse(size_t index)
+    {
+        TIME_SCOPE(SymbolParse);
+        auto& path = candidates[index];
+        auto language = SymbolIndex::GetLanguage(path);
+
+        ParsedSymbolFile file;
+        file.path = path;
+        auto fullPath = root / path;
+
+        // Without the file's details there is no telling it hasn't changed, so it always has
+        auto known = pFileSystem->GetFileInfo(fullPath, file.modifiedTime, file.size);
+        if (known ? !spIndex->IsStale(path, file.modifiedTime, file.size) : !pFileSystem->Exists(fullPath))
+        {
+            return;
+        }
+
+        // Files we can't parse are still recorded, so they aren't read again
+        if (language != SymbolLanguage::None && file.size <= MaxParsedFileSize)
+        {
+            auto text = pFileSystem->Read(fullPath);
+            if (!known)
+            {
+                file.size = text.size();
+            }
+            if (file.size <= MaxParsedFileSize)
+            {
+                SymbolIndex::Parse(text, language, file.symbols);
+            }
         }
-        return spResult;
-    },
-        startPath);
+        parsed[index] = std::move(file);
+    }
+
+    void Finish()
+    {
+        std::vector<ParsedSymbolFile> changed;
+        for (auto& file : parsed)
+        {
+            if (!file.path.empty())
+            {
+                changed.push_back(std::move(file));
+            }
+        }
+
+        auto spNewIndex = std::make_shared<SymbolIndex>(*spIndex);
+        spNewIndex->Update(spFiles->paths, changed);
+        if (!changed.empty() || spNewIndex->GetFileCount() != spIndex->GetFileCount())
+        {
+            spNewIndex->Save(*pFileSystem, root / ".zep" / "symboldb");
+        }
+
+        ZLOG(INFO, "Symbol table: " << spNewIndex->GetFileCount() << " files, " << changed.size() << " parsed, " << spNewIndex->GetSymbolCount() << " symbols, " << timer_get_elapsed_seconds(updateTimer) << "s");
+        fnDone(spNewIndex);
+    }
+};
+
+} // namespace
+
+std::future<std::shared_ptr<FileIndexResult>> Indexer::IndexPaths(ZepEditor& editor, const ZepPath& startPath, std::shared_ptr<FileIndexProgress> spProgress, bool watch, std::function<void(std::shared_ptr<FileIndexResult>)> fnDone, TaskGroup* pTasks)
+{
+    std::vector<std::string> ignorePaths;
+    std::vector<std::string> includePaths;
+    std::string errors;
+    GetSearchPaths(editor, startPath, ignorePaths, includePaths, errors);
+
+    if (!errors.empty())
+    {
+        auto spResult = std::make_shared<FileIndexResult>();
+        spResult->errors = errors;
+        if (fnDone)
+        {
+            fnDone(spResult);
+        }
+        return make_ready_future(spResult);
+    }
+
+    auto spWalk = std::make_shared<DirectoryWalk>();
+    spWalk->pPool = &editor.GetThreadPool();
+    spWalk->pTasks = pTasks;
+    spWalk->spMatcher = CompileMatcher(ignorePaths, includePaths);
+    spWalk->pFileSystem = &editor.GetFileSystem();
+    spWalk->spProgress = spProgress;
+    spWalk->root = startPath;
+    spWalk->watch = watch;
+    spWalk->fnDone = fnDone;
+    if (pTasks)
+    {
+        spWalk->token = pTasks->token();
+    }
+
+    auto& pool = editor.GetThreadPool();
+    auto workers = std::max(size_t(1), pool.thread_count());
+    for (size_t i = 0; i < workers; i++)
+    {
+        spWalk->queues.push_back(std::make_unique<DirectoryWalk::WorkQueue>());
+    }
+
+    auto future = spWalk->result.get_future();
+
+    // The root is the first directory, and its worker the first
+    spWalk->queues[0]->directories.push_back(std::string());
+    spWalk->workers = 1;
+    spWalk->Start();
+
+    return future;
 }
 
 void Indexer::Notify(std::shared_ptr<ZepMessage> message)
 {
-    if (message->messageId == Msg::Tick)
+    if (message->messageId == Msg::FilesChanged)
     {
+        auto& events = GetEditor().GetFileEvents();
         if (m_fileSearchActive)
         {
-            if (!is_future_ready(m_indexResult))
-            {
-                return;
-            }
+            m_walkEvents.insert(m_walkEvents.end(), events.begin(), events.end());
+        }
+        else if (m_spFilePaths)
+        {
+            ApplyFileEvents(events);
+            StartPendingUpdates();
+        }
+    }
+}
+
+void Indexer::OnWalkDone(std::shared_ptr<FileIndexResult> spResult)
+{
+    m_fileSearchActive = false;
+
+    m_spFilePaths = spResult;
+    if (!m_spFilePaths->errors.empty())
+    {
+        GetEditor().SetCommandText(m_spFilePaths->errors);
+        return;
+    }
+
+    m_trigramUpdatePending = m_trigramFullUpdate = true;
+    m_symbolUpdatePending = m_symbolFullUpdate = true;
+
+    // The walk may or may not have seen these
+    auto events = std::move(m_walkEvents);
+    m_walkEvents.clear();
+    ApplyFileEvents(events);
+    StartPendingUpdates();
+}
+
+void Indexer::OnSymbolUpdateDone(std::shared_ptr<SymbolIndex> spIndex)
+{
+    m_symbolUpdateActive = false;
+    m_spSymbolIndex = spIndex;
+    StartPendingUpdates();
+}
 
-            m_fileSearchActive = false;
+void Indexer::OnTrigramUpdateDone(std::shared_ptr<TrigramIndex> spIndex, bool fullUpdate, std::vector<ZepPath> changed, std::vector<ZepPath> removed, bool unsaved)
+{
+    m_trigramUpdateActive = false;
+
+    // The old one is behind by just these files; after a walk it could be behind on anything
+    m_spTrigramSpare.reset();
+    if (!fullUpdate)
+    {
+        m_spTrigramSpare = m_spTrigramIndex;
+        m_trigramSpareChanged = std::move(changed);
+        m_trigramSpareRemoved = std::move(removed);
+    }
+    m_spTrigramIndex = spIndex;
+    m_trigramUnsaved = unsaved;
+    StartPendingUpdates();
+}
+
+void Indexer::StartPendingUpdates()
+{
+    // Nothing is updated until the walk has given us the files
+    if (m_fileSearchActive || !m_spFilePaths)
+    {
+        return;
+    }
+
+    // Wait for the saved table before updating it; it tells us what we can skip
+    if (m_symbolUpdatePending && !m_symbolUpdateActive)
+    {
+        m_symbolUpdatePending = false;
+        StartSymbolUpdate();
+    }
+
+    if (m_trigramUpdatePending && !m_trigramUpdateActive)
+    {
+        m_trigramUpdatePending = false;
+        StartTrigramUpdate();
+    }
+}
+
+void Indexer::ApplyFileEvents(const std::vector<ZepFileEvent>& events)
+{
+    auto rootPrefix = m_searchRoot.string() + "/";
+
+    std::set<std::string> added;
+    std::set<std::string> removed;
+    std::vector<std::string> removedDirectories;
+    for (auto& event : events)
+    {
+        if (event.change == ZepFileChange::Overflow)
+        {
+            // We don't know what we missed; walk it all again
+            ZLOG(INFO, "File events lost, re-indexing");
+            StartWalk();
+            return;
+        }
 
-            m_spFilePaths = m_indexResult.get();
-            if (!m_spFilePaths->errors.empty())
+        auto fullPath = event.path.string();
+        if (fullPath.compare(0, rootPrefix.size(), rootPrefix) != 0)
+        {
+            continue;
+        }
+
+        // Filtered just like the walk
+        auto path = fullPath.substr(rootPrefix.size());
+        auto tags = m_spMatcher->Match(path);
+        if (tags & PatternTag::Ignore)
+        {
+            continue;
+        }
+
+        if (event.isDirectory)
+        {
+            if (event.change == ZepFileChange::Created)
             {
-                GetEditor().SetCommandText(m_spFilePaths->errors);
-                return;
+                WatchNewDirectory(path, added);
             }
-
-            // Queue the files to be searched
+            else if (event.change == ZepFileChange::Deleted)
             {
-                std::lock_guard<std::mutex> guard(m_queueMutex);
-                for (auto& p : m_spFilePaths->paths)
-                {
-                    m_searchQueue.push_back(p);
-                }
+                removedDirectories.push_back(path + "/");
             }
+            continue;
+        }
+
+        if (!(tags & PatternTag::Include))
+        {
+            continue;
+        }
+
+        // In order; a file can be written, deleted and written again between ticks
+        if (event.change == ZepFileChange::Deleted)
+        {
+            added.erase(path);
+            removed.insert(path);
+        }
+        else
+        {
+            removed.erase(path);
+            added.insert(path);
+        }
+    }
+
+    // The file list only changes when files come or go
+    std::vector<std::string> paths;
+    paths.reserve(m_spFilePaths->paths.size() + added.size());
+    bool listChanged = false;
+    for (auto& filePath : m_spFilePaths->paths)
+    {
+        auto path = filePath.string();
+        auto inRemovedDirectory = std::any_of(removedDirectories.begin(), removedDirectories.end(), [&](const std::string& directory) {
+            return path.compare(0, directory.size(), directory) == 0;
+        });
+
+        if (inRemovedDirectory)
+        {
+            removed.insert(path);
+        }
 
-            // Kick off the thread
-            StartSymbolSearch();
+        if (removed.find(path) != removed.end() && added.find(path) == added.end())
+        {
+            listChanged = true;
+            continue;
         }
+        paths.push_back(path);
+    }
+
+    auto existing = paths.size();
+    for (auto& path : added)
+    {
+        if (!std::binary_search(paths.begin(), paths.begin() + existing, path))
+        {
+            paths.push_back(path);
+            listChanged = true;
+        }
+    }
+
+    if (listChanged)
+    {
+        std::sort(paths.begin(), paths.end());
+
+        auto spResult = std::make_shared<FileIndexResult>();
+        spResult->root = m_searchRoot;
+        spResult->paths.reserve(paths.size());
+        for (auto& path : paths)
+        {
+            spResult->paths.push_back(ZepPath(path));
+            spResult->pathArena.Add(path);
+        }
+        m_spFilePaths = spResult;
+    }
+
+    for (auto& path : added)
+    {
+        m_trigramRemoved.erase(path);
+        m_trigramChanged.insert(path);
+        m_symbolChanged.insert(path);
+    }
+
+    for (auto& path : removed)
+    {
+        m_trigramChanged.erase(path);
+        m_trigramRemoved.insert(path);
+    }
+
+    if (!added.empty() || !removed.empty())
+    {
+        m_trigramUpdatePending = true;
+        m_symbolUpdatePending = true;
     }
 }
 
-void Indexer::StartSymbolSearch()
+void Indexer::WatchNewDirectory(const std::string& directory, std::set<std::string>& added)
 {
-    GetEditor().GetThreadPool().enqueue([=]() {
-        for (;;)
+    // Anything already in it was created before we could watch it
+    auto& fs = GetEditor().GetFileSystem();
+    fs.WatchDirectory(m_searchRoot / directory);
+    fs.ListDirectory(m_searchRoot / directory, [&](const std::string& name, bool isDirectory) {
+        auto path = directory + "/" + name;
+        auto tags = m_spMatcher->Match(path);
+        if (tags & PatternTag::Ignore)
         {
-            ZepPath path;
-            {
-                std::lock_guard<std::mutex> lock(m_queueMutex);
-                if (m_searchQueue.empty())
-                {
-                    return true;
-                }
+            return;
+        }
 
-                path = m_searchQueue.front();
-                m_searchQueue.pop_front();
-            }
+        if (isDirectory)
+        {
+            WatchNewDirectory(path, added);
+        }
+        else if (tags & PatternTag::Include)
+        {
+            added.insert(path);
+        }
+    });
+}
 
-            auto& fs = GetEditor().GetFileSystem();
+void Indexer::StartTrigramUpdate()
+{
+    if (m_trigramUpdateActive)
+    {
+        return;
+    }
 
-            std::string strLast;
+    auto fullUpdate = m_trigramFullUpdate;
+    std::vector<ZepPath> changed(m_trigramChanged.begin(), m_trigramChanged.end());
+    std::vector<ZepPath> removed(m_trigramRemoved.begin(), m_trigramRemoved.end());
 
-            auto fullPath = m_searchRoot / path;
-            if (fs.Exists(fullPath))
-            {
-                ZLOG(DBG, "Parsing: " << fullPath.c_str());
-                auto strFile = GetEditor().GetFileSystem().Read(fullPath);
+    m_trigramFullUpdate = false;
+    m_trigramChanged.clear();
+    m_trigramRemoved.clear();
+
+    // The worker owns its index until it is handed back on the main thread: the spare if no search still has it,
+    // caught up with what it missed, or else a copy of the live one
+    std::shared_ptr<TrigramIndex> spIndex;
+    std::vector<ZepPath> catchUpChanged;
+    std::vector<ZepPath> catchUpRemoved;
+    if (!fullUpdate && m_spTrigramSpare && m_spTrigramSpare.use_count() == 1)
+    {
+        spIndex = std::move(m_spTrigramSpare);
+        catchUpChanged = std::move(m_trigramSpareChanged);
+        catchUpRemoved = std::move(m_trigramSpareRemoved);
+    }
+    else
+    {
+        spIndex = m_spTrigramIndex ? std::make_shared<TrigramIndex>(*m_spTrigramIndex) : std::make_shared<TrigramIndex>();
+    }
+    m_spTrigramSpare.reset();
+    m_trigramSpareChanged.clear();
+    m_trigramSpareRemoved.clear();
 
-                std::vector<std::string> tokens;
-                string_split(strFile, ";()[] \t\n\r&!\"\'*:,<>", tokens);
+    auto save = fullUpdate || timer_get_elapsed_seconds(m_trigramSaveTimer) >= TrigramSaveSeconds;
+    if (save)
+    {
+        timer_restart(m_trigramSaveTimer);
+    }
+    auto unsaved = m_trigramUnsaved;
+
+    auto spFiles = m_spFilePaths;
+    auto root = m_searchRoot;
+    auto pFileSystem = &GetEditor().GetFileSystem();
+
+    auto pEditor = &GetEditor();
+    m_trigramUpdateActive = true;
+    m_tasks.run([=]() {
+        TIME_SCOPE(TrigramUpdate);
+        timer t;
+        timer_start(t);
+
+        auto dbPath = root / ".zep" / "indexdb";
+
+        uint32_t updated = 0;
+        if (fullUpdate)
+        {
+            // Pick up where the last session left off; only changed files are read
+            if (spIndex->GetLiveFileCount() == 0)
+            {
+                spIndex->Load(*pFileSystem, dbPath);
             }
+            updated = spIndex->Update(*pFileSystem, root, spFiles->paths);
+        }
+        else
+        {
+            spIndex->UpdateFiles(*pFileSystem, root, catchUpChanged, catchUpRemoved);
+            updated = spIndex->UpdateFiles(*pFileSystem, root, changed, removed);
         }
+
+        auto modified = unsaved || updated != 0 || !removed.empty();
+        if (modified && save)
+        {
+            spIndex->Save(*pFileSystem, dbPath);
+        }
+
+        ZLOG(INFO, "Trigram index: " << spIndex->GetLiveFileCount() << " files, " << updated << " updated, " << spIndex->GetTrigramCount() << " trigrams, " << timer_get_elapsed_seconds(t) << "s");
+        pEditor->PostToMainThread(this, [this, spIndex, fullUpdate, changed, removed, modified, save]() {
+            OnTrigramUpdateDone(spIndex, fullUpdate, changed, removed, modified && !save);
+        });
     });
 }
 
+std::vector<TrigramSearchResult> Indexer::Search(const std::string& query, bool regex, size_t maxResults) const
+{
+    if (!m_spTrigramIndex)
+    {
+        return std::vector<TrigramSearchResult>();
+    }
+
+    auto& fs = GetEditor().GetFileSystem();
+    if (regex)
+    {
+        return m_spTrigramIndex->SearchRegex(fs, m_searchRoot, query, maxResults);
+    }
+    return m_spTrigramIndex->SearchLiteral(fs, m_searchRoot, query, maxResults);
+}
+
+void Indexer::StartSymbolUpdate()
+{
+    auto spUpdate = std::make_shared<SymbolUpdate>();
+    spUpdate->pFileSystem = &GetEditor().GetFileSystem();
+    spUpdate->root = m_searchRoot;
+    spUpdate->spFiles = m_spFilePaths;
+    if (m_symbolFullUpdate)
+    {
+        spUpdate->candidates = m_spFilePaths->paths;
+    }
+    else
+    {
+        spUpdate->candidates.assign(m_symbolChanged.begin(), m_symbolChanged.end());
+    }
+    m_symbolFullUpdate = false;
+    m_symbolChanged.clear();
+    spUpdate->spIndex = m_spSymbolIndex ? m_spSymbolIndex : std::make_shared<SymbolIndex>();
+    spUpdate->parsed.resize(spUpdate->candidates.size());
+    timer_start(spUpdate->updateTimer);
+
+    auto pEditor = &GetEditor();
+    spUpdate->fnDone = [this, pEditor](std::shared_ptr<SymbolIndex> spIndex) {
+        pEditor->PostToMainThread(this, [this, spIndex]() {
+            OnSymbolUpdateDone(spIndex);
+        });
+    };
+
+    m_symbolUpdateActive = true;
+    m_tasks.parallel_for(
+        spUpdate->candidates.size(), [spUpdate](size_t index) {
+            spUpdate->Parse(index);
+        },
+        [spUpdate]() {
+            spUpdate->Finish();
+        });
+}
+
+std::vector<SymbolDefinition> Indexer::FindDefinitions(const std::string& name) const
+{
+    if (!m_spSymbolIndex)
+    {
+        return std::vector<SymbolDefinition>();
+    }
+    return m_spSymbolIndex->Find(name);
+}
+
 bool Indexer::StartIndexing()
 {
     bool foundGit = false;
@@ -284,13 +862,53 @@ bool Indexer::StartIndexing()
         }
     }
 
-    int v = 0;
-    fs.Write(indexDBRoot / "indexdb", &v, 1);
+    // Definitions from the last session are available while the project is walked and parsed again
+    auto pFileSystem = &fs;
+    auto dbPath = indexDBRoot / "symboldb";
+    auto pEditor = &GetEditor();
+    m_symbolUpdateActive = true;
+    m_tasks.run([this, pEditor, pFileSystem, dbPath]() {
+        auto spIndex = std::make_shared<SymbolIndex>();
+        spIndex->Load(*pFileSystem, dbPath);
+        pEditor->PostToMainThread(this, [this, spIndex]() {
+            OnSymbolUpdateDone(spIndex);
+        });
+    });
 
-    m_fileSearchActive = true;
-    m_indexResult = Indexer::IndexPaths(GetEditor(), m_searchRoot);
+    std::vector<std::string> ignorePaths;
+    std::vector<std::string> includePaths;
+    std::string errors;
+    GetSearchPaths(GetEditor(), m_searchRoot, ignorePaths, includePaths, errors);
+    m_spMatcher = CompileMatcher(ignorePaths, includePaths);
 
+    StartWalk();
     return true;
 }
 
+void Indexer::StopIndexing()
+{
+    m_tasks.cancel();
+    GetEditor().CancelPosts(this);
+
+    m_fileSearchActive = false;
+    m_walkEvents.clear();
+    m_symbolUpdateActive = m_symbolUpdatePending = false;
+    m_trigramUpdateActive = m_trigramUpdatePending = false;
+    m_spTrigramSpare.reset();
+}
+
+void Indexer::StartWalk()
+{
+    // The walk watches each directory it visits; after that, events keep us current
+    auto pEditor = &GetEditor();
+    m_fileSearchActive = true;
+    Indexer::IndexPaths(
+        GetEditor(), m_searchRoot, nullptr, true, [this, pEditor](std::shared_ptr<FileIndexResult> spResult) {
+            pEditor->PostToMainThread(this, [this, spResult]() {
+                OnWalkDone(spResult);
+            });
+        },
+        &m_tasks);
+}
+
 } // namespace Zep
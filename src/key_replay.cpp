@@ -0,0 +1,163 @@
+#include <algorithm>
+#include <sstream>
+
+#include "zep/buffer.h"
+#include "zep/editor.h"
+#include "zep/filesystem.h"
+#include "zep/key_replay.h"
+#include "zep/mode.h"
+
+#include "zep/mcommon/animation/timer.h"
+#include "zep/mcommon/logger.h"
+#include "zep/mcommon/string/stringutils.h"
+
+namespace Zep
+{
+
+namespace
+{
+const char* RecordingHeader = "# zep keys: time_us key modifiers";
+
+void SortByTime(std::vector<ProfileTotal>& totals)
+{
+    std::stable_sort(totals.begin(), totals.end(), [](const ProfileTotal& lhs, const ProfileTotal& rhs) {
+        return lhs.time > rhs.time;
+    });
+}
+
+void WriteTotals(std::ostream& str, const char* name, const std::vector<ProfileTotal>& totals)
+{
+    str << "  \"" << name << "\": [";
+    for (size_t index = 0; index < totals.size(); index++)
+    {
+        auto& total = totals[index];
+        str << (index == 0 ? "\n" : ",\n");
+        str << "    { \"name\": ";
+        string_write_json(str, total.name);
+        str << ", \"count\": " << total.count << ", \"total_us\": " << total.time << ", \"max_us\": " << total.max << " }";
+    }
+    str << "\n  ]";
+}
+} // namespace
+
+bool KeyRecording::Load(IZepFileSystem& fs, const ZepPath& path)
+{
+    keys.clear();
+    if (!fs.Exists(path))
+    {
+        return false;
+    }
+
+    std::istringstream str(fs.Read(path));
+    std::string line;
+    while (std::getline(str, line))
+    {
+        if (line.empty() || line[0] == '#')
+        {
+            continue;
+        }
+
+        std::istringstream fields(line);
+        RecordedKey key;
+        if (!(fields >> key.time >> key.key >> key.modifiers))
+        {
+            ZLOG(ERROR, "Bad key recording line: " << line);
+            keys.clear();
+            return false;
+        }
+        keys.push_back(key);
+    }
+    return true;
+}
+
+bool KeyRecording::Save(IZepFileSystem& fs, const ZepPath& path) const
+{
+    std::ostringstream str;
+    str << RecordingHeader << "\n";
+    for (auto& key : keys)
+    {
+        str << key.time << " " << key.key << " " << key.modifiers << "\n";
+    }
+
+    auto text = str.str();
+    return fs.Write(path, text.c_str(), text.size());
+}
+
+void ReplayReport::WriteJson(std::ostream& str) const
+{
+    str << "{\n";
+    str << "  \"keys\": " << keys << ",\n";
+    str << "  \"frames\": " << frames << ",\n";
+    str << "  \"elapsed_us\": " << elapsed << ",\n";
+    str << "  \"recorded_us\": " << recorded << ",\n";
+    WriteTotals(str, "commands", commands);
+    str << ",\n";
+    WriteTotals(str, "subsystems", subsystems);
+    str << ",\n  \"allocations\": [";
+    bool first = true;
+    for (auto& [scope, total] : allocations)
+    {
+        str << (first ? "\n" : ",\n");
+        first = false;
+        str << "    { \"scope\": ";
+        string_write_json(str, scope);
+        str << ", \"count\": " << total.scopes << ", \"allocs\": " << total.allocs << ", \"bytes\": " << total.bytes << ", \"max_allocs\": " << total.maxAllocs << " }";
+    }
+    str << "\n  ]\n}\n";
+}
+
+ReplayReport ReplayKeys(ZepEditor& editor, const KeyRecording& recording, const ReplayOptions& options)
+{
+    ReplayReport report;
+    report.recorded = recording.keys.empty() ? 0 : recording.keys.back().time - recording.keys.front().time;
+
+    editor.EnableCommandTimes(true);
+    editor.ResetAllocations();
+    profile_start(ProfileFlags::Totals);
+
+    auto frame = [&]() {
+        editor.RefreshRequired();
+        editor.Display();
+        report.frames++;
+    };
+
+    auto start = timer_get_time_now();
+    uint32_t keysSinceFrame = 0;
+    for (auto& key : recording.keys)
+    {
+        // The session may have closed everything
+        auto pBuffer = editor.GetActiveBuffer();
+        if (!pBuffer || !pBuffer->GetMode())
+        {
+            break;
+        }
+
+        pBuffer->GetMode()->AddKeyPress(key.key, key.modifiers);
+        report.keys++;
+
+        if (options.displayEvery != 0 && ++keysSinceFrame >= options.displayEvery)
+        {
+            keysSinceFrame = 0;
+            frame();
+        }
+    }
+
+    // Whatever the last keys changed is shown
+    if (keysSinceFrame != 0 || options.displayEvery == 0)
+    {
+        frame();
+    }
+    report.elapsed = timer_get_time_now() - start;
+
+    profile_stop();
+    report.commands = editor.GetCommandTimes();
+    report.subsystems = profile_get_totals();
+    report.allocations = editor.GetAllocations();
+    editor.EnableCommandTimes(false);
+
+    SortByTime(report.commands);
+    SortByTime(report.subsystems);
+    return report;
+}
+
+} // namespace Zep
@@ -0,0 +1,85 @@
+#include <algorithm>
+#include <cmath>
+
+#include "zep/mcommon/animation/histogram.h"
+
+namespace Zep
+{
+
+uint32_t LatencyHistogram::BucketIndex(uint64_t value)
+{
+    if (value < LinearCount)
+    {
+        return uint32_t(value);
+    }
+
+    uint32_t exponent = 0;
+    for (auto v = value; v > 1; v >>= 1)
+    {
+        exponent++;
+    }
+
+    // The bits below the top one pick the sub bucket
+    auto shift = exponent - SubBucketBits;
+    auto subBucket = uint32_t(value >> shift) & ((1 << SubBucketBits) - 1);
+    return LinearCount + (exponent - SubBucketBits - 1) * (1 << SubBucketBits) + subBucket;
+}
+
+uint64_t LatencyHistogram::BucketLimit(uint32_t index)
+{
+    if (index < LinearCount)
+    {
+        return index;
+    }
+
+    index -= LinearCount;
+    auto shift = index / (1 << SubBucketBits) + 1;
+    auto subBucket = index % (1 << SubBucketBits);
+    auto lower = (uint64_t((1 << SubBucketBits) + subBucket)) << shift;
+    return lower + ((uint64_t(1) << shift) - 1);
+}
+
+void LatencyHistogram::Add(uint64_t value)
+{
+    m_buckets[BucketIndex(value)]++;
+    m_count++;
+    m_total += value;
+    m_max = std::max(m_max, value);
+}
+
+void LatencyHistogram::Clear()
+{
+    m_buckets.fill(0);
+    m_count = 0;
+    m_total = 0;
+    m_max = 0;
+}
+
+double LatencyHistogram::GetMean() const
+{
+    return m_count == 0 ? 0.0 : double(m_total) / double(m_count);
+}
+
+uint64_t LatencyHistogram::GetPercentile(double fraction) const
+{
+    if (m_count == 0)
+    {
+        return 0;
+    }
+
+    auto rank = uint64_t(std::ceil(std::min(std::max(fraction, 0.0), 1.0) * double(m_count)));
+    rank = std::max(rank, uint64_t(1));
+
+    uint64_t seen = 0;
+    for (uint32_t index = 0; index < BucketCount; index++)
+    {
+        seen += m_buckets[index];
+        if (seen >= rank)
+        {
+            return std::min(BucketLimit(index), m_max);
+        }
+    }
+    return m_max;
+}
+
+} // namespace Zep
@@ -0,0 +1,328 @@
+#include <algorithm>
+#include <atomic>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+
+#include "zep/mcommon/animation/profiler.h"
+#include "zep/mcommon/animation/timer.h"
+#include "zep/mcommon/string/stringutils.h"
+
+namespace Zep
+{
+
+namespace
+{
+
+// Events kept per thread; a power of 2
+const uint64_t RingSize = 1 << 15;
+const uint64_t SlotWriting = ~uint64_t(0);
+
+// A dump can copy a slot while its thread is writing it, so each slot carries the index of the event in it,
+// and is only used if that is the same before and after the copy
+struct RingSlot
+{
+    std::atomic<uint64_t> sequence{ SlotWriting };
+    std::atomic<const char*> name{ nullptr };
+    std::atomic<uint64_t> time{ 0 };
+    std::atomic<int64_t> value{ 0 };
+    std::atomic<ProfileEventType> type{ ProfileEventType::Begin };
+};
+
+struct ThreadProfile
+{
+    uint32_t id = 0;
+    std::atomic<const char*> threadName{ nullptr };
+    std::atomic<bool> exited{ false };
+
+    // Count of events ever written; only the owning thread writes
+    std::atomic<uint64_t> head{ 0 };
+    std::unique_ptr<RingSlot[]> slots = std::make_unique<RingSlot[]>(RingSize);
+
+    // Only for ProfileFlags::Totals; the owner adds, a reader sums them up
+    std::mutex totalsMutex;
+    std::unordered_map<const char*, ProfileTotal> totals;
+
+    void AddTotal(const char* name, uint64_t time)
+    {
+        std::lock_guard<std::mutex> lock(totalsMutex);
+        auto& total = totals[name];
+        total.count++;
+        total.time += time;
+        total.max = std::max(total.max, time);
+    }
+
+    void Push(ProfileEventType type, const char* name, int64_t value)
+    {
+        auto index = head.load(std::memory_order_relaxed);
+        auto& slot = slots[index & (RingSize - 1)];
+        slot.sequence.store(SlotWriting, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_release);
+
+        slot.name.store(name, std::memory_order_relaxed);
+        slot.time.store(timer_get_time_now(), std::memory_order_relaxed);
+        slot.value.store(value, std::memory_order_relaxed);
+        slot.type.store(type, std::memory_order_relaxed);
+
+        slot.sequence.store(index, std::memory_order_release);
+        head.store(index + 1, std::memory_order_release);
+    }
+
+    // Oldest first; anything overwritten while we read is left out
+    void Read(std::vector<ProfileEvent>& events) const
+    {
+        auto end = head.load(std::memory_order_acquire);
+        auto begin = end > RingSize ? end - RingSize : 0;
+        for (auto index = begin; index < end; index++)
+        {
+            auto& slot = slots[index & (RingSize - 1)];
+            if (slot.sequence.load(std::memory_order_acquire) != index)
+            {
+                continue;
+            }
+
+            ProfileEvent ev;
+            ev.name = slot.name.load(std::memory_order_relaxed);
+            ev.time = slot.time.load(std::memory_order_relaxed);
+            ev.value = slot.value.load(std::memory_order_relaxed);
+            ev.type = slot.type.load(std::memory_order_relaxed);
+
+            std::atomic_thread_fence(std::memory_order_acquire);
+            if (slot.sequence.load(std::memory_order_relaxed) == index)
+            {
+                events.push_back(ev);
+            }
+        }
+    }
+};
+
+struct ProfileState
+{
+    // Guards the list of threads, not the rings
+    std::mutex mutex;
+    std::vector<std::unique_ptr<ThreadProfile>> threads;
+    uint32_t nextId = 1;
+
+    std::atomic<bool> recording{ false };
+    std::atomic<bool> totals{ false };
+    std::atomic<uint64_t> startTime{ 0 };
+};
+
+ProfileState& GetState()
+{
+    static ProfileState state;
+    return state;
+}
+
+// Marks the ring as free to drop when its thread goes away; the events stay until the next start
+struct ThreadHandle
+{
+    ThreadProfile* pProfile = nullptr;
+    ~ThreadHandle()
+    {
+        if (pProfile)
+        {
+            pProfile->exited = true;
+        }
+    }
+};
+thread_local ThreadHandle threadHandle;
+
+ThreadProfile& GetThreadProfile()
+{
+    if (!threadHandle.pProfile)
+    {
+        auto& state = GetState();
+        std::lock_guard<std::mutex> lock(state.mutex);
+        state.threads.push_back(std::make_unique<ThreadProfile>());
+        state.threads.back()->id = state.nextId++;
+        threadHandle.pProfile = state.threads.back().get();
+    }
+    return *threadHandle.pProfile;
+}
+
+} // namespace
+
+void profile_start(uint32_t flags)
+{
+    auto& state = GetState();
+    {
+        std::lock_guard<std::mutex> lock(state.mutex);
+        for (auto itr = state.threads.begin(); itr != state.threads.end();)
+        {
+            if ((*itr)->exited)
+            {
+                itr = state.threads.erase(itr);
+            }
+            else
+            {
+                std::lock_guard<std::mutex> totalsLock((*itr)->totalsMutex);
+                (*itr)->totals.clear();
+                itr++;
+            }
+        }
+    }
+    state.totals = (flags & ProfileFlags::Totals) != 0;
+    state.startTime = timer_get_time_now();
+    state.recording = true;
+}
+
+void profile_stop()
+{
+    GetState().recording = false;
+}
+
+bool profile_is_recording()
+{
+    return GetState().recording.load(std::memory_order_relaxed);
+}
+
+void profile_begin(const char* name)
+{
+    if (profile_is_recording())
+    {
+        GetThreadProfile().Push(ProfileEventType::Begin, name, 0);
+    }
+}
+
+void profile_end(const char* name)
+{
+    // Always closed once begun, even if recording stopped in between; unmatched ends are dropped on output
+    if (threadHandle.pProfile)
+    {
+        threadHandle.pProfile->Push(ProfileEventType::End, name, 0);
+    }
+}
+
+void profile_counter(const char* name, int64_t value)
+{
+    if (profile_is_recording())
+    {
+        GetThreadProfile().Push(ProfileEventType::Counter, name, value);
+    }
+}
+
+void profile_set_thread_name(const char* name)
+{
+    GetThreadProfile().threadName = name;
+}
+
+void profile_write_trace(std::ostream& str)
+{
+    auto& state = GetState();
+    auto startTime = state.startTime.load();
+
+    str << "{\"traceEvents\":[";
+    bool first = true;
+    auto writeHeader = [&](const char* name, const char* phase, uint32_t id) {
+        str << (first ? "\n" : ",\n");
+        first = false;
+        str << "{\"name\":";
+        string_write_json(str, name);
+        str << ",\"ph\":\"" << phase << "\",\"pid\":1,\"tid\":" << id;
+    };
+
+    std::lock_guard<std::mutex> lock(state.mutex);
+    std::vector<ProfileEvent> events;
+    for (auto& spThread : state.threads)
+    {
+        events.clear();
+        spThread->Read(events);
+
+        auto threadName = spThread->threadName.load();
+        if (threadName)
+        {
+            writeHeader("thread_name", "M", spThread->id);
+            str << ",\"args\":{\"name\":";
+            string_write_json(str, threadName);
+            str << "}}";
+        }
+
+        // Scopes that began before the start (or before the ring wrapped) would end without beginning
+        uint32_t depth = 0;
+        for (auto& ev : events)
+        {
+            if (ev.time < startTime)
+            {
+                continue;
+            }
+
+            switch (ev.type)
+            {
+            case ProfileEventType::Begin:
+                depth++;
+                writeHeader(ev.name, "B", spThread->id);
+                break;
+            case ProfileEventType::End:
+                if (depth == 0)
+                {
+                    continue;
+                }
+                depth--;
+                writeHeader(ev.name, "E", spThread->id);
+                break;
+            case ProfileEventType::Counter:
+                writeHeader(ev.name, "C", spThread->id);
+                str << ",\"args\":{\"value\":" << ev.value << "}";
+                break;
+            }
+            str << ",\"ts\":" << (ev.time - startTime) << "}";
+        }
+    }
+    str << "\n],\"displayTimeUnit\":\"ms\"}\n";
+}
+
+std::vector<ProfileTotal> profile_get_totals()
+{
+    // The same name can be at different addresses in different files
+    std::map<std::string, ProfileTotal> merged;
+
+    auto& state = GetState();
+    std::lock_guard<std::mutex> lock(state.mutex);
+    for (auto& spThread : state.threads)
+    {
+        std::lock_guard<std::mutex> totalsLock(spThread->totalsMutex);
+        for (auto& [pName, total] : spThread->totals)
+        {
+            auto& entry = merged[pName];
+            entry.count += total.count;
+            entry.time += total.time;
+            entry.max = std::max(entry.max, total.max);
+        }
+    }
+
+    std::vector<ProfileTotal> totals;
+    for (auto& [name, total] : merged)
+    {
+        totals.push_back(total);
+        totals.back().name = name;
+    }
+    return totals;
+}
+
+ProfileBlock::ProfileBlock(const char* name)
+    : m_name(name)
+    , m_recording(profile_is_recording())
+{
+    if (m_recording)
+    {
+        m_start = timer_get_time_now();
+        profile_begin(name);
+    }
+}
+
+ProfileBlock::~ProfileBlock()
+{
+    if (m_recording)
+    {
+        profile_end(m_name);
+        if (GetState().totals.load(std::memory_order_relaxed))
+        {
+            GetThreadProfile().AddTotal(m_name, timer_get_time_now() - m_start);
+        }
+    }
+}
+
+} // namespace Zep
@@ -14,7 +14,6 @@ struct TimedSection
 };
 
 timer globalTimer;
-profile_data globalProfiler;
 
 uint64_t timer_get_time_now()
 {
@@ -52,28 +51,4 @@ double timer_to_ms(uint64_t value)
     return double(value / 1000.0);
 }
 
-ProfileBlock::ProfileBlock(const char* timer)
-    : strTimer(timer)
-{
-    timer_start(blockTimer);
-    if (globalProfiler.timerData.find(timer) == globalProfiler.timerData.end())
-    {
-        globalProfiler.timerData[timer] = profile_value{};
-    }
-}
-
-ProfileBlock::~ProfileBlock()
-{
-    elapsed = timer_get_elapsed(blockTimer);
-    profile_add_value(globalProfiler.timerData.find(strTimer)->second, double(elapsed));
-}
-
-void profile_add_value(profile_value& val, double av)
-{
-    val.count++;
-    val.average = val.average * (val.count - 1) / val.count + av / val.count;
-    val.current = av;
-}
-
-
 } // namespace Zep
@@ -0,0 +1,337 @@
+#include <algorithm>
+#include <cassert>
+#include <map>
+
+#include "zep/mcommon/file/fnmatch.h"
+#include "zep/mcommon/file/glob.h"
+
+namespace Zep
+{
+
+namespace
+{
+// Beyond this many states we give up on the DFA and just run the patterns one at a time
+const size_t MaxDFAStates = 16384;
+
+// "*.ext" with nothing else special in it
+bool IsExtensionPattern(const std::string& pattern)
+{
+    if (pattern.size() < 3 || pattern[0] != '*' || pattern[1] != '.')
+    {
+        return false;
+    }
+    return pattern.find_first_of("*?[\\/.", 2) == std::string::npos;
+}
+} // namespace
+
+void GlobMatcher::AddPatterns(const std::vector<std::string>& patterns, uint32_t tag)
+{
+    m_compiled = false;
+    for (auto& pattern : patterns)
+    {
+        if (IsExtensionPattern(pattern))
+        {
+            auto itr = m_extensionStore.insert(pattern.substr(2)).first;
+            m_extensions[std::string_view(*itr)] |= tag;
+            continue;
+        }
+
+        AddPattern(pattern, tag);
+        m_fallback.push_back(std::make_pair(pattern, tag));
+    }
+}
+
+void GlobMatcher::AddPattern(const std::string& pattern, uint32_t tag)
+{
+    m_starts.push_back(uint32_t(m_tokens.size()));
+
+    auto size = pattern.size();
+    for (size_t i = 0; i < size; i++)
+    {
+        Token token;
+        auto ch = uint8_t(pattern[i]);
+        switch (ch)
+        {
+        case '?':
+            token.type = TokenType::Any;
+            break;
+        case '*':
+            // Collapse multiple stars
+            if (!m_tokens.empty() && m_tokens.back().type == TokenType::Star && uint32_t(m_tokens.size()) > m_starts.back())
+            {
+                continue;
+            }
+            token.type = TokenType::Star;
+            break;
+        case '[':
+        {
+            // As fnmatch's rangematch; an unterminated class can never match anything
+            std::bitset<256> bits;
+            bool terminated = false;
+            size_t j = i + 1;
+            bool negate = j < size && (pattern[j] == '!' || pattern[j] == '^');
+            if (negate)
+            {
+                j++;
+            }
+
+            while (j < size)
+            {
+                auto c = uint8_t(pattern[j++]);
+                if (c == ']')
+                {
+                    terminated = true;
+                    break;
+                }
+                if (c == '\\')
+                {
+                    if (j >= size)
+                        break;
+                    c = uint8_t(pattern[j++]);
+                }
+
+                if (j + 1 < size && pattern[j] == '-' && pattern[j + 1] != ']')
+                {
+                    auto c2 = uint8_t(pattern[j + 1]);
+                    j += 2;
+                    if (c2 == '\\')
+                    {
+                        if (j >= size)
+                            break;
+                        c2 = uint8_t(pattern[j++]);
+                    }
+                    for (uint32_t r = c; r <= c2; r++)
+                    {
+                        bits.set(r);
+                    }
+                }
+                else
+                {
+                    bits.set(c);
+                }
+            }
+
+            if (!terminated)
+            {
+                bits.reset();
+                i = size;
+            }
+            else
+            {
+                if (negate)
+                {
+                    bits.flip();
+                }
+                i = j - 1;
+            }
+
+            token.type = TokenType::Class;
+            token.classIndex = uint32_t(m_classes.size());
+            m_classes.push_back(bits);
+        }
+        break;
+        case '\\':
+            if (i + 1 < size)
+            {
+                ch = uint8_t(pattern[++i]);
+            }
+            token.ch = ch;
+            break;
+        default:
+            token.ch = ch;
+            break;
+        }
+        m_tokens.push_back(token);
+    }
+
+    Token accept;
+    accept.type = TokenType::Accept;
+    accept.tag = tag;
+    m_tokens.push_back(accept);
+}
+
+bool GlobMatcher::Accepts(const Token& token, uint8_t ch) const
+{
+    switch (token.type)
+    {
+    case TokenType::Literal:
+        return token.ch == ch;
+    case TokenType::Class:
+        return m_classes[token.classIndex][ch];
+    case TokenType::Any:
+    case TokenType::Star:
+        return true;
+    default:
+        return false;
+    }
+}
+
+void GlobMatcher::AddClosure(uint32_t position, std::vector<uint32_t>& states) const
+{
+    if (std::find(states.begin(), states.end(), position) != states.end())
+    {
+        return;
+    }
+    states.push_back(position);
+
+    // A star can match nothing
+    if (m_tokens[position].type == TokenType::Star)
+    {
+        AddClosure(position + 1, states);
+    }
+}
+
+void GlobMatcher::Compile()
+{
+    m_compiled = true;
+    m_useFallback = false;
+    m_transitions.clear();
+    m_acceptTags.clear();
+
+    if (m_tokens.empty())
+    {
+        return;
+    }
+
+    // Bytes that every token treats the same way share a column in the transition table
+    std::map<std::vector<bool>, uint8_t> signatures;
+    for (uint32_t b = 0; b < 256; b++)
+    {
+        std::vector<bool> signature;
+        for (auto& token : m_tokens)
+        {
+            if (token.type == TokenType::Literal || token.type == TokenType::Class)
+            {
+                signature.push_back(Accepts(token, uint8_t(b)));
+            }
+        }
+        auto itr = signatures.find(signature);
+        if (itr == signatures.end())
+        {
+            itr = signatures.insert(std::make_pair(signature, uint8_t(signatures.size()))).first;
+        }
+        m_byteClass[b] = itr->second;
+    }
+    m_byteClassCount = uint32_t(signatures.size());
+
+    std::vector<uint8_t> representative(m_byteClassCount);
+    for (int b = 255; b >= 0; b--)
+    {
+        representative[m_byteClass[b]] = uint8_t(b);
+    }
+
+    // Subset construction; state 0 is the dead state
+    std::map<std::vector<uint32_t>, int32_t> stateLookup;
+    std::vector<std::vector<uint32_t>> states;
+
+    auto addState = [&](std::vector<uint32_t>& set) {
+        std::sort(set.begin(), set.end());
+        auto itr = stateLookup.find(set);
+        if (itr != stateLookup.end())
+        {
+            return itr->second;
+        }
+
+        auto id = int32_t(states.size());
+        uint32_t tags = 0;
+        for (auto& pos : set)
+        {
+            if (m_tokens[pos].type == TokenType::Accept)
+            {
+                tags |= m_tokens[pos].tag;
+            }
+        }
+        stateLookup[set] = id;
+        states.push_back(set);
+        m_acceptTags.push_back(tags);
+        m_transitions.resize(states.size() * m_byteClassCount, -1);
+        return id;
+    };
+
+    std::vector<uint32_t> set;
+    addState(set);
+
+    for (auto& start : m_starts)
+    {
+        AddClosure(start, set);
+    }
+    m_startState = addState(set);
+
+    for (size_t current = 0; current < states.size(); current++)
+    {
+        if (states.size() > MaxDFAStates)
+        {
+            m_useFallback = true;
+            m_transitions.clear();
+            m_acceptTags.clear();
+            return;
+        }
+
+        for (uint32_t byteClass = 0; byteClass < m_byteClassCount; byteClass++)
+        {
+            set.clear();
+            for (auto& pos : states[current])
+            {
+                auto& token = m_tokens[pos];
+                if (!Accepts(token, representative[byteClass]))
+                {
+                    continue;
+                }
+                // A star stays where it is, and can also move on
+                AddClosure(token.type == TokenType::Star ? pos : pos + 1, set);
+            }
+            auto next = addState(set);
+            m_transitions[current * m_byteClassCount + byteClass] = next;
+        }
+    }
+}
+
+uint32_t GlobMatcher::Match(const std::string_view& path) const
+{
+    assert(m_compiled);
+
+    uint32_t tags = 0;
+    if (!m_extensions.empty())
+    {
+        auto dot = path.rfind('.');
+        if (dot != std::string_view::npos)
+        {
+            auto itr = m_extensions.find(path.substr(dot + 1));
+            if (itr != m_extensions.end())
+            {
+                tags |= itr->second;
+            }
+        }
+    }
+
+    if (m_useFallback)
+    {
+        std::string str(path);
+        for (auto& [pattern, tag] : m_fallback)
+        {
+            if (!(tags & tag) && fnmatch(pattern.c_str(), str.c_str(), 0) == 0)
+            {
+                tags |= tag;
+            }
+        }
+        return tags;
+    }
+
+    if (m_acceptTags.empty())
+    {
+        return tags;
+    }
+
+    auto state = m_startState;
+    for (auto ch : path)
+    {
+        state = m_transitions[state * m_byteClassCount + m_byteClass[uint8_t(ch)]];
+        if (state == 0)
+        {
+            return tags;
+        }
+    }
+    return tags | m_acceptTags[state];
+}
+
+} // namespace Zep
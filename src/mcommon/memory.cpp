@@ -0,0 +1,81 @@
+#include <atomic>
+#include <iomanip>
+#include <sstream>
+
+#include "zep/mcommon/memory.h"
+
+namespace Zep
+{
+
+namespace
+{
+// Only constant initialized state here: the hooks run before any constructors do
+std::atomic<bool> hooksInstalled{ false };
+thread_local AllocationCounts threadAllocations;
+} // namespace
+
+std::string memory_to_string(uint64_t bytes)
+{
+    const char* units[] = { "B", "KB", "MB", "GB", "TB" };
+    double size = double(bytes);
+    size_t unit = 0;
+    while (size >= 1024.0 && unit < sizeof(units) / sizeof(units[0]) - 1)
+    {
+        size /= 1024.0;
+        unit++;
+    }
+
+    std::ostringstream str;
+    if (unit == 0)
+    {
+        str << bytes << " B";
+    }
+    else
+    {
+        str << std::fixed << std::setprecision(1) << size << " " << units[unit];
+    }
+    return str.str();
+}
+
+bool memory_hooks_installed()
+{
+    return hooksInstalled.load(std::memory_order_relaxed);
+}
+
+void memory_set_hooks_installed()
+{
+    hooksInstalled = true;
+}
+
+AllocationCounts memory_thread_allocations()
+{
+    return threadAllocations;
+}
+
+void memory_note_alloc(size_t bytes)
+{
+    threadAllocations.allocs++;
+    threadAllocations.bytes += bytes;
+}
+
+void memory_note_free()
+{
+    threadAllocations.frees++;
+}
+
+AllocationScope::AllocationScope()
+    : m_start(memory_thread_allocations())
+{
+}
+
+AllocationCounts AllocationScope::GetCounts() const
+{
+    auto now = memory_thread_allocations();
+    AllocationCounts counts;
+    counts.allocs = now.allocs - m_start.allocs;
+    counts.bytes = now.bytes - m_start.bytes;
+    counts.frees = now.frees - m_start.frees;
+    return counts;
+}
+
+} // namespace Zep
@@ -0,0 +1,295 @@
+#include <algorithm>
+
+#include "zep/mcommon/string/fuzzy_match.h"
+
+namespace Zep
+{
+
+namespace
+{
+
+// Scoring constants, as used by fzf
+const int32_t ScoreMatch = 16;
+const int32_t ScoreGapStart = -3;
+const int32_t ScoreGapExtension = -1;
+const int32_t BonusBoundary = ScoreMatch / 2;
+const int32_t BonusDelimiter = BonusBoundary + 1;
+const int32_t BonusNonWord = ScoreMatch / 2;
+const int32_t BonusCamel = BonusBoundary + ScoreGapExtension;
+const int32_t BonusConsecutive = -(ScoreGapStart + ScoreGapExtension);
+const int32_t BonusFirstCharMultiplier = 2;
+
+enum class CharClass
+{
+    NonWord,
+    Delimiter,
+    Lower,
+    Upper,
+    Number
+};
+
+inline CharClass GetCharClass(char ch)
+{
+    if (ch >= 'a' && ch <= 'z')
+        return CharClass::Lower;
+    if (ch >= 'A' && ch <= 'Z')
+        return CharClass::Upper;
+    if (ch >= '0' && ch <= '9')
+        return CharClass::Number;
+    if (ch == '/' || ch == '\\')
+        return CharClass::Delimiter;
+    if ((unsigned char)ch >= 0x80)
+        return CharClass::Lower;
+    return CharClass::NonWord;
+}
+
+inline int32_t GetBonus(CharClass prev, CharClass cls)
+{
+    bool word = cls == CharClass::Lower || cls == CharClass::Upper || cls == CharClass::Number;
+    if (word)
+    {
+        if (prev == CharClass::Delimiter)
+            return BonusDelimiter;
+        if (prev == CharClass::NonWord)
+            return BonusBoundary;
+    }
+
+    if ((prev == CharClass::Lower && cls == CharClass::Upper) || (prev != CharClass::Number && cls == CharClass::Number))
+    {
+        return BonusCamel;
+    }
+
+    if (!word)
+    {
+        return BonusNonWord;
+    }
+    return 0;
+}
+
+inline char ToLowerASCII(char ch)
+{
+    return (ch >= 'A' && ch <= 'Z') ? char(ch + ('a' - 'A')) : ch;
+}
+
+// Is lhs a better match than rhs?  Ties go to the shorter string, then the earlier one
+inline bool IsBetter(const FuzzyMatch& lhs, const FuzzyMatch& rhs)
+{
+    if (lhs.score != rhs.score)
+        return lhs.score > rhs.score;
+    if (lhs.length != rhs.length)
+        return lhs.length < rhs.length;
+    return lhs.index < rhs.index;
+}
+
+} // namespace
+
+void FuzzyArena::Add(const std::string& str)
+{
+    text.insert(text.end(), str.begin(), str.end());
+    for (auto& ch : str)
+    {
+        lowerText.push_back(ToLowerASCII(ch));
+    }
+    offsets.push_back(uint32_t(text.size()));
+    masks.push_back(fuzzy_char_mask(str.data(), str.data() + str.size()));
+}
+
+void FuzzyArena::Clear()
+{
+    text.clear();
+    lowerText.clear();
+    offsets.assign(1, 0);
+    masks.clear();
+}
+
+uint64_t fuzzy_char_mask(const char* pBegin, const char* pEnd)
+{
+    uint64_t mask = 0;
+    for (auto pCh = pBegin; pCh < pEnd; pCh++)
+    {
+        auto ch = (unsigned char)ToLowerASCII(*pCh);
+        if (ch >= 'a' && ch <= 'z')
+        {
+            mask |= 1ull << (ch - 'a');
+        }
+        else if (ch >= '0' && ch <= '9')
+        {
+            mask |= 1ull << (26 + ch - '0');
+        }
+        else
+        {
+            mask |= 1ull << (36 + (ch % 28));
+        }
+    }
+    return mask;
+}
+
+bool fuzzy_score(const char* pText, const char* pSearch, uint32_t length, const char* pPattern, uint32_t patternLength, int32_t& score)
+{
+    score = 0;
+    if (patternLength == 0)
+    {
+        return true;
+    }
+
+    // Forward: find the first place the whole pattern is complete
+    uint32_t patternIndex = 0;
+    int64_t start = -1;
+    int64_t end = -1;
+    for (uint32_t i = 0; i < length; i++)
+    {
+        if (pSearch[i] == pPattern[patternIndex])
+        {
+            if (start < 0)
+            {
+                start = i;
+            }
+            if (++patternIndex == patternLength)
+            {
+                end = i + 1;
+                break;
+            }
+        }
+    }
+
+    if (end < 0)
+    {
+        return false;
+    }
+
+    // Backward: tighten the start of the match
+    patternIndex = patternLength - 1;
+    for (int64_t i = end - 1; i >= start; i--)
+    {
+        if (pSearch[i] == pPattern[patternIndex])
+        {
+            if (patternIndex == 0)
+            {
+                start = i;
+                break;
+            }
+            patternIndex--;
+        }
+    }
+
+    // Score the window
+    int32_t consecutive = 0;
+    int32_t firstBonus = 0;
+    bool inGap = false;
+    patternIndex = 0;
+    auto prevClass = start > 0 ? GetCharClass(pText[start - 1]) : CharClass::Delimiter;
+    for (int64_t i = start; i < end; i++)
+    {
+        auto cls = GetCharClass(pText[i]);
+        if (patternIndex < patternLength && pSearch[i] == pPattern[patternIndex])
+        {
+            score += ScoreMatch;
+            auto bonus = GetBonus(prevClass, cls);
+            if (consecutive == 0)
+            {
+                firstBonus = bonus;
+            }
+            else
+            {
+                // A run keeps the bonus it started with
+                if (bonus >= BonusBoundary && bonus > firstBonus)
+                {
+                    firstBonus = bonus;
+                }
+                bonus = std::max(std::max(bonus, firstBonus), BonusConsecutive);
+            }
+
+            score += (patternIndex == 0) ? bonus * BonusFirstCharMultiplier : bonus;
+            inGap = false;
+            consecutive++;
+            patternIndex++;
+        }
+        else
+        {
+            score += inGap ? ScoreGapExtension : ScoreGapStart;
+            inGap = true;
+            consecutive = 0;
+            firstBonus = 0;
+        }
+        prevClass = cls;
+    }
+    return true;
+}
+
+FuzzySearchResult fuzzy_search(const FuzzyArena& arena, const std::string& pattern, uint32_t begin, uint32_t end, uint32_t maxResults)
+{
+    FuzzySearchResult result;
+    if (maxResults == 0)
+    {
+        return result;
+    }
+
+    // Smart case; if the user types capitals they care about them
+    bool caseSensitive = std::any_of(pattern.begin(), pattern.end(), [](char ch) { return ch >= 'A' && ch <= 'Z'; });
+    auto patternMask = fuzzy_char_mask(pattern.data(), pattern.data() + pattern.size());
+
+    std::string searchPattern = pattern;
+    if (!caseSensitive)
+    {
+        std::transform(searchPattern.begin(), searchPattern.end(), searchPattern.begin(), ToLowerASCII);
+    }
+
+    auto& heap = result.matches;
+    heap.reserve(maxResults + 1);
+
+    end = std::min(end, arena.Size());
+    for (uint32_t index = begin; index < end; index++)
+    {
+        if ((arena.masks[index] & patternMask) != patternMask)
+        {
+            continue;
+        }
+
+        auto offset = arena.offsets[index];
+        auto length = arena.offsets[index + 1] - offset;
+        auto pText = arena.text.data() + offset;
+        auto pSearch = caseSensitive ? pText : arena.lowerText.data() + offset;
+
+        int32_t score;
+        if (!fuzzy_score(pText, pSearch, length, searchPattern.data(), uint32_t(searchPattern.size()), score))
+        {
+            continue;
+        }
+
+        result.matchCount++;
+
+        // The heap front is the worst match we are keeping
+        FuzzyMatch match{ score, index, length };
+        if (heap.size() < maxResults)
+        {
+            heap.push_back(match);
+            std::push_heap(heap.begin(), heap.end(), IsBetter);
+        }
+        else if (IsBetter(match, heap.front()))
+        {
+            std::pop_heap(heap.begin(), heap.end(), IsBetter);
+            heap.back() = match;
+            std::push_heap(heap.begin(), heap.end(), IsBetter);
+        }
+    }
+
+    std::sort_heap(heap.begin(), heap.end(), IsBetter);
+    return result;
+}
+
+FuzzySearchResult fuzzy_merge(std::vector<FuzzySearchResult>& parts, uint32_t maxResults)
+{
+    FuzzySearchResult result;
+    for (auto& part : parts)
+    {
+        result.matchCount += part.matchCount;
+        result.matches.insert(result.matches.end(), part.matches.begin(), part.matches.end());
+    }
+
+    auto keep = std::min(size_t(maxResults), result.matches.size());
+    std::partial_sort(result.matches.begin(), result.matches.begin() + keep, result.matches.end(), IsBetter);
+    result.matches.resize(keep);
+    return result;
+}
+
+} // namespace Zep
@@ -0,0 +1,262 @@
+#include <unordered_map>
+
+#include "zep/mcommon/string/line_diff.h"
+
+namespace Zep
+{
+
+namespace
+{
+
+struct Differ
+{
+    std::vector<uint32_t> a;
+    std::vector<uint32_t> b;
+    std::vector<bool> deleted;
+    std::vector<bool> inserted;
+    std::vector<int64_t> forward;
+    std::vector<int64_t> backward;
+
+    void Compare(int64_t aBegin, int64_t aEnd, int64_t bBegin, int64_t bEnd)
+    {
+        // Common ends are never part of the edit
+        while (aBegin < aEnd && bBegin < bEnd && a[aBegin] == b[bBegin])
+        {
+            aBegin++;
+            bBegin++;
+        }
+        while (aBegin < aEnd && bBegin < bEnd && a[aEnd - 1] == b[bEnd - 1])
+        {
+            aEnd--;
+            bEnd--;
+        }
+
+        if (aBegin == aEnd || bBegin == bEnd)
+        {
+            for (auto i = aBegin; i < aEnd; i++)
+            {
+                deleted[i] = true;
+            }
+            for (auto i = bBegin; i < bEnd; i++)
+            {
+                inserted[i] = true;
+            }
+            return;
+        }
+
+        int64_t x = 0;
+        int64_t y = 0;
+        if (!FindMiddleSnake(aBegin, aEnd, bBegin, bEnd, x, y))
+        {
+            // Nothing in common at all
+            for (auto i = aBegin; i < aEnd; i++)
+            {
+                deleted[i] = true;
+            }
+            for (auto i = bBegin; i < bEnd; i++)
+            {
+                inserted[i] = true;
+            }
+            return;
+        }
+
+        Compare(aBegin, aBegin + x, bBegin, bBegin + y);
+        Compare(aBegin + x, aEnd, bBegin + y, bEnd);
+    }
+
+    // Run the search from both ends at once until the paths overlap; the point they meet at splits the
+    // problem in two, and only two diagonals' worth of state is kept
+    bool FindMiddleSnake(int64_t aBegin, int64_t aEnd, int64_t bBegin, int64_t bEnd, int64_t& splitX, int64_t& splitY)
+    {
+        auto n = aEnd - aBegin;
+        auto m = bEnd - bBegin;
+        auto maxD = (n + m + 1) / 2;
+        auto offset = maxD;
+        auto length = 2 * maxD + 2;
+
+        forward.assign(size_t(length), -1);
+        backward.assign(size_t(length), -1);
+        forward[size_t(offset + 1)] = 0;
+        backward[size_t(offset + 1)] = 0;
+
+        auto delta = n - m;
+        bool front = (delta % 2) != 0;
+
+        // Diagonals that have run off the edges are not searched again
+        int64_t k1Start = 0;
+        int64_t k1End = 0;
+        int64_t k2Start = 0;
+        int64_t k2End = 0;
+        for (int64_t d = 0; d < maxD; d++)
+        {
+            for (auto k1 = -d + k1Start; k1 <= d - k1End; k1 += 2)
+            {
+                auto k1Offset = offset + k1;
+                int64_t x1;
+                if (k1 == -d || (k1 != d && forward[k1Offset - 1] < forward[k1Offset + 1]))
+                {
+                    x1 = forward[k1Offset + 1];
+                }
+                else
+                {
+                    x1 = forward[k1Offset - 1] + 1;
+                }
+
+                auto y1 = x1 - k1;
+                while (x1 < n && y1 < m && a[aBegin + x1] == b[bBegin + y1])
+                {
+                    x1++;
+                    y1++;
+                }
+                forward[k1Offset] = x1;
+
+                if (x1 > n)
+                {
+                    k1End += 2;
+                }
+                else if (y1 > m)
+                {
+                    k1Start += 2;
+                }
+                else if (front)
+                {
+                    auto k2Offset = offset + delta - k1;
+                    if (k2Offset >= 0 && k2Offset < length && backward[k2Offset] != -1)
+                    {
+                        if (x1 >= n - backward[k2Offset])
+                        {
+                            splitX = x1;
+                            splitY = y1;
+                            return true;
+                        }
+                    }
+                }
+            }
+
+            for (auto k2 = -d + k2Start; k2 <= d - k2End; k2 += 2)
+            {
+                auto k2Offset = offset + k2;
+                int64_t x2;
+                if (k2 == -d || (k2 != d && backward[k2Offset - 1] < backward[k2Offset + 1]))
+                {
+                    x2 = backward[k2Offset + 1];
+                }
+                else
+                {
+                    x2 = backward[k2Offset - 1] + 1;
+                }
+
+                auto y2 = x2 - k2;
+                while (x2 < n && y2 < m && a[aEnd - x2 - 1] == b[bEnd - y2 - 1])
+                {
+                    x2++;
+                    y2++;
+                }
+                backward[k2Offset] = x2;
+
+                if (x2 > n)
+                {
+                    k2End += 2;
+                }
+                else if (y2 > m)
+                {
+                    k2Start += 2;
+                }
+                else if (!front)
+                {
+                    auto k1Offset = offset + delta - k2;
+                    if (k1Offset >= 0 && k1Offset < length && forward[k1Offset] != -1)
+                    {
+                        auto x1 = forward[k1Offset];
+                        auto y1 = offset + x1 - k1Offset;
+                        if (x1 >= n - x2)
+                        {
+                            splitX = x1;
+                            splitY = y1;
+                            return true;
+                        }
+                    }
+                }
+            }
+        }
+        return false;
+    }
+};
+
+} // namespace
+
+std::vector<std::string_view> diff_split_lines(std::string_view text)
+{
+    std::vector<std::string_view> lines;
+    size_t start = 0;
+    while (start < text.size())
+    {
+        auto end = text.find('\n', start);
+        end = (end == std::string_view::npos) ? text.size() : end + 1;
+        lines.push_back(text.substr(start, end - start));
+        start = end;
+    }
+    return lines;
+}
+
+std::vector<DiffHunk> diff_lines(const std::vector<std::string_view>& oldLines, const std::vector<std::string_view>& newLines)
+{
+    Differ differ;
+
+    std::unordered_map<std::string_view, uint32_t> ids;
+    auto intern = [&](const std::vector<std::string_view>& lines, std::vector<uint32_t>& out) {
+        out.reserve(lines.size());
+        for (auto& line : lines)
+        {
+            out.push_back(ids.emplace(line, uint32_t(ids.size())).first->second);
+        }
+    };
+    intern(oldLines, differ.a);
+    intern(newLines, differ.b);
+
+    differ.deleted.resize(oldLines.size());
+    differ.inserted.resize(newLines.size());
+    differ.Compare(0, int64_t(oldLines.size()), 0, int64_t(newLines.size()));
+
+    // Walk both sides together; unchanged lines pair up between the hunks
+    std::vector<DiffHunk> hunks;
+    uint32_t oldIndex = 0;
+    uint32_t newIndex = 0;
+    auto oldSize = uint32_t(oldLines.size());
+    auto newSize = uint32_t(newLines.size());
+    while (oldIndex < oldSize || newIndex < newSize)
+    {
+        if (oldIndex < oldSize && newIndex < newSize && !differ.deleted[oldIndex] && !differ.inserted[newIndex])
+        {
+            oldIndex++;
+            newIndex++;
+            continue;
+        }
+
+        DiffHunk hunk;
+        hunk.oldLine = oldIndex;
+        hunk.newLine = newIndex;
+        while (oldIndex < oldSize && differ.deleted[oldIndex])
+        {
+            oldIndex++;
+        }
+        while (newIndex < newSize && differ.inserted[newIndex])
+        {
+            newIndex++;
+        }
+        hunk.oldCount = oldIndex - hunk.oldLine;
+        hunk.newCount = newIndex - hunk.newLine;
+        if (hunk.oldCount == 0 && hunk.newCount == 0)
+        {
+            // Unpaired lines left on one side; can't happen with a consistent script
+            hunk.oldCount = oldSize - oldIndex;
+            hunk.newCount = newSize - newIndex;
+            oldIndex = oldSize;
+            newIndex = newSize;
+        }
+        hunks.push_back(hunk);
+    }
+    return hunks;
+}
+
+} // namespace Zep
@@ -0,0 +1,192 @@
+#include <algorithm>
+#include <cstring>
+#include <vector>
+
+#include "zep/mcommon/file/varint.h"
+#include "zep/mcommon/string/lz.h"
+
+namespace Zep
+{
+
+namespace
+{
+
+// Each sequence is a token, with the literal count in the high nibble and the match length in the low,
+// either of which spills into extra bytes at 15; the literals; then the match as a 16 bit offset back
+// into the output.  The last sequence is literals only, and ends where the output reaches its size.
+const size_t MinMatch = 4;
+const size_t MaxOffset = 0xFFFF;
+const uint32_t HashBits = 14;
+
+uint32_t ReadQuad(const std::string& in, size_t pos)
+{
+    uint32_t quad;
+    memcpy(&quad, in.data() + pos, sizeof(quad));
+    return quad;
+}
+
+uint32_t HashQuad(uint32_t quad)
+{
+    return (quad * 2654435761u) >> (32 - HashBits);
+}
+
+void WriteLength(std::string& out, size_t length)
+{
+    while (length >= 255)
+    {
+        out.push_back(char(255));
+        length -= 255;
+    }
+    out.push_back(char(length));
+}
+
+bool ReadLength(const std::string& in, size_t& pos, size_t& length)
+{
+    for (;;)
+    {
+        if (pos >= in.size())
+        {
+            return false;
+        }
+        auto byte = uint8_t(in[pos++]);
+        length += byte;
+        if (byte != 255)
+        {
+            return true;
+        }
+    }
+}
+
+void WriteSequence(std::string& out, const std::string& in, size_t literalStart, size_t literalEnd, size_t offset, size_t matchLength)
+{
+    auto literals = literalEnd - literalStart;
+    auto matchCode = matchLength ? matchLength - MinMatch : 0;
+    out.push_back(char((std::min(literals, size_t(15)) << 4) | std::min(matchCode, size_t(15))));
+    if (literals >= 15)
+    {
+        WriteLength(out, literals - 15);
+    }
+    out.append(in, literalStart, literals);
+
+    if (matchLength)
+    {
+        out.push_back(char(offset & 0xFF));
+        out.push_back(char(offset >> 8));
+        if (matchCode >= 15)
+        {
+            WriteLength(out, matchCode - 15);
+        }
+    }
+}
+
+} // namespace
+
+std::string lz_compress(const std::string& in)
+{
+    std::string out;
+    write_varint(out, in.size());
+
+    // The last place each 4 byte run was seen, plus one
+    std::vector<uint32_t> table(size_t(1) << HashBits, 0);
+
+    size_t anchor = 0;
+    size_t pos = 0;
+    while (pos + MinMatch <= in.size())
+    {
+        auto quad = ReadQuad(in, pos);
+        auto& slot = table[HashQuad(quad)];
+        auto candidate = size_t(slot);
+        slot = uint32_t(pos + 1);
+
+        if (candidate == 0 || pos - (candidate - 1) > MaxOffset || ReadQuad(in, candidate - 1) != quad)
+        {
+            pos++;
+            continue;
+        }
+
+        auto match = candidate - 1;
+        auto length = MinMatch;
+        while (pos + length < in.size() && in[match + length] == in[pos + length])
+        {
+            length++;
+        }
+
+        WriteSequence(out, in, anchor, pos, pos - match, length);
+        pos += length;
+        anchor = pos;
+    }
+
+    if (anchor < in.size())
+    {
+        WriteSequence(out, in, anchor, in.size(), 0, 0);
+    }
+    return out;
+}
+
+bool lz_decompress(const std::string& in, std::string& out)
+{
+    out.clear();
+
+    size_t pos = 0;
+    uint64_t size = 0;
+    if (!read_varint(in, pos, size) || size > in.size() * uint64_t(256))
+    {
+        // No byte of the stream stands for more than 255 of the output, so the size is damaged
+        return false;
+    }
+    out.reserve(size_t(size));
+
+    while (out.size() < size)
+    {
+        if (pos >= in.size())
+        {
+            return false;
+        }
+        auto token = uint8_t(in[pos++]);
+
+        size_t literals = token >> 4;
+        if (literals == 15 && !ReadLength(in, pos, literals))
+        {
+            return false;
+        }
+        if (literals > in.size() - pos || literals > size - out.size())
+        {
+            return false;
+        }
+        out.append(in, pos, literals);
+        pos += literals;
+
+        if (out.size() == size)
+        {
+            break;
+        }
+
+        if (pos + 2 > in.size())
+        {
+            return false;
+        }
+        auto offset = size_t(uint8_t(in[pos])) | (size_t(uint8_t(in[pos + 1])) << 8);
+        pos += 2;
+
+        size_t length = token & 0xF;
+        if (length == 15 && !ReadLength(in, pos, length))
+        {
+            return false;
+        }
+        length += MinMatch;
+        if (offset == 0 || offset > out.size() || length > size - out.size())
+        {
+            return false;
+        }
+
+        // A byte at a time; the match may run on into what it is copying
+        auto from = out.size() - offset;
+        for (size_t index = 0; index < length; index++)
+        {
+            out.push_back(out[from + index]);
+        }
+    }
+    return pos == in.size();
+}
+
+} // namespace Zep
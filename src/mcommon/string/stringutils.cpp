@@ -403,4 +403,26 @@ const StringId& StringId::operator=(const std::string& str)
     return *this;
 }
 
+void string_write_json(std::ostream& str, const char* text)
+{
+    str << '"';
+    for (auto p = text; *p; p++)
+    {
+        auto ch = uint8_t(*p);
+        if (ch == '"' || ch == '\\')
+        {
+            str << '\\' << char(ch);
+        }
+        else if (ch < 0x20)
+        {
+            str << ' ';
+        }
+        else
+        {
+            str << char(ch);
+        }
+    }
+    str << '"';
+}
+
 } // namespace Zep
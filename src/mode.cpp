@@ -2,12 +2,17 @@
 #include "zep/buffer.h"
 #include "zep/editor.h"
 #include "zep/filesystem.h"
+#include "zep/indexer.h"
+#include "zep/key_replay.h"
 #include "zep/mcommon/logger.h"
+#include "zep/mcommon/memory.h"
 #include "zep/mode_search.h"
 #include "zep/regress.h"
 #include "zep/syntax.h"
 #include "zep/tab_window.h"
 
+#include <iomanip>
+
 namespace Zep
 {
 CommandContext::CommandContext(const std::string& commandIn, ZepMode& md, EditorMode editorMode)
@@ -149,7 +154,7 @@ void CommandContext::GetCommandRegisters()
 }
 
 ZepMode::ZepMode(ZepEditor& editor)
-    : ZepComponent(editor)
+    : ZepComponent(editor, ComponentMessages::Subscribed)
 {
 }
 
@@ -372,6 +377,8 @@ void ZepMode::AddKeyPress(uint32_t key, uint32_t modifierKeys)
         return;
     }
 
+    GetEditor().RecordKey(key, modifierKeys);
+
     // Temporarily accept up to 255; this is not fully allowing UTF8 input yet (though display and management of buffers with
     // utf8 is just fine)
     key &= 0xFF;
@@ -388,7 +395,12 @@ void ZepMode::AddKeyPress(uint32_t key, uint32_t modifierKeys)
 
     // Get the new command by parsing out the keys
     // We convert CTRL + f to a string: "<C-f>"
+    // However many edits the key makes, listeners hear about each buffer once
+    GetEditor().BeginInputLatency();
+    GetEditor().BeginBufferChanges();
     HandleMappedInput(ConvertInputToMapString(key, modifierKeys));
+    GetEditor().MarkInputLatency(LatencyStage::Command);
+    GetEditor().EndBufferChanges();
 
     if (m_pCurrentWindow)
     {
@@ -399,6 +411,7 @@ void ZepMode::AddKeyPress(uint32_t key, uint32_t modifierKeys)
         }
     }
 
+    GetEditor().EndInputLatency();
     timer_restart(m_lastKeyPressTimer);
 }
 
@@ -428,6 +441,8 @@ void ZepMode::HandleMappedInput(const std::string& input)
         return;
     }
 
+    auto commandStart = timer_get_time_now();
+
     // The current command is our currently typed multi-key operation
     m_currentCommand += input;
 
@@ -488,7 +503,7 @@ void ZepMode::HandleMappedInput(const std::string& input)
             // If not in insert mode, begin the group, because we have started a new operation
             if (m_currentMode != EditorMode::Insert || ZTestFlags(spContext->commandResult.flags, CommandResultFlags::BeginUndoGroup))
             {
-                AddCommand(std::make_shared<ZepCommand_GroupMarker>(spContext->buffer));
+                spContext->buffer.GetUndoLog().BeginGroup();
 
                 // Record for the dot command
                 m_dotCommand = m_currentCommand;
@@ -508,7 +523,7 @@ void ZepMode::HandleMappedInput(const std::string& input)
             // remember the dot command that did it
             if (enteringMode(EditorMode::Insert))
             {
-                AddCommand(std::make_shared<ZepCommand_GroupMarker>(spContext->buffer));
+                spContext->buffer.GetUndoLog().BeginGroup();
                 m_dotCommand = m_currentCommand;
             }
         }
@@ -557,6 +572,8 @@ void ZepMode::HandleMappedInput(const std::string& input)
         }
     }
     ClampCursorForMode();
+
+    GetEditor().AddCommandTime(spContext->keymap.foundMapping, timer_get_time_now() - commandStart);
 }
 
 void ZepMode::AddCommand(std::shared_ptr<ZepCommand> spCmd)
@@ -573,12 +590,12 @@ void ZepMode::AddCommand(std::shared_ptr<ZepCommand> spCmd)
         return;
     }
 
+    // What it did goes in the buffer's undo log, in place of anything there was to redo
+    auto& undoLog = spCmd->GetBuffer().GetUndoLog();
     spCmd->Redo();
-    m_undoStack.push(spCmd);
-
-    // Can't redo anything beyond this point
-    std::stack<std::shared_ptr<ZepCommand>> empty;
-    m_redoStack.swap(empty);
+    spCmd->RecordUndo(undoLog);
+    undoLog.AddCursors(spCmd->GetCursorBefore(), spCmd->GetCursorAfter());
+    undoLog.Trim(uint64_t(GetEditor().GetConfig().undoBudget) << 20, GetEditor().GetConfig().undoSpill);
 
     if (spCmd->GetCursorAfter().Valid())
     {
@@ -593,33 +610,12 @@ void ZepMode::Redo()
         return;
     }
 
-    if (m_redoStack.empty())
-        return;
-
-    if (std::dynamic_pointer_cast<ZepCommand_GroupMarker>(m_redoStack.top()) != nullptr)
+    auto& buffer = GetCurrentWindow()->GetBuffer();
+    auto cursor = buffer.GetUndoLog().Redo(buffer);
+    if (cursor.Valid())
     {
-        m_undoStack.push(m_redoStack.top());
-        m_redoStack.pop();
+        GetCurrentWindow()->SetBufferCursor(cursor);
     }
-
-    while (!m_redoStack.empty())
-    {
-        auto& spCommand = m_redoStack.top();
-        spCommand->Redo();
-
-        if (spCommand->GetCursorAfter().Valid())
-        {
-            GetCurrentWindow()->SetBufferCursor(spCommand->GetCursorAfter());
-        }
-
-        m_undoStack.push(spCommand);
-        m_redoStack.pop();
-
-        if (std::dynamic_pointer_cast<ZepCommand_GroupMarker>(spCommand) != nullptr)
-        {
-            break;
-        }
-    };
 }
 
 void ZepMode::Undo()
@@ -629,33 +625,12 @@ void ZepMode::Undo()
         return;
     }
 
-    if (m_undoStack.empty())
-        return;
-
-    if (std::dynamic_pointer_cast<ZepCommand_GroupMarker>(m_undoStack.top()) != nullptr)
+    auto& buffer = GetCurrentWindow()->GetBuffer();
+    auto cursor = buffer.GetUndoLog().Undo(buffer);
+    if (cursor.Valid())
     {
-        m_redoStack.push(m_undoStack.top());
-        m_undoStack.pop();
+        GetCurrentWindow()->SetBufferCursor(cursor);
     }
-
-    while (!m_undoStack.empty())
-    {
-        auto& spCommand = m_undoStack.top();
-        spCommand->Undo();
-
-        if (spCommand->GetCursorBefore().Valid())
-        {
-            GetCurrentWindow()->SetBufferCursor(spCommand->GetCursorBefore());
-        }
-
-        m_redoStack.push(spCommand);
-        m_undoStack.pop();
-
-        if (std::dynamic_pointer_cast<ZepCommand_GroupMarker>(spCommand) != nullptr)
-        {
-            break;
-        }
-    };
 }
 
 GlyphRange ZepMode::GetInclusiveVisualRange() const
@@ -692,8 +667,16 @@ bool ZepMode::GetCommand(CommandContext& context)
     {
         // TODO: Is it possible extend our key mapping to better process ex commands?  Or are these
         // too specialized?
+        AllocationScope exAllocations;
         if (HandleExCommand(context.fullCommand))
         {
+            // By the command's name, without its arguments; searches and cancelled commands aren't counted
+            if (m_lastKey == ExtKeys::RETURN && context.fullCommand[0] == ':')
+            {
+                auto name = context.fullCommand.substr(0, context.fullCommand.find_first_of(" <"));
+                GetEditor().AddAllocations(name, exAllocations.GetCounts());
+            }
+
             // buffer.GetMode()->Begin(GetCurrentWindow());
             SwitchMode(DefaultMode());
             ResetCommand();
@@ -893,6 +876,43 @@ bool ZepMode::GetCommand(CommandContext& context)
         GetEditor().AddSearch();
         return true;
     }
+    else if (mappedCommand == id_GotoDefinition)
+    {
+        auto pIndexer = GetEditor().GetIndexer();
+        if (pIndexer == nullptr)
+        {
+            GetEditor().SetCommandText("No project index");
+            return true;
+        }
+
+        auto range = buffer.InnerWordMotion(bufferCursor, SearchType::Word);
+        auto word = buffer.GetBufferText(range.first, range.second);
+        auto definitions = pIndexer->FindDefinitions(word);
+        if (definitions.empty())
+        {
+            GetEditor().SetCommandText("No definition: " + word);
+            return true;
+        }
+
+        auto& definition = definitions[0];
+        auto pBuffer = GetEditor().GetFileBuffer(pIndexer->GetSearchRoot() / definition.path, 0, true);
+        if (pBuffer != nullptr)
+        {
+            GetCurrentWindow()->SetBuffer(pBuffer);
+
+            ByteRange lineRange;
+            if (pBuffer->GetLineOffsets(definition.line, lineRange))
+            {
+                GetCurrentWindow()->SetBufferCursor(GlyphIterator(pBuffer, std::min(lineRange.first + definition.column, lineRange.second)));
+            }
+
+            if (definitions.size() > 1)
+            {
+                GetEditor().SetCommandText(word + ": 1 of " + std::to_string(definitions.size()) + " definitions");
+            }
+        }
+        return true;
+    }
     else if (mappedCommand == id_Redo)
     {
         context.commandResult.modeSwitch = DefaultMode();
@@ -2074,6 +2094,23 @@ void ZepMode::UpdateVisualSelection()
     }
 }
 
+namespace
+{
+// A file next to the project index, so what the tools write doesn't land in the user's files; empty if the
+// directory can't be made
+ZepPath GetProjectDataPath(ZepEditor& editor, const char* name)
+{
+    auto& fs = editor.GetFileSystem();
+    bool foundGit = false;
+    auto root = fs.GetSearchRoot(fs.GetWorkingDirectory(), foundGit) / ".zep";
+    if (!fs.IsDirectory(root) && !fs.MakeDirectories(root))
+    {
+        return ZepPath();
+    }
+    return root / name;
+}
+} // namespace
+
 bool ZepMode::HandleExCommand(std::string strCommand)
 {
     if (strCommand.empty())
@@ -2291,6 +2328,84 @@ bool ZepMode::HandleExCommand(std::string strCommand)
         {
             GetEditor().SetCommandText(GetEditor().GetFileSystem().GetWorkingDirectory().string());
         }
+        else if (strCommand.find(":ZProfile") == 0)
+        {
+            auto strTok = string_split(strCommand, " ");
+            auto action = strTok.size() > 1 ? strTok[1] : std::string("dump");
+            if (action == "start")
+            {
+                profile_start();
+                GetEditor().SetCommandText("Profiling");
+            }
+            else if (action == "stop")
+            {
+                profile_stop();
+                GetEditor().SetCommandText("Profiling stopped");
+            }
+            else if (action == "dump")
+            {
+                auto path = GetProjectDataPath(GetEditor(), "profile.json");
+
+                std::ostringstream str;
+                profile_write_trace(str);
+                auto trace = str.str();
+                if (!path.empty() && GetEditor().GetFileSystem().Write(path, trace.c_str(), trace.size()))
+                {
+                    GetEditor().SetCommandText("Profile written to " + path.string());
+                }
+                else
+                {
+                    GetEditor().SetCommandText("Can't write " + path.string());
+                }
+            }
+            else
+            {
+                GetEditor().SetCommandText("Usage: ZProfile start|stop|dump");
+            }
+        }
+        else if (strCommand.find(":ZRecord") == 0)
+        {
+            auto strTok = string_split(strCommand, " ");
+            auto action = strTok.size() > 1 ? strTok[1] : std::string();
+            if (action == "start")
+            {
+                GetEditor().StartKeyRecording();
+                GetEditor().SetCommandText("Recording keys");
+            }
+            else if (action == "stop")
+            {
+                auto spRecording = GetEditor().StopKeyRecording();
+                if (!spRecording)
+                {
+                    GetEditor().SetCommandText("Not recording");
+                    return true;
+                }
+
+                // Leave out the keys typing this command
+                auto& keys = spRecording->keys;
+                auto itrColon = std::find_if(keys.rbegin(), keys.rend(), [](const RecordedKey& key) {
+                    return key.key == ':';
+                });
+                if (itrColon != keys.rend())
+                {
+                    keys.erase(std::next(itrColon).base(), keys.end());
+                }
+
+                auto path = strTok.size() > 2 ? ZepPath(strTok[2]) : GetProjectDataPath(GetEditor(), "session.zkeys");
+                if (!path.empty() && spRecording->Save(GetEditor().GetFileSystem(), path))
+                {
+                    GetEditor().SetCommandText("Recorded " + std::to_string(keys.size()) + " keys to " + path.string());
+                }
+                else
+                {
+                    GetEditor().SetCommandText("Can't write " + path.string());
+                }
+            }
+            else
+            {
+                GetEditor().SetCommandText("Usage: ZRecord start|stop [file]");
+            }
+        }
         else if (strCommand.find(":ZTestFloatSlider") == 0)
         {
             // auto line = buffer.GetBufferLine(bufferCursor);
@@ -2430,6 +2545,83 @@ bool ZepMode::HandleExCommand(std::string strCommand)
         {
             GetEditor().GetConfig().showNormalModeKeyStrokes = !GetEditor().GetConfig().showNormalModeKeyStrokes;
         }
+        else if (strCommand == ":ZShowLatency")
+        {
+            GetEditor().GetConfig().showLatency = !GetEditor().GetConfig().showLatency;
+        }
+        else if (strCommand == ":ZResetLatency")
+        {
+            GetEditor().ResetLatency();
+        }
+        else if (strCommand.find(":ZAllocs") == 0)
+        {
+            if (strCommand == ":ZAllocs reset")
+            {
+                GetEditor().ResetAllocations();
+                GetEditor().SetCommandText("Allocation counts reset");
+                return true;
+            }
+            if (!memory_hooks_installed())
+            {
+                GetEditor().SetCommandText("Allocations aren't counted in this build");
+                return true;
+            }
+
+            std::ostringstream str;
+            str << "--- allocations ---" << '\n';
+            str << std::setw(10) << "count" << std::setw(12) << "allocs/each" << std::setw(10) << "max" << std::setw(12) << "bytes/each" << "   scope" << '\n';
+            for (auto& [scope, total] : GetEditor().GetAllocations())
+            {
+                str << std::setw(10) << total.scopes;
+                str << std::setw(12) << std::fixed << std::setprecision(1) << double(total.allocs) / double(total.scopes);
+                str << std::setw(10) << total.maxAllocs;
+                str << std::setw(12) << memory_to_string(total.bytes / total.scopes);
+                str << "   " << scope << '\n';
+            }
+            GetEditor().SetCommandText(str.str());
+        }
+        else if (strCommand == ":ZMem")
+        {
+            std::ostringstream str;
+            str << "--- memory ---" << '\n';
+
+            const char* columns[] = { "total", "text", "gap", "lines", "syntax", "adorn", "markers", "undo", "redo", "windows", "asleep" };
+            for (auto column : columns)
+            {
+                str << std::setw(10) << column;
+            }
+            str << "    buffer" << '\n';
+
+            BufferMemory all;
+            for (auto& memory : GetEditor().GetMemoryUsage())
+            {
+                const uint64_t values[] = { memory.Total(), memory.text, memory.textGap, memory.lineEnds, memory.syntax, memory.adornments, memory.markers, memory.undo, memory.redo, memory.windows, memory.hibernated };
+                for (auto value : values)
+                {
+                    str << std::setw(10) << memory_to_string(value);
+                }
+                str << ' ' << (memory.pBuffer->IsHidden() ? 'h' : ' ') << (memory.pBuffer->IsHibernated() ? 'z' : ' ') << ' ' << string_replace(memory.pBuffer->GetName(), "\n", "^J") << '\n';
+
+                all.text += memory.text;
+                all.textGap += memory.textGap;
+                all.lineEnds += memory.lineEnds;
+                all.syntax += memory.syntax;
+                all.adornments += memory.adornments;
+                all.markers += memory.markers;
+                all.undo += memory.undo;
+                all.redo += memory.redo;
+                all.windows += memory.windows;
+                all.hibernated += memory.hibernated;
+            }
+            str << std::setw(10) << memory_to_string(all.Total()) << "   in all";
+            GetEditor().SetCommandText(str.str());
+        }
+        else if (strCommand == ":ZHibernate")
+        {
+            // Everything that is hidden, whatever the budget
+            auto count = GetEditor().HibernateBuffers(0);
+            GetEditor().SetCommandText("Hibernated " + std::to_string(count) + " buffers");
+        }
         else if (strCommand == ":ZThemeToggle")
         {
             // An easy test command to check per-buffer themeing
@@ -2528,15 +2720,13 @@ bool ZepMode::HandleExCommand(std::string strCommand)
             auto& buffer = pWindow->GetBuffer();
             auto searchString = m_currentCommand.substr(1);
 
-            buffer.ClearRangeMarkers(RangeMarkerType::Search);
-
-            uint32_t numMarkers = 0;
+            std::vector<RangeMarkerDesc> markers;
             GlyphIterator start = buffer.Begin();
 
             if (!searchString.empty())
             {
                 static const uint32_t MaxMarkers = 1000;
-                while (numMarkers < MaxMarkers)
+                while (markers.size() < MaxMarkers)
                 {
                     auto found = buffer.Find(start, (uint8_t*)&searchString[0], (uint8_t*)&searchString[searchString.length()]);
                     if (!found.Valid())
@@ -2546,16 +2736,20 @@ bool ZepMode::HandleExCommand(std::string strCommand)
 
                     start = found + 1;
 
-                    auto spMarker = std::make_shared<RangeMarker>(buffer);
-                    spMarker->SetColors(ThemeColor::VisualSelectBackground, ThemeColor::Text);
-                    spMarker->SetRange(ByteRange(found.Index(), found.PeekByteOffset(long(searchString.size())).Index()));
-                    spMarker->displayType = RangeMarkerDisplayType::Background;
-                    spMarker->markerType = RangeMarkerType::Search;
-
-                    numMarkers++;
+                    RangeMarkerDesc marker;
+                    marker.range = ByteRange(found.Index(), found.PeekByteOffset(long(searchString.size())).Index());
+                    marker.backgroundColor = ThemeColor::VisualSelectBackground;
+                    marker.textColor = ThemeColor::Text;
+                    marker.highlightColor = ThemeColor::Text;
+                    marker.displayType = RangeMarkerDisplayType::Background;
+                    marker.markerType = RangeMarkerType::Search;
+                    markers.push_back(marker);
                 }
             }
 
+            // The last search's markers go in the same pass
+            buffer.ReplaceRangeMarkers(RangeMarkerType::Search, markers);
+
             Direction dir = (m_currentCommand[0] == '/') ? Direction::Forward : Direction::Backward;
             m_lastSearchDirection = dir;
 
@@ -2682,6 +2876,7 @@ void ZepMode::AddGlobalKeyMaps()
     keymap_add({ &m_normalMap }, { "H" }, id_PreviousTabWindow);
     keymap_add({ &m_normalMap }, { "L" }, id_NextTabWindow);
     keymap_add({ &m_normalMap }, { "<C-i><C-o>" }, id_SwitchToAlternateFile);
+    keymap_add({ &m_normalMap }, { "gd" }, id_GotoDefinition);
     keymap_add({ &m_normalMap }, { "+" }, id_FontBigger);
     keymap_add({ &m_normalMap }, { "-" }, id_FontSmaller);
 }
@@ -1,41 +1,47 @@
+#include <algorithm>
+#include <thread>
+
 #include "zep/mode_search.h"
 #include "zep/filesystem.h"
 #include "zep/tab_window.h"
 #include "zep/window.h"
 
 #include "zep/mcommon/logger.h"
-#include "zep/mcommon/threadutils.h"
 
 #include "zep/mcommon/file/fnmatch.h"
 
 namespace Zep
 {
 
+namespace
+{
+// Only the top matches are ever shown
+const uint32_t MaxSearchResults = 500;
+
+// Don't bother splitting up small searches
+const uint32_t MinPathsPerPartition = 8192;
+
+// Find the set a match index is in, and the index within it
+std::pair<const FileIndexResult*, uint32_t> FindFile(const std::vector<std::shared_ptr<FileIndexResult>>& sets, const std::vector<uint32_t>& starts, uint32_t index)
+{
+    auto set = size_t(std::upper_bound(starts.begin(), starts.end(), index) - starts.begin()) - 1;
+    return std::make_pair(sets[set].get(), index - starts[set]);
+}
+} // namespace
+
 ZepMode_Search::ZepMode_Search(ZepEditor& editor, ZepWindow& launchWindow, ZepWindow& window, const ZepPath& path)
     : ZepMode(editor)
     , m_launchWindow(launchWindow)
     , m_window(window)
     , m_startPath(path)
+    , m_walkTasks(editor.GetThreadPool())
+    , m_searchTasks(editor.GetThreadPool(), TaskPriority::Interactive)
 {
 }
 
-ZepMode_Search::~ZepMode_Search()
-{
-    // Ensure threads have finished
-    if (m_indexResult.valid())
-    {
-        m_indexResult.wait();
-    }
-
-    if (m_searchResult.valid())
-    {
-        m_searchResult.wait();
-    }
-}
-
 void ZepMode_Search::AddKeyPress(uint32_t key, uint32_t modifiers)
 {
-    (void)modifiers;
+    GetEditor().RecordKey(key, modifiers);
     if (key == ExtKeys::ESCAPE)
     {
         // CM TODO:
@@ -109,12 +115,22 @@ void ZepMode_Search::AddKeyPress(uint32_t key, uint32_t modifiers)
         }
     }
 
+    UpdateStatus();
+}
+
+void ZepMode_Search::UpdateStatus()
+{
     std::ostringstream str;
     str << ">>> " << m_searchTerm;
 
-    if (!m_indexTree.empty())
+    if (m_resultsValid)
     {
-        str << " (" << m_indexTree[m_indexTree.size() - 1]->indices.size() << " / " << m_indexTree[0]->indices.size() << ")";
+        str << " (" << m_results.matchCount << " / " << m_fileCount << ")";
+    }
+
+    if (fileSearchActive)
+    {
+        str << " Indexing...";
     }
 
     GetEditor().SetCommandText(str.str());
@@ -128,224 +144,272 @@ void ZepMode_Search::Begin(ZepWindow* pWindow)
     m_searchTerm = "";
     GetEditor().SetCommandText(">>> ");
 
-    m_indexResult = Indexer::IndexPaths(GetEditor(), m_startPath);
-    m_window.GetBuffer().SetText(std::string("Indexing: ") + m_startPath.string());
+    // The project indexer keeps its list current, so there is nothing to walk
+    auto pIndexer = GetEditor().GetIndexer();
+    auto spFiles = pIndexer ? pIndexer->GetFileIndex() : nullptr;
+    if (spFiles && spFiles->root == m_startPath)
+    {
+        AddFileSet(spFiles);
+        UpdateTree();
+        UpdateStatus();
+        return;
+    }
+
+    // Whatever the walk has found so far is searched while it runs
+    auto pEditor = &GetEditor();
+    m_spProgress = std::make_shared<FileIndexProgress>();
+    m_spProgress->fnBatch = [this, pEditor]() {
+        pEditor->PostToMainThread(this, [this]() {
+            OnWalkBatches();
+        });
+    };
 
     fileSearchActive = true;
+    Indexer::IndexPaths(
+        GetEditor(), m_startPath, m_spProgress, false, [this, pEditor](std::shared_ptr<FileIndexResult> spResult) {
+            pEditor->PostToMainThread(this, [this, spResult]() {
+                OnWalkDone(spResult);
+            });
+        },
+        &m_walkTasks);
+    m_window.GetBuffer().SetText(std::string("Indexing: ") + m_startPath.string());
 }
 
-void ZepMode_Search::Notify(std::shared_ptr<ZepMessage> message)
+void ZepMode_Search::OnWalkBatches()
 {
-    ZepMode::Notify(message);
-    if (message->messageId == Msg::Tick)
+    if (!fileSearchActive)
     {
-        if (fileSearchActive)
-        {
-            if (!is_future_ready(m_indexResult))
-            {
-                return;
-            }
-    
-            fileSearchActive = false;
-
-            m_spFilePaths = m_indexResult.get();
-            if (!m_spFilePaths->errors.empty())
-            {
-                GetEditor().SetCommandText(m_spFilePaths->errors);
-                return;
-            }
-
-            InitSearchTree();
-            ShowTreeResult();
-            UpdateTree();
-
-            GetEditor().RequestRefresh();
-        }
+        return;
+    }
 
-        if (treeSearchActive)
+    {
+        std::lock_guard<std::mutex> lock(m_spProgress->mutex);
+        for (auto& spBatch : m_spProgress->batches)
         {
-            UpdateTree();
+            AddFileSet(spBatch);
         }
+        m_spProgress->batches.clear();
+    }
+
+    if (m_filesChanged)
+    {
+        UpdateTree();
+        UpdateStatus();
+        GetEditor().RequestRefresh();
     }
 }
 
-void ZepMode_Search::InitSearchTree()
+void ZepMode_Search::OnWalkDone(std::shared_ptr<FileIndexResult> spResult)
 {
-    m_indexTree.clear();
-    auto pInitSet = std::make_shared<IndexSet>();
-    for (uint32_t i = 0; i < (uint32_t)m_spFilePaths->paths.size(); i++)
+    fileSearchActive = false;
+    if (!spResult->errors.empty())
     {
-        pInitSet->indices.insert(std::make_pair(0, SearchResult{ i, 0 }));
+        GetEditor().SetCommandText(spResult->errors);
+        return;
     }
-    m_indexTree.push_back(pInitSet);
+
+    // The complete, sorted, result replaces the batches
+    m_fileSets.clear();
+    m_fileSetStarts.clear();
+    m_fileCount = 0;
+    AddFileSet(spResult);
+
+    UpdateTree();
+    UpdateStatus();
+    GetEditor().RequestRefresh();
+}
+
+void ZepMode_Search::AddFileSet(std::shared_ptr<FileIndexResult> spFiles)
+{
+    m_fileSetStarts.push_back(m_fileCount);
+    m_fileSets.push_back(spFiles);
+    m_fileCount += uint32_t(spFiles->paths.size());
+    m_filesChanged = true;
 }
 
 void ZepMode_Search::ShowTreeResult()
 {
-    std::ostringstream str;
-    bool start = true;
-    for (auto& index : m_indexTree.back()->indices)
-    {
-        if (!start)
-        {
-            str << std::endl;
-        }
-        str << m_spFilePaths->paths[index.second.index].string();
-        start = false;
-    }
-    m_window.GetBuffer().SetText(str.str());
+    // The buffer asks for the lines it shows; a copy of the (small) top list keeps them valid while we search again
+    auto sets = m_resultSets;
+    auto starts = m_resultStarts;
+    auto matches = m_results.matches;
+    m_window.GetBuffer().SetVirtualList(long(matches.size()), [sets, starts, matches](long line) {
+        auto file = FindFile(sets, starts, matches[line].index);
+        return file.first->paths[file.second].string();
+    });
     m_window.SetBufferCursor(m_window.GetBuffer().Begin());
 }
 
 void ZepMode_Search::OpenSelection(OpenType type)
 {
-    if (m_indexTree.empty())
+    if (!m_resultsValid)
         return;
 
     auto cursor = m_window.GetBufferCursor();
-    auto line = m_window.GetBuffer().GetBufferLine(cursor);
-    auto paths = m_indexTree[m_indexTree.size() - 1];
+    auto line = m_window.GetBuffer().GetVirtualPageStart() + m_window.GetBuffer().GetBufferLine(cursor);
 
     auto& buffer = m_window.GetBuffer();
 
     GetEditor().GetActiveTabWindow()->SetActiveWindow(&m_launchWindow);
 
-    long count = 0;
-    for (auto& index : m_indexTree.back()->indices)
+    if (line >= 0 && line < long(m_results.matches.size()))
     {
-        if (count == line)
-        {
-            auto path = m_spFilePaths->paths[index.second.index];
-            auto full_path = m_spFilePaths->root / path;
+        auto file = FindFile(m_resultSets, m_resultStarts, m_results.matches[line].index);
+        auto full_path = file.first->root / file.first->paths[file.second];
 
-            auto pBuffer = GetEditor().GetFileBuffer(full_path, 0, true);
-            if (pBuffer != nullptr)
+        auto pBuffer = GetEditor().GetFileBuffer(full_path, 0, true);
+        if (pBuffer != nullptr)
+        {
+            switch (type)
             {
-                switch (type)
-                {
-                case OpenType::Replace:
+            case OpenType::Replace:
+            {
+                auto win = GetEditor().FindBufferWindows(pBuffer);
+                // If they just hit enter, then jump to existing if possible.
+                if (!win.empty())
                 {
-                    auto win = GetEditor().FindBufferWindows(pBuffer);
-                    // If they just hit enter, then jump to existing if possible.
-                    if (!win.empty())
-                    {
-                        GetEditor().SetCurrentTabWindow(&win[0]->GetTabWindow());
-                        win[0]->GetTabWindow().SetActiveWindow(win[0]);
-                    }
-                    else
-                    {
-                        m_launchWindow.SetBuffer(pBuffer);
-                    }
+                    GetEditor().SetCurrentTabWindow(&win[0]->GetTabWindow());
+                    win[0]->GetTabWindow().SetActiveWindow(win[0]);
                 }
-                 break;
-                case OpenType::VSplit:
-                    GetEditor().GetActiveTabWindow()->AddWindow(pBuffer, &m_launchWindow, RegionLayoutType::HBox);
-                    break;
-                case OpenType::HSplit:
-                    GetEditor().GetActiveTabWindow()->AddWindow(pBuffer, &m_launchWindow, RegionLayoutType::VBox);
-                    break;
-                case OpenType::Tab:
-                    GetEditor().AddTabWindow()->AddWindow(pBuffer, nullptr, RegionLayoutType::HBox);
-                    break;
+                else
+                {
+                    m_launchWindow.SetBuffer(pBuffer);
                 }
             }
+             break;
+            case OpenType::VSplit:
+                GetEditor().GetActiveTabWindow()->AddWindow(pBuffer, &m_launchWindow, RegionLayoutType::HBox);
+                break;
+            case OpenType::HSplit:
+                GetEditor().GetActiveTabWindow()->AddWindow(pBuffer, &m_launchWindow, RegionLayoutType::VBox);
+                break;
+            case OpenType::Tab:
+                GetEditor().AddTabWindow()->AddWindow(pBuffer, nullptr, RegionLayoutType::HBox);
+                break;
+            }
         }
-        count++;
     }
 
     // Removing the buffer will also kill this mode and its window; this is the last thing we can do here
     GetEditor().RemoveBuffer(&buffer);
 }
 
-void ZepMode_Search::UpdateTree()
+void ZepMode_Search::OnSearchDone(std::shared_ptr<std::vector<FuzzySearchResult>> spParts)
 {
-    if (fileSearchActive)
+    // Superseded while it was being posted
+    if (spParts != m_spSearchParts)
     {
         return;
     }
 
+    auto parts = std::move(*m_spSearchParts);
+    m_spSearchParts.reset();
+
+    m_results = fuzzy_merge(parts, MaxSearchResults);
+    m_resultSets = m_searchSets;
+    m_resultStarts = m_searchStarts;
+    m_resultTerm = m_activeSearchTerm;
+    m_resultsValid = true;
+    treeSearchActive = false;
+
+    ShowTreeResult();
+    UpdateStatus();
+    GetEditor().RequestRefresh();
+
+    UpdateTree();
+}
+
+void ZepMode_Search::UpdateTree()
+{
     if (treeSearchActive)
     {
-        if (!is_future_ready(m_searchResult))
+        // The user typed; what we are looking for is gone, so drop it. If only more files arrived, the search
+        // that is running goes again when it is done
+        if (m_activeSearchTerm == m_searchTerm)
         {
             return;
         }
-
-        m_indexTree.push_back(m_searchResult.get());
+        m_searchTasks.cancel();
         treeSearchActive = false;
     }
 
-    // If the user is typing capitals, he cares about them in the search!
-    m_caseImportant = string_tolower(m_searchTerm) != m_searchTerm;
+    // Up to date, or the user typed (or more files arrived) while we were searching, and we go again
+    if (m_resultsValid && m_resultTerm == m_searchTerm && !m_filesChanged)
+    {
+        return;
+    }
 
-    assert(!m_indexTree.empty());
+    // Every search is a full pass over the arenas; the character masks reject most paths before scoring,
+    // and each partition only keeps its own top matches
+    m_activeSearchTerm = m_searchTerm;
+    m_searchSets = m_fileSets;
+    m_searchStarts = m_fileSetStarts;
+    m_filesChanged = false;
 
-    uint32_t treeDepth = uint32_t(m_indexTree.size() - 1);
-    if (m_searchTerm.size() < treeDepth)
+    struct SearchRange
     {
-        while (m_searchTerm.size() < treeDepth)
-        {
-            m_indexTree.pop_back();
-            treeDepth--;
-        };
-    }
-    else if (m_searchTerm.size() > treeDepth)
+        std::shared_ptr<FileIndexResult> spFiles;
+        uint32_t start;
+        uint32_t begin;
+        uint32_t end;
+    };
+
+    auto pattern = m_activeSearchTerm;
+    auto threads = uint32_t(std::max(size_t(1), GetEditor().GetThreadPool().thread_count()));
+    auto partitionSize = std::max(MinPathsPerPartition, (m_fileCount + threads - 1) / threads);
+
+    // Small batches are grouped, and big sets split, so each partition gets about the same number of paths
+    auto spPartitions = std::make_shared<std::vector<std::vector<SearchRange>>>(1);
+    uint32_t rangeSize = 0;
+    for (size_t set = 0; set < m_searchSets.size(); set++)
     {
-        std::shared_ptr<IndexSet> spStartSet;
-        spStartSet = m_indexTree[m_indexTree.size() - 1];
-        char startChar = m_searchTerm[m_indexTree.size() - 1];
-
-        // Search for a match at the next level of the search tree
-        m_searchResult = GetEditor().GetThreadPool().enqueue([&](std::shared_ptr<IndexSet> spStartSet, const char startChar) {
-            auto spResult = std::make_shared<IndexSet>();
-            for (auto& searchPair : spStartSet->indices)
+        auto& spFiles = m_searchSets[set];
+        auto count = spFiles->pathArena.Size();
+        for (uint32_t begin = 0; begin < count;)
+        {
+            auto end = std::min(count, begin + (partitionSize - rangeSize));
+            spPartitions->back().push_back(SearchRange{ spFiles, m_searchStarts[set], begin, end });
+            rangeSize += end - begin;
+            begin = end;
+
+            if (rangeSize >= partitionSize)
             {
-                auto index = searchPair.second.index;
-                auto loc = searchPair.second.location;
-                auto dist = searchPair.first;
+                spPartitions->emplace_back();
+                rangeSize = 0;
+            }
+        }
+    }
 
-                size_t pos = 0;
-                if (m_caseImportant)
-                {
-                    auto str = m_spFilePaths->paths[index].string();
-                    pos = str.find_first_of(startChar, loc);
-                }
-                else
-                {
-                    auto str = m_spFilePaths->lowerPaths[index];
-                    pos = str.find_first_of(startChar, loc);
-                }
+    if (spPartitions->size() > 1 && spPartitions->back().empty())
+    {
+        spPartitions->pop_back();
+    }
 
-                if (pos != std::string::npos)
+    // The user is waiting on this one; it goes ahead of any walk or index update. The merge is posted back
+    // by whichever partition finishes last.
+    auto spParts = std::make_shared<std::vector<FuzzySearchResult>>(spPartitions->size());
+    auto pEditor = &GetEditor();
+    m_spSearchParts = spParts;
+    treeSearchActive = true;
+    m_searchTasks.parallel_for(
+        spPartitions->size(), [spPartitions, spParts, pattern](size_t index) {
+            TIME_SCOPE(FuzzySearch);
+            std::vector<FuzzySearchResult> parts;
+            for (auto& range : (*spPartitions)[index])
+            {
+                parts.push_back(fuzzy_search(range.spFiles->pathArena, pattern, range.begin, range.end, MaxSearchResults));
+                for (auto& match : parts.back().matches)
                 {
-                    // this approach 'clumps things together'
-                    // It rewards more for strings of subsequent characters
-                    uint32_t newDist = ((uint32_t)pos - loc);
-                    if (dist == 0)
-                    {
-                        newDist = 1;
-                    }
-                    else if (newDist == 1)
-                    {
-                        newDist = dist;
-                    }
-                    else
-                    {
-                        newDist = dist + 1;
-                    }
-
-                    spResult->indices.insert(std::make_pair(newDist, SearchResult{ index, (uint32_t)pos }));
+                    match.index += range.start;
                 }
             }
-            return spResult;
+            (*spParts)[index] = fuzzy_merge(parts, MaxSearchResults);
         },
-            spStartSet, startChar);
-
-        treeSearchActive = true;
-    }
-
-    ShowTreeResult();
-    GetEditor().RequestRefresh();
+        [this, pEditor, spParts]() {
+            pEditor->PostToMainThread(this, [this, spParts]() {
+                OnSearchDone(spParts);
+            });
+        });
 }
 
 CursorType ZepMode_Search::GetCursorType() const
@@ -37,25 +37,11 @@ void ZepMode_Tree::BuildTree()
 {
     auto& buffer = m_window.GetBuffer();
 
-    std::ostringstream strBuffer;
+    m_rows.clear();
     std::function<void(ZepTreeNode*, uint32_t indent)> fnVisit;
 
     fnVisit = [&](ZepTreeNode* pNode, uint32_t indent) {
-        for (uint32_t i = 0; i < indent; i++)
-        {
-            strBuffer << " ";
-        }
-
-        if (pNode->HasChildren())
-        {
-            strBuffer << (pNode->IsExpanded() ? "~ " : "+ ");
-        }
-        else
-        {
-            strBuffer << "  ";
-        }
-
-        strBuffer << pNode->GetName() << std::endl;
+        m_rows.push_back(TreeRow{ pNode, indent });
 
         if (pNode->IsExpanded())
         {
@@ -74,9 +60,21 @@ void ZepMode_Tree::BuildTree()
         }
     }
 
-    ChangeRecord tempRecord;
-    buffer.Clear();
-    buffer.Insert(buffer.Begin(), strBuffer.str(), tempRecord);
+    // The mode lives as long as the buffer, so the rows do too
+    buffer.SetVirtualList(long(m_rows.size()), [this](long line) {
+        auto& row = m_rows[line];
+
+        std::string str(row.indent, ' ');
+        if (row.pNode->HasChildren())
+        {
+            str += row.pNode->IsExpanded() ? "~ " : "+ ";
+        }
+        else
+        {
+            str += "  ";
+        }
+        return str + row.pNode->GetName();
+    });
 }
 
 void ZepMode_Tree::Begin(ZepWindow* pWindow)
@@ -1,19 +1,31 @@
+#include <algorithm>
+#include <limits>
+
 #include "zep/range_markers.h"
 #include "zep/buffer.h"
 #include "zep/editor.h"
 
+#include "zep/mcommon/memory.h"
+
 namespace Zep
 {
 
 RangeMarker::RangeMarker(ZepBuffer& buffer)
     : m_buffer(buffer)
 {
-    onPreBufferInsert = buffer.sigPreInsert.connect([=](ZepBuffer& buffer, const GlyphIterator& itrStart, const std::string& str) {
-        HandleBufferInsert(buffer, itrStart, str);
-    });
-    onPreBufferDelete = buffer.sigPreDelete.connect([=](ZepBuffer& buffer, const GlyphIterator& itrStart, const GlyphIterator itrEnd) {
-        HandleBufferDelete(buffer, itrStart, itrEnd);
-    });
+}
+
+RangeMarker::RangeMarker(ZepBuffer& buffer, const RangeMarkerDesc& desc)
+    : displayType(desc.displayType)
+    , markerType(desc.markerType)
+    , m_buffer(buffer)
+    , m_range(desc.range)
+    , m_name(desc.name)
+    , m_description(desc.description)
+    , m_textColor(desc.textColor)
+    , m_backgroundColor(desc.backgroundColor)
+    , m_highlightColor(desc.highlightColor)
+{
 }
 
 bool RangeMarker::ContainsLocation(GlyphIterator loc) const
@@ -88,6 +100,10 @@ void RangeMarker::SetRange(ByteRange range)
 
 const ByteRange& RangeMarker::GetRange() const
 {
+    if (m_tableSlot >= 0)
+    {
+        m_range = m_buffer.GetRangeMarkerTable().GetRange(*this);
+    }
     return m_range;
 }
 
@@ -96,105 +112,570 @@ ZepBuffer& RangeMarker::GetBuffer()
     return m_buffer;
 }
 
-// By Default Markers will:
-// - Move down if text is inserted before them.
-// - Move up if text is deleted before them.
-// - Remove themselves from the buffer if text is edited _inside_ them.
-// Derived markers can modify this behavior.
-// Its up to marker owners to update this behavior if necessary
-// Markers do not act inside the undo/redo system.  They live on the buffer but are not stored with it.  They are adornments that 
-// must be managed externally
-void RangeMarker::HandleBufferInsert(ZepBuffer& buffer, const GlyphIterator& itrStart, const std::string& str)
+const std::string& RangeMarker::GetName() const
+{
+    return m_name;
+}
+
+const std::string& RangeMarker::GetDescription() const
+{
+    return m_description;
+}
+
+void RangeMarker::SetName(const std::string& strName)
+{
+    m_name = strName;
+}
+
+void RangeMarker::SetDescription(const std::string& strDescription)
+{
+    m_description = strDescription;
+}
+
+void RangeMarker::SetEnabled(bool enabled)
 {
-    if (!m_enabled)
+    if (m_enabled == enabled)
     {
         return;
     }
 
-    if (itrStart.Index() > GetRange().second)
+    // The table keeps disabled markers apart from the rest
+    if (m_tableSlot < 0)
     {
+        m_enabled = enabled;
         return;
     }
-    else
+
+    auto spMarker = shared_from_this();
+    m_buffer.ClearRangeMarker(spMarker);
+
+    m_enabled = enabled;
+    m_buffer.AddRangeMarker(spMarker);
+}
+    
+const NVec2f& RangeMarker::GetInlineSize() const
+{
+    return m_inlineSize;
+}
+
+void RangeMarker::SetInlineSize(const NVec2f& size)
+{
+    m_inlineSize = size;
+}
+
+namespace
+{
+// Removed markers sort where they were, but can never be found
+const ByteIndex DeadSecond = std::numeric_limits<ByteIndex>::min() / 4;
+} // namespace
+
+RangeMarkerTable::~RangeMarkerTable()
+{
+    Clear();
+}
+
+void RangeMarkerTable::Add(const std::shared_ptr<RangeMarker>& spMarker)
+{
+    if (spMarker->m_tableSlot >= 0)
+    {
+        return;
+    }
+
+    if (!spMarker->m_enabled)
     {
-        auto itrEnd = itrStart + long(str.size());
-        if (itrEnd.Index() <= (GetRange().first + 1))
+        spMarker->m_tableSlot = int64_t(m_pinned.size());
+        spMarker->m_tablePinned = true;
+        m_pinned.push_back(spMarker);
+        return;
+    }
+
+    spMarker->m_tableSlot = int64_t(m_pending.size());
+    spMarker->m_tablePending = true;
+    m_pending.push_back(spMarker);
+}
+
+void RangeMarkerTable::Remove(RangeMarker& marker)
+{
+    if (marker.m_tableSlot < 0)
+    {
+        return;
+    }
+
+    if (marker.m_tablePending)
+    {
+        Unlist(m_pending, marker);
+        marker.m_tablePending = false;
+        return;
+    }
+
+    if (marker.m_tablePinned)
+    {
+        Unlist(m_pinned, marker);
+        marker.m_tablePinned = false;
+        return;
+    }
+
+    std::vector<std::shared_ptr<RangeMarker>> removed;
+    Kill(size_t(marker.m_tableSlot), nullptr, removed);
+}
+
+// Take a marker out of an unordered list, moving the last one into its slot
+void RangeMarkerTable::Unlist(std::vector<std::shared_ptr<RangeMarker>>& markers, RangeMarker& marker)
+{
+    auto slot = size_t(marker.m_tableSlot);
+    std::swap(markers[slot], markers.back());
+    markers[slot]->m_tableSlot = int64_t(slot);
+    markers.pop_back();
+    marker.m_tableSlot = -1;
+}
+
+void RangeMarkerTable::Clear()
+{
+    // The markers may outlive us; leave them where they were
+    for (size_t index = 0; index < m_entries.size(); index++)
+    {
+        if (m_entries[index])
         {
-            auto distance = itrEnd.Index() - itrStart.Index();
-            auto currentRange = GetRange();
-            SetRange(ByteRange(currentRange.first + distance, currentRange.second + distance));
+            m_entries[index]->m_range = GetRange(*m_entries[index]);
+            m_entries[index]->m_tableSlot = -1;
         }
-        else
+    }
+
+    for (auto& spMarker : m_pending)
+    {
+        spMarker->m_tableSlot = -1;
+        spMarker->m_tablePending = false;
+    }
+
+    for (auto& spMarker : m_pinned)
+    {
+        spMarker->m_tableSlot = -1;
+        spMarker->m_tablePinned = false;
+    }
+
+    m_entries.clear();
+    m_nodes.clear();
+    m_pending.clear();
+    m_pinned.clear();
+    m_deadCount = 0;
+}
+
+uint64_t RangeMarkerTable::GetMemoryUsage() const
+{
+    uint64_t bytes = memory_vector_bytes(m_entries) + memory_vector_bytes(m_nodes) + memory_vector_bytes(m_pending) + memory_vector_bytes(m_pinned);
+
+    // Shared with whoever else holds the markers, but they are here for this buffer
+    auto addMarker = [&](const std::shared_ptr<RangeMarker>& spMarker) {
+        if (spMarker)
+        {
+            bytes += sizeof(RangeMarker) + memory_string_bytes(spMarker->GetName()) + memory_string_bytes(spMarker->GetDescription());
+        }
+    };
+    std::for_each(m_entries.begin(), m_entries.end(), addMarker);
+    std::for_each(m_pending.begin(), m_pending.end(), addMarker);
+    std::for_each(m_pinned.begin(), m_pinned.end(), addMarker);
+    return bytes;
+}
+
+void RangeMarkerTable::Flush() const
+{
+    if (m_pending.empty() && m_deadCount * 2 <= m_entries.size())
+    {
+        return;
+    }
+    Rebuild(Gather(0));
+}
+
+// Everything in the table, where it is now; except the markers of the given types, which are let go
+std::vector<RangeMarkerTable::Item> RangeMarkerTable::Gather(uint32_t dropTypes) const
+{
+    std::vector<ByteRange> ranges;
+    ranges.reserve(m_entries.size());
+    if (!m_entries.empty())
+    {
+        Gather(1, 0, m_entries.size(), 0, ranges);
+    }
+
+    std::vector<Item> items;
+    items.reserve(m_entries.size() - m_deadCount + m_pending.size());
+    for (size_t index = 0; index < m_entries.size(); index++)
+    {
+        if (m_entries[index])
+        {
+            items.push_back(Item{ ranges[index], m_entries[index] });
+        }
+    }
+
+    for (auto& spMarker : m_pending)
+    {
+        items.push_back(Item{ spMarker->m_range, spMarker });
+    }
+
+    if (dropTypes != 0)
+    {
+        items.erase(std::remove_if(items.begin(), items.end(), [&](Item& item) {
+            if (!(item.spMarker->markerType & dropTypes) || (item.spMarker->displayType & RangeMarkerDisplayType::Timed))
+            {
+                return false;
+            }
+            item.spMarker->m_range = item.range;
+            item.spMarker->m_tableSlot = -1;
+            item.spMarker->m_tablePending = false;
+            return true;
+        }),
+            items.end());
+    }
+    return items;
+}
+
+void RangeMarkerTable::Rebuild(std::vector<Item>&& items) const
+{
+    std::stable_sort(items.begin(), items.end(), [](const Item& lhs, const Item& rhs) {
+        return lhs.range.first < rhs.range.first;
+    });
+
+    std::vector<ByteRange> ranges;
+    ranges.reserve(items.size());
+    m_entries.clear();
+    m_entries.reserve(items.size());
+    for (auto& item : items)
+    {
+        item.spMarker->m_tableSlot = int64_t(m_entries.size());
+        item.spMarker->m_tablePending = false;
+        m_entries.push_back(std::move(item.spMarker));
+        ranges.push_back(item.range);
+    }
+    m_pending.clear();
+    m_deadCount = 0;
+
+    m_nodes.assign(m_entries.size() * 4, Node());
+    if (!m_entries.empty())
+    {
+        Build(1, 0, m_entries.size(), ranges);
+    }
+}
+
+void RangeMarkerTable::Replace(uint32_t markerTypes, const std::vector<std::shared_ptr<RangeMarker>>& markers)
+{
+    auto items = Gather(markerTypes);
+
+    m_pinned.erase(std::remove_if(m_pinned.begin(), m_pinned.end(), [&](const std::shared_ptr<RangeMarker>& spMarker) {
+        if (!(spMarker->markerType & markerTypes) || (spMarker->displayType & RangeMarkerDisplayType::Timed))
         {
-            buffer.ClearRangeMarker(shared_from_this());
-            m_enabled = false;
+            return false;
         }
+        spMarker->m_tableSlot = -1;
+        spMarker->m_tablePinned = false;
+        return true;
+    }),
+        m_pinned.end());
+    for (size_t slot = 0; slot < m_pinned.size(); slot++)
+    {
+        m_pinned[slot]->m_tableSlot = int64_t(slot);
+    }
+
+    items.reserve(items.size() + markers.size());
+    for (auto& spMarker : markers)
+    {
+        if (spMarker->m_tableSlot < 0)
+        {
+            items.push_back(Item{ spMarker->m_range, spMarker });
+        }
+    }
+    Rebuild(std::move(items));
+}
+
+void RangeMarkerTable::Build(size_t node, size_t begin, size_t end, const std::vector<ByteRange>& ranges) const
+{
+    auto& current = m_nodes[node];
+    if (end - begin == 1)
+    {
+        current.minFirst = current.maxFirst = ranges[begin].first;
+        current.maxSecond = ranges[begin].second;
+        return;
+    }
+
+    auto mid = (begin + end) / 2;
+    Build(node * 2, begin, mid, ranges);
+    Build(node * 2 + 1, mid, end, ranges);
+    auto& left = m_nodes[node * 2];
+    auto& right = m_nodes[node * 2 + 1];
+    current.minFirst = left.minFirst;
+    current.maxFirst = right.maxFirst;
+    current.maxSecond = std::max(left.maxSecond, right.maxSecond);
+}
+
+void RangeMarkerTable::Gather(size_t node, size_t begin, size_t end, ByteIndex shift, std::vector<ByteRange>& ranges) const
+{
+    auto& current = m_nodes[node];
+    if (end - begin == 1)
+    {
+        ranges.push_back(ByteRange(current.minFirst + shift, current.maxSecond + shift));
+        return;
     }
+
+    auto mid = (begin + end) / 2;
+    Gather(node * 2, begin, mid, shift + current.shift, ranges);
+    Gather(node * 2 + 1, mid, end, shift + current.shift, ranges);
 }
 
-void RangeMarker::HandleBufferDelete(ZepBuffer& buffer, const GlyphIterator& itrStart, const GlyphIterator& itrEnd)
+// Node bounds include the node's own shift, but not those of the nodes above it
+void RangeMarkerTable::Update(size_t node)
 {
-    if (!m_enabled)
+    auto& current = m_nodes[node];
+    auto& left = m_nodes[node * 2];
+    auto& right = m_nodes[node * 2 + 1];
+    current.minFirst = left.minFirst + current.shift;
+    current.maxFirst = right.maxFirst + current.shift;
+    current.maxSecond = std::max(left.maxSecond, right.maxSecond) + current.shift;
+}
+
+void RangeMarkerTable::Shift(size_t node, size_t begin, size_t end, size_t from, ByteIndex delta)
+{
+    if (end <= from)
+    {
+        return;
+    }
+
+    if (begin >= from)
     {
+        auto& current = m_nodes[node];
+        current.shift += delta;
+        current.minFirst += delta;
+        current.maxFirst += delta;
+        current.maxSecond += delta;
         return;
     }
 
-    if (itrStart.Index() > GetRange().second)
+    auto mid = (begin + end) / 2;
+    Shift(node * 2, begin, mid, from, delta);
+    Shift(node * 2 + 1, mid, end, from, delta);
+    Update(node);
+}
+
+void RangeMarkerTable::Kill(size_t node, size_t begin, size_t end, size_t index, ByteIndex shift, const ByteIndex* pNewFirst)
+{
+    auto& current = m_nodes[node];
+    if (end - begin == 1)
     {
+        current.maxSecond = DeadSecond;
+        if (pNewFirst)
+        {
+            current.minFirst = current.maxFirst = *pNewFirst - shift;
+        }
         return;
     }
+
+    auto mid = (begin + end) / 2;
+    if (index < mid)
+    {
+        Kill(node * 2, begin, mid, index, shift + current.shift, pNewFirst);
+    }
     else
     {
-        ZLOG(INFO, "Range: " << itrStart.Index() << ", " << itrEnd.Index() << " : mark: " << GetRange().first);
+        Kill(node * 2 + 1, mid, end, index, shift + current.shift, pNewFirst);
+    }
+    Update(node);
+}
+
+void RangeMarkerTable::Kill(size_t index, const ByteIndex* pNewFirst, std::vector<std::shared_ptr<RangeMarker>>& removed)
+{
+    auto& spMarker = m_entries[index];
+    if (spMarker)
+    {
+        spMarker->m_range = GetRange(*spMarker);
+        spMarker->m_tableSlot = -1;
+        removed.push_back(spMarker);
+        spMarker.reset();
+        m_deadCount++;
+    }
+
+    // The shift is taken from the leaf's ancestors; the root has none
+    Kill(1, 0, m_entries.size(), index, 0, pNewFirst);
+}
 
-        // It's OK to move on the first char; since that is like a shove
-        if (itrEnd.Index() < (GetRange().first + 1))
+size_t RangeMarkerTable::FindLeaf(size_t index, ByteIndex& shift) const
+{
+    size_t node = 1;
+    size_t begin = 0;
+    size_t end = m_entries.size();
+    shift = 0;
+    while (end - begin > 1)
+    {
+        shift += m_nodes[node].shift;
+        auto mid = (begin + end) / 2;
+        if (index < mid)
         {
-            auto distance = std::min(itrEnd.Index(), GetRange().first) - itrStart.Index();
-            auto currentRange = GetRange();
-            SetRange(ByteRange(currentRange.first - distance, currentRange.second - distance));
+            node = node * 2;
+            end = mid;
         }
         else
         {
-            buffer.ClearRangeMarker(shared_from_this());
-            m_enabled = false;
+            node = node * 2 + 1;
+            begin = mid;
         }
     }
+    return node;
 }
 
-const std::string& RangeMarker::GetName() const
+ByteRange RangeMarkerTable::GetRange(const RangeMarker& marker) const
 {
-    return m_name;
+    if (marker.m_tableSlot < 0 || marker.m_tablePending || marker.m_tablePinned)
+    {
+        return marker.m_range;
+    }
+
+    ByteIndex shift = 0;
+    auto& leaf = m_nodes[FindLeaf(size_t(marker.m_tableSlot), shift)];
+    return ByteRange(leaf.minFirst + shift, leaf.maxSecond + shift);
 }
 
-const std::string& RangeMarker::GetDescription() const
+// The first entry starting at or after the position; starts are in order, dead ones included
+size_t RangeMarkerTable::LowerBound(ByteIndex position) const
 {
-    return m_description;
+    size_t node = 1;
+    size_t begin = 0;
+    size_t end = m_entries.size();
+    ByteIndex shift = 0;
+    while (end - begin > 1)
+    {
+        shift += m_nodes[node].shift;
+        auto mid = (begin + end) / 2;
+        if (m_nodes[node * 2].maxFirst + shift >= position)
+        {
+            node = node * 2;
+            end = mid;
+        }
+        else
+        {
+            node = node * 2 + 1;
+            begin = mid;
+        }
+    }
+    return (m_nodes[node].minFirst + shift >= position) ? begin : end;
 }
 
-void RangeMarker::SetName(const std::string& strName)
+void RangeMarkerTable::CollectEndingAfter(size_t node, size_t begin, size_t end, size_t before, ByteIndex position, ByteIndex shift, std::vector<size_t>& indices) const
 {
-    m_name = strName;
+    auto& current = m_nodes[node];
+    if (begin >= before || current.maxSecond + shift <= position)
+    {
+        return;
+    }
+
+    if (end - begin == 1)
+    {
+        indices.push_back(begin);
+        return;
+    }
+
+    auto mid = (begin + end) / 2;
+    CollectEndingAfter(node * 2, begin, mid, before, position, shift + current.shift, indices);
+    CollectEndingAfter(node * 2 + 1, mid, end, before, position, shift + current.shift, indices);
 }
 
-void RangeMarker::SetDescription(const std::string& strDescription)
+void RangeMarkerTable::Insert(ByteIndex at, ByteIndex length, std::vector<std::shared_ptr<RangeMarker>>& removed)
 {
-    m_description = strDescription;
+    Flush();
+    if (m_entries.empty())
+    {
+        return;
+    }
+
+    // Those starting before the insert, but still going, have had text put inside them
+    auto from = LowerBound(at);
+    std::vector<size_t> inside;
+    CollectEndingAfter(1, 0, m_entries.size(), from, at, 0, inside);
+    for (auto index : inside)
+    {
+        Kill(index, nullptr, removed);
+    }
+
+    Shift(1, 0, m_entries.size(), from, length);
 }
 
-void RangeMarker::SetEnabled(bool enabled)
+void RangeMarkerTable::Delete(ByteIndex begin, ByteIndex end, std::vector<std::shared_ptr<RangeMarker>>& removed)
 {
-    m_enabled = enabled;
+    Flush();
+    if (m_entries.empty() || begin >= end)
+    {
+        return;
+    }
+
+    auto from = LowerBound(begin);
+    auto to = LowerBound(end);
+
+    std::vector<size_t> inside;
+    CollectEndingAfter(1, 0, m_entries.size(), from, begin, 0, inside);
+    for (auto index : inside)
+    {
+        Kill(index, nullptr, removed);
+    }
+
+    // Everything starting in the deleted text goes; left at its start so the order holds after the shift
+    for (auto index = from; index < to; index++)
+    {
+        Kill(index, &begin, removed);
+    }
+
+    Shift(1, 0, m_entries.size(), to, begin - end);
 }
-    
-const NVec2f& RangeMarker::GetInlineSize() const
+
+void RangeMarkerTable::Find(ByteIndex first, ByteIndex last, std::vector<std::shared_ptr<RangeMarker>>& found) const
 {
-    return m_inlineSize;
+    Flush();
+    auto begin = found.size();
+    if (!m_entries.empty())
+    {
+        Find(1, 0, m_entries.size(), first, last, 0, found);
+    }
+
+    // The same test as the tree's, merged into start order
+    auto middle = found.size();
+    for (auto& spMarker : m_pinned)
+    {
+        auto& range = spMarker->m_range;
+        if (range.first <= last && (first == 0 || range.second > first))
+        {
+            found.push_back(spMarker);
+        }
+    }
+
+    if (middle != found.size())
+    {
+        auto byStart = [](const std::shared_ptr<RangeMarker>& lhs, const std::shared_ptr<RangeMarker>& rhs) {
+            return lhs->m_range.first < rhs->m_range.first;
+        };
+        std::sort(found.begin() + middle, found.end(), byStart);
+        for (auto itr = found.begin() + begin; itr != found.begin() + middle; itr++)
+        {
+            (*itr)->m_range = GetRange(**itr);
+        }
+        std::inplace_merge(found.begin() + begin, found.begin() + middle, found.end(), byStart);
+    }
 }
 
-void RangeMarker::SetInlineSize(const NVec2f& size)
+void RangeMarkerTable::Find(size_t node, size_t begin, size_t end, ByteIndex first, ByteIndex last, ByteIndex shift, std::vector<std::shared_ptr<RangeMarker>>& found) const
 {
-    m_inlineSize = size;
+    // Everything here starts too late, or ends too early; an inclusive range ends at least at its start
+    auto& current = m_nodes[node];
+    if (current.minFirst + shift > last || (first > 0 && current.maxSecond + shift <= first))
+    {
+        return;
+    }
+
+    if (end - begin == 1)
+    {
+        if (m_entries[begin])
+        {
+            found.push_back(m_entries[begin]);
+        }
+        return;
+    }
+
+    auto mid = (begin + end) / 2;
+    Find(node * 2, begin, mid, first, last, shift + current.shift, found);
+    Find(node * 2 + 1, mid, end, first, last, shift + current.shift, found);
 }
 
 }; // namespace Zep
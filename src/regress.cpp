@@ -48,12 +48,12 @@ void ZepRegressExCommand::Run(const std::vector<std::string>& tokens)
     m_enable = !m_enable;
     if (m_enable)
     {
-        GetEditor().RegisterCallback(this);
+        GetEditor().ScheduleTick(this, 0.0f);
         m_windowOperationCount = 150;
     }
     else
     {
-        GetEditor().UnRegisterCallback(this);
+        GetEditor().CancelTicks(this);
     }
 }
 
@@ -62,6 +62,10 @@ void ZepRegressExCommand::Notify(std::shared_ptr<ZepMessage> message)
     if (message->messageId == Msg::Tick)
     {
         Tick();
+        if (m_enable)
+        {
+            GetEditor().ScheduleTick(this, 0.05f - float(timer_get_elapsed_seconds(m_timer)));
+        }
     }
 }
 
@@ -10,14 +10,23 @@
 namespace Zep
 {
 
+namespace
+{
+// Holding a button down scrolls again after a pause, then every frame
+const float RepeatDelay = 0.5f;
+const float RepeatInterval = 1.0f / 60.0f;
+} // namespace
+
 Scroller::Scroller(ZepEditor& editor, Region& parent)
-    : ZepComponent(editor)
+    : ZepComponent(editor, ComponentMessages::Subscribed)
 {
     m_region = std::make_shared<Region>();
     m_topButtonRegion = std::make_shared<Region>();
     m_bottomButtonRegion = std::make_shared<Region>();
     m_mainRegion = std::make_shared<Region>();
 
+    GetEditor().Subscribe(this, { Msg::MouseDown, Msg::MouseUp, Msg::MouseMove });
+
     m_region->flags = RegionFlags::Expanding;
     m_topButtonRegion->flags = RegionFlags::Fixed;
     m_bottomButtonRegion->flags = RegionFlags::Fixed;
@@ -43,15 +52,18 @@ Scroller::Scroller(ZepEditor& editor, Region& parent)
 
 void Scroller::CheckState()
 {
-    if (m_scrollState == ScrollState::None)
+    if (m_scrollState == ScrollState::None || m_scrollState == ScrollState::Drag)
     {
         return;
     }
 
-    if (timer_get_elapsed_seconds(m_start_delay_timer) < 0.5f)
+    auto elapsed = float(timer_get_elapsed_seconds(m_start_delay_timer));
+    if (elapsed < RepeatDelay)
     {
+        GetEditor().ScheduleTick(this, RepeatDelay - elapsed);
         return;
     }
+    GetEditor().ScheduleTick(this, RepeatInterval);
 
     switch (m_scrollState)
     {
@@ -186,6 +198,11 @@ void Scroller::Notify(std::shared_ptr<ZepMessage> message)
                         message->handled = true;
                     }
                 }
+
+                if (m_scrollState != ScrollState::None && m_scrollState != ScrollState::Drag)
+                {
+                    GetEditor().ScheduleTick(this, RepeatDelay);
+                }
             }
             break;
         case Msg::MouseUp:
@@ -0,0 +1,941 @@
+#include <algorithm>
+#include <cctype>
+#include <cstring>
+#include <string_view>
+#include <unordered_set>
+
+#include "zep/mcommon/file/varint.h"
+#include "zep/mcommon/logger.h"
+#include "zep/mcommon/string/stringutils.h"
+
+#include "zep/filesystem.h"
+#include "zep/symbol_index.h"
+
+namespace Zep
+{
+
+namespace
+{
+const char IndexMagic[4] = { 'Z', 'S', 'Y', 'M' };
+const uint64_t IndexVersion = 1;
+
+struct Token
+{
+    std::string_view text;
+    uint32_t line = 0;
+    uint32_t column = 0;
+    bool identifier = false;
+};
+
+inline bool IsIdentifierStart(uint8_t ch)
+{
+    return (ch >= 'a' && ch <= 'z') || (ch >= 'A' && ch <= 'Z') || ch == '_' || ch == '$' || ch >= 0x80;
+}
+
+inline bool IsIdentifierChar(uint8_t ch)
+{
+    return IsIdentifierStart(ch) || (ch >= '0' && ch <= '9');
+}
+
+// Walks a file keeping track of the line and column
+struct Scanner
+{
+    const std::string& text;
+    size_t pos = 0;
+    uint32_t line = 0;
+    size_t lineStart = 0;
+
+    explicit Scanner(const std::string& t)
+        : text(t)
+    {
+    }
+
+    bool Done() const
+    {
+        return pos >= text.size();
+    }
+
+    char Peek(size_t offset = 0) const
+    {
+        return pos + offset < text.size() ? text[pos + offset] : 0;
+    }
+
+    void Advance()
+    {
+        if (text[pos++] == '\n')
+        {
+            line++;
+            lineStart = pos;
+        }
+    }
+
+    void SkipTo(char ch)
+    {
+        while (!Done() && Peek() != ch)
+        {
+            Advance();
+        }
+    }
+
+    void SkipQuoted(char quote)
+    {
+        Advance();
+        while (!Done() && Peek() != quote && Peek() != '\n')
+        {
+            if (Peek() == '\\')
+            {
+                Advance();
+                if (Done())
+                {
+                    break;
+                }
+            }
+            Advance();
+        }
+        if (!Done() && Peek() == quote)
+        {
+            Advance();
+        }
+    }
+
+    Token Make(size_t start, bool identifier) const
+    {
+        Token token;
+        token.text = std::string_view(text.data() + start, pos - start);
+        token.line = line;
+        token.column = uint32_t(start - lineStart);
+        token.identifier = identifier;
+        return token;
+    }
+};
+
+// Identifiers, and punctuation a character at a time (except '::', '->' and '&&').
+// Comments, strings and numbers are dropped; #define adds a macro symbol, and the rest of the preprocessor is skipped.
+void TokenizeC(const std::string& text, std::vector<Token>& tokens, std::vector<ParsedSymbol>& symbols)
+{
+    Scanner scan(text);
+    bool lineStart = true;
+    while (!scan.Done())
+    {
+        auto ch = uint8_t(scan.Peek());
+        if (ch == '\n')
+        {
+            scan.Advance();
+            lineStart = true;
+            continue;
+        }
+
+        if (ch == ' ' || ch == '\t' || ch == '\r' || ch == '\f' || ch == '\v')
+        {
+            scan.Advance();
+            continue;
+        }
+
+        if (ch == '/' && scan.Peek(1) == '/')
+        {
+            scan.SkipTo('\n');
+            continue;
+        }
+
+        if (ch == '/' && scan.Peek(1) == '*')
+        {
+            scan.Advance();
+            scan.Advance();
+            while (!scan.Done() && !(scan.Peek() == '*' && scan.Peek(1) == '/'))
+            {
+                scan.Advance();
+            }
+            if (!scan.Done())
+            {
+                scan.Advance();
+                scan.Advance();
+            }
+            continue;
+        }
+
+        if (ch == '#' && lineStart)
+        {
+            scan.Advance();
+            while (scan.Peek() == ' ' || scan.Peek() == '\t')
+            {
+                scan.Advance();
+            }
+
+            auto start = scan.pos;
+            while (IsIdentifierChar(uint8_t(scan.Peek())))
+            {
+                scan.Advance();
+            }
+
+            if (scan.Make(start, true).text == "define")
+            {
+                while (scan.Peek() == ' ' || scan.Peek() == '\t')
+                {
+                    scan.Advance();
+                }
+                start = scan.pos;
+                while (IsIdentifierChar(uint8_t(scan.Peek())))
+                {
+                    scan.Advance();
+                }
+                auto name = scan.Make(start, true);
+                if (!name.text.empty())
+                {
+                    symbols.push_back(ParsedSymbol{ std::string(name.text), name.line, name.column, SymbolKind::Macro });
+                }
+            }
+
+            // To the end of the directive, following line continuations
+            while (!scan.Done() && scan.Peek() != '\n')
+            {
+                if (scan.Peek() == '\\')
+                {
+                    scan.Advance();
+                    if (scan.Peek() == '\r')
+                    {
+                        scan.Advance();
+                    }
+                }
+                scan.Advance();
+            }
+            continue;
+        }
+
+        lineStart = false;
+
+        if (ch == '"' || ch == '\'')
+        {
+            scan.SkipQuoted(char(ch));
+            continue;
+        }
+
+        if (ch >= '0' && ch <= '9')
+        {
+            while (IsIdentifierChar(uint8_t(scan.Peek())) || scan.Peek() == '.' || scan.Peek() == '\'')
+            {
+                scan.Advance();
+            }
+            continue;
+        }
+
+        auto start = scan.pos;
+        if (IsIdentifierStart(ch))
+        {
+            while (IsIdentifierChar(uint8_t(scan.Peek())))
+            {
+                scan.Advance();
+            }
+
+            // Raw strings; R"delim( ... )delim"
+            auto token = scan.Make(start, true);
+            if (scan.Peek() == '"' && token.text.back() == 'R' && (token.text == "R" || token.text == "u8R" || token.text == "uR" || token.text == "UR" || token.text == "LR"))
+            {
+                scan.Advance();
+                auto delimStart = scan.pos;
+                while (!scan.Done() && scan.Peek() != '(' && scan.Peek() != '\n')
+                {
+                    scan.Advance();
+                }
+                auto end = ")" + text.substr(delimStart, scan.pos - delimStart) + "\"";
+                auto found = text.find(end, scan.pos);
+                found = (found == std::string::npos) ? text.size() : found + end.size();
+                while (scan.pos < found)
+                {
+                    scan.Advance();
+                }
+                continue;
+            }
+
+            tokens.push_back(token);
+            continue;
+        }
+
+        scan.Advance();
+        if ((ch == ':' && scan.Peek() == ':') || (ch == '-' && scan.Peek() == '>') || (ch == '&' && scan.Peek() == '&'))
+        {
+            scan.Advance();
+        }
+        tokens.push_back(scan.Make(start, false));
+    }
+}
+
+// Things that look like calls, but are not functions
+const std::unordered_set<std::string_view> NotFunctions = {
+    "if", "for", "while", "switch", "return", "sizeof", "catch", "alignof", "alignas", "decltype", "static_assert",
+    "defined", "new", "delete", "throw", "noexcept", "typeid", "do", "else", "case", "operator", "co_return",
+    "co_await", "co_yield", "__attribute__", "__declspec", "requires"
+};
+
+// Words that can't come before the name of a function definition
+const std::unordered_set<std::string_view> NotBeforeFunctions = {
+    "return", "else", "case", "new", "delete", "throw", "goto", "co_return", "co_await", "co_yield", "typedef", "using"
+};
+
+// Things that can follow the parameter list of a function definition
+const std::unordered_set<std::string_view> FunctionQualifiers = {
+    "const", "volatile", "noexcept", "override", "final", "throw", "try", "mutable"
+};
+
+size_t SkipBalanced(const std::vector<Token>& tokens, size_t i)
+{
+    // tokens[i] is the opening '('; returns the index after the matching ')'
+    int depth = 0;
+    for (; i < tokens.size(); i++)
+    {
+        auto& text = tokens[i].text;
+        if (text == "(")
+        {
+            depth++;
+        }
+        else if (text == ")" && --depth == 0)
+        {
+            return i + 1;
+        }
+        else if (text == "{" || text == "}" || text == ";")
+        {
+            // Unbalanced; give up at the statement
+            return i;
+        }
+    }
+    return i;
+}
+
+void FindCSymbols(const std::vector<Token>& tokens, std::vector<ParsedSymbol>& symbols)
+{
+    auto count = tokens.size();
+    auto text = [&](size_t i) {
+        return i < count ? tokens[i].text : std::string_view();
+    };
+    auto add = [&](size_t i, SymbolKind kind) {
+        symbols.push_back(ParsedSymbol{ std::string(tokens[i].text), tokens[i].line, tokens[i].column, kind });
+    };
+
+    for (size_t i = 0; i < count; i++)
+    {
+        auto& token = tokens[i];
+        if (!token.identifier)
+        {
+            continue;
+        }
+
+        if (token.text == "class" || token.text == "struct" || token.text == "union")
+        {
+            if (text(i - 1) == "enum" || text(i - 1) == "<" || text(i - 1) == ",")
+            {
+                continue;
+            }
+
+            // class ZEP_API Foo final : public Bar {
+            size_t name = 0;
+            size_t j = i + 1;
+            while (j < count)
+            {
+                if (tokens[j].identifier && tokens[j].text != "final")
+                {
+                    name = j++;
+                }
+                else if (text(j) == "(")
+                {
+                    j = SkipBalanced(tokens, j);
+                }
+                else if (text(j) == "[" || text(j) == "]" || text(j) == "::")
+                {
+                    j++;
+                }
+                else
+                {
+                    break;
+                }
+            }
+            if (name != 0 && (text(j) == "{" || text(j) == ":" || text(j) == "final"))
+            {
+                add(name, SymbolKind::Type);
+            }
+        }
+        else if (token.text == "enum")
+        {
+            auto j = i + 1;
+            if (text(j) == "class" || text(j) == "struct")
+            {
+                j++;
+            }
+            if (j < count && tokens[j].identifier && (text(j + 1) == "{" || text(j + 1) == ":"))
+            {
+                add(j, SymbolKind::Type);
+            }
+        }
+        else if (token.text == "namespace")
+        {
+            // namespace a::b {
+            auto j = i + 1;
+            while (j + 1 < count && tokens[j].identifier && text(j + 1) == "::")
+            {
+                j += 2;
+            }
+            if (j < count && tokens[j].identifier && text(j + 1) == "{")
+            {
+                add(j, SymbolKind::Namespace);
+            }
+        }
+        else if (token.text == "using")
+        {
+            if (i + 1 < count && tokens[i + 1].identifier && text(i + 2) == "=")
+            {
+                add(i + 1, SymbolKind::Type);
+            }
+        }
+        else if (token.text == "typedef")
+        {
+            // The last name before the ';', or the (*name) of a function pointer
+            size_t name = 0;
+            int braces = 0;
+            int parens = 0;
+            size_t j = i + 1;
+            for (; j < count; j++)
+            {
+                auto t = text(j);
+                if (t == "{")
+                    braces++;
+                else if (t == "}")
+                    braces--;
+                else if (t == "(")
+                    parens++;
+                else if (t == ")")
+                    parens--;
+                else if (t == ";" && braces <= 0)
+                    break;
+                else if (braces == 0 && tokens[j].identifier)
+                {
+                    if (parens == 0 || (text(j - 1) == "*" && text(j - 2) == "("))
+                    {
+                        name = j;
+                    }
+                }
+            }
+            if (name != 0)
+            {
+                add(name, SymbolKind::Type);
+            }
+            i = j;
+        }
+        else if (text(i + 1) == "(" && NotFunctions.find(token.text) == NotFunctions.end())
+        {
+            // A definition needs a type or scope in front of it; calls don't
+            if (i > 0)
+            {
+                auto& prev = tokens[i - 1];
+                if (prev.identifier)
+                {
+                    if (NotBeforeFunctions.find(prev.text) != NotBeforeFunctions.end())
+                    {
+                        continue;
+                    }
+                }
+                else if (prev.text != "::" && prev.text != "*" && prev.text != "&" && prev.text != "&&" && prev.text != ">" && prev.text != ";" && prev.text != "{" && prev.text != "}" && prev.text != ")" && prev.text != "]")
+                {
+                    continue;
+                }
+            }
+
+            auto j = SkipBalanced(tokens, i + 1);
+            while (j < count)
+            {
+                if (tokens[j].identifier && FunctionQualifiers.find(tokens[j].text) != FunctionQualifiers.end())
+                {
+                    j++;
+                    if (text(j) == "(")
+                    {
+                        j = SkipBalanced(tokens, j);
+                    }
+                }
+                else if (text(j) == "&" || text(j) == "&&")
+                {
+                    j++;
+                }
+                else if (text(j) == "->")
+                {
+                    // Trailing return type
+                    while (j < count && text(j) != "{" && text(j) != ";" && text(j) != "=")
+                    {
+                        j++;
+                    }
+                }
+                else
+                {
+                    break;
+                }
+            }
+
+            // The body, or a constructor's initializer list
+            if (text(j) == "{" || text(j) == ":")
+            {
+                add(i, SymbolKind::Function);
+            }
+        }
+    }
+}
+
+void TokenizeLisp(const std::string& text, std::vector<Token>& tokens)
+{
+    Scanner scan(text);
+    while (!scan.Done())
+    {
+        auto ch = scan.Peek();
+        if (ch == ';')
+        {
+            scan.SkipTo('\n');
+            continue;
+        }
+
+        if (ch == '#' && scan.Peek(1) == '|')
+        {
+            while (!scan.Done() && !(scan.Peek() == '|' && scan.Peek(1) == '#'))
+            {
+                scan.Advance();
+            }
+            if (!scan.Done())
+            {
+                scan.Advance();
+                scan.Advance();
+            }
+            continue;
+        }
+
+        if (ch == '"')
+        {
+            // Lisp strings can span lines
+            scan.Advance();
+            while (!scan.Done() && scan.Peek() != '"')
+            {
+                if (scan.Peek() == '\\')
+                {
+                    scan.Advance();
+                    if (scan.Done())
+                    {
+                        break;
+                    }
+                }
+                scan.Advance();
+            }
+            if (!scan.Done())
+            {
+                scan.Advance();
+            }
+            continue;
+        }
+
+        auto start = scan.pos;
+        if (ch == '(' || ch == '[' || ch == ')' || ch == ']')
+        {
+            scan.Advance();
+            tokens.push_back(scan.Make(start, false));
+            continue;
+        }
+
+        if (std::isspace((unsigned char)ch) || ch == '\'' || ch == '`' || ch == ',')
+        {
+            scan.Advance();
+            continue;
+        }
+
+        while (!scan.Done() && !std::isspace((unsigned char)scan.Peek()) && std::strchr("()[]\";'`,", scan.Peek()) == nullptr)
+        {
+            scan.Advance();
+        }
+        tokens.push_back(scan.Make(start, true));
+    }
+}
+
+void FindLispSymbols(const std::vector<Token>& tokens, std::vector<ParsedSymbol>& symbols)
+{
+    static const std::unordered_map<std::string_view, SymbolKind> definers = {
+        { "define", SymbolKind::Variable },
+        { "defun", SymbolKind::Function },
+        { "defmacro", SymbolKind::Macro },
+        { "define-macro", SymbolKind::Macro },
+        { "define-syntax", SymbolKind::Macro },
+        { "defvar", SymbolKind::Variable },
+        { "defparameter", SymbolKind::Variable },
+        { "defconstant", SymbolKind::Variable },
+        { "defstruct", SymbolKind::Type },
+        { "defclass", SymbolKind::Type },
+        { "define-record-type", SymbolKind::Type },
+        { "defgeneric", SymbolKind::Function },
+        { "defmethod", SymbolKind::Function }
+    };
+
+    for (size_t i = 0; i + 2 < tokens.size(); i++)
+    {
+        if (tokens[i].text != "(" || !tokens[i + 1].identifier)
+        {
+            continue;
+        }
+
+        auto itr = definers.find(tokens[i + 1].text);
+        if (itr == definers.end())
+        {
+            continue;
+        }
+
+        auto kind = itr->second;
+        auto name = i + 2;
+
+        // (define (fn args) ...)
+        if (tokens[name].text == "(" && name + 1 < tokens.size() && tokens[name + 1].identifier)
+        {
+            name++;
+            if (kind == SymbolKind::Variable)
+            {
+                kind = SymbolKind::Function;
+            }
+        }
+
+        if (tokens[name].identifier)
+        {
+            symbols.push_back(ParsedSymbol{ std::string(tokens[name].text), tokens[name].line, tokens[name].column, kind });
+        }
+    }
+}
+
+} // namespace
+
+SymbolLanguage SymbolIndex::GetLanguage(const ZepPath& path)
+{
+    static const std::unordered_map<std::string, SymbolLanguage> extensions = {
+        { ".c", SymbolLanguage::C },
+        { ".cc", SymbolLanguage::C },
+        { ".cpp", SymbolLanguage::C },
+        { ".cxx", SymbolLanguage::C },
+        { ".h", SymbolLanguage::C },
+        { ".hh", SymbolLanguage::C },
+        { ".hpp", SymbolLanguage::C },
+        { ".hxx", SymbolLanguage::C },
+        { ".inl", SymbolLanguage::C },
+        { ".lsp", SymbolLanguage::Lisp },
+        { ".lisp", SymbolLanguage::Lisp },
+        { ".scm", SymbolLanguage::Lisp },
+        { ".ss", SymbolLanguage::Lisp },
+        { ".el", SymbolLanguage::Lisp }
+    };
+
+    auto itr = extensions.find(string_tolower(path.extension().string()));
+    return itr == extensions.end() ? SymbolLanguage::None : itr->second;
+}
+
+void SymbolIndex::Parse(const std::string& text, SymbolLanguage language, std::vector<ParsedSymbol>& symbols)
+{
+    std::vector<Token> tokens;
+    switch (language)
+    {
+    case SymbolLanguage::C:
+        TokenizeC(text, tokens, symbols);
+        FindCSymbols(tokens, symbols);
+        break;
+    case SymbolLanguage::Lisp:
+        TokenizeLisp(text, tokens);
+        FindLispSymbols(tokens, symbols);
+        break;
+    default:
+        break;
+    }
+}
+
+void SymbolIndex::Clear()
+{
+    m_files.clear();
+    m_fileLookup.clear();
+    m_nameText.clear();
+    m_nameOffsets.assign(1, 0);
+    m_nameSymbols.assign(1, 0);
+    m_symbols.clear();
+}
+
+bool SymbolIndex::IsStale(const ZepPath& path, uint64_t modifiedTime, uint64_t size) const
+{
+    auto itr = m_fileLookup.find(path.string());
+    if (itr == m_fileLookup.end())
+    {
+        return true;
+    }
+    auto& file = m_files[itr->second];
+    return file.modifiedTime != modifiedTime || file.size != size;
+}
+
+void SymbolIndex::Update(const std::vector<ZepPath>& paths, const std::vector<ParsedSymbolFile>& parsed)
+{
+    std::unordered_map<std::string, const ParsedSymbolFile*> parsedLookup;
+    for (auto& file : parsed)
+    {
+        parsedLookup[file.path.string()] = &file;
+    }
+
+    struct PendingSymbol
+    {
+        std::string_view name;
+        SymbolEntry entry;
+    };
+
+    std::vector<SymbolFile> files;
+    std::vector<PendingSymbol> pending;
+    std::vector<uint32_t> remap(m_files.size(), uint32_t(-1));
+
+    files.reserve(paths.size());
+    for (auto& path : paths)
+    {
+        auto key = path.string();
+        auto id = uint32_t(files.size());
+
+        auto itrParsed = parsedLookup.find(key);
+        if (itrParsed != parsedLookup.end())
+        {
+            auto& file = *itrParsed->second;
+            files.push_back(SymbolFile{ file.path, file.modifiedTime, file.size });
+            for (auto& symbol : file.symbols)
+            {
+                pending.push_back(PendingSymbol{ symbol.name, SymbolEntry{ id, symbol.line, symbol.column, symbol.kind } });
+            }
+            continue;
+        }
+
+        auto itrOld = m_fileLookup.find(key);
+        if (itrOld != m_fileLookup.end() && remap[itrOld->second] == uint32_t(-1))
+        {
+            remap[itrOld->second] = id;
+            files.push_back(m_files[itrOld->second]);
+        }
+    }
+
+    // Carry over the symbols of the files we kept
+    for (uint32_t name = 0; name < uint32_t(GetNameCount()); name++)
+    {
+        std::string_view nameText(m_nameText.data() + m_nameOffsets[name], m_nameOffsets[name + 1] - m_nameOffsets[name]);
+        for (auto index = m_nameSymbols[name]; index < m_nameSymbols[name + 1]; index++)
+        {
+            auto entry = m_symbols[index];
+            if (remap[entry.file] != uint32_t(-1))
+            {
+                entry.file = remap[entry.file];
+                pending.push_back(PendingSymbol{ nameText, entry });
+            }
+        }
+    }
+
+    std::sort(pending.begin(), pending.end(), [](const PendingSymbol& lhs, const PendingSymbol& rhs) {
+        if (lhs.name != rhs.name)
+            return lhs.name < rhs.name;
+        if (lhs.entry.file != rhs.entry.file)
+            return lhs.entry.file < rhs.entry.file;
+        if (lhs.entry.line != rhs.entry.line)
+            return lhs.entry.line < rhs.entry.line;
+        return lhs.entry.column < rhs.entry.column;
+    });
+
+    // The pending names point into the old arena, so build the new one to the side
+    std::vector<char> nameText;
+    std::vector<uint32_t> nameOffsets = { 0 };
+    std::vector<uint32_t> nameSymbols = { 0 };
+    std::vector<SymbolEntry> symbols;
+    symbols.reserve(pending.size());
+    for (size_t i = 0; i < pending.size(); i++)
+    {
+        if (i == 0 || pending[i].name != pending[i - 1].name)
+        {
+            if (i != 0)
+            {
+                nameSymbols.push_back(uint32_t(symbols.size()));
+            }
+            nameText.insert(nameText.end(), pending[i].name.begin(), pending[i].name.end());
+            nameOffsets.push_back(uint32_t(nameText.size()));
+        }
+        symbols.push_back(pending[i].entry);
+    }
+    if (!symbols.empty())
+    {
+        nameSymbols.push_back(uint32_t(symbols.size()));
+    }
+
+    m_files.swap(files);
+    m_fileLookup.clear();
+    for (uint32_t id = 0; id < uint32_t(m_files.size()); id++)
+    {
+        m_fileLookup[m_files[id].path.string()] = id;
+    }
+    m_nameText.swap(nameText);
+    m_nameOffsets.swap(nameOffsets);
+    m_nameSymbols.swap(nameSymbols);
+    m_symbols.swap(symbols);
+}
+
+std::vector<SymbolDefinition> SymbolIndex::Find(const std::string& name) const
+{
+    std::vector<SymbolDefinition> definitions;
+
+    // Binary search the sorted names in the arena
+    uint32_t low = 0;
+    uint32_t high = uint32_t(GetNameCount());
+    while (low < high)
+    {
+        auto mid = low + (high - low) / 2;
+        std::string_view midText(m_nameText.data() + m_nameOffsets[mid], m_nameOffsets[mid + 1] - m_nameOffsets[mid]);
+        if (midText < name)
+        {
+            low = mid + 1;
+        }
+        else
+        {
+            high = mid;
+        }
+    }
+
+    if (low == GetNameCount() || GetName(low) != name)
+    {
+        return definitions;
+    }
+
+    for (auto index = m_nameSymbols[low]; index < m_nameSymbols[low + 1]; index++)
+    {
+        auto& entry = m_symbols[index];
+        definitions.push_back(SymbolDefinition{ m_files[entry.file].path, long(entry.line), long(entry.column), entry.kind });
+    }
+    return definitions;
+}
+
+bool SymbolIndex::Save(IZepFileSystem& fs, const ZepPath& dbPath) const
+{
+    std::string out;
+    out.append(IndexMagic, sizeof(IndexMagic));
+    write_varint(out, IndexVersion);
+
+    write_varint(out, m_files.size());
+    for (auto& file : m_files)
+    {
+        auto str = file.path.string();
+        write_varint(out, str.size());
+        out.append(str);
+        write_varint(out, file.modifiedTime);
+        write_varint(out, file.size);
+    }
+
+    // Names are sorted, so each only stores what differs from the one before
+    write_varint(out, GetNameCount());
+    std::string_view last;
+    for (uint32_t name = 0; name < uint32_t(GetNameCount()); name++)
+    {
+        std::string_view nameText(m_nameText.data() + m_nameOffsets[name], m_nameOffsets[name + 1] - m_nameOffsets[name]);
+        size_t shared = 0;
+        while (shared < last.size() && shared < nameText.size() && last[shared] == nameText[shared])
+        {
+            shared++;
+        }
+        write_varint(out, shared);
+        write_varint(out, nameText.size() - shared);
+        out.append(nameText.data() + shared, nameText.size() - shared);
+        last = nameText;
+
+        write_varint(out, m_nameSymbols[name + 1] - m_nameSymbols[name]);
+        for (auto index = m_nameSymbols[name]; index < m_nameSymbols[name + 1]; index++)
+        {
+            auto& entry = m_symbols[index];
+            write_varint(out, entry.file);
+            write_varint(out, entry.line);
+            write_varint(out, entry.column);
+            write_varint(out, uint64_t(entry.kind));
+        }
+    }
+
+    return fs.Write(dbPath, out.data(), out.size());
+}
+
+bool SymbolIndex::Load(IZepFileSystem& fs, const ZepPath& dbPath)
+{
+    Clear();
+
+    if (!fs.Exists(dbPath))
+    {
+        return false;
+    }
+
+    auto in = fs.Read(dbPath);
+    if (in.size() < sizeof(IndexMagic) || memcmp(in.data(), IndexMagic, sizeof(IndexMagic)) != 0)
+    {
+        return false;
+    }
+
+    auto fail = [&]() {
+        ZLOG(INFO, "Discarding bad symbol table: " << dbPath.string());
+        Clear();
+        return false;
+    };
+
+    size_t pos = sizeof(IndexMagic);
+    uint64_t version = 0;
+    uint64_t fileCount = 0;
+    if (!read_varint(in, pos, version) || version != IndexVersion || !read_varint(in, pos, fileCount))
+    {
+        return fail();
+    }
+
+    for (uint64_t i = 0; i < fileCount; i++)
+    {
+        uint64_t len = 0;
+        SymbolFile file;
+        if (!read_varint(in, pos, len) || pos + len > in.size())
+        {
+            return fail();
+        }
+        file.path = ZepPath(in.substr(pos, size_t(len)));
+        pos += size_t(len);
+        if (!read_varint(in, pos, file.modifiedTime) || !read_varint(in, pos, file.size))
+        {
+            return fail();
+        }
+        m_fileLookup[file.path.string()] = uint32_t(m_files.size());
+        m_files.push_back(file);
+    }
+
+    uint64_t nameCount = 0;
+    if (!read_varint(in, pos, nameCount))
+    {
+        return fail();
+    }
+
+    std::string last;
+    for (uint64_t name = 0; name < nameCount; name++)
+    {
+        uint64_t shared = 0;
+        uint64_t len = 0;
+        uint64_t count = 0;
+        if (!read_varint(in, pos, shared) || !read_varint(in, pos, len) || shared > last.size() || pos + len > in.size())
+        {
+            return fail();
+        }
+        last = last.substr(0, size_t(shared)) + in.substr(pos, size_t(len));
+        pos += size_t(len);
+
+        m_nameText.insert(m_nameText.end(), last.begin(), last.end());
+        m_nameOffsets.push_back(uint32_t(m_nameText.size()));
+
+        if (!read_varint(in, pos, count))
+        {
+            return fail();
+        }
+
+        for (uint64_t c = 0; c < count; c++)
+        {
+            uint64_t file = 0;
+            uint64_t line = 0;
+            uint64_t column = 0;
+            uint64_t kind = 0;
+            if (!read_varint(in, pos, file) || !read_varint(in, pos, line) || !read_varint(in, pos, column) || !read_varint(in, pos, kind) || file >= fileCount || kind > uint64_t(SymbolKind::Variable))
+            {
+                return fail();
+            }
+            m_symbols.push_back(SymbolEntry{ uint32_t(file), uint32_t(line), uint32_t(column), SymbolKind(kind) });
+        }
+        m_nameSymbols.push_back(uint32_t(m_symbols.size()));
+    }
+
+    return true;
+}
+
+} // namespace Zep
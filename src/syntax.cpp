@@ -4,6 +4,7 @@
 #include "zep/theme.h"
 
 #include "zep/mcommon/logger.h"
+#include "zep/mcommon/memory.h"
 #include "zep/mcommon/string/stringutils.h"
 
 #include <string>
@@ -17,14 +18,15 @@ ZepSyntax::ZepSyntax(
     const std::unordered_set<std::string>& keywords,
     const std::unordered_set<std::string>& identifiers,
     uint32_t flags)
-    : ZepComponent(buffer.GetEditor())
+    : ZepComponent(buffer.GetEditor(), ComponentMessages::Subscribed)
     , m_buffer(buffer)
     , m_keywords(keywords)
     , m_identifiers(identifiers)
-    , m_stop(false)
+    , m_syntaxTasks(buffer.GetEditor().GetThreadPool(), TaskPriority::Interactive)
     , m_flags(flags)
 {
     m_syntax.resize(m_buffer.GetWorkingBuffer().size());
+    GetEditor().Subscribe(this, Msg::Buffer, &m_buffer);
     m_adornments.push_back(std::make_shared<ZepSyntaxAdorn_RainbowBrackets>(*this, m_buffer));
 }
 
@@ -33,6 +35,31 @@ ZepSyntax::~ZepSyntax()
     Interrupt();
 }
 
+uint64_t ZepSyntax::GetMemoryUsage() const
+{
+    uint64_t bytes = memory_vector_bytes(m_syntax) + memory_vector_bytes(m_commentEntries);
+    bytes += memory_vector_bytes(m_multiCommentStarts) + memory_vector_bytes(m_multiCommentEnds);
+    for (auto& words : { &m_keywords, &m_identifiers })
+    {
+        bytes += memory_hash_bytes(*words);
+        for (auto& word : *words)
+        {
+            bytes += memory_string_bytes(word);
+        }
+    }
+    return bytes;
+}
+
+uint64_t ZepSyntax::GetAdornmentMemoryUsage() const
+{
+    uint64_t bytes = 0;
+    for (auto& spAdorn : m_adornments)
+    {
+        bytes += spAdorn->GetMemoryUsage();
+    }
+    return bytes;
+}
+
 SyntaxResult ZepSyntax::GetSyntaxAt(const GlyphIterator& offset) const
 {
     Zep::SyntaxResult result;
@@ -64,21 +91,15 @@ SyntaxResult ZepSyntax::GetSyntaxAt(const GlyphIterator& offset) const
 
 void ZepSyntax::Wait() const
 {
-    if (m_syntaxResult.valid())
-    {
-        m_syntaxResult.wait();
-    }
+    m_syntaxTasks.wait();
 }
 
 void ZepSyntax::Interrupt()
 {
-    // Stop the thread, wait for it
-    m_stop = true;
-    if (m_syntaxResult.valid())
-    {
-        m_syntaxResult.get();
-    }
-    m_stop = false;
+    // A pass that hasn't started is dropped; one that is running stops at its next check, and we only
+    // wait for that, since it writes to the syntax we are about to change
+    m_syntaxTasks.cancel();
+    m_syntaxTasks.wait();
 }
 
 void ZepSyntax::QueueUpdateSyntax(GlyphIterator startLocation, GlyphIterator endLocation)
@@ -100,11 +121,13 @@ void ZepSyntax::QueueUpdateSyntax(GlyphIterator startLocation, GlyphIterator end
     m_processedChar = std::min(long(m_processedChar), long(m_buffer.GetWorkingBuffer().size() - 1));
     m_targetChar = std::min(long(m_targetChar), long(m_buffer.GetWorkingBuffer().size() - 1));
 
-    // Have the thread update the syntax in the new region
-    // If the pool has no threads, this will end up serial
-    //m_syntaxResult = GetEditor().GetThreadPool().enqueue([=]() {
+    // Have the thread update the syntax in the new region; the display waits on it, so it goes ahead of
+    // any background work. If the pool has no threads, this will end up serial
+    m_cancel = m_syntaxTasks.token();
+    m_syntaxTasks.run([this]() {
+        TIME_SCOPE(SyntaxUpdate);
         UpdateSyntax();
-    //});
+    });
 }
 
 void ZepSyntax::Notify(std::shared_ptr<ZepMessage> spMsg)
@@ -113,10 +136,6 @@ void ZepSyntax::Notify(std::shared_ptr<ZepMessage> spMsg)
     if (spMsg->messageId == Msg::Buffer)
     {
         auto spBufferMsg = std::static_pointer_cast<BufferMessage>(spMsg);
-        if (spBufferMsg->pBuffer != &m_buffer)
-        {
-            return;
-        }
         if (spBufferMsg->type == BufferMessageType::PreBufferChange)
         {
             Interrupt();
@@ -138,6 +157,21 @@ void ZepSyntax::Notify(std::shared_ptr<ZepMessage> spMsg)
             Interrupt();
             QueueUpdateSyntax(spBufferMsg->startLocation, spBufferMsg->endLocation);
         }
+        else if (spBufferMsg->type == BufferMessageType::TextReplaced)
+        {
+            Interrupt();
+            auto oldEnd = m_syntax.begin() + spBufferMsg->oldEndLocation.Index();
+            auto growth = ByteDistance(spBufferMsg->oldEndLocation, spBufferMsg->endLocation);
+            if (growth > 0)
+            {
+                m_syntax.insert(oldEnd, growth, SyntaxData{});
+            }
+            else
+            {
+                m_syntax.erase(oldEnd + growth, oldEnd);
+            }
+            QueueUpdateSyntax(spBufferMsg->startLocation, spBufferMsg->endLocation);
+        }
     }
 }
 
@@ -199,7 +233,7 @@ void ZepSyntax::UpdateSyntax()
     // Walk the buffer updating information about syntax coloring
     while (itrCurrent != itrEnd)
     {
-        if (m_stop == true)
+        if (m_cancel.is_cancelled())
         {
             return;
         }
@@ -45,7 +45,7 @@ void ZepSyntax_Markdown::UpdateSyntax()
     // Walk backwards to previous delimiter
     while (itrCurrent != itrEnd)
     {
-        if (m_stop == true)
+        if (m_cancel.is_cancelled())
         {
             return;
         }
@@ -1,6 +1,7 @@
 #include "zep/syntax_rainbow_brackets.h"
 #include "zep/theme.h"
 
+#include "zep/mcommon/memory.h"
 #include "zep/mcommon/string/stringutils.h"
 #include "zep/mcommon/logger.h"
 
@@ -11,7 +12,7 @@ namespace Zep
 ZepSyntaxAdorn_RainbowBrackets::ZepSyntaxAdorn_RainbowBrackets(ZepSyntax& syntax, ZepBuffer& buffer)
     : ZepSyntaxAdorn(syntax, buffer)
 {
-    syntax.GetEditor().RegisterCallback(this);
+    GetEditor().Subscribe(this, Msg::Buffer, &buffer);
     
     Update(buffer.Begin(), buffer.End());
 }
@@ -26,11 +27,7 @@ void ZepSyntaxAdorn_RainbowBrackets::Notify(std::shared_ptr<ZepMessage> spMsg)
     if (spMsg->messageId == Msg::Buffer)
     {
         auto spBufferMsg = std::static_pointer_cast<BufferMessage>(spMsg);
-        if (spBufferMsg->pBuffer != &m_buffer)
-        {
-            return;
-        }
-        else if (spBufferMsg->type == BufferMessageType::TextDeleted)
+        if (spBufferMsg->type == BufferMessageType::TextDeleted)
         {
             Clear(spBufferMsg->startLocation, spBufferMsg->endLocation);
         }
@@ -44,6 +41,12 @@ void ZepSyntaxAdorn_RainbowBrackets::Notify(std::shared_ptr<ZepMessage> spMsg)
         {
             Update(spBufferMsg->startLocation, spBufferMsg->endLocation);
         }
+        else if (spBufferMsg->type == BufferMessageType::TextReplaced)
+        {
+            Clear(spBufferMsg->startLocation, spBufferMsg->oldEndLocation);
+            Insert(spBufferMsg->startLocation, spBufferMsg->endLocation);
+            Update(spBufferMsg->startLocation, spBufferMsg->endLocation);
+        }
     }
 }
 
@@ -72,6 +75,11 @@ SyntaxResult ZepSyntaxAdorn_RainbowBrackets::GetSyntaxAt(const GlyphIterator& of
     return data;
 }
 
+uint64_t ZepSyntaxAdorn_RainbowBrackets::GetMemoryUsage() const
+{
+    return memory_map_bytes(m_brackets);
+}
+
 void ZepSyntaxAdorn_RainbowBrackets::Insert(const GlyphIterator& start, const GlyphIterator& end)
 {
     // Adjust all the brackets after us by the same distance
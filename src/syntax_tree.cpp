@@ -43,7 +43,7 @@ void ZepSyntax_Tree::UpdateSyntax()
     // Walk backwards to previous delimiter
     while (itrCurrent != itrEnd)
     {
-        if (m_stop == true)
+        if (m_cancel.is_cancelled())
         {
             return;
         }
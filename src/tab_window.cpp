@@ -12,11 +12,13 @@ namespace Zep
 {
 
 ZepTabWindow::ZepTabWindow(ZepEditor& editor)
-    : ZepComponent(editor)
+    : ZepComponent(editor, ComponentMessages::Subscribed)
     , m_editor(editor)
 {
     m_spRootRegion = std::make_shared<Region>();
     m_spRootRegion->flags = RegionFlags::Expanding;
+
+    GetEditor().Subscribe(this, Msg::MouseDown);
 }
 
 ZepTabWindow::~ZepTabWindow()
@@ -4,7 +4,13 @@
 #include "zep/buffer.h"
 #include "zep/display.h"
 #include "zep/editor.h"
+#include "zep/filesystem.h"
+#include "zep/mode.h"
+#include "zep/window.h"
+
+#include <filesystem>
 #include <gtest/gtest.h>
+#include <thread>
 
 using namespace Zep;
 class BufferTest : public testing::Test
@@ -59,4 +65,558 @@ TEST_F(BufferTest, FindFirstOf)
     ASSERT_TRUE(char_index == 0 && loc.Index() == 0);
 }
 
+TEST_F(BufferTest, VirtualListPage)
+{
+    long requested = 0;
+    pBuffer->SetVirtualPage(0, 4);
+    pBuffer->SetVirtualList(100000, [&](long line) {
+        requested++;
+        return "line" + std::to_string(line);
+    });
+
+    // Only the page is built
+    ASSERT_EQ(pBuffer->GetBufferType(), BufferType::VirtualList);
+    ASSERT_EQ(requested, 4);
+    ASSERT_EQ(pBuffer->GetLineCount(), 4);
+    ASSERT_EQ(pBuffer->GetBufferText(pBuffer->Begin(), pBuffer->End()), "line0\nline1\nline2\nline3");
+
+    ASSERT_TRUE(pBuffer->SetVirtualPage(50000, 2));
+    ASSERT_EQ(pBuffer->GetBufferText(pBuffer->Begin(), pBuffer->End()), "line50000\nline50001");
+
+    // Clamped to the end of the list
+    ASSERT_TRUE(pBuffer->SetVirtualPage(200000, 2));
+    ASSERT_EQ(pBuffer->GetVirtualPageStart(), 99998);
+    ASSERT_FALSE(pBuffer->SetVirtualPage(99998, 2));
+}
+
+TEST_F(BufferTest, ReloadAppliesOnlyTheDiff)
+{
+    auto path = ZepPath((std::filesystem::temp_directory_path() / "zep_reload_test.txt").string());
+    auto write = [&](const std::string& text) {
+        spEditor->GetFileSystem().Write(path, text.c_str(), text.size());
+    };
+    write("one\ntwo\nthree\nfour\n");
+
+    auto pFile = spEditor->GetFileBuffer(path);
+    ASSERT_NE(pFile, nullptr);
+
+    // A marker on a line the reload doesn't touch
+    auto spMarker = std::make_shared<RangeMarker>(*pFile);
+    spMarker->SetRange(ByteRange(14, 18));
+    pFile->AddRangeMarker(spMarker);
+
+    write("zero\none\n2\nthree\nfour\n");
+    auto updates = pFile->GetUpdateCount();
+    pFile->Reload();
+    spEditor->RefreshRequired();
+
+    ASSERT_FALSE(pFile->IsReloading());
+    ASSERT_EQ(pFile->GetBufferText(pFile->Begin(), pFile->End()), "zero\none\n2\nthree\nfour\n");
+    ASSERT_FALSE(pFile->HasFileFlags(FileFlags::Dirty));
+
+    // An insert and a replace (a delete and an insert); "four" moved along with its text
+    ASSERT_EQ(pFile->GetUpdateCount() - updates, 3);
+    ASSERT_EQ(pFile->GetBufferText(GlyphIterator(pFile, spMarker->GetRange().first), GlyphIterator(pFile, spMarker->GetRange().second)), "four");
+
+    std::filesystem::remove(path.string());
+}
+
+TEST_F(BufferTest, ReloadIsUndoneInTurn)
+{
+    auto path = ZepPath((std::filesystem::temp_directory_path() / "zep_reload_undo_test.txt").string());
+    auto write = [&](const std::string& text) {
+        spEditor->GetFileSystem().Write(path, text.c_str(), text.size());
+    };
+    write("one\ntwo\n");
+
+    auto pFile = spEditor->GetFileBuffer(path);
+    ASSERT_NE(pFile, nullptr);
+    spEditor->SetDisplayRegion(NVec2f(0.0f, 0.0f), NVec2f(1024.0f, 1024.0f));
+    spEditor->GetActiveWindow()->SetBuffer(pFile);
+
+    auto pMode = pFile->GetMode();
+    for (auto ch : std::string("iAX"))
+    {
+        pMode->AddKeyPress(ch);
+    }
+    pMode->AddKeyPress(ExtKeys::ESCAPE);
+    int64_t size;
+    ASSERT_TRUE(pFile->Save(size));
+
+    write("zero\nzero\none\ntwo\n");
+    pFile->Reload();
+    spEditor->RefreshRequired();
+    ASSERT_EQ(pFile->GetBufferText(pFile->Begin(), pFile->End()), "zero\nzero\none\ntwo\n");
+
+    // The reload goes first, then the typing, each at the offsets it was made at
+    pMode->AddKeyPress('u');
+    EXPECT_EQ(pFile->GetBufferText(pFile->Begin(), pFile->End()), "AXone\ntwo\n");
+    pMode->AddKeyPress('u');
+    EXPECT_EQ(pFile->GetBufferText(pFile->Begin(), pFile->End()), "one\ntwo\n");
+    pMode->Redo();
+    pMode->Redo();
+    EXPECT_EQ(pFile->GetBufferText(pFile->Begin(), pFile->End()), "zero\nzero\none\ntwo\n");
+
+    std::filesystem::remove(path.string());
+}
+
+TEST_F(BufferTest, MarkersOnLineMatchOverlaps)
+{
+    std::string text;
+    for (int line = 0; line < 200; line++)
+    {
+        text += "line " + std::to_string(line) + " of the marker test\n";
+    }
+    pBuffer->SetText(text);
+
+    // Markers of all sizes, some spanning lines, some empty
+    std::vector<std::shared_ptr<RangeMarker>> markers;
+    uint32_t seed = 1;
+    auto next = [&]() {
+        seed = seed * 1664525 + 1013904223;
+        return long(seed >> 8);
+    };
+    for (int i = 0; i < 2000; i++)
+    {
+        auto start = next() % long(text.size());
+        auto length = (i % 10 == 0) ? next() % 200 : next() % 8;
+        auto spMarker = std::make_shared<RangeMarker>(*pBuffer);
+        spMarker->markerType = (i % 3 == 0) ? RangeMarkerType::Search : RangeMarkerType::Mark;
+        spMarker->SetRange(ByteRange(start, std::min(start + length, long(text.size()))));
+        markers.push_back(spMarker);
+    }
+
+    for (long line = 0; line < pBuffer->GetLineCount(); line++)
+    {
+        ByteRange lineRange;
+        pBuffer->GetLineOffsets(line, lineRange);
+        auto lineLast = std::max(lineRange.first, lineRange.second - 1);
+
+        std::set<std::shared_ptr<RangeMarker>> expected;
+        for (auto& spMarker : markers)
+        {
+            auto markerLast = std::max(0l, spMarker->GetRange().second - 1);
+            if ((spMarker->markerType & RangeMarkerType::Mark) && spMarker->GetRange().first <= lineLast && lineRange.first <= markerLast)
+            {
+                expected.insert(spMarker);
+            }
+        }
+
+        std::set<std::shared_ptr<RangeMarker>> found;
+        ByteIndex previous = 0;
+        for (auto& [start, markerSet] : pBuffer->GetRangeMarkersOnLine(RangeMarkerType::Mark, line))
+        {
+            ASSERT_GE(start, previous);
+            previous = start;
+            found.insert(markerSet.begin(), markerSet.end());
+        }
+        ASSERT_EQ(found, expected);
+    }
+}
+
+TEST_F(BufferTest, MarkersFollowEdits)
+{
+    std::string text;
+    for (int line = 0; line < 50; line++)
+    {
+        text += "some text on line " + std::to_string(line) + "\n";
+    }
+    pBuffer->SetText(text);
+
+    uint32_t seed = 3;
+    auto next = [&](long range) {
+        seed = seed * 1664525 + 1013904223;
+        return long(seed >> 8) % range;
+    };
+
+    // The model: markers move when the edit is before them, go when it is inside, stay when it is after
+    struct Expected
+    {
+        std::shared_ptr<RangeMarker> spMarker;
+        ByteRange range;
+        bool live = true;
+    };
+    std::vector<Expected> expected;
+    for (int i = 0; i < 500; i++)
+    {
+        auto size = long(pBuffer->GetWorkingBuffer().size() - 1);
+        auto start = next(size);
+        auto end = std::min(size, start + next(12));
+        auto spMarker = std::make_shared<RangeMarker>(*pBuffer);
+        spMarker->SetRange(ByteRange(start, end));
+        expected.push_back(Expected{ spMarker, ByteRange(start, end) });
+    }
+
+    for (int edit = 0; edit < 300; edit++)
+    {
+        auto size = long(pBuffer->GetWorkingBuffer().size() - 1);
+        ChangeRecord record;
+        if (next(2) == 0 || size < 20)
+        {
+            auto at = next(size + 1);
+            auto length = 1 + next(4);
+            pBuffer->Insert(GlyphIterator(pBuffer, at), std::string(length, 'x'), record);
+            for (auto& marker : expected)
+            {
+                if (!marker.live)
+                    continue;
+                if (at <= marker.range.first)
+                {
+                    marker.range.first += length;
+                    marker.range.second += length;
+                }
+                else if (at < marker.range.second)
+                {
+                    marker.live = false;
+                }
+            }
+        }
+        else
+        {
+            auto begin = next(size);
+            auto end = std::min(size, begin + 1 + next(6));
+            pBuffer->Delete(GlyphIterator(pBuffer, begin), GlyphIterator(pBuffer, end), record);
+            for (auto& marker : expected)
+            {
+                if (!marker.live)
+                    continue;
+                if (marker.range.first >= end)
+                {
+                    marker.range.first -= end - begin;
+                    marker.range.second -= end - begin;
+                }
+                else if (marker.range.first >= begin || marker.range.second > begin)
+                {
+                    marker.live = false;
+                }
+            }
+        }
+
+        // Some come and go as we edit
+        if (edit % 10 == 0)
+        {
+            auto& marker = expected[next(long(expected.size()))];
+            if (marker.live)
+            {
+                pBuffer->ClearRangeMarker(marker.spMarker);
+                marker.live = false;
+            }
+        }
+    }
+
+    std::set<std::shared_ptr<RangeMarker>> found;
+    pBuffer->ForEachMarker(RangeMarkerType::All, Direction::Backward, pBuffer->Begin(), pBuffer->End(), [&](const std::shared_ptr<RangeMarker>& spMarker) {
+        found.insert(spMarker);
+        return true;
+    });
+
+    for (auto& marker : expected)
+    {
+        ASSERT_EQ(found.count(marker.spMarker) != 0, marker.live);
+        if (marker.live)
+        {
+            ASSERT_EQ(marker.spMarker->GetRange().first, marker.range.first);
+            ASSERT_EQ(marker.spMarker->GetRange().second, marker.range.second);
+        }
+    }
+}
+
+TEST_F(BufferTest, DisabledMarkersIgnoreEdits)
+{
+    pBuffer->SetText("one two three four\n");
+
+    auto spMoving = std::make_shared<RangeMarker>(*pBuffer);
+    spMoving->SetRange(ByteRange(8, 13));
+    auto spPinned = std::make_shared<RangeMarker>(*pBuffer);
+    spPinned->SetRange(ByteRange(8, 13));
+    spPinned->SetEnabled(false);
+    auto spInside = std::make_shared<RangeMarker>(*pBuffer);
+    spInside->SetRange(ByteRange(14, 18));
+    spInside->SetEnabled(false);
+
+    // Before both, then inside the last
+    ChangeRecord record;
+    pBuffer->Insert(pBuffer->Begin(), "xx", record);
+    pBuffer->Delete(GlyphIterator(pBuffer, 17), GlyphIterator(pBuffer, 18), record);
+
+    ASSERT_EQ(spMoving->GetRange().first, 10);
+    ASSERT_EQ(spMoving->GetRange().second, 15);
+    ASSERT_EQ(spPinned->GetRange().first, 8);
+    ASSERT_EQ(spPinned->GetRange().second, 13);
+    ASSERT_EQ(spInside->GetRange().first, 14);
+    ASSERT_EQ(spInside->GetRange().second, 18);
+
+    // Still in the buffer, in start order
+    std::vector<std::shared_ptr<RangeMarker>> found;
+    pBuffer->ForEachMarker(RangeMarkerType::All, Direction::Forward, pBuffer->Begin(), pBuffer->End(), [&](const std::shared_ptr<RangeMarker>& spMarker) {
+        found.push_back(spMarker);
+        return true;
+    });
+    ASSERT_EQ(found, (std::vector<std::shared_ptr<RangeMarker>>{ spPinned, spMoving, spInside }));
+
+    // Enabled again, it follows edits from where it is
+    spPinned->SetEnabled(true);
+    pBuffer->Insert(pBuffer->Begin(), "y", record);
+    ASSERT_EQ(spPinned->GetRange().first, 9);
+    ASSERT_EQ(spPinned->GetRange().second, 14);
+    ASSERT_EQ(spInside->GetRange().first, 14);
+    ASSERT_EQ(spInside->GetRange().second, 18);
+
+    pBuffer->ClearRangeMarker(spInside);
+    ASSERT_EQ(pBuffer->GetRangeMarkerTable().Size(), 2u);
+}
+
+TEST_F(BufferTest, ReplaceRangeMarkersInBulk)
+{
+    std::string text(100000, 'a');
+    pBuffer->SetText(text);
+
+    auto countMarkers = [&](uint32_t types) {
+        size_t count = 0;
+        pBuffer->ForEachMarker(types, Direction::Backward, pBuffer->Begin(), pBuffer->End(), [&](const std::shared_ptr<RangeMarker>&) {
+            count++;
+            return true;
+        });
+        return count;
+    };
+
+    auto spOld = std::make_shared<RangeMarker>(*pBuffer);
+    spOld->SetRange(ByteRange(10, 20));
+    auto spSearch = std::make_shared<RangeMarker>(*pBuffer);
+    spSearch->markerType = RangeMarkerType::Search;
+    spSearch->SetRange(ByteRange(30, 40));
+    pBuffer->BeginFlash(1.0f, FlashType::Flash, GlyphRange(pBuffer->Begin(), pBuffer->Begin() + 5));
+
+    std::vector<RangeMarkerDesc> errors;
+    for (long i = 0; i < 50000; i++)
+    {
+        RangeMarkerDesc desc;
+        desc.range = ByteRange(i * 2, i * 2 + 1);
+        desc.name = "Error";
+        desc.displayType = RangeMarkerDisplayType::CompileError;
+        errors.push_back(desc);
+    }
+
+    // Replaces the old mark, but not the flash, which expires by itself, or the search marker
+    auto created = pBuffer->ReplaceRangeMarkers(RangeMarkerType::Mark, errors);
+    ASSERT_EQ(created.size(), errors.size());
+    ASSERT_EQ(countMarkers(RangeMarkerType::Mark), errors.size() + 1);
+    ASSERT_EQ(countMarkers(RangeMarkerType::Search), 1);
+    ASSERT_EQ(spOld->GetRange().first, 10);
+    ASSERT_EQ(created[100]->GetName(), "Error");
+
+    // They follow edits like any other marker
+    ChangeRecord record;
+    pBuffer->Insert(pBuffer->Begin(), "bb", record);
+    ASSERT_EQ(created[100]->GetRange().first, 202);
+    ASSERT_EQ(spSearch->GetRange().first, 32);
+
+    pBuffer->ReplaceRangeMarkers(RangeMarkerType::Mark, {});
+    ASSERT_EQ(countMarkers(RangeMarkerType::Mark), 1);
+}
+
+
+namespace
+{
+struct BufferListener : public ZepComponent
+{
+    BufferListener(ZepEditor& editor, ComponentMessages messages = ComponentMessages::Subscribed)
+        : ZepComponent(editor, messages)
+    {
+    }
+
+    void Notify(std::shared_ptr<ZepMessage> message) override
+    {
+        if (message->messageId == Msg::Buffer)
+        {
+            auto spBufferMsg = std::static_pointer_cast<BufferMessage>(message);
+            buffers.push_back(spBufferMsg->pBuffer);
+            changes.push_back(*spBufferMsg);
+        }
+        ids.push_back(message->messageId);
+        if (fnNotify)
+        {
+            fnNotify();
+        }
+    }
+
+    std::vector<ZepBuffer*> buffers;
+    std::vector<BufferMessage> changes;
+    std::vector<Msg> ids;
+    std::function<void()> fnNotify;
+};
+} // namespace
+
+TEST_F(BufferTest, MessagesGoToSubscribers)
+{
+    auto pOther = spEditor->GetEmptyBuffer("other");
+
+    BufferListener mine(*spEditor);
+    BufferListener all(*spEditor);
+    BufferListener none(*spEditor);
+    BufferListener unsubscribed(*spEditor, ComponentMessages::All);
+    spEditor->Subscribe(&mine, Msg::Buffer, pBuffer);
+    spEditor->Subscribe(&all, { Msg::Buffer, Msg::Tick });
+
+    ChangeRecord record;
+    pOther->Insert(pOther->Begin(), "a", record);
+    ASSERT_TRUE(mine.buffers.empty());
+    ASSERT_EQ(all.buffers.size(), 2);
+    ASSERT_EQ(all.buffers[0], pOther);
+
+    pBuffer->Insert(pBuffer->Begin(), "a", record);
+    ASSERT_EQ(mine.buffers.size(), 2);
+    ASSERT_EQ(mine.buffers[0], pBuffer);
+    ASSERT_EQ(all.buffers.size(), 4);
+
+    ZepMessage tick(Msg::Tick);
+    spEditor->Broadcast(tick);
+    ASSERT_EQ(all.ids.back(), Msg::Tick);
+    ASSERT_TRUE(none.ids.empty());
+
+    // A component that never asked hears everything, as they always have
+    ASSERT_EQ(unsubscribed.buffers.size(), 4);
+    ASSERT_EQ(unsubscribed.ids.back(), Msg::Tick);
+
+    // Leaving, and joining, while the message is being sent
+    BufferListener late(*spEditor);
+    mine.fnNotify = [&]() {
+        spEditor->Unsubscribe(&all);
+        spEditor->Subscribe(&late, Msg::Buffer, pBuffer);
+    };
+    pBuffer->Insert(pBuffer->Begin(), "a", record);
+    ASSERT_EQ(all.buffers.size(), 4);
+    ASSERT_EQ(late.buffers.size(), 1);
+    mine.fnNotify = nullptr;
+
+    pBuffer->Insert(pBuffer->Begin(), "a", record);
+    ASSERT_EQ(mine.buffers.size(), 6);
+    ASSERT_EQ(late.buffers.size(), 3);
+}
+
+
+TEST_F(BufferTest, BatchedChangesArriveAsOne)
+{
+    pBuffer->SetText("0123456789");
+
+    BufferListener listener(*spEditor);
+    spEditor->Subscribe(&listener, Msg::Buffer, pBuffer);
+
+    ChangeRecord record;
+    spEditor->BeginBufferChanges();
+    pBuffer->Insert(pBuffer->Begin() + 2, "ab", record);
+    pBuffer->Delete(pBuffer->Begin() + 6, pBuffer->Begin() + 8, record);
+    ASSERT_EQ(listener.changes.size(), 1);
+    ASSERT_EQ(listener.changes[0].type, BufferMessageType::PreBufferChange);
+    spEditor->EndBufferChanges();
+
+    // "2345" became "ab23"
+    ASSERT_EQ(pBuffer->GetBufferText(pBuffer->Begin(), pBuffer->End()), "01ab236789");
+    ASSERT_EQ(listener.changes.size(), 2);
+    auto& change = listener.changes[1];
+    ASSERT_EQ(change.type, BufferMessageType::TextReplaced);
+    ASSERT_EQ(change.startLocation.Index(), 2);
+    ASSERT_EQ(change.endLocation.Index(), 6);
+    ASSERT_EQ(change.oldEndLocation.Index(), 6);
+
+    // A load in the middle sends what came before it first; here, all of the old text going
+    listener.changes.clear();
+    spEditor->BeginBufferChanges();
+    pBuffer->Delete(pBuffer->Begin(), pBuffer->Begin() + 1, record);
+    pBuffer->SetText("new", true);
+    spEditor->EndBufferChanges();
+    ASSERT_EQ(listener.changes.size(), 3);
+    ASSERT_EQ(listener.changes[1].type, BufferMessageType::TextReplaced);
+    ASSERT_EQ(listener.changes[1].endLocation.Index(), 0);
+    ASSERT_EQ(listener.changes[1].oldEndLocation.Index(), 10);
+    ASSERT_EQ(listener.changes.back().type, BufferMessageType::Loaded);
+}
+
+
+TEST_F(BufferTest, ScheduledTicks)
+{
+    int wakeups = 0;
+    spEditor->SetWakeupCallback([&]() {
+        wakeups++;
+    });
+
+    BufferListener listener(*spEditor);
+    spEditor->ScheduleTick(&listener, 0.0f);
+    spEditor->RefreshRequired();
+    ASSERT_EQ(listener.ids.size(), 1);
+    ASSERT_EQ(listener.ids[0], Msg::Tick);
+
+    // Only when asked again
+    spEditor->RefreshRequired();
+    ASSERT_EQ(listener.ids.size(), 1);
+
+    bool ready = false;
+    spEditor->TickWhenReady(&listener, [&]() {
+        return ready;
+    });
+    spEditor->RefreshRequired();
+    ASSERT_EQ(listener.ids.size(), 1);
+    ready = true;
+    spEditor->RefreshRequired();
+    ASSERT_EQ(listener.ids.size(), 2);
+
+    // Nothing to do until the cursor blinks, or a refresh is asked for
+    spEditor->ScheduleTick(&listener, 60.0f);
+    auto wakeup = spEditor->GetNextWakeup();
+    ASSERT_GT(wakeup, 0.0f);
+    ASSERT_LT(wakeup, 1.0f);
+    spEditor->RequestRefresh();
+    ASSERT_EQ(spEditor->GetNextWakeup(), 0.0f);
+    ASSERT_EQ(wakeups, 1);
+
+    // Gone before its time
+    {
+        BufferListener shortLived(*spEditor);
+        spEditor->ScheduleTick(&shortLived, 0.0f);
+    }
+    spEditor->RefreshRequired();
+    ASSERT_EQ(listener.ids.size(), 2);
+}
+
+TEST_F(BufferTest, PostsRunOnTheMainThread)
+{
+    int wakeups = 0;
+    spEditor->SetWakeupCallback([&]() {
+        wakeups++;
+    });
+
+    // A result from the pool, and a second stage started from the first; both land in the same refresh
+    BufferListener listener(*spEditor);
+    std::vector<int> stages;
+    auto mainThread = std::this_thread::get_id();
+    auto pEditor = spEditor.get();
+    spEditor->GetThreadPool().enqueue([&]() {
+        pEditor->PostToMainThread(&listener, [&]() {
+            ASSERT_EQ(std::this_thread::get_id(), mainThread);
+            stages.push_back(1);
+            pEditor->GetThreadPool().enqueue([&]() {
+                pEditor->PostToMainThread(&listener, [&]() {
+                    stages.push_back(2);
+                });
+            }).wait();
+        });
+    }).wait();
+
+    ASSERT_GE(wakeups, 1);
+    ASSERT_EQ(spEditor->GetNextWakeup(), 0.0f);
+    ASSERT_TRUE(stages.empty());
+    spEditor->RefreshRequired();
+    ASSERT_EQ(stages, std::vector<int>({ 1, 2 }));
+
+    // Dropped when the owner goes away first
+    {
+        BufferListener shortLived(*spEditor);
+        spEditor->PostToMainThread(&shortLived, [&]() {
+            stages.push_back(3);
+        });
+    }
+    spEditor->RefreshRequired();
+    ASSERT_EQ(stages.size(), 2);
+}
+
 // TODO
@@ -0,0 +1,91 @@
+#include "zep/mcommon/string/fuzzy_match.h"
+
+#include <gtest/gtest.h>
+
+using namespace Zep;
+
+namespace
+{
+FuzzyArena MakeArena(const std::vector<std::string>& paths)
+{
+    FuzzyArena arena;
+    for (auto& p : paths)
+    {
+        arena.Add(p);
+    }
+    return arena;
+}
+
+std::vector<std::string> Search(const FuzzyArena& arena, const std::string& pattern, uint32_t maxResults = 10)
+{
+    std::vector<std::string> ret;
+    for (auto& match : fuzzy_search(arena, pattern, 0, arena.Size(), maxResults).matches)
+    {
+        ret.push_back(arena.Get(match.index));
+    }
+    return ret;
+}
+} // namespace
+
+TEST(FuzzyMatch, NoMatch)
+{
+    auto arena = MakeArena({ "src/buffer.cpp", "include/zep/buffer.h" });
+    ASSERT_TRUE(Search(arena, "xyz").empty());
+    ASSERT_TRUE(Search(arena, "hb").empty());
+}
+
+TEST(FuzzyMatch, LongGapStillMatches)
+{
+    // The gap costs more than the two matches earn; it is still a match
+    auto longPath = "a" + std::string(50, 'x') + "b";
+    int32_t score = 0;
+    ASSERT_TRUE(fuzzy_score(longPath.c_str(), longPath.c_str(), uint32_t(longPath.size()), "ab", 2, score));
+    ASSERT_LT(score, 0);
+
+    auto arena = MakeArena({ longPath, "ab.txt" });
+    auto result = fuzzy_search(arena, "ab", 0, arena.Size(), 10);
+    ASSERT_EQ(result.matchCount, 2u);
+    ASSERT_EQ(result.matches.size(), 2u);
+}
+
+TEST(FuzzyMatch, PrefersBoundaries)
+{
+    auto arena = MakeArena({ "src/mode_vim.cpp", "src/mcommon/file/path.cpp", "src/mode_search.cpp" });
+
+    // 'ms' as in mode_search beats the scattered match in mcommon/.../path
+    auto results = Search(arena, "msearch");
+    ASSERT_EQ(results.size(), 1u);
+    ASSERT_EQ(results[0], "src/mode_search.cpp");
+
+    results = Search(arena, "mvim");
+    ASSERT_EQ(results[0], "src/mode_vim.cpp");
+}
+
+TEST(FuzzyMatch, SmartCase)
+{
+    auto arena = MakeArena({ "src/Buffer.cpp", "src/buffer.cpp" });
+    ASSERT_EQ(Search(arena, "buffer").size(), 2u);
+    ASSERT_EQ(Search(arena, "Buffer"), std::vector<std::string>{ "src/Buffer.cpp" });
+}
+
+TEST(FuzzyMatch, TopKAcrossPartitions)
+{
+    std::vector<std::string> paths;
+    for (int i = 0; i < 100; i++)
+    {
+        paths.push_back("dir" + std::to_string(i) + "/file.txt");
+    }
+    paths.push_back("file.txt");
+    auto arena = MakeArena(paths);
+
+    std::vector<FuzzySearchResult> parts;
+    parts.push_back(fuzzy_search(arena, "file", 0, 50, 5));
+    parts.push_back(fuzzy_search(arena, "file", 50, arena.Size(), 5));
+    auto result = fuzzy_merge(parts, 5);
+
+    ASSERT_EQ(result.matchCount, 101u);
+    ASSERT_EQ(result.matches.size(), 5u);
+
+    // Shortest path wins the tie
+    ASSERT_EQ(arena.Get(result.matches[0].index), "file.txt");
+}
@@ -0,0 +1,69 @@
+#include "zep/mcommon/file/fnmatch.h"
+#include "zep/mcommon/file/glob.h"
+
+#include <gtest/gtest.h>
+
+using namespace Zep;
+
+namespace
+{
+const std::vector<std::string> IgnorePatterns = { "[Bb]uild/*", "**/[Oo]bj/**", "**/[Bb]in/**", "[Bb]uilt*", "third?party/[!a-c]*", "esc\\*aped" };
+const std::vector<std::string> IncludePatterns = { "*.cpp", "*.h", "*.lsp", "src/*/test_??.inl" };
+
+const std::vector<std::string> Paths = {
+    "main.cpp",
+    "build/main.cpp",
+    "Build",
+    "src/obj/foo.h",
+    "obj/foo.h",
+    "src/bin/x.lsp",
+    "Built.cpp",
+    "builder/a.cpp",
+    "thirdparty/d.h",
+    "third-party/b.h",
+    "third_party/z.cpp",
+    "esc*aped",
+    "escXaped",
+    "src/zep/test_01.inl",
+    "src/zep/test_001.inl",
+    "readme.md",
+    "a.cpp.bak",
+    ".cpp",
+    "dir.h/file.txt"
+};
+} // namespace
+
+// The compiled matcher must agree with fnmatch, pattern by pattern
+TEST(GlobMatcher, MatchesFnmatch)
+{
+    GlobMatcher matcher;
+    matcher.AddPatterns(IgnorePatterns, 1);
+    matcher.AddPatterns(IncludePatterns, 2);
+    matcher.Compile();
+
+    for (auto& path : Paths)
+    {
+        uint32_t expected = 0;
+        for (auto& pattern : IgnorePatterns)
+        {
+            expected |= fnmatch(pattern.c_str(), path.c_str(), 0) == 0 ? 1 : 0;
+        }
+        for (auto& pattern : IncludePatterns)
+        {
+            expected |= fnmatch(pattern.c_str(), path.c_str(), 0) == 0 ? 2 : 0;
+        }
+        EXPECT_EQ(matcher.Match(path), expected) << path;
+    }
+}
+
+TEST(GlobMatcher, Extensions)
+{
+    GlobMatcher matcher;
+    matcher.AddPatterns({ "*.cpp", "*.h" }, 1);
+    matcher.Compile();
+
+    ASSERT_EQ(matcher.Match("a/b/c.cpp"), 1u);
+    ASSERT_EQ(matcher.Match("c.h"), 1u);
+    ASSERT_EQ(matcher.Match("c.hpp"), 0u);
+    ASSERT_EQ(matcher.Match("cpp"), 0u);
+}
@@ -0,0 +1,175 @@
+#include "config_app.h"
+
+#include "zep/display.h"
+#include "zep/editor.h"
+#include "zep/filesystem.h"
+#include "zep/indexer.h"
+
+#include <filesystem>
+#include <gtest/gtest.h>
+#include <thread>
+
+using namespace Zep;
+class IndexerTest : public testing::Test
+{
+public:
+    IndexerTest()
+    {
+        spEditor = std::make_shared<ZepEditor>(new ZepDisplayNull(), ZEP_ROOT);
+        cwd = std::filesystem::current_path();
+
+        root = ZepPath((std::filesystem::temp_directory_path() / "zep_indexer_test").string());
+        std::filesystem::remove_all(root.string());
+        std::filesystem::create_directories(root.string());
+    }
+
+    ~IndexerTest()
+    {
+        // Setting the working directory changes the process's
+        std::filesystem::current_path(cwd);
+        std::filesystem::remove_all(root.string());
+    }
+
+    void WriteFile(const std::string& name)
+    {
+        std::filesystem::create_directories((root / name).parent_path().string());
+        spEditor->GetFileSystem().Write(root / name, "x", 1);
+    }
+
+public:
+    std::shared_ptr<ZepEditor> spEditor;
+    ZepPath root;
+    std::filesystem::path cwd;
+};
+
+TEST_F(IndexerTest, ParallelWalk)
+{
+    std::vector<std::string> expected;
+    for (int dir = 0; dir < 20; dir++)
+    {
+        for (int file = 0; file < 60; file++)
+        {
+            auto name = "dir" + std::to_string(dir) + "/sub/file" + std::to_string(file) + ".cpp";
+            WriteFile(name);
+            expected.push_back(name);
+        }
+        WriteFile("dir" + std::to_string(dir) + "/notes.bin");
+    }
+    WriteFile("build/ignored.cpp");
+    std::sort(expected.begin(), expected.end());
+
+    auto spProgress = std::make_shared<FileIndexProgress>();
+    auto spResult = Indexer::IndexPaths(*spEditor, root, spProgress).get();
+    ASSERT_TRUE(spResult->errors.empty());
+
+    // Sorted, ignored directories pruned, and only the included extensions
+    std::vector<std::string> found;
+    for (auto& path : spResult->paths)
+    {
+        found.push_back(path.string());
+    }
+    ASSERT_EQ(found, expected);
+    ASSERT_EQ(spResult->pathArena.Size(), expected.size());
+
+    // Every path was also streamed in a batch while the walk ran
+    size_t streamed = 0;
+    for (auto& spBatch : spProgress->batches)
+    {
+        streamed += spBatch->paths.size();
+    }
+    ASSERT_EQ(streamed, expected.size());
+}
+
+TEST_F(IndexerTest, DefaultListDirectory)
+{
+    WriteFile("a.cpp");
+    WriteFile("sub/b.cpp");
+
+    // The fallback for file systems without their own sees the same entries, and doesn't recurse
+    auto list = [&](bool fallback) {
+        auto& fs = spEditor->GetFileSystem();
+        std::vector<std::pair<std::string, bool>> entries;
+        auto fnEntry = [&](const std::string& name, bool isDirectory) {
+            entries.emplace_back(name, isDirectory);
+        };
+        if (fallback)
+        {
+            fs.IZepFileSystem::ListDirectory(root, fnEntry);
+        }
+        else
+        {
+            fs.ListDirectory(root, fnEntry);
+        }
+        std::sort(entries.begin(), entries.end());
+        return entries;
+    };
+    auto entries = list(true);
+    ASSERT_EQ(entries, list(false));
+    ASSERT_EQ(entries, (std::vector<std::pair<std::string, bool>>{ { "a.cpp", false }, { "sub", true } }));
+}
+
+#if defined(ZEP_FEATURE_FILE_WATCHER) && defined(__linux__)
+TEST_F(IndexerTest, WatchDirectory)
+{
+    auto& fs = spEditor->GetFileSystem();
+    ASSERT_TRUE(fs.WatchDirectory(root));
+
+    WriteFile("watched.cpp");
+    std::filesystem::create_directories((root / "newdir").string());
+    std::filesystem::remove((root / "watched.cpp").string());
+
+    std::vector<ZepFileEvent> events;
+    fs.PollFileEvents(events);
+
+    // Written and closed, a new directory, then the delete; in order
+    std::vector<std::pair<std::string, ZepFileChange>> found;
+    for (auto& event : events)
+    {
+        found.push_back(std::make_pair(event.path.filename().string(), event.change));
+    }
+
+    auto expected = std::vector<std::pair<std::string, ZepFileChange>>{
+        { "watched.cpp", ZepFileChange::Created },
+        { "watched.cpp", ZepFileChange::Modified },
+        { "newdir", ZepFileChange::Created },
+        { "watched.cpp", ZepFileChange::Deleted }
+    };
+    ASSERT_EQ(found, expected);
+    ASSERT_TRUE(events[2].isDirectory);
+}
+
+TEST_F(IndexerTest, EventUpdatesKeepSearchCurrent)
+{
+    std::filesystem::create_directories((root / ".git").string());
+    auto write = [&](const std::string& name, const std::string& text) {
+        spEditor->GetFileSystem().Write(root / name, text.c_str(), text.size());
+    };
+    write("a.cpp", "int Alpha;\n");
+    spEditor->GetFileSystem().SetWorkingDirectory(root);
+
+    Indexer indexer(*spEditor);
+    ASSERT_TRUE(indexer.StartIndexing());
+    auto waitFor = [&](const std::string& query, size_t count) {
+        for (int i = 0; i < 500 && indexer.Search(query, false).size() != count; i++)
+        {
+            std::this_thread::sleep_for(std::chrono::milliseconds(10));
+            spEditor->RefreshRequired();
+        }
+        return indexer.Search(query, false).size() == count;
+    };
+    ASSERT_TRUE(waitFor("Alpha", 1));
+
+    // Each update after the first starts from the index before last, which has to catch up on the files it missed
+    write("b.cpp", "int Beta;\n");
+    ASSERT_TRUE(waitFor("Beta", 1));
+    write("c.cpp", "int Gamma;\n");
+    ASSERT_TRUE(waitFor("Gamma", 1));
+    write("a.cpp", "int Delta;\n");
+    ASSERT_TRUE(waitFor("Delta", 1));
+    ASSERT_TRUE(waitFor("Alpha", 0));
+    ASSERT_EQ(indexer.Search("Beta", false).size(), 1u);
+    ASSERT_EQ(indexer.Search("Gamma", false).size(), 1u);
+
+    indexer.StopIndexing();
+}
+#endif
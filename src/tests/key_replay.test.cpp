@@ -0,0 +1,108 @@
+#include "config_app.h"
+
+#include "zep/buffer.h"
+#include "zep/display.h"
+#include "zep/editor.h"
+#include "zep/key_replay.h"
+#include "zep/mode.h"
+
+#include <filesystem>
+#include <gtest/gtest.h>
+#include <sstream>
+
+using namespace Zep;
+
+namespace
+{
+std::shared_ptr<ZepEditor> MakeEditor()
+{
+    auto spEditor = std::make_shared<ZepEditor>(new ZepDisplayNull(), ZEP_ROOT, ZepEditorFlags::DisableThreads);
+    spEditor->InitWithText("Test Buffer", "");
+    spEditor->SetDisplayRegion(NVec2f(0.0f, 0.0f), NVec2f(1024.0f, 1024.0f));
+    return spEditor;
+}
+
+void TypeKeys(ZepEditor& editor, const std::string& keys)
+{
+    for (auto ch : keys)
+    {
+        editor.GetActiveBuffer()->GetMode()->AddKeyPress(ch);
+    }
+}
+} // namespace
+
+TEST(KeyReplayTest, RecordSaveAndReplay)
+{
+    auto spEditor = MakeEditor();
+    TypeKeys(*spEditor, "ijunk");
+    spEditor->GetActiveBuffer()->GetMode()->AddKeyPress(ExtKeys::ESCAPE);
+
+    spEditor->StartKeyRecording();
+    TypeKeys(*spEditor, "ddihello");
+    spEditor->GetActiveBuffer()->GetMode()->AddKeyPress(ExtKeys::ESCAPE);
+    TypeKeys(*spEditor, "yyp");
+    auto spRecording = spEditor->StopKeyRecording();
+    ASSERT_NE(spRecording, nullptr);
+    EXPECT_EQ(spEditor->StopKeyRecording(), nullptr);
+
+    auto expected = spEditor->GetActiveBuffer()->GetBufferText(spEditor->GetActiveBuffer()->Begin(), spEditor->GetActiveBuffer()->End());
+    ASSERT_EQ(spRecording->keys.size(), 12u);
+    EXPECT_EQ(spRecording->keys[0].key, uint32_t('d'));
+    EXPECT_EQ(spRecording->keys[8].key, uint32_t(ExtKeys::ESCAPE));
+    EXPECT_LE(spRecording->keys[0].time, spRecording->keys[11].time);
+
+    // Through a file and back
+    auto path = ZepPath((std::filesystem::temp_directory_path() / "zep_replay_test.zkeys").string());
+    ASSERT_TRUE(spRecording->Save(spEditor->GetFileSystem(), path));
+    KeyRecording loaded;
+    ASSERT_TRUE(loaded.Load(spEditor->GetFileSystem(), path));
+    ASSERT_EQ(loaded.keys.size(), spRecording->keys.size());
+    for (size_t index = 0; index < loaded.keys.size(); index++)
+    {
+        EXPECT_EQ(loaded.keys[index].time, spRecording->keys[index].time);
+        EXPECT_EQ(loaded.keys[index].key, spRecording->keys[index].key);
+        EXPECT_EQ(loaded.keys[index].modifiers, spRecording->keys[index].modifiers);
+    }
+    std::filesystem::remove(path.string());
+
+    // The same edits on the same text
+    auto spReplay = MakeEditor();
+    TypeKeys(*spReplay, "ijunk");
+    spReplay->GetActiveBuffer()->GetMode()->AddKeyPress(ExtKeys::ESCAPE);
+
+    auto report = ReplayKeys(*spReplay, loaded);
+    auto pBuffer = spReplay->GetActiveBuffer();
+    EXPECT_EQ(pBuffer->GetBufferText(pBuffer->Begin(), pBuffer->End()), expected);
+    EXPECT_EQ(report.keys, 12u);
+    EXPECT_EQ(report.frames, 12u);
+    EXPECT_FALSE(profile_is_recording());
+
+    auto findCommand = [&](const std::string& name) {
+        return std::find_if(report.commands.begin(), report.commands.end(), [&](const ProfileTotal& total) {
+            return total.name == name;
+        });
+    };
+    ASSERT_NE(findCommand("DeleteLine"), report.commands.end());
+    EXPECT_EQ(findCommand("DeleteLine")->count, 1u);
+    EXPECT_FALSE(report.subsystems.empty());
+
+    // Timing is off again after the replay
+    TypeKeys(*spReplay, "dd");
+    EXPECT_TRUE(spReplay->GetCommandTimes().empty());
+}
+
+TEST(KeyReplayTest, ReportNamesAreEscaped)
+{
+    // Ex command scopes are the command as typed
+    ReplayReport report;
+    ProfileTotal total;
+    total.name = "say \"hi\"\\";
+    report.commands.push_back(total);
+    report.allocations[":%s/\"a\"/b/"].scopes = 1;
+
+    std::ostringstream str;
+    report.WriteJson(str);
+    auto json = str.str();
+    EXPECT_NE(json.find("\"name\": \"say \\\"hi\\\"\\\\\""), std::string::npos);
+    EXPECT_NE(json.find("\"scope\": \":%s/\\\"a\\\"/b/\""), std::string::npos);
+}
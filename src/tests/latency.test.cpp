@@ -0,0 +1,78 @@
+#include "config_app.h"
+
+#include "zep/display.h"
+#include "zep/editor.h"
+#include "zep/mcommon/animation/histogram.h"
+#include "zep/mode.h"
+
+#include <gtest/gtest.h>
+
+using namespace Zep;
+
+TEST(LatencyTest, HistogramPercentiles)
+{
+    LatencyHistogram histogram;
+    EXPECT_EQ(histogram.GetPercentile(0.5), 0u);
+
+    for (uint64_t value = 1; value <= 1000; value++)
+    {
+        histogram.Add(value);
+    }
+    EXPECT_EQ(histogram.GetCount(), 1000u);
+    EXPECT_EQ(histogram.GetMax(), 1000u);
+    EXPECT_DOUBLE_EQ(histogram.GetMean(), 500.5);
+
+    // Exact for small values, and within an eighth above that
+    EXPECT_EQ(histogram.GetPercentile(0.01), 10u);
+    auto p50 = histogram.GetPercentile(0.5);
+    EXPECT_GE(p50, 500u);
+    EXPECT_LE(p50, 500u + 500u / 8);
+    auto p99 = histogram.GetPercentile(0.99);
+    EXPECT_GE(p99, 990u);
+    EXPECT_LE(p99, 1000u);
+    EXPECT_EQ(histogram.GetPercentile(1.0), 1000u);
+
+    // Huge values still have a bucket
+    histogram.Add(~uint64_t(0));
+    EXPECT_EQ(histogram.GetPercentile(1.0), ~uint64_t(0));
+
+    histogram.Clear();
+    EXPECT_EQ(histogram.GetCount(), 0u);
+    EXPECT_EQ(histogram.GetMax(), 0u);
+}
+
+TEST(LatencyTest, KeysAreTimedToTheNextFrame)
+{
+    auto spEditor = std::make_shared<ZepEditor>(new ZepDisplayNull(), ZEP_ROOT, ZepEditorFlags::DisableThreads);
+    spEditor->InitWithText("Test Buffer", "");
+    spEditor->SetDisplayRegion(NVec2f(0.0f, 0.0f), NVec2f(1024.0f, 1024.0f));
+
+    // Nothing is waiting on this one
+    spEditor->Display();
+    EXPECT_EQ(spEditor->GetLatency(LatencyStage::Total).GetCount(), 0u);
+
+    auto pMode = spEditor->GetGlobalMode();
+    pMode->AddKeyPress('i');
+    pMode->AddKeyPress('a');
+    pMode->AddKeyPress('b');
+    EXPECT_EQ(spEditor->GetLatency(LatencyStage::Total).GetCount(), 0u);
+
+    spEditor->Display();
+    for (size_t stage = 0; stage < size_t(LatencyStage::Count); stage++)
+    {
+        // One sample per key, except for the frame stages
+        auto expected = (stage == size_t(LatencyStage::Layout) || stage == size_t(LatencyStage::Draw)) ? 1u : 3u;
+        EXPECT_EQ(spEditor->GetLatency(LatencyStage(stage)).GetCount(), expected) << ZepEditor::GetLatencyStageName(LatencyStage(stage));
+    }
+
+    auto& total = spEditor->GetLatency(LatencyStage::Total);
+    EXPECT_GE(total.GetMax(), spEditor->GetLatency(LatencyStage::Draw).GetMax());
+
+    // The overlay draws on top, without counting itself
+    spEditor->GetConfig().showLatency = true;
+    spEditor->Display();
+    EXPECT_EQ(total.GetCount(), 3u);
+
+    spEditor->ResetLatency();
+    EXPECT_EQ(total.GetCount(), 0u);
+}
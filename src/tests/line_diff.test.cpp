@@ -0,0 +1,135 @@
+#include "zep/mcommon/string/line_diff.h"
+
+#include <random>
+#include <string>
+
+#include <gtest/gtest.h>
+
+using namespace Zep;
+
+namespace
+{
+// Apply the hunks to the old lines; the result should be the new lines
+std::string Patch(const std::vector<std::string_view>& oldLines, const std::vector<std::string_view>& newLines, const std::vector<DiffHunk>& hunks)
+{
+    std::string result;
+    uint32_t line = 0;
+    for (auto& hunk : hunks)
+    {
+        for (; line < hunk.oldLine; line++)
+        {
+            result += oldLines[line];
+        }
+        for (uint32_t i = 0; i < hunk.newCount; i++)
+        {
+            result += newLines[hunk.newLine + i];
+        }
+        line += hunk.oldCount;
+    }
+    for (; line < oldLines.size(); line++)
+    {
+        result += oldLines[line];
+    }
+    return result;
+}
+} // namespace
+
+TEST(LineDiff, SplitKeepsNewlines)
+{
+    auto lines = diff_split_lines("a\nb\n\nc");
+    ASSERT_EQ(lines, (std::vector<std::string_view>{ "a\n", "b\n", "\n", "c" }));
+    ASSERT_TRUE(diff_split_lines("").empty());
+}
+
+TEST(LineDiff, Identical)
+{
+    auto lines = diff_split_lines("a\nb\nc\n");
+    ASSERT_TRUE(diff_lines(lines, lines).empty());
+}
+
+TEST(LineDiff, MinimalHunks)
+{
+    std::string oldText = "one\ntwo\nthree\nfour\nfive\n";
+    std::string newText = "zero\none\ntwo\n3\nfour\n";
+    auto oldLines = diff_split_lines(oldText);
+    auto newLines = diff_split_lines(newText);
+    auto hunks = diff_lines(oldLines, newLines);
+
+    // An insert at the top, a changed line, and a delete at the end
+    ASSERT_EQ(hunks.size(), 3);
+    ASSERT_EQ(hunks[0].oldLine, 0);
+    ASSERT_EQ(hunks[0].oldCount, 0);
+    ASSERT_EQ(hunks[0].newCount, 1);
+    ASSERT_EQ(hunks[1].oldLine, 2);
+    ASSERT_EQ(hunks[1].oldCount, 1);
+    ASSERT_EQ(hunks[1].newLine, 3);
+    ASSERT_EQ(hunks[1].newCount, 1);
+    ASSERT_EQ(hunks[2].oldLine, 4);
+    ASSERT_EQ(hunks[2].oldCount, 1);
+    ASSERT_EQ(hunks[2].newCount, 0);
+    ASSERT_EQ(Patch(oldLines, newLines, hunks), newText);
+}
+
+TEST(LineDiff, RandomEditsRoundTrip)
+{
+    std::mt19937 rng(7);
+    for (int round = 0; round < 200; round++)
+    {
+        // A small alphabet, so lines repeat and the diff has choices to make
+        std::vector<std::string> oldText;
+        auto size = rng() % 40;
+        for (uint32_t i = 0; i < size; i++)
+        {
+            oldText.push_back(std::string(1, char('a' + rng() % 5)) + "\n");
+        }
+
+        auto newText = oldText;
+        auto edits = rng() % 6;
+        uint32_t changed = 0;
+        for (uint32_t i = 0; i < edits; i++)
+        {
+            auto at = newText.empty() ? 0 : rng() % newText.size();
+            switch (rng() % 3)
+            {
+            case 0:
+                newText.insert(newText.begin() + at, std::string(1, char('a' + rng() % 5)) + "\n");
+                changed++;
+                break;
+            case 1:
+                if (!newText.empty())
+                {
+                    newText.erase(newText.begin() + at);
+                    changed++;
+                }
+                break;
+            default:
+                if (!newText.empty())
+                {
+                    newText[at] = "x\n";
+                    changed += 2;
+                }
+                break;
+            }
+        }
+
+        std::string oldJoined;
+        std::string newJoined;
+        for (auto& line : oldText)
+            oldJoined += line;
+        for (auto& line : newText)
+            newJoined += line;
+
+        auto oldLines = diff_split_lines(oldJoined);
+        auto newLines = diff_split_lines(newJoined);
+        auto hunks = diff_lines(oldLines, newLines);
+        ASSERT_EQ(Patch(oldLines, newLines, hunks), newJoined);
+
+        // Never more lines touched than the edits we made
+        uint32_t touched = 0;
+        for (auto& hunk : hunks)
+        {
+            touched += hunk.oldCount + hunk.newCount;
+        }
+        ASSERT_LE(touched, changed);
+    }
+}
@@ -0,0 +1,75 @@
+#include "zep/mcommon/string/lz.h"
+
+#include <gtest/gtest.h>
+
+using namespace Zep;
+
+namespace
+{
+void ExpectRoundTrip(const std::string& text)
+{
+    auto compressed = lz_compress(text);
+    std::string out;
+    ASSERT_TRUE(lz_decompress(compressed, out));
+    EXPECT_EQ(out, text);
+}
+} // namespace
+
+TEST(LzTest, RoundTrip)
+{
+    ExpectRoundTrip("");
+    ExpectRoundTrip("a");
+    ExpectRoundTrip("abcd");
+    ExpectRoundTrip("abcabcabcabcabcabc");
+    ExpectRoundTrip(std::string(100000, 'x'));
+    ExpectRoundTrip(std::string("with\0nulls\0with\0nulls\0", 22));
+
+    // No repeats at all, and long literal runs
+    std::string noise;
+    uint32_t seed = 1;
+    for (int i = 0; i < 70000; i++)
+    {
+        seed = seed * 1103515245 + 12345;
+        noise.push_back(char(seed >> 16));
+    }
+    ExpectRoundTrip(noise);
+}
+
+TEST(LzTest, SourceCompresses)
+{
+    std::string text;
+    for (int line = 0; line < 3000; line++)
+    {
+        text += "    auto value" + std::to_string(line % 37) + " = GetValue(" + std::to_string(line) + ");\n";
+    }
+    auto compressed = lz_compress(text);
+    EXPECT_LT(compressed.size(), text.size() / 3);
+
+    std::string out;
+    ASSERT_TRUE(lz_decompress(compressed, out));
+    EXPECT_EQ(out, text);
+}
+
+TEST(LzTest, DamagedStreams)
+{
+    auto compressed = lz_compress("hello hello hello hello hello world");
+    std::string out;
+
+    // Cut short anywhere, it fails rather than reading past the end
+    for (size_t size = 0; size < compressed.size(); size++)
+    {
+        EXPECT_FALSE(lz_decompress(compressed.substr(0, size), out));
+    }
+
+    // Trailing junk
+    EXPECT_FALSE(lz_decompress(compressed + "x", out));
+
+    // An offset back before the start of the output
+    std::string bad;
+    bad.push_back(char(8)); // Size
+    bad.push_back(char(0x10)); // One literal, then a match of 4
+    bad.push_back('a');
+    bad.push_back(char(5));
+    bad.push_back(char(0));
+    EXPECT_FALSE(lz_decompress(bad, out));
+}
@@ -0,0 +1,279 @@
+#include "config_app.h"
+
+#include "zep/buffer.h"
+#include "zep/display.h"
+#include "zep/editor.h"
+#include "zep/mode.h"
+#include "zep/syntax.h"
+
+#include "zep/mcommon/memory.h"
+
+#include <chrono>
+#include <filesystem>
+#include <gtest/gtest.h>
+#include <thread>
+
+using namespace Zep;
+
+namespace
+{
+const BufferMemory& FindMemory(const std::vector<BufferMemory>& usage, const ZepBuffer* pBuffer)
+{
+    auto itr = std::find_if(usage.begin(), usage.end(), [&](const BufferMemory& memory) {
+        return memory.pBuffer == pBuffer;
+    });
+    EXPECT_NE(itr, usage.end());
+    return *itr;
+}
+
+std::string BufferText(const ZepBuffer* pBuffer)
+{
+    return pBuffer->GetBufferText(pBuffer->Begin(), pBuffer->End());
+}
+
+uint64_t ResidentBytes(const ZepBuffer* pBuffer)
+{
+    BufferMemory memory;
+    pBuffer->AddMemoryUsage(memory);
+    return memory.Total();
+}
+} // namespace
+
+TEST(MemoryTest, ToString)
+{
+    EXPECT_EQ(memory_to_string(0), "0 B");
+    EXPECT_EQ(memory_to_string(1023), "1023 B");
+    EXPECT_EQ(memory_to_string(1536), "1.5 KB");
+    EXPECT_EQ(memory_to_string(uint64_t(3) << 30), "3.0 GB");
+}
+
+TEST(MemoryTest, BuffersAreReportedBiggestFirst)
+{
+    auto spEditor = std::make_shared<ZepEditor>(new ZepDisplayNull(), ZEP_ROOT, ZepEditorFlags::DisableThreads);
+    spEditor->SetDisplayRegion(NVec2f(0.0f, 0.0f), NVec2f(1024.0f, 1024.0f));
+
+    std::string text;
+    for (int line = 0; line < 2000; line++)
+    {
+        text += "int main() { return " + std::to_string(line) + "; }\n";
+    }
+    auto pSmall = spEditor->InitWithText("small.cpp", "int x;\n");
+    auto pBig = spEditor->GetEmptyBuffer("big.cpp");
+    pBig->SetText(text);
+
+    auto usage = spEditor->GetMemoryUsage();
+    ASSERT_GE(usage.size(), 2u);
+    EXPECT_EQ(usage[0].pBuffer, pBig);
+    for (size_t index = 1; index < usage.size(); index++)
+    {
+        EXPECT_GE(usage[index - 1].Total(), usage[index].Total());
+    }
+
+    auto& big = FindMemory(usage, pBig);
+    EXPECT_EQ(big.text, pBig->GetWorkingBuffer().size());
+    EXPECT_GE(big.lineEnds, 2000 * sizeof(ByteIndex));
+    EXPECT_GE(big.syntax, pBig->GetWorkingBuffer().size() * sizeof(SyntaxData));
+    EXPECT_GT(big.adornments, 0u);
+    EXPECT_EQ(big.windows, 0u);
+    EXPECT_EQ(big.undo, 0u);
+
+    // Only the shown buffer has line spans
+    spEditor->Display();
+    usage = spEditor->GetMemoryUsage();
+    EXPECT_GT(FindMemory(usage, pSmall).windows, 0u);
+    EXPECT_EQ(FindMemory(usage, pBig).windows, 0u);
+
+    // Edits are counted against the buffer they were made in, then move to the redo side
+    auto pMode = pSmall->GetMode();
+    for (auto ch : std::string("ihello world"))
+    {
+        pMode->AddKeyPress(ch);
+    }
+    pMode->AddKeyPress(ExtKeys::ESCAPE);
+    usage = spEditor->GetMemoryUsage();
+    auto undo = FindMemory(usage, pSmall).undo;
+    EXPECT_GT(undo, 0u);
+    EXPECT_EQ(FindMemory(usage, pSmall).redo, 0u);
+    EXPECT_EQ(FindMemory(usage, pBig).undo, 0u);
+
+    pMode->AddKeyPress('u');
+    usage = spEditor->GetMemoryUsage();
+    EXPECT_LT(FindMemory(usage, pSmall).undo, undo);
+    EXPECT_GT(FindMemory(usage, pSmall).redo, 0u);
+}
+
+TEST(MemoryTest, TypingAllocations)
+{
+    // The test program has the hooks in
+    ASSERT_TRUE(memory_hooks_installed());
+
+    auto spEditor = std::make_shared<ZepEditor>(new ZepDisplayNull(), ZEP_ROOT, ZepEditorFlags::DisableThreads);
+    auto pBuffer = spEditor->InitWithText("test.cpp", "int main()\n{\n}\n");
+    spEditor->SetDisplayRegion(NVec2f(0.0f, 0.0f), NVec2f(1024.0f, 1024.0f));
+    auto pMode = pBuffer->GetMode();
+
+    // The first keys and frames set things up
+    pMode->AddKeyPress('i');
+    for (auto ch : std::string("warm up "))
+    {
+        pMode->AddKeyPress(ch);
+        spEditor->Display();
+    }
+    spEditor->ResetAllocations();
+
+    // No 'j': the insert map waits on it for "jk"
+    const std::string typed = "abcdefgh";
+    for (auto ch : typed)
+    {
+        pMode->AddKeyPress(ch);
+        spEditor->Display();
+    }
+
+    // About 40 and 55 when this was written
+    auto& key = spEditor->GetAllocations().at("key");
+    EXPECT_EQ(key.scopes, typed.size());
+    EXPECT_GT(key.allocs, 0u);
+    EXPECT_LT(key.maxAllocs, 64u);
+
+    auto& frame = spEditor->GetAllocations().at("frame");
+    EXPECT_EQ(frame.scopes, typed.size());
+    EXPECT_LT(frame.maxAllocs, 128u);
+
+    // Ex commands by name
+    pMode->AddKeyPress(ExtKeys::ESCAPE);
+    for (auto ch : std::string(":ZMem"))
+    {
+        pMode->AddKeyPress(ch);
+    }
+    pMode->AddKeyPress(ExtKeys::RETURN);
+    ASSERT_EQ(spEditor->GetAllocations().count(":ZMem"), 1u);
+    EXPECT_EQ(spEditor->GetAllocations().at(":ZMem").scopes, 1u);
+
+    spEditor->ResetAllocations();
+    EXPECT_TRUE(spEditor->GetAllocations().empty());
+}
+
+TEST(MemoryTest, HibernateAndWake)
+{
+    auto spEditor = std::make_shared<ZepEditor>(new ZepDisplayNull(), ZEP_ROOT, ZepEditorFlags::DisableThreads);
+    spEditor->SetDisplayRegion(NVec2f(0.0f, 0.0f), NVec2f(1024.0f, 1024.0f));
+    auto pShown = spEditor->InitWithText("shown.cpp", "int x;\n");
+
+    std::string text;
+    for (int line = 0; line < 2000; line++)
+    {
+        text += "int main() { return " + std::to_string(line) + "; }\n";
+    }
+
+    // Clean, from a file
+    auto path = ZepPath((std::filesystem::temp_directory_path() / "zep_hibernate_test.cpp").string());
+    ASSERT_TRUE(spEditor->GetFileSystem().Write(path, text.c_str(), text.size()));
+    auto pClean = spEditor->GetFileBuffer(path);
+    ASSERT_FALSE(pClean->HasFileFlags(FileFlags::Dirty));
+    ASSERT_NE(pClean->GetSyntax(), nullptr);
+
+    // Edited, with no file
+    auto pDirty = spEditor->GetEmptyBuffer("dirty.cpp");
+    pDirty->SetText(text);
+    ASSERT_TRUE(pDirty->HasFileFlags(FileFlags::Dirty));
+    auto dirtyBytes = ResidentBytes(pDirty);
+
+    EXPECT_FALSE(pShown->Hibernate());
+    EXPECT_TRUE(pClean->Hibernate());
+    EXPECT_TRUE(pDirty->Hibernate());
+    EXPECT_FALSE(pDirty->Hibernate());
+
+    // The clean one leaves it all to the file; the other keeps its text compressed
+    auto usage = spEditor->GetMemoryUsage();
+    EXPECT_EQ(FindMemory(usage, pClean).hibernated, 0u);
+    EXPECT_EQ(FindMemory(usage, pClean).syntax, 0u);
+    EXPECT_GT(FindMemory(usage, pDirty).hibernated, 0u);
+    EXPECT_LT(FindMemory(usage, pDirty).hibernated, text.size() / 4);
+    EXPECT_LT(ResidentBytes(pDirty), dirtyBytes / 8);
+    EXPECT_EQ(pClean->GetLineCount(), 1);
+
+    auto updateCount = pDirty->GetUpdateCount();
+    pDirty->Wake();
+    EXPECT_FALSE(pDirty->IsHibernated());
+    EXPECT_EQ(BufferText(pDirty), text);
+    EXPECT_EQ(pDirty->GetLineCount(), 2001);
+    EXPECT_TRUE(pDirty->HasFileFlags(FileFlags::Dirty));
+    EXPECT_EQ(pDirty->GetUpdateCount(), updateCount);
+    ASSERT_NE(pDirty->GetSyntax(), nullptr);
+
+    // Showing it wakes it
+    spEditor->GetActiveWindow()->SetBuffer(pClean);
+    EXPECT_FALSE(pClean->IsHibernated());
+    EXPECT_EQ(BufferText(pClean), text);
+    EXPECT_FALSE(pClean->HasFileFlags(FileFlags::Dirty));
+    spEditor->Display();
+
+    // Changed on disk while it slept, it wakes to the new text
+    spEditor->GetActiveWindow()->SetBuffer(pShown);
+    EXPECT_TRUE(pClean->Hibernate());
+    std::string newText = "int changed;\n";
+    ASSERT_TRUE(spEditor->GetFileSystem().Write(path, newText.c_str(), newText.size()));
+    pClean->Wake();
+    EXPECT_EQ(BufferText(pClean), newText);
+    EXPECT_FALSE(pClean->HasFileFlags(FileFlags::Dirty | FileFlags::ChangedOnDisk));
+
+    std::filesystem::remove(path.string());
+}
+
+TEST(MemoryTest, HibernateLeastRecentlyUsed)
+{
+    auto spEditor = std::make_shared<ZepEditor>(new ZepDisplayNull(), ZEP_ROOT, ZepEditorFlags::DisableThreads);
+    spEditor->SetDisplayRegion(NVec2f(0.0f, 0.0f), NVec2f(1024.0f, 1024.0f));
+    auto pShown = spEditor->InitWithText("shown.cpp", "int x;\n");
+    auto pMode = pShown->GetMode();
+
+    std::string text;
+    for (int line = 0; line < 500; line++)
+    {
+        text += "int value = " + std::to_string(line) + ";\n";
+    }
+
+    // An edit to undo once the buffer has slept
+    pMode->AddKeyPress('i');
+    for (auto ch : std::string("hello "))
+    {
+        pMode->AddKeyPress(ch);
+    }
+    pMode->AddKeyPress(ExtKeys::ESCAPE);
+    auto edited = BufferText(pShown);
+
+    auto pOld = spEditor->GetEmptyBuffer("old.cpp");
+    pOld->SetText(text);
+    std::this_thread::sleep_for(std::chrono::milliseconds(2));
+    auto pNew = spEditor->GetEmptyBuffer("new.cpp");
+    pNew->SetText(text);
+    spEditor->GetActiveWindow()->SetBuffer(pNew);
+    std::this_thread::sleep_for(std::chrono::milliseconds(2));
+    spEditor->GetActiveWindow()->SetBuffer(pOld);
+    spEditor->GetActiveWindow()->SetBuffer(pShown);
+
+    // Just over budget; the one shown longest ago goes, and the shown one stays
+    uint64_t total = 0;
+    for (auto& memory : spEditor->GetMemoryUsage())
+    {
+        BufferMemory own;
+        memory.pBuffer->AddMemoryUsage(own);
+        total += own.Total();
+    }
+    EXPECT_EQ(spEditor->HibernateBuffers(total - 1), 1u);
+    EXPECT_TRUE(pNew->IsHibernated());
+    EXPECT_FALSE(pOld->IsHibernated());
+
+    // Without a budget, everything hidden
+    EXPECT_GE(spEditor->HibernateBuffers(0), 1u);
+    EXPECT_TRUE(pOld->IsHibernated());
+    EXPECT_FALSE(pShown->IsHibernated());
+
+    // Undo follows the text back
+    spEditor->GetActiveWindow()->SetBuffer(pOld);
+    EXPECT_TRUE(pShown->Hibernate());
+    spEditor->GetActiveWindow()->SetBuffer(pShown);
+    EXPECT_EQ(BufferText(pShown), edited);
+    pMode->AddKeyPress('u');
+    EXPECT_EQ(BufferText(pShown), "int x;\n");
+}
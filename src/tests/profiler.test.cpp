@@ -0,0 +1,129 @@
+#include "zep/mcommon/animation/profiler.h"
+
+#include <gtest/gtest.h>
+
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+using namespace Zep;
+
+namespace
+{
+std::string GetTrace()
+{
+    std::ostringstream str;
+    profile_write_trace(str);
+    return str.str();
+}
+
+size_t CountOf(const std::string& text, const std::string& find)
+{
+    size_t count = 0;
+    for (auto pos = text.find(find); pos != std::string::npos; pos = text.find(find, pos + 1))
+    {
+        count++;
+    }
+    return count;
+}
+} // namespace
+
+TEST(ProfilerTest, NestedScopesAndCounters)
+{
+    // Not recording; nothing is kept
+    {
+        TIME_SCOPE(Unrecorded);
+    }
+
+    profile_start();
+
+    // Began before the start; the end is dropped
+    profile_end("Early");
+    {
+        TIME_SCOPE(Outer);
+        {
+            TIME_SCOPE(Inner);
+            PROFILE_COUNTER(Items, 42);
+        }
+    }
+    profile_stop();
+
+    {
+        TIME_SCOPE(Stopped);
+    }
+
+    auto trace = GetTrace();
+    EXPECT_EQ(trace.find("{\"traceEvents\":["), 0u);
+    EXPECT_NE(trace.find("],\"displayTimeUnit\":\"ms\"}"), std::string::npos);
+    EXPECT_EQ(trace.find("Unrecorded"), std::string::npos);
+    EXPECT_EQ(trace.find("Early"), std::string::npos);
+    EXPECT_EQ(trace.find("Stopped"), std::string::npos);
+
+    auto outerBegin = trace.find("{\"name\":\"Outer\",\"ph\":\"B\"");
+    auto innerBegin = trace.find("{\"name\":\"Inner\",\"ph\":\"B\"");
+    auto counter = trace.find("{\"name\":\"Items\",\"ph\":\"C\"");
+    auto innerEnd = trace.find("{\"name\":\"Inner\",\"ph\":\"E\"");
+    auto outerEnd = trace.find("{\"name\":\"Outer\",\"ph\":\"E\"");
+    ASSERT_NE(outerEnd, std::string::npos);
+    EXPECT_LT(outerBegin, innerBegin);
+    EXPECT_LT(innerBegin, counter);
+    EXPECT_LT(counter, innerEnd);
+    EXPECT_LT(innerEnd, outerEnd);
+    EXPECT_NE(trace.find("\"args\":{\"value\":42}"), std::string::npos);
+}
+
+TEST(ProfilerTest, ThreadsRecordSeparately)
+{
+    const int Threads = 4;
+    const int Scopes = 1000;
+    const char* names[Threads] = { "Worker A", "Worker B", "Worker C", "Worker D" };
+
+    profile_start();
+    std::vector<std::thread> threads;
+    for (int t = 0; t < Threads; t++)
+    {
+        threads.emplace_back([&, t]() {
+            profile_set_thread_name(names[t]);
+            for (int i = 0; i < Scopes; i++)
+            {
+                TIME_SCOPE(ThreadWork);
+            }
+        });
+    }
+
+    // Reading while the threads write is allowed; we just see some of it
+    GetTrace();
+
+    for (auto& thread : threads)
+    {
+        thread.join();
+    }
+    profile_stop();
+
+    auto trace = GetTrace();
+    for (auto& name : names)
+    {
+        EXPECT_NE(trace.find(std::string("\"args\":{\"name\":\"") + name + "\"}"), std::string::npos);
+    }
+    EXPECT_EQ(CountOf(trace, "\"ThreadWork\",\"ph\":\"B\""), size_t(Threads * Scopes));
+    EXPECT_EQ(CountOf(trace, "\"ThreadWork\",\"ph\":\"E\""), size_t(Threads * Scopes));
+}
+
+TEST(ProfilerTest, RingKeepsTheNewestEvents)
+{
+    profile_start();
+    for (int i = 0; i < 100000; i++)
+    {
+        TIME_SCOPE(Wrapped);
+    }
+    profile_stop();
+
+    // The oldest are gone, but whatever is left still pairs up
+    auto trace = GetTrace();
+    auto begins = CountOf(trace, "\"Wrapped\",\"ph\":\"B\"");
+    auto ends = CountOf(trace, "\"Wrapped\",\"ph\":\"E\"");
+    EXPECT_GT(begins, 0u);
+    EXPECT_LT(begins, 100000u);
+    EXPECT_EQ(begins, ends);
+}
@@ -0,0 +1,151 @@
+#include "config_app.h"
+
+#include "zep/display.h"
+#include "zep/editor.h"
+#include "zep/filesystem.h"
+#include "zep/symbol_index.h"
+
+#include <filesystem>
+#include <gtest/gtest.h>
+
+using namespace Zep;
+class SymbolIndexTest : public testing::Test
+{
+public:
+    SymbolIndexTest()
+    {
+        spEditor = std::make_shared<ZepEditor>(new ZepDisplayNull(), ZEP_ROOT, ZepEditorFlags::DisableThreads);
+
+        root = ZepPath((std::filesystem::temp_directory_path() / "zep_symbol_test").string());
+        std::filesystem::remove_all(root.string());
+        std::filesystem::create_directories(root.string());
+    }
+
+    ~SymbolIndexTest()
+    {
+        std::filesystem::remove_all(root.string());
+    }
+
+    std::vector<std::string> Parse(const std::string& text, SymbolLanguage language)
+    {
+        std::vector<ParsedSymbol> symbols;
+        SymbolIndex::Parse(text, language, symbols);
+
+        std::vector<std::string> names;
+        for (auto& symbol : symbols)
+        {
+            names.push_back(symbol.name);
+        }
+        std::sort(names.begin(), names.end());
+        return names;
+    }
+
+public:
+    std::shared_ptr<ZepEditor> spEditor;
+    ZepPath root;
+};
+
+TEST_F(SymbolIndexTest, ParseC)
+{
+    auto names = Parse(R"(
+#define MAX_SIZE 10
+namespace Zep {
+class ZEP_API Buffer final : public Base
+{
+    Buffer() : m_size(MAX_SIZE) {}
+    int Size() const { return Length(m_size); }
+    void Declared(int a);
+};
+enum class Mode : int { A, B };
+typedef void (*fnCallback)(int);
+using Callback = std::function<void()>;
+// int Commented() {}
+static const char* str = "int Quoted() {}";
+void Buffer::Insert(const std::string& s)
+{
+    if (s.empty()) { return; }
+    auto fn = [&](int x) { Call(x); };
+    while (Next(s)) {}
+}
+auto Trailing() -> int
+{
+    return 0;
+}
+}
+)",
+        SymbolLanguage::C);
+
+    std::vector<std::string> expected = { "Buffer", "Buffer", "Callback", "Insert", "MAX_SIZE", "Mode", "Size", "Trailing", "Zep", "fnCallback" };
+    ASSERT_EQ(names, expected);
+}
+
+TEST_F(SymbolIndexTest, ParseLisp)
+{
+    auto names = Parse(R"lisp(
+; (define commented 1)
+(define (square x) (* x x))
+(define answer 42)
+(defun add (a b) (+ a b))
+(defmacro my-when (c &body b) "(define quoted 1)" `(if ,c (progn ,@b)))
+(square answer)
+)lisp",
+        SymbolLanguage::Lisp);
+
+    std::vector<std::string> expected = { "add", "answer", "my-when", "square" };
+    ASSERT_EQ(names, expected);
+}
+
+TEST_F(SymbolIndexTest, UpdateFindAndPersist)
+{
+    ParsedSymbolFile a;
+    a.path = ZepPath("a.cpp");
+    a.modifiedTime = 1;
+    a.size = 10;
+    SymbolIndex::Parse("void Alpha() {}\nvoid Shared() {}\n", SymbolLanguage::C, a.symbols);
+
+    ParsedSymbolFile b;
+    b.path = ZepPath("b.cpp");
+    b.modifiedTime = 2;
+    b.size = 20;
+    SymbolIndex::Parse("\n  int Shared() { return 1; }\n", SymbolLanguage::C, b.symbols);
+
+    SymbolIndex index;
+    index.Update({ a.path, b.path }, { a, b });
+    ASSERT_EQ(index.GetFileCount(), 2);
+    ASSERT_EQ(index.GetNameCount(), 2);
+
+    auto shared = index.Find("Shared");
+    ASSERT_EQ(shared.size(), 2);
+    ASSERT_EQ(shared[1].path.string(), "b.cpp");
+    ASSERT_EQ(shared[1].line, 1);
+    ASSERT_EQ(shared[1].column, 6);
+    ASSERT_TRUE(index.Find("Missing").empty());
+
+    ASSERT_FALSE(index.IsStale(a.path, 1, 10));
+    ASSERT_TRUE(index.IsStale(a.path, 3, 10));
+    ASSERT_TRUE(index.IsStale(ZepPath("c.cpp"), 1, 10));
+
+    // Round trip
+    auto dbPath = root / "symboldb";
+    ASSERT_TRUE(index.Save(spEditor->GetFileSystem(), dbPath));
+    SymbolIndex loaded;
+    ASSERT_TRUE(loaded.Load(spEditor->GetFileSystem(), dbPath));
+    ASSERT_EQ(loaded.GetSymbolCount(), index.GetSymbolCount());
+    ASSERT_EQ(loaded.Find("Alpha").size(), 1);
+    ASSERT_EQ(loaded.Find("Shared").size(), 2);
+
+    // b.cpp changes, a.cpp goes away; unchanged files keep their symbols
+    ParsedSymbolFile c;
+    c.path = ZepPath("c.cpp");
+    SymbolIndex::Parse("struct Gamma {};\n", SymbolLanguage::C, c.symbols);
+    b.symbols.clear();
+
+    loaded.Update({ b.path, c.path }, { b });
+    ASSERT_TRUE(loaded.Find("Alpha").empty());
+    ASSERT_TRUE(loaded.Find("Shared").empty());
+    ASSERT_TRUE(loaded.Find("Gamma").empty());
+
+    loaded.Update({ b.path, c.path }, { c });
+    ASSERT_EQ(loaded.Find("Gamma").size(), 1);
+    ASSERT_EQ(loaded.GetFileCount(), 2);
+}
@@ -0,0 +1,141 @@
+#include "zep/mcommon/threadpool.h"
+
+#include <gtest/gtest.h>
+
+namespace
+{
+// Holds a worker until it is released
+struct Gate
+{
+    std::promise<void> started;
+    std::promise<void> release;
+};
+} // namespace
+
+TEST(ThreadPoolTest, HigherPriorityGoesFirst)
+{
+    // One worker for interactive work, and one for the rest
+    ThreadPool pool(2);
+
+    Gate gate;
+    auto released = gate.release.get_future().share();
+    auto blocker = pool.enqueue(TaskPriority::Idle, [&]() {
+        gate.started.set_value();
+        released.wait();
+    });
+    gate.started.get_future().wait();
+
+    std::mutex mutex;
+    std::vector<int> order;
+    auto record = [&](int id) {
+        std::lock_guard<std::mutex> lock(mutex);
+        order.push_back(id);
+    };
+
+    CancelToken token;
+    auto idle = pool.enqueue(TaskPriority::Idle, [&]() { record(0); });
+    auto normal = pool.enqueue(TaskPriority::Normal, [&]() { record(1); });
+    auto cancelled = pool.enqueue(TaskPriority::Normal, token, [&]() { record(2); });
+    token.cancel();
+
+    // Not held up by the background work
+    pool.enqueue(TaskPriority::Interactive, [&]() { record(3); }).wait();
+    ASSERT_EQ(order, std::vector<int>({ 3 }));
+
+    gate.release.set_value();
+    idle.wait();
+    normal.wait();
+    ASSERT_EQ(order, std::vector<int>({ 3, 1, 0 }));
+    ASSERT_THROW(cancelled.get(), std::future_error);
+}
+
+TEST(ThreadPoolTest, ParallelFor)
+{
+    for (size_t threads : { 1, 4 })
+    {
+        ThreadPool pool(threads);
+
+        std::vector<int> hits(1000);
+        pool.parallel_for(hits.size(), [&](size_t index) {
+            hits[index]++;
+        });
+        ASSERT_EQ(std::count(hits.begin(), hits.end(), 1), 1000);
+
+        // The caller helps, so a task can wait on one of its own
+        std::atomic<size_t> inner{ 0 };
+        pool.parallel_for(8, [&](size_t) {
+            pool.parallel_for(8, [&](size_t) {
+                inner++;
+            });
+        });
+        ASSERT_EQ(inner, 64);
+
+        std::atomic<int> done{ 0 };
+        std::atomic<size_t> count{ 0 };
+        auto future = pool.parallel_for_async(
+            100, [&](size_t) {
+                count++;
+            },
+            [&]() {
+                done++;
+                ASSERT_EQ(count, 100);
+            });
+        future.wait();
+        ASSERT_EQ(done, 1);
+
+        // Nothing to do still finishes
+        pool.parallel_for_async(0, [](size_t) {}, [&]() { done++; }).wait();
+        ASSERT_EQ(done, 2);
+    }
+}
+
+TEST(ThreadPoolTest, CancelTaskGroup)
+{
+    ThreadPool pool(2);
+
+    Gate gate;
+    auto released = gate.release.get_future().share();
+    auto blocker = pool.enqueue(TaskPriority::Normal, [&]() {
+        gate.started.set_value();
+        released.wait();
+    });
+    gate.started.get_future().wait();
+
+    // Queued behind the blocker; cancelling drops it, without waiting for a worker to get to it
+    std::atomic<int> ran{ 0 };
+    {
+        TaskGroup group(pool);
+        group.run([&]() { ran++; });
+        group.parallel_for(
+            10, [&](size_t) { ran++; }, [&]() { ran++; });
+        ASSERT_TRUE(group.is_busy());
+        group.cancel();
+        ASSERT_FALSE(group.is_busy());
+    }
+
+    // A running task is told to stop, and waited for
+    TaskGroup group(pool, TaskPriority::Interactive);
+    std::promise<void> started;
+    auto token = group.token();
+    group.run([&]() {
+        started.set_value();
+        while (!token.is_cancelled())
+        {
+            std::this_thread::yield();
+        }
+        ran += 100;
+    });
+    started.get_future().wait();
+    group.cancel();
+    group.wait();
+    ASSERT_EQ(ran, 100);
+
+    // And the group can be used again
+    group.run([&]() { ran++; });
+    group.wait();
+    ASSERT_EQ(ran, 101);
+
+    gate.release.set_value();
+    blocker.wait();
+    ASSERT_EQ(ran, 101);
+}
@@ -0,0 +1,156 @@
+#include "config_app.h"
+
+#include "zep/display.h"
+#include "zep/editor.h"
+#include "zep/filesystem.h"
+#include "zep/trigram_index.h"
+
+#include "zep/mcommon/file/varint.h"
+
+#include <filesystem>
+#include <gtest/gtest.h>
+
+using namespace Zep;
+class TrigramIndexTest : public testing::Test
+{
+public:
+    TrigramIndexTest()
+    {
+        spEditor = std::make_shared<ZepEditor>(new ZepDisplayNull(), ZEP_ROOT, ZepEditorFlags::DisableThreads);
+
+        root = ZepPath((std::filesystem::temp_directory_path() / "zep_trigram_test").string());
+        std::filesystem::remove_all(root.string());
+        std::filesystem::create_directories(root.string());
+    }
+
+    ~TrigramIndexTest()
+    {
+        std::filesystem::remove_all(root.string());
+    }
+
+    void WriteFile(const std::string& name, const std::string& text)
+    {
+        spEditor->GetFileSystem().Write(root / name, text.c_str(), text.size());
+    }
+
+public:
+    std::shared_ptr<ZepEditor> spEditor;
+    ZepPath root;
+};
+
+TEST_F(TrigramIndexTest, RequiredLiterals)
+{
+    ASSERT_EQ(TrigramIndex::GetRequiredLiterals("hello"), std::vector<std::string>{ "hello" });
+    ASSERT_EQ(TrigramIndex::GetRequiredLiterals("foo.*bar"), (std::vector<std::string>{ "foo", "bar" }));
+    ASSERT_EQ(TrigramIndex::GetRequiredLiterals("abcd?e"), (std::vector<std::string>{ "abc", "e" }));
+    ASSERT_EQ(TrigramIndex::GetRequiredLiterals("(abc)?def"), (std::vector<std::string>{ "def" }));
+    ASSERT_EQ(TrigramIndex::GetRequiredLiterals("a\\.b[xyz]+c"), (std::vector<std::string>{ "a.b", "c" }));
+    ASSERT_TRUE(TrigramIndex::GetRequiredLiterals("foo|bar").empty());
+}
+
+TEST_F(TrigramIndexTest, SearchAndUpdate)
+{
+    WriteFile("a.cpp", "int main()\n{\n    return Frobnicate();\n}\n");
+    WriteFile("b.cpp", "void other()\n{\n}\n");
+
+    std::vector<ZepPath> paths{ ZepPath("a.cpp"), ZepPath("b.cpp") };
+
+    auto& fs = spEditor->GetFileSystem();
+    TrigramIndex index;
+    ASSERT_EQ(index.Update(fs, root, paths), 2u);
+
+    auto results = index.SearchLiteral(fs, root, "Frobnicate");
+    ASSERT_EQ(results.size(), 1u);
+    ASSERT_EQ(results[0].path.string(), "a.cpp");
+    ASSERT_EQ(results[0].line, 2);
+    ASSERT_EQ(results[0].column, 11);
+
+    // Only candidate files are verified
+    ASSERT_EQ(index.GetCandidates({ "other" }).size(), 1u);
+    ASSERT_EQ(index.SearchRegex(fs, root, "vo+id\\s+oth").size(), 1u);
+
+    // Nothing changed on disk; nothing re-read
+    ASSERT_EQ(index.Update(fs, root, paths), 0u);
+
+    // Round trip through the database
+    ASSERT_TRUE(index.Save(fs, root / "indexdb"));
+    TrigramIndex loaded;
+    ASSERT_TRUE(loaded.Load(fs, root / "indexdb"));
+    ASSERT_EQ(loaded.GetLiveFileCount(), 2u);
+    ASSERT_EQ(loaded.Update(fs, root, paths), 0u);
+    ASSERT_EQ(loaded.SearchLiteral(fs, root, "Frobnicate").size(), 1u);
+
+    // A changed file is re-indexed, and old content is no longer found
+    WriteFile("a.cpp", "int main()\n{\n    return Frobnicated + 1;\n}\n");
+    ASSERT_EQ(loaded.Update(fs, root, paths), 1u);
+    ASSERT_EQ(loaded.SearchLiteral(fs, root, "Frobnicate()").size(), 0u);
+    ASSERT_EQ(loaded.SearchLiteral(fs, root, "Frobnicated").size(), 1u);
+
+    // A removed file is forgotten
+    ASSERT_EQ(loaded.Update(fs, root, { ZepPath("a.cpp") }), 0u);
+    ASSERT_EQ(loaded.GetLiveFileCount(), 1u);
+    ASSERT_TRUE(loaded.GetCandidates({ "other" }).empty());
+}
+
+TEST_F(TrigramIndexTest, DamagedDatabase)
+{
+    WriteFile("a.cpp", "int main()\n{\n    return Frobnicate();\n}\n");
+    WriteFile("b.cpp", "void other()\n{\n}\n");
+
+    auto& fs = spEditor->GetFileSystem();
+    TrigramIndex index;
+    index.Update(fs, root, { ZepPath("a.cpp"), ZepPath("b.cpp") });
+    ASSERT_TRUE(index.Save(fs, root / "indexdb"));
+    auto saved = fs.Read(root / "indexdb");
+
+    // Cut short anywhere, it is thrown away rather than thrown from
+    TrigramIndex loaded;
+    for (size_t size = 0; size < saved.size(); size++)
+    {
+        fs.Write(root / "indexdb", saved.data(), size);
+        ASSERT_FALSE(loaded.Load(fs, root / "indexdb"));
+        ASSERT_EQ(loaded.GetLiveFileCount(), 0u);
+    }
+
+    // A file count no file could hold; the magic and version are 5 bytes
+    auto damaged = saved.substr(0, 5);
+    write_varint(damaged, uint64_t(1) << 60);
+    fs.Write(root / "indexdb", damaged.data(), damaged.size());
+    ASSERT_FALSE(loaded.Load(fs, root / "indexdb"));
+}
+
+namespace
+{
+// A file system that can't say when a file changed
+class ZepFileSystemNoInfo : public ZepFileSystemCPP
+{
+public:
+    using ZepFileSystemCPP::ZepFileSystemCPP;
+    virtual bool GetFileInfo(const ZepPath& path, uint64_t& modifiedTime, uint64_t& size) const override
+    {
+        return IZepFileSystem::GetFileInfo(path, modifiedTime, size);
+    }
+};
+} // namespace
+
+TEST_F(TrigramIndexTest, WithoutFileInfoAlwaysStale)
+{
+    WriteFile("a.cpp", "int main()\n{\n    return Frobnicate();\n}\n");
+    std::vector<ZepPath> paths{ ZepPath("a.cpp") };
+
+    ZepFileSystemNoInfo fs(ZEP_ROOT);
+    TrigramIndex index;
+    ASSERT_EQ(index.Update(fs, root, paths), 1u);
+    ASSERT_EQ(index.SearchLiteral(fs, root, "Frobnicate").size(), 1u);
+
+    // Read every time, so a change is never missed
+    WriteFile("a.cpp", "int main()\n{\n    return Frobnicated + 1;\n}\n");
+    ASSERT_EQ(index.Update(fs, root, paths), 1u);
+    ASSERT_EQ(index.GetLiveFileCount(), 1u);
+    ASSERT_EQ(index.SearchLiteral(fs, root, "Frobnicated").size(), 1u);
+
+    // Gone is still gone
+    std::filesystem::remove((root / "a.cpp").string());
+    ASSERT_EQ(index.Update(fs, root, paths), 0u);
+    ASSERT_EQ(index.GetLiveFileCount(), 0u);
+}
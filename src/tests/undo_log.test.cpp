@@ -0,0 +1,189 @@
+#include "config_app.h"
+
+#include "zep/buffer.h"
+#include "zep/display.h"
+#include "zep/editor.h"
+#include "zep/mode.h"
+#include "zep/undo_log.h"
+
+#include <gtest/gtest.h>
+
+using namespace Zep;
+
+namespace
+{
+class UndoLogTest : public testing::Test
+{
+public:
+    UndoLogTest()
+    {
+        spEditor = std::make_shared<ZepEditor>(new ZepDisplayNull(), ZEP_ROOT, ZepEditorFlags::DisableThreads);
+        pBuffer = spEditor->InitWithText("Test Buffer", "");
+        spEditor->SetDisplayRegion(NVec2f(0.0f, 0.0f), NVec2f(1024.0f, 1024.0f));
+    }
+
+    std::string Text() const
+    {
+        return pBuffer->GetBufferText(pBuffer->Begin(), pBuffer->End());
+    }
+
+    void TypeKeys(const std::string& keys)
+    {
+        for (auto ch : keys)
+        {
+            pBuffer->GetMode()->AddKeyPress(ch);
+        }
+    }
+
+    // Edits made straight to the buffer, recorded as a mode would
+    void Insert(long offset, const std::string& text)
+    {
+        ChangeRecord changeRecord;
+        pBuffer->Insert(GlyphIterator(pBuffer, offset), text, changeRecord);
+        pBuffer->GetUndoLog().AddInsert(offset, text);
+    }
+
+    void Delete(long offset, long length)
+    {
+        ChangeRecord changeRecord;
+        pBuffer->Delete(GlyphIterator(pBuffer, offset), GlyphIterator(pBuffer, offset + length), changeRecord);
+        pBuffer->GetUndoLog().AddDelete(offset, changeRecord.strDeleted);
+    }
+
+    std::shared_ptr<ZepEditor> spEditor;
+    ZepBuffer* pBuffer = nullptr;
+};
+} // namespace
+
+TEST_F(UndoLogTest, TypingIsOneChange)
+{
+    // No 'j'; the insert map waits on it for "jk"
+    TypeKeys("ihello worms");
+    pBuffer->GetMode()->AddKeyPress(ExtKeys::ESCAPE);
+    ASSERT_EQ(Text(), "hello worms");
+
+    auto& undoLog = pBuffer->GetUndoLog();
+    EXPECT_EQ(undoLog.GetGroupCount(), 1u);
+    EXPECT_EQ(undoLog.GetChangeCount(), 1u);
+
+    // Each delete is an undo of its own
+    TypeKeys("xxx");
+    EXPECT_EQ(Text(), "hello wo");
+    EXPECT_EQ(undoLog.GetGroupCount(), 4u);
+
+    TypeKeys("uuu");
+    EXPECT_EQ(Text(), "hello worms");
+    TypeKeys("u");
+    EXPECT_EQ(Text(), "");
+
+    pBuffer->GetMode()->Redo();
+    EXPECT_EQ(Text(), "hello worms");
+
+    // A new edit replaces what could have been redone
+    TypeKeys("$x");
+    EXPECT_EQ(undoLog.GetGroupCount(), 2u);
+    pBuffer->GetMode()->Redo();
+    EXPECT_EQ(Text(), "hello worm");
+}
+
+TEST_F(UndoLogTest, DeletesJoinUp)
+{
+    Insert(0, "abcdefghij");
+    auto& undoLog = pBuffer->GetUndoLog();
+    undoLog.BeginGroup();
+
+    // Forward from one place, then back from it
+    Delete(4, 1);
+    Delete(4, 2);
+    Delete(3, 1);
+    Delete(2, 1);
+    EXPECT_EQ(Text(), "abhij");
+    EXPECT_EQ(undoLog.GetChangeCount(), 2u);
+
+    undoLog.Undo(*pBuffer);
+    EXPECT_EQ(Text(), "abcdefghij");
+    undoLog.Redo(*pBuffer);
+    EXPECT_EQ(Text(), "abhij");
+}
+
+TEST_F(UndoLogTest, LargeGroupInOneUndo)
+{
+    std::string original;
+    for (int i = 0; i < 50000; i++)
+    {
+        original += "a\n";
+    }
+    pBuffer->SetText(original);
+
+    // 100k edits, as a replace of every line would make
+    auto& undoLog = pBuffer->GetUndoLog();
+    undoLog.BeginGroup();
+    for (long line = 0; line < 50000; line++)
+    {
+        Delete(line * 2, 1);
+        Insert(line * 2, "b");
+    }
+    EXPECT_EQ(undoLog.GetChangeCount(), 100000u);
+    EXPECT_EQ(Text().substr(0, 6), "b\nb\nb\n");
+
+    auto cursor = undoLog.Undo(*pBuffer);
+    EXPECT_FALSE(cursor.Valid());
+    EXPECT_EQ(Text(), original);
+    EXPECT_EQ(pBuffer->GetLineCount(), 50001);
+
+    undoLog.Redo(*pBuffer);
+    EXPECT_EQ(Text().find('a'), std::string::npos);
+}
+
+TEST_F(UndoLogTest, TrimDropsOldest)
+{
+    auto& undoLog = pBuffer->GetUndoLog();
+    auto lineCount = pBuffer->GetLineCount();
+    for (int group = 0; group < 100; group++)
+    {
+        undoLog.BeginGroup();
+        Insert(0, std::string(100, char('a' + group % 26)) + "\n");
+        undoLog.Trim(4096, false);
+    }
+    EXPECT_LT(undoLog.GetGroupCount(), 100u);
+    EXPECT_LE(undoLog.GetUndoMemory(), 3 * 4096u);
+    EXPECT_EQ(undoLog.GetSpillCount(), 0u);
+
+    // Only as far back as it kept
+    auto kept = undoLog.GetGroupCount();
+    for (size_t group = 0; group < kept; group++)
+    {
+        undoLog.Undo(*pBuffer);
+    }
+    EXPECT_EQ(pBuffer->GetLineCount(), lineCount + long(100 - kept));
+    EXPECT_FALSE(undoLog.Undo(*pBuffer).Valid());
+    EXPECT_EQ(pBuffer->GetLineCount(), lineCount + long(100 - kept));
+}
+
+TEST_F(UndoLogTest, TrimSpillsAndComesBack)
+{
+    auto& undoLog = pBuffer->GetUndoLog();
+    auto lineCount = pBuffer->GetLineCount();
+    for (int group = 0; group < 100; group++)
+    {
+        undoLog.BeginGroup();
+        Insert(0, std::string(100, char('a' + group % 26)) + "\n");
+        undoLog.Trim(4096, true);
+    }
+    EXPECT_LT(undoLog.GetGroupCount(), 100u);
+    EXPECT_GT(undoLog.GetSpillCount(), 0u);
+
+    for (int group = 0; group < 100; group++)
+    {
+        undoLog.Undo(*pBuffer);
+    }
+    EXPECT_EQ(Text(), "");
+    EXPECT_EQ(undoLog.GetSpillCount(), 0u);
+
+    for (int group = 0; group < 100; group++)
+    {
+        undoLog.Redo(*pBuffer);
+    }
+    EXPECT_EQ(pBuffer->GetLineCount(), lineCount + 100);
+    EXPECT_EQ(Text().substr(0, 3), "vvv");
+}
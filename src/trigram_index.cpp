@@ -0,0 +1,678 @@
+#include <algorithm>
+#include <cctype>
+#include <cstring>
+#include <regex>
+#include <unordered_set>
+
+#include "zep/mcommon/file/varint.h"
+#include "zep/mcommon/logger.h"
+
+#include "zep/filesystem.h"
+#include "zep/trigram_index.h"
+
+namespace Zep
+{
+
+namespace
+{
+const char IndexMagic[4] = { 'Z', 'T', 'R', 'I' };
+const uint64_t IndexVersion = 1;
+
+// Files bigger than this are not worth indexing; they are likely generated
+const uint64_t MaxIndexedFileSize = 16 * 1024 * 1024;
+
+// Bytes to check for a zero when deciding if a file is binary
+const size_t BinaryCheckSize = 8000;
+
+inline uint8_t ToLowerASCII(uint8_t ch)
+{
+    return (ch >= 'A' && ch <= 'Z') ? uint8_t(ch + ('a' - 'A')) : ch;
+}
+
+// Walk the lines of a file; the callback gets the line text and the line number
+template <typename F>
+void ForEachLine(const std::string& text, F&& fn)
+{
+    size_t start = 0;
+    long line = 0;
+    while (start <= text.size())
+    {
+        auto end = text.find('\n', start);
+        if (end == std::string::npos)
+        {
+            end = text.size();
+        }
+        auto len = end - start;
+        if (len > 0 && text[end - 1] == '\r')
+        {
+            len--;
+        }
+        if (!fn(text.substr(start, len), line))
+        {
+            return;
+        }
+        start = end + 1;
+        line++;
+    }
+}
+
+} // namespace
+
+void TrigramIndex::GetTrigrams(const uint8_t* pBegin, const uint8_t* pEnd, std::vector<uint32_t>& trigrams)
+{
+    if (pEnd - pBegin < 3)
+    {
+        return;
+    }
+
+    for (auto pCh = pBegin; pCh + 2 < pEnd; pCh++)
+    {
+        // Matches are only ever verified a line at a time, so trigrams that span a line are useless
+        if (pCh[0] == '\n' || pCh[1] == '\n' || pCh[2] == '\n' || pCh[0] == '\r' || pCh[1] == '\r' || pCh[2] == '\r')
+        {
+            continue;
+        }
+        trigrams.push_back((uint32_t(ToLowerASCII(pCh[0])) << 16) | (uint32_t(ToLowerASCII(pCh[1])) << 8) | uint32_t(ToLowerASCII(pCh[2])));
+    }
+}
+
+std::vector<std::string> TrigramIndex::GetRequiredLiterals(const std::string& pattern)
+{
+    struct Group
+    {
+        std::vector<std::string> literals;
+        bool discard = false;
+    };
+
+    std::vector<Group> groups(1);
+    std::string current;
+
+    auto flush = [&]() {
+        if (!current.empty())
+        {
+            groups.back().literals.push_back(current);
+            current.clear();
+        }
+    };
+
+    auto isOptional = [&](size_t next) {
+        if (next >= pattern.size())
+        {
+            return false;
+        }
+        return pattern[next] == '*' || pattern[next] == '?' || pattern[next] == '{';
+    };
+
+    auto addLiteral = [&](char ch, size_t next) {
+        // A literal that can repeat zero times is not required
+        if (isOptional(next))
+        {
+            flush();
+            return;
+        }
+        current.push_back(ch);
+    };
+
+    for (size_t i = 0; i < pattern.size(); i++)
+    {
+        auto ch = pattern[i];
+        switch (ch)
+        {
+        case '|':
+            // Alternation; we can't say which side must be present, so nothing is required
+            return std::vector<std::string>();
+        case '\\':
+            if (i + 1 >= pattern.size())
+            {
+                return std::vector<std::string>();
+            }
+            i++;
+            if (std::isalnum((unsigned char)pattern[i]))
+            {
+                // Character classes, back references, word boundaries...
+                flush();
+            }
+            else
+            {
+                addLiteral(pattern[i], i + 1);
+            }
+            break;
+        case '(':
+            flush();
+            groups.emplace_back();
+            if (i + 1 < pattern.size() && pattern[i + 1] == '?')
+            {
+                // (?: is just a group; look arounds don't consume, so their contents are not required
+                groups.back().discard = (i + 2 >= pattern.size() || pattern[i + 2] != ':');
+                i += 2;
+            }
+            break;
+        case ')':
+        {
+            flush();
+            if (groups.size() < 2)
+            {
+                return std::vector<std::string>();
+            }
+            auto group = groups.back();
+            groups.pop_back();
+            if (!group.discard && !isOptional(i + 1))
+            {
+                groups.back().literals.insert(groups.back().literals.end(), group.literals.begin(), group.literals.end());
+            }
+        }
+        break;
+        case '[':
+        {
+            flush();
+            i++;
+            if (i < pattern.size() && pattern[i] == '^')
+            {
+                i++;
+            }
+            if (i < pattern.size() && pattern[i] == ']')
+            {
+                i++;
+            }
+            while (i < pattern.size() && pattern[i] != ']')
+            {
+                if (pattern[i] == '\\')
+                {
+                    i++;
+                }
+                i++;
+            }
+        }
+        break;
+        case '{':
+            flush();
+            while (i < pattern.size() && pattern[i] != '}')
+            {
+                i++;
+            }
+            break;
+        case '.':
+        case '^':
+        case '$':
+        case '*':
+        case '+':
+        case '?':
+            flush();
+            break;
+        default:
+            addLiteral(ch, i + 1);
+            break;
+        }
+    }
+    flush();
+
+    if (groups.size() != 1)
+    {
+        return std::vector<std::string>();
+    }
+    return groups[0].literals;
+}
+
+void TrigramIndex::AddFile(const ZepPath& path, uint64_t modifiedTime, uint64_t size, const std::string& text)
+{
+    auto id = uint32_t(m_files.size());
+
+    TrigramFile file;
+    file.path = path;
+    file.modifiedTime = modifiedTime;
+    file.size = size;
+    m_files.push_back(file);
+    m_lookup[path.string()] = id;
+
+    // Binary files are tracked so we don't re-read them, but never become candidates
+    auto checkSize = std::min(text.size(), BinaryCheckSize);
+    if (std::memchr(text.data(), 0, checkSize) != nullptr)
+    {
+        return;
+    }
+
+    std::vector<uint32_t> trigrams;
+    trigrams.reserve(text.size());
+    GetTrigrams((const uint8_t*)text.data(), (const uint8_t*)text.data() + text.size(), trigrams);
+    std::sort(trigrams.begin(), trigrams.end());
+    trigrams.erase(std::unique(trigrams.begin(), trigrams.end()), trigrams.end());
+
+    // Ids only ever grow, so the posting lists stay sorted
+    for (auto& t : trigrams)
+    {
+        m_postings[t].push_back(id);
+    }
+}
+
+void TrigramIndex::Compact()
+{
+    std::vector<uint32_t> remap(m_files.size(), uint32_t(-1));
+    std::vector<TrigramFile> files;
+    files.reserve(m_lookup.size());
+
+    m_lookup.clear();
+    for (uint32_t id = 0; id < uint32_t(m_files.size()); id++)
+    {
+        if (m_files[id].live)
+        {
+            remap[id] = uint32_t(files.size());
+            m_lookup[m_files[id].path.string()] = remap[id];
+            files.push_back(m_files[id]);
+        }
+    }
+
+    for (auto itr = m_postings.begin(); itr != m_postings.end();)
+    {
+        auto& ids = itr->second;
+        auto out = ids.begin();
+        for (auto& id : ids)
+        {
+            if (remap[id] != uint32_t(-1))
+            {
+                *out++ = remap[id];
+            }
+        }
+        ids.erase(out, ids.end());
+
+        if (ids.empty())
+        {
+            itr = m_postings.erase(itr);
+        }
+        else
+        {
+            ids.shrink_to_fit();
+            itr++;
+        }
+    }
+
+    m_files.swap(files);
+    m_deadFiles = 0;
+}
+
+bool TrigramIndex::RefreshFile(IZepFileSystem& fs, const ZepPath& root, const ZepPath& path)
+{
+    uint64_t modifiedTime = 0;
+    uint64_t size = 0;
+    auto fullPath = root / path;
+    if (!fs.GetFileInfo(fullPath, modifiedTime, size))
+    {
+        if (!fs.Exists(fullPath))
+        {
+            RemoveFile(path);
+            return false;
+        }
+
+        // No way to tell if it changed, so it always has
+        auto text = fs.Read(fullPath);
+        RemoveFile(path);
+        AddFile(path, 0, text.size(), text.size() > MaxIndexedFileSize ? std::string() : text);
+        return true;
+    }
+
+    auto itr = m_lookup.find(path.string());
+    if (itr != m_lookup.end())
+    {
+        auto& file = m_files[itr->second];
+        if (file.modifiedTime == modifiedTime && file.size == size)
+        {
+            return false;
+        }
+        RemoveFile(path);
+    }
+
+    AddFile(path, modifiedTime, size, size > MaxIndexedFileSize ? std::string() : fs.Read(fullPath));
+    return true;
+}
+
+void TrigramIndex::RemoveFile(const ZepPath& path)
+{
+    auto itr = m_lookup.find(path.string());
+    if (itr != m_lookup.end())
+    {
+        m_files[itr->second].live = false;
+        m_deadFiles++;
+        m_lookup.erase(itr);
+    }
+}
+
+uint32_t TrigramIndex::Update(IZepFileSystem& fs, const ZepPath& root, const std::vector<ZepPath>& paths)
+{
+    uint32_t updated = 0;
+    std::unordered_set<std::string> seen;
+    seen.reserve(paths.size());
+
+    for (auto& path : paths)
+    {
+        seen.insert(path.string());
+        if (RefreshFile(fs, root, path))
+        {
+            updated++;
+        }
+    }
+
+    // Forget files that have gone away
+    for (auto itr = m_lookup.begin(); itr != m_lookup.end();)
+    {
+        if (seen.find(itr->first) == seen.end())
+        {
+            m_files[itr->second].live = false;
+            m_deadFiles++;
+            itr = m_lookup.erase(itr);
+        }
+        else
+        {
+            itr++;
+        }
+    }
+
+    if (m_deadFiles > m_files.size() / 2)
+    {
+        Compact();
+    }
+
+    return updated;
+}
+
+uint32_t TrigramIndex::UpdateFiles(IZepFileSystem& fs, const ZepPath& root, const std::vector<ZepPath>& changed, const std::vector<ZepPath>& removed)
+{
+    for (auto& path : removed)
+    {
+        RemoveFile(path);
+    }
+
+    uint32_t updated = 0;
+    for (auto& path : changed)
+    {
+        if (RefreshFile(fs, root, path))
+        {
+            updated++;
+        }
+    }
+
+    if (m_deadFiles > m_files.size() / 2)
+    {
+        Compact();
+    }
+
+    return updated;
+}
+
+std::vector<uint32_t> TrigramIndex::GetCandidates(const std::vector<std::string>& literals) const
+{
+    std::vector<uint32_t> trigrams;
+    for (auto& literal : literals)
+    {
+        GetTrigrams((const uint8_t*)literal.data(), (const uint8_t*)literal.data() + literal.size(), trigrams);
+    }
+    std::sort(trigrams.begin(), trigrams.end());
+    trigrams.erase(std::unique(trigrams.begin(), trigrams.end()), trigrams.end());
+
+    std::vector<uint32_t> candidates;
+    if (trigrams.empty())
+    {
+        // Nothing to narrow the search with; every file is a candidate
+        candidates.reserve(m_lookup.size());
+        for (auto& [path, id] : m_lookup)
+        {
+            candidates.push_back(id);
+        }
+        std::sort(candidates.begin(), candidates.end());
+        return candidates;
+    }
+
+    std::vector<const std::vector<uint32_t>*> lists;
+    for (auto& t : trigrams)
+    {
+        auto itr = m_postings.find(t);
+        if (itr == m_postings.end())
+        {
+            return candidates;
+        }
+        lists.push_back(&itr->second);
+    }
+
+    // Shortest lists first, to keep the intersection small
+    std::sort(lists.begin(), lists.end(), [](auto lhs, auto rhs) { return lhs->size() < rhs->size(); });
+
+    candidates = *lists[0];
+    std::vector<uint32_t> scratch;
+    for (size_t i = 1; i < lists.size() && !candidates.empty(); i++)
+    {
+        scratch.clear();
+        std::set_intersection(candidates.begin(), candidates.end(), lists[i]->begin(), lists[i]->end(), std::back_inserter(scratch));
+        candidates.swap(scratch);
+    }
+
+    candidates.erase(std::remove_if(candidates.begin(), candidates.end(), [&](uint32_t id) { return !m_files[id].live; }), candidates.end());
+    return candidates;
+}
+
+std::vector<TrigramSearchResult> TrigramIndex::SearchLiteral(IZepFileSystem& fs, const ZepPath& root, const std::string& text, size_t maxResults) const
+{
+    std::vector<TrigramSearchResult> results;
+    if (text.empty())
+    {
+        return results;
+    }
+
+    for (auto id : GetCandidates({ text }))
+    {
+        auto& file = m_files[id];
+        auto contents = fs.Read(root / file.path);
+        ForEachLine(contents, [&](const std::string& line, long lineNumber) {
+            for (auto pos = line.find(text); pos != std::string::npos; pos = line.find(text, pos + 1))
+            {
+                results.push_back(TrigramSearchResult{ file.path, lineNumber, long(pos), line });
+                if (results.size() >= maxResults)
+                {
+                    return false;
+                }
+            }
+            return true;
+        });
+
+        if (results.size() >= maxResults)
+        {
+            break;
+        }
+    }
+    return results;
+}
+
+std::vector<TrigramSearchResult> TrigramIndex::SearchRegex(IZepFileSystem& fs, const ZepPath& root, const std::string& pattern, size_t maxResults) const
+{
+    std::vector<TrigramSearchResult> results;
+
+    std::regex re;
+    try
+    {
+        re = std::regex(pattern);
+    }
+    catch (std::regex_error& err)
+    {
+        ZLOG(ERROR, "Bad search pattern: " << pattern << " : " << err.what());
+        return results;
+    }
+
+    for (auto id : GetCandidates(GetRequiredLiterals(pattern)))
+    {
+        auto& file = m_files[id];
+        auto contents = fs.Read(root / file.path);
+        ForEachLine(contents, [&](const std::string& line, long lineNumber) {
+            std::smatch match;
+            if (std::regex_search(line, match, re))
+            {
+                results.push_back(TrigramSearchResult{ file.path, lineNumber, long(match.position(0)), line });
+            }
+            return results.size() < maxResults;
+        });
+
+        if (results.size() >= maxResults)
+        {
+            break;
+        }
+    }
+    return results;
+}
+
+bool TrigramIndex::Save(IZepFileSystem& fs, const ZepPath& dbPath) const
+{
+    // Only live files are written, so ids are remapped on the way out
+    std::vector<uint32_t> remap(m_files.size(), uint32_t(-1));
+    uint32_t liveCount = 0;
+    for (uint32_t id = 0; id < uint32_t(m_files.size()); id++)
+    {
+        if (m_files[id].live)
+        {
+            remap[id] = liveCount++;
+        }
+    }
+
+    std::string out;
+    out.append(IndexMagic, sizeof(IndexMagic));
+    write_varint(out, IndexVersion);
+
+    write_varint(out, liveCount);
+    for (auto& file : m_files)
+    {
+        if (!file.live)
+        {
+            continue;
+        }
+        auto str = file.path.string();
+        write_varint(out, str.size());
+        out.append(str);
+        write_varint(out, file.modifiedTime);
+        write_varint(out, file.size);
+    }
+
+    std::vector<uint32_t> ids;
+    std::string postings;
+    uint64_t postingCount = 0;
+    for (auto& [trigram, list] : m_postings)
+    {
+        ids.clear();
+        for (auto& id : list)
+        {
+            if (remap[id] != uint32_t(-1))
+            {
+                ids.push_back(remap[id]);
+            }
+        }
+        if (ids.empty())
+        {
+            continue;
+        }
+
+        // Lists are sorted, so store the deltas
+        write_varint(postings, trigram);
+        write_varint(postings, ids.size());
+        uint32_t last = 0;
+        for (auto& id : ids)
+        {
+            write_varint(postings, id - last);
+            last = id;
+        }
+        postingCount++;
+    }
+
+    write_varint(out, postingCount);
+    out.append(postings);
+
+    return fs.Write(dbPath, out.data(), out.size());
+}
+
+bool TrigramIndex::Load(IZepFileSystem& fs, const ZepPath& dbPath)
+{
+    m_files.clear();
+    m_lookup.clear();
+    m_postings.clear();
+    m_deadFiles = 0;
+
+    if (!fs.Exists(dbPath))
+    {
+        return false;
+    }
+
+    auto in = fs.Read(dbPath);
+    if (in.size() < sizeof(IndexMagic) || memcmp(in.data(), IndexMagic, sizeof(IndexMagic)) != 0)
+    {
+        return false;
+    }
+
+    auto fail = [&]() {
+        ZLOG(INFO, "Discarding bad index: " << dbPath.string());
+        m_files.clear();
+        m_lookup.clear();
+        m_postings.clear();
+        return false;
+    };
+
+    size_t pos = sizeof(IndexMagic);
+    uint64_t version = 0;
+    uint64_t fileCount = 0;
+    // Every entry takes a byte or more, so no count can be bigger than what is left; checked before anything is
+    // reserved, so a damaged file can't ask for more memory than there is
+    if (!read_varint(in, pos, version) || version != IndexVersion || !read_varint(in, pos, fileCount) || fileCount > in.size() - pos)
+    {
+        return fail();
+    }
+
+    m_files.reserve(size_t(fileCount));
+    for (uint64_t i = 0; i < fileCount; i++)
+    {
+        uint64_t len = 0;
+        TrigramFile file;
+        if (!read_varint(in, pos, len) || len > in.size() - pos)
+        {
+            return fail();
+        }
+        file.path = ZepPath(in.substr(pos, size_t(len)));
+        pos += size_t(len);
+        if (!read_varint(in, pos, file.modifiedTime) || !read_varint(in, pos, file.size))
+        {
+            return fail();
+        }
+        m_lookup[file.path.string()] = uint32_t(m_files.size());
+        m_files.push_back(file);
+    }
+
+    uint64_t postingCount = 0;
+    if (!read_varint(in, pos, postingCount) || postingCount > in.size() - pos)
+    {
+        return fail();
+    }
+
+    m_postings.reserve(size_t(postingCount));
+    for (uint64_t i = 0; i < postingCount; i++)
+    {
+        uint64_t trigram = 0;
+        uint64_t count = 0;
+        if (!read_varint(in, pos, trigram) || !read_varint(in, pos, count) || count > fileCount || count > in.size() - pos)
+        {
+            return fail();
+        }
+
+        auto& ids = m_postings[uint32_t(trigram)];
+        ids.reserve(size_t(count));
+        uint64_t id = 0;
+        for (uint64_t c = 0; c < count; c++)
+        {
+            uint64_t delta = 0;
+            if (!read_varint(in, pos, delta))
+            {
+                return fail();
+            }
+            id += delta;
+            if (id >= fileCount)
+            {
+                return fail();
+            }
+            ids.push_back(uint32_t(id));
+        }
+    }
+
+    return true;
+}
+
+} // namespace Zep
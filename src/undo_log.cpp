@@ -0,0 +1,446 @@
+#include <cassert>
+#include <limits>
+
+#include "zep/buffer.h"
+#include "zep/editor.h"
+#include "zep/undo_log.h"
+
+#include "zep/mcommon/file/varint.h"
+#include "zep/mcommon/memory.h"
+
+namespace Zep
+{
+
+UndoLog::~UndoLog()
+{
+    if (m_pSpillFile)
+    {
+        std::fclose(m_pSpillFile);
+    }
+}
+
+void UndoLog::Clear()
+{
+    m_changes.clear();
+    m_groups.clear();
+    m_text.clear();
+    m_current = 0;
+
+    m_spills.clear();
+    if (m_pSpillFile)
+    {
+        std::fclose(m_pSpillFile);
+        m_pSpillFile = nullptr;
+    }
+}
+
+void UndoLog::TruncateRedo()
+{
+    if (m_current == m_groups.size())
+    {
+        return;
+    }
+
+    auto firstChange = m_groups[m_current].firstChange;
+    if (firstChange < m_changes.size())
+    {
+        m_text.resize(m_changes[firstChange].textStart);
+    }
+    m_changes.resize(firstChange);
+    m_groups.resize(m_current);
+}
+
+void UndoLog::BeginGroup()
+{
+    TruncateRedo();
+
+    // One that never got any changes is used again
+    Group group;
+    group.firstChange = m_changes.size();
+    if (!m_groups.empty() && m_groups.back().firstChange == m_changes.size())
+    {
+        m_groups.back() = group;
+        return;
+    }
+
+    m_groups.push_back(group);
+    m_current = m_groups.size();
+}
+
+UndoLog::Group& UndoLog::CurrentGroup()
+{
+    TruncateRedo();
+    if (m_groups.empty())
+    {
+        BeginGroup();
+    }
+    return m_groups.back();
+}
+
+size_t UndoLog::GroupEnd(size_t group) const
+{
+    return group + 1 < m_groups.size() ? m_groups[group + 1].firstChange : m_changes.size();
+}
+
+void UndoLog::AddInsert(ByteIndex offset, const std::string& text)
+{
+    if (text.empty())
+    {
+        return;
+    }
+    assert(text.size() < std::numeric_limits<uint32_t>::max());
+
+    auto& group = CurrentGroup();
+    if (m_changes.size() > group.firstChange)
+    {
+        // Typing on from the last insert
+        auto& last = m_changes.back();
+        if (last.inserted && offset == last.offset + ByteIndex(last.textLength) && text.size() < std::numeric_limits<uint32_t>::max() - last.textLength)
+        {
+            m_text.append(text);
+            last.textLength += uint32_t(text.size());
+            return;
+        }
+    }
+
+    Change change;
+    change.offset = offset;
+    change.textStart = m_text.size();
+    change.textLength = uint32_t(text.size());
+    change.inserted = true;
+    m_text.append(text);
+    m_changes.push_back(change);
+}
+
+void UndoLog::AddDelete(ByteIndex offset, const std::string& text)
+{
+    if (text.empty())
+    {
+        return;
+    }
+    assert(text.size() < std::numeric_limits<uint32_t>::max());
+
+    auto& group = CurrentGroup();
+    auto length = ByteIndex(text.size());
+    if (m_changes.size() > group.firstChange && text.size() < std::numeric_limits<uint32_t>::max() - m_changes.back().textLength)
+    {
+        auto& last = m_changes.back();
+        auto lastEnd = last.offset + ByteIndex(last.textLength);
+        if (last.inserted && offset >= last.offset && offset + length == lastEnd)
+        {
+            // Backspacing over what was just typed; it was never there
+            m_text.resize(m_text.size() - text.size());
+            last.textLength -= uint32_t(text.size());
+            if (last.textLength == 0)
+            {
+                m_changes.pop_back();
+            }
+            return;
+        }
+        else if (!last.inserted && offset == last.offset)
+        {
+            // Deleting forward from the same place
+            m_text.append(text);
+            last.textLength += uint32_t(text.size());
+            return;
+        }
+        else if (!last.inserted && offset + length == last.offset)
+        {
+            // Backspacing; the last change's text is at the end, so only it moves up
+            m_text.insert(last.textStart, text);
+            last.offset = offset;
+            last.textLength += uint32_t(text.size());
+            return;
+        }
+    }
+
+    Change change;
+    change.offset = offset;
+    change.textStart = m_text.size();
+    change.textLength = uint32_t(text.size());
+    change.inserted = false;
+    m_text.append(text);
+    m_changes.push_back(change);
+}
+
+void UndoLog::AddCursors(const GlyphIterator& before, const GlyphIterator& after)
+{
+    auto& group = CurrentGroup();
+    if (before.Valid() && group.cursorBefore < 0)
+    {
+        group.cursorBefore = before.Index();
+    }
+    if (after.Valid())
+    {
+        group.cursorAfter = after.Index();
+    }
+}
+
+GlyphIterator UndoLog::Undo(ZepBuffer& buffer)
+{
+    // Groups with nothing in them are passed over; going past the oldest we have brings back any spilled
+    for (;;)
+    {
+        while (m_current > 0 && GroupEnd(m_current - 1) == m_groups[m_current - 1].firstChange)
+        {
+            m_current--;
+        }
+        if (m_current > 0 || !Unspill())
+        {
+            break;
+        }
+    }
+
+    if (m_current == 0)
+    {
+        return GlyphIterator();
+    }
+
+    m_current--;
+    auto group = m_groups[m_current];
+
+    // Listeners hear about the lot once, at the end
+    buffer.GetEditor().BeginBufferChanges();
+    ChangeRecord changeRecord;
+    for (auto index = GroupEnd(m_current); index > group.firstChange; index--)
+    {
+        auto& change = m_changes[index - 1];
+        changeRecord.Clear();
+        if (change.inserted)
+        {
+            buffer.Delete(GlyphIterator(&buffer, change.offset), GlyphIterator(&buffer, change.offset + change.textLength), changeRecord);
+        }
+        else
+        {
+            buffer.Insert(GlyphIterator(&buffer, change.offset), m_text.substr(change.textStart, change.textLength), changeRecord);
+        }
+    }
+    buffer.GetEditor().EndBufferChanges();
+
+    return group.cursorBefore >= 0 ? GlyphIterator(&buffer, group.cursorBefore) : GlyphIterator();
+}
+
+GlyphIterator UndoLog::Redo(ZepBuffer& buffer)
+{
+    while (m_current < m_groups.size() && GroupEnd(m_current) == m_groups[m_current].firstChange)
+    {
+        m_current++;
+    }
+
+    if (m_current == m_groups.size())
+    {
+        return GlyphIterator();
+    }
+
+    auto group = m_groups[m_current];
+    buffer.GetEditor().BeginBufferChanges();
+    ChangeRecord changeRecord;
+    for (auto index = group.firstChange; index < GroupEnd(m_current); index++)
+    {
+        auto& change = m_changes[index];
+        changeRecord.Clear();
+        if (change.inserted)
+        {
+            buffer.Insert(GlyphIterator(&buffer, change.offset), m_text.substr(change.textStart, change.textLength), changeRecord);
+        }
+        else
+        {
+            buffer.Delete(GlyphIterator(&buffer, change.offset), GlyphIterator(&buffer, change.offset + change.textLength), changeRecord);
+        }
+    }
+    buffer.GetEditor().EndBufferChanges();
+    m_current++;
+
+    return group.cursorAfter >= 0 ? GlyphIterator(&buffer, group.cursorAfter) : GlyphIterator();
+}
+
+uint64_t UndoLog::GetUsedMemory(size_t groupBegin, size_t groupEnd) const
+{
+    if (groupBegin >= groupEnd)
+    {
+        return 0;
+    }
+
+    auto changeBegin = m_groups[groupBegin].firstChange;
+    auto changeEnd = GroupEnd(groupEnd - 1);
+    auto textBegin = changeBegin < m_changes.size() ? m_changes[changeBegin].textStart : m_text.size();
+    auto textEnd = changeEnd < m_changes.size() ? m_changes[changeEnd].textStart : m_text.size();
+    return (groupEnd - groupBegin) * sizeof(Group) + (changeEnd - changeBegin) * sizeof(Change) + (textEnd - textBegin);
+}
+
+uint64_t UndoLog::GetUndoMemory() const
+{
+    // The spare room is the undo side's; it is what the next change goes into
+    auto total = memory_vector_bytes(m_changes) + memory_vector_bytes(m_groups) + memory_string_bytes(m_text);
+    auto redo = GetRedoMemory();
+    return total > redo ? total - redo : 0;
+}
+
+uint64_t UndoLog::GetRedoMemory() const
+{
+    return GetUsedMemory(m_current, m_groups.size());
+}
+
+void UndoLog::Trim(uint64_t budget, bool spill)
+{
+    if (budget == 0 || GetUsedMemory(0, m_groups.size()) <= budget)
+    {
+        return;
+    }
+
+    // Down to half the budget, so it isn't every change that pays; the group still being added to stays
+    auto excess = GetUsedMemory(0, m_groups.size()) - budget / 2;
+    size_t count = 0;
+    while (count + 1 < m_current && GetUsedMemory(0, count) < excess)
+    {
+        count++;
+    }
+    if (count == 0)
+    {
+        return;
+    }
+
+    if (spill)
+    {
+        Spill(count);
+    }
+    else
+    {
+        // What was spilled before is older than what goes now; without it in between it is no use
+        m_spills.clear();
+    }
+
+    auto changeEnd = m_groups[count].firstChange;
+    auto textEnd = changeEnd < m_changes.size() ? m_changes[changeEnd].textStart : m_text.size();
+    m_text.erase(0, textEnd);
+    m_changes.erase(m_changes.begin(), m_changes.begin() + changeEnd);
+    for (auto& change : m_changes)
+    {
+        change.textStart -= textEnd;
+    }
+    m_groups.erase(m_groups.begin(), m_groups.begin() + count);
+    for (auto& group : m_groups)
+    {
+        group.firstChange -= changeEnd;
+    }
+    m_current -= count;
+
+    // The point is to give the memory back
+    m_text.shrink_to_fit();
+    m_changes.shrink_to_fit();
+    m_groups.shrink_to_fit();
+}
+
+// A chunk is the group count, then for each group its change count and cursors (plus one, so -1 fits), then
+// each change's offset, length and kind; the text of all of them follows, in order
+void UndoLog::Spill(size_t groupCount)
+{
+    std::string chunk;
+    write_varint(chunk, groupCount);
+    for (size_t group = 0; group < groupCount; group++)
+    {
+        write_varint(chunk, GroupEnd(group) - m_groups[group].firstChange);
+        write_varint(chunk, uint64_t(m_groups[group].cursorBefore + 1));
+        write_varint(chunk, uint64_t(m_groups[group].cursorAfter + 1));
+        for (auto index = m_groups[group].firstChange; index < GroupEnd(group); index++)
+        {
+            write_varint(chunk, uint64_t(m_changes[index].offset));
+            write_varint(chunk, m_changes[index].textLength);
+            chunk.push_back(m_changes[index].inserted ? 1 : 0);
+        }
+    }
+    auto changeEnd = GroupEnd(groupCount - 1);
+    chunk.append(m_text, 0, changeEnd < m_changes.size() ? m_changes[changeEnd].textStart : m_text.size());
+
+    if (!m_pSpillFile)
+    {
+        m_pSpillFile = std::tmpfile();
+    }
+
+    auto offset = m_spills.empty() ? 0l : m_spills.back().first + m_spills.back().second;
+    if (!m_pSpillFile || std::fseek(m_pSpillFile, offset, SEEK_SET) != 0 || std::fwrite(chunk.data(), 1, chunk.size(), m_pSpillFile) != chunk.size())
+    {
+        // Nowhere to put it; it is dropped like any other
+        m_spills.clear();
+        return;
+    }
+    m_spills.push_back({ offset, long(chunk.size()) });
+}
+
+bool UndoLog::Unspill()
+{
+    if (m_spills.empty())
+    {
+        return false;
+    }
+
+    auto spill = m_spills.back();
+    m_spills.pop_back();
+
+    std::string chunk(size_t(spill.second), 0);
+    if (std::fseek(m_pSpillFile, spill.first, SEEK_SET) != 0 || std::fread(&chunk[0], 1, chunk.size(), m_pSpillFile) != chunk.size())
+    {
+        m_spills.clear();
+        return false;
+    }
+
+    std::vector<Change> changes;
+    std::vector<Group> groups;
+    size_t textSize = 0;
+    size_t pos = 0;
+    uint64_t groupCount = 0;
+    auto parsed = read_varint(chunk, pos, groupCount);
+    for (uint64_t group = 0; parsed && group < groupCount; group++)
+    {
+        uint64_t changeCount = 0;
+        uint64_t cursorBefore = 0;
+        uint64_t cursorAfter = 0;
+        parsed = read_varint(chunk, pos, changeCount) && read_varint(chunk, pos, cursorBefore) && read_varint(chunk, pos, cursorAfter);
+
+        Group newGroup;
+        newGroup.firstChange = changes.size();
+        newGroup.cursorBefore = ByteIndex(cursorBefore) - 1;
+        newGroup.cursorAfter = ByteIndex(cursorAfter) - 1;
+        groups.push_back(newGroup);
+
+        for (uint64_t index = 0; parsed && index < changeCount; index++)
+        {
+            uint64_t offset = 0;
+            uint64_t length = 0;
+            parsed = read_varint(chunk, pos, offset) && read_varint(chunk, pos, length) && pos < chunk.size();
+            if (parsed)
+            {
+                Change change;
+                change.offset = ByteIndex(offset);
+                change.textStart = textSize;
+                change.textLength = uint32_t(length);
+                change.inserted = chunk[pos++] != 0;
+                changes.push_back(change);
+                textSize += change.textLength;
+            }
+        }
+    }
+
+    if (!parsed || chunk.size() - pos != textSize)
+    {
+        m_spills.clear();
+        return false;
+    }
+
+    // Older than anything here, so it all goes in front
+    for (auto& change : m_changes)
+    {
+        change.textStart += textSize;
+    }
+    for (auto& group : m_groups)
+    {
+        group.firstChange += changes.size();
+    }
+    m_changes.insert(m_changes.begin(), changes.begin(), changes.end());
+    m_groups.insert(m_groups.begin(), groups.begin(), groups.end());
+    m_text.insert(0, chunk, pos, textSize);
+    m_current += groups.size();
+    return true;
+}
+
+} // namespace Zep
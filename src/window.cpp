@@ -12,6 +12,7 @@
 #include "zep/window.h"
 
 #include "zep/mcommon/logger.h"
+#include "zep/mcommon/memory.h"
 #include "zep/mcommon/string/stringutils.h"
 #include "zep/mcommon/utf8.h"
 
@@ -34,9 +35,10 @@ namespace Zep
 
 const float ScrollBarSize = 17.0f;
 const float UnderlineMargin = 1.0f;
+const float ToolTipDelay = 0.5f; // Seconds the mouse rests before we ask for a tip
 
 ZepWindow::ZepWindow(ZepTabWindow& window, ZepBuffer* buffer)
-    : ZepComponent(window.GetEditor())
+    : ZepComponent(window.GetEditor(), ComponentMessages::Subscribed)
     , m_tabWindow(window)
     , m_pBuffer(buffer)
 {
@@ -80,6 +82,7 @@ ZepWindow::ZepWindow(ZepTabWindow& window, ZepBuffer* buffer)
     m_vScroller = std::make_shared<Scroller>(GetEditor(), *m_vScrollRegion);
     m_vScroller->vertical = false;
 
+    GetEditor().Subscribe(this, { Msg::ComponentChanged, Msg::MouseMove, Msg::MouseDown, Msg::ConfigChanged });
     SetBuffer(m_pBuffer);
 
     timer_start(m_toolTipTimer);
@@ -162,6 +165,11 @@ void ZepWindow::UpdateAirline()
     m_airline.leftBoxes.push_back(AirBox{ m_pBuffer->GetDisplayName(), FilterActiveColor(m_pBuffer->GetTheme().GetColor(ThemeColor::AirlineBackground)) });
     m_airline.leftBoxes.push_back(AirBox{ std::to_string(cursor.x) + ":" + std::to_string(cursor.y), m_pBuffer->GetTheme().GetColor(ThemeColor::TabActive) });
 
+    if (m_pBuffer->HasFileFlags(FileFlags::ChangedOnDisk))
+    {
+        m_airline.leftBoxes.push_back(AirBox{ "CHANGED ON DISK", m_pBuffer->GetTheme().GetColor(ThemeColor::Warning) });
+    }
+
 #ifdef _DEBUG
     m_airline.leftBoxes.push_back(AirBox{ "(" + std::to_string(GetEditor().GetDisplay().GetPixelScale().x) + "," + std::to_string(GetEditor().GetDisplay().GetPixelScale().y) + ")", m_pBuffer->GetTheme().GetColor(ThemeColor::Error) });
 #endif
@@ -182,11 +190,6 @@ void ZepWindow::Notify(std::shared_ptr<ZepMessage> payload)
     {
         auto pMsg = std::static_pointer_cast<BufferMessage>(payload);
 
-        if (pMsg->pBuffer != m_pBuffer)
-        {
-            return;
-        }
-
         m_layoutDirty = true;
 
         if (pMsg->type != BufferMessageType::PreBufferChange)
@@ -227,6 +230,21 @@ void ZepWindow::Notify(std::shared_ptr<ZepMessage> payload)
 
             // Can now show tooltip again, due to mouse hover
             m_tipDisabledTillMove = false;
+
+            // Look again once the mouse has been still for long enough
+            GetEditor().ScheduleTick(this, ToolTipDelay);
+        }
+    }
+    else if (payload->messageId == Msg::Tick)
+    {
+        auto elapsed = float(timer_get_elapsed_seconds(m_toolTipTimer));
+        if (elapsed > ToolTipDelay)
+        {
+            GetEditor().RequestRefresh();
+        }
+        else
+        {
+            GetEditor().ScheduleTick(this, ToolTipDelay - elapsed + 0.001f);
         }
     }
     else if (payload->messageId == Msg::ConfigChanged)
@@ -979,7 +997,7 @@ void ZepWindow::DisplayLineBackground(SpanInfo& lineInfo, ZepSyntax* pSyntax)
 
                 // If this marker has an associated tooltip, pop it up after a time delay
                 // TODO: Make tooltip generation seperate to this display loop
-                if (m_toolTips.empty() && !m_tipDisabledTillMove && (tipTimeSeconds > 0.5f))
+                if (m_toolTips.empty() && !m_tipDisabledTillMove && (tipTimeSeconds > ToolTipDelay))
                 {
                     bool showTip = false;
                     if (marker->displayType & RangeMarkerDisplayType::Tooltip)
@@ -1387,6 +1405,12 @@ void ZepWindow::DisableToolTipTillMove()
 void ZepWindow::SetBuffer(ZepBuffer* pBuffer)
 {
     assert(pBuffer);
+    pBuffer->Wake();
+    auto pOldBuffer = m_pBuffer;
+
+    // Only the messages from our own buffer
+    GetEditor().Unsubscribe(this, Msg::Buffer, m_pBuffer);
+    GetEditor().Subscribe(this, Msg::Buffer, pBuffer);
 
     m_pBuffer = pBuffer;
     m_layoutDirty = true;
@@ -1399,6 +1423,13 @@ void ZepWindow::SetBuffer(ZepBuffer* pBuffer)
         pBuffer->GetMode()->Begin(this);
     }
     GetEditor().UpdateTabs();
+
+    // The buffer we showed before may be hidden now.  Not while we are being made; until the tab window
+    // has us, our own buffer looks hidden too
+    if (pOldBuffer != pBuffer)
+    {
+        GetEditor().UpdateHibernation();
+    }
 }
 
 GlyphIterator ZepWindow::GetBufferCursor()
@@ -1409,6 +1440,15 @@ GlyphIterator ZepWindow::GetBufferCursor()
     return m_bufferCursor;
 }
 
+void ZepWindow::AddMemoryUsage(BufferMemory& memory) const
+{
+    memory.windows += memory_vector_bytes(m_windowLines);
+    for (auto pLine : m_windowLines)
+    {
+        memory.windows += sizeof(SpanInfo) + memory_vector_bytes(pLine->lineCodePoints);
+    }
+}
+
 ZepBuffer& ZepWindow::GetBuffer() const
 {
     return *m_pBuffer;
@@ -1645,13 +1685,48 @@ void ZepWindow::DisplayGridMarkers()
     */
 }
 
+// A virtual list buffer only holds a page of lines; it is kept a line bigger than the window at each end, so that
+// line motions can step off the visible part, and is slid along the list when the cursor reaches the edge.
+void ZepWindow::UpdateVirtualPage()
+{
+    auto pageLines = std::max(1l, GetMaxDisplayLines()) + 2;
+    auto pageStart = m_pBuffer->GetVirtualPageStart();
+    auto cursorLine = m_pBuffer->GetBufferLine(m_bufferCursor);
+    auto row = pageStart + cursorLine;
+
+    auto newStart = pageStart;
+    if (cursorLine == 0)
+    {
+        newStart = row - 1;
+    }
+    else if (cursorLine >= pageLines - 1)
+    {
+        newStart = row - pageLines + 2;
+    }
+
+    if (m_pBuffer->SetVirtualPage(newStart, pageLines))
+    {
+        ByteRange range;
+        if (m_pBuffer->GetLineOffsets(row - m_pBuffer->GetVirtualPageStart(), range))
+        {
+            SetBufferCursor(GlyphIterator(m_pBuffer, range.first));
+        }
+    }
+}
+
 void ZepWindow::Display()
 {
     TIME_SCOPE(Display);
+    auto layoutStart = timer_get_time_now();
 
     auto pMode = GetBuffer().GetMode();
     pMode->PreDisplay(*this);
 
+    if (m_pBuffer->GetBufferType() == BufferType::VirtualList)
+    {
+        UpdateVirtualPage();
+    }
+
     // Ensure line spans are valid; updated if the text is changed or the window dimensions change
     UpdateLayout();
     ScrollToCursor();
@@ -1678,6 +1753,7 @@ void ZepWindow::Display()
     UpdateAirline();
 
     UpdateLayout();
+    GetEditor().AddLayoutLatency(timer_get_time_now() - layoutStart);
 
     if (GetEditor().GetConfig().style == EditorStyle::Normal)
     {
@@ -1785,7 +1861,7 @@ void ZepWindow::Display()
     }
 
     // No tooltip, and we can show one, then ask for tooltips from any client that wants to show them
-    if (!m_tipDisabledTillMove && (timer_get_elapsed_seconds(m_toolTipTimer) > 0.5f) && m_toolTips.empty() && m_lastTipQueryPos != m_mouseHoverPos)
+    if (!m_tipDisabledTillMove && (timer_get_elapsed_seconds(m_toolTipTimer) > ToolTipDelay) && m_toolTips.empty() && m_lastTipQueryPos != m_mouseHoverPos)
     {
         auto spMsg = std::make_shared<ToolTipMessage>(m_pBuffer, m_mouseHoverPos, m_mouseBufferLocation);
         GetEditor().Broadcast(spMsg);
@@ -1,8 +1,10 @@
 #include <gtest/gtest.h>
 
+// Count the allocations, so tests can check how many a change makes
+#include "zep/mcommon/memory_hooks.h"
+
 int main(int argc, char* argv[])
 {
     ::testing::InitGoogleTest(&argc, argv);
     return RUN_ALL_TESTS();
 }
-